@@ -114,6 +114,7 @@ struct ExternalVariable
 //==============================================================================
 /** This holds a short MIDI message and a frame-based timestamp, and is used in
     various places where buffers of time-stamped MIDI messages are needed.
+    Longer messages such as SysEx can't be represented, so they can't be sent to a patch.
  */
 struct MIDIEvent
 {
@@ -276,6 +277,20 @@ struct BuildSettings
     std::string  mainProcessor;
     SourceFiles  overrideStandardLibrary;
 
+    /** If this isn't empty, the compiler records a profile of each phase of the build and
+        writes it to this file in the Chrome trace-event format.
+        @see CompileProfiler
+    */
+    std::string  compileProfileFile;
+
+    /** If this is non-zero, a performer should instrument the program so that it counts
+        the CPU cycles spent in each of its processors (if it's 1) or in each of its
+        functions (if it's 2), by passing these settings to ExecutionProfile::apply()
+        when it links the program.
+        @see ExecutionProfile, Performer::getExecutionProfile
+    */
+    int          executionProfileLevel = 0;
+
     choc::value::Value customSettings;
 };
 
@@ -16,6 +16,7 @@
 #include "../../soul_patch.h"
 #include "../../patch/helper_classes/soul_patch_Utilities.h"
 #include "../../common/soul_ProgramDefinitions.h"
+#include "../../3rdParty/choc/containers/choc_SingleReaderMultipleWriterFIFO.h"
 
 namespace soul
 {
@@ -37,7 +38,8 @@ namespace patch
 struct SOULPatchAudioProcessor    : public juce::AudioPluginInstance,
                                     private juce::Thread,
                                     private juce::AsyncUpdater,
-                                    private juce::Timer
+                                    private juce::Timer,
+                                    private juce::MidiKeyboardState::Listener
 {
     /** Creates a SOULPatchAudioProcessor from a PatchInstance.
 
@@ -65,11 +67,15 @@ struct SOULPatchAudioProcessor    : public juce::AudioPluginInstance,
          millisecsBetweenFileChecks (millisecondsBetweenFileChangeChecks <= 0 ? -1 : millisecondsBetweenFileChangeChecks)
     {
         jassert (patch != nullptr);
+        injectedMIDI.reset (maxInjectedMIDIMessages);
+        injectedMIDIForBlock.resize (maxInjectedMIDIMessages);
+        midiKeyboardState.addListener (this);
         startThread (3);
     }
 
     ~SOULPatchAudioProcessor() override
     {
+        midiKeyboardState.removeListener (this);
         stopThread (100000);
         stopTimer();
         player = {};
@@ -263,9 +269,9 @@ struct SOULPatchAudioProcessor    : public juce::AudioPluginInstance,
         numPatchInputChannels = 0;
         numPatchOutputChannels = 0;
         setRateAndBufferSizeDetails (sampleRate, maxBlockSize);
-        midiCollector.reset (sampleRate);
         midiKeyboardState.reset();
         playheadState.reset();
+        lastMIDIBlockTime = juce::Time::getMillisecondCounterHiRes() * 0.001;
 
         if (player != nullptr)
         {
@@ -299,87 +305,113 @@ struct SOULPatchAudioProcessor    : public juce::AudioPluginInstance,
     {
         auto numFrames = audio.getNumSamples();
 
-        outputBuffer.setSize (juce::jmax (numPatchOutputChannels, getTotalNumOutputChannels()), numFrames, false, false, true);
-        outputBuffer.clear();
+        if (player == nullptr || ! player->isPlayable() || isSuspended())
+        {
+            for (int i = 0; i < getTotalNumOutputChannels(); ++i)
+                audio.clear (i, 0, numFrames);
 
-        inputBuffer.setSize (juce::jmax (numPatchInputChannels, getTotalNumInputChannels()), numFrames, false, false, true);
-        inputBuffer.clear();
+            return;
+        }
 
-        if (player != nullptr && player->isPlayable() && ! isSuspended())
-        {
-            if (auto playhead = getPlayHead())
-                playheadState.updateAndApply (*playhead, *player);
+        if (auto playhead = getPlayHead())
+            playheadState.updateAndApply (*playhead, *player);
 
-            soul::patch::PatchPlayer::RenderContext rc;
+        // The player consumes all of its input before it writes any output, so when the
+        // patch's channels line up with the host's, it can read and write the host's buffer
+        // directly, and the scratch buffers are only needed when some conversion is required.
+        bool readInputInPlace   = preprocessInputData   == nullptr && numPatchInputChannels  <= getTotalNumInputChannels();
+        bool writeOutputInPlace = postprocessOutputData == nullptr && numPatchOutputChannels <= getTotalNumOutputChannels();
 
-            for (int i = 0; i < getTotalNumInputChannels(); i++)
-                inputBuffer.copyFrom (i, 0, audio, i, 0, numFrames);
+        soul::patch::PatchPlayer::RenderContext rc;
 
-            if (preprocessInputData != nullptr)
-                preprocessInputData (inputBuffer);
+        if (readInputInPlace)
+        {
+            rc.inputChannels = audio.getArrayOfReadPointers();
+        }
+        else
+        {
+            inputBuffer.setSize (juce::jmax (numPatchInputChannels, getTotalNumInputChannels()), numFrames, false, false, true);
 
-            rc.inputChannels = inputBuffer.getArrayOfWritePointers();
-            rc.numInputChannels = (uint32_t) numPatchInputChannels;
-            rc.outputChannels = outputBuffer.getArrayOfWritePointers();
-            rc.numOutputChannels = (uint32_t) numPatchOutputChannels;
-            rc.numFrames = (uint32_t) numFrames;
-            rc.incomingMIDI = messageSpaceIn.data();
-            rc.numMIDIMessagesIn = 0;
-            rc.outgoingMIDI = messageSpaceOut.data();
-            rc.maximumMIDIMessagesOut = (uint32_t) messageSpaceOut.size();
-            rc.numMIDIMessagesOut = 0;
-
-            midiCollector.removeNextBlockOfMessages (midi, numFrames);
-            midiKeyboardState.processNextMidiBuffer (midi, 0, numFrames, true);
-
-            if (! midi.isEmpty())
+            for (int i = 0; i < inputBuffer.getNumChannels(); ++i)
             {
-                auto maxEvents = messageSpaceIn.size();
+                if (i < getTotalNumInputChannels())
+                    inputBuffer.copyFrom (i, 0, audio, i, 0, numFrames);
+                else
+                    inputBuffer.clear (i, 0, numFrames);
+            }
 
-                auto iter = midi.cbegin();
-                auto end = midi.cend();
-                size_t i = 0;
+            if (preprocessInputData != nullptr)
+                preprocessInputData (inputBuffer);
 
-                while (i < maxEvents && iter != end)
-                {
-                    auto message = *iter++;
+            rc.inputChannels = inputBuffer.getArrayOfReadPointers();
+        }
 
-                    if (message.numBytes < 4)
-                        messageSpaceIn[i++] = { static_cast<uint32_t> (message.samplePosition),
-                                                { message.data[0], message.data[1], message.data[2] } };
-                }
+        if (writeOutputInPlace)
+        {
+            rc.outputChannels = audio.getArrayOfWritePointers();
+        }
+        else
+        {
+            outputBuffer.setSize (juce::jmax (numPatchOutputChannels, getTotalNumOutputChannels()), numFrames, false, false, true);
 
-                rc.numMIDIMessagesIn = (uint32_t) i;
-                midi.clear();
-            }
+            // The player writes all of its own channels, so only the extra ones need clearing
+            for (int i = numPatchOutputChannels; i < outputBuffer.getNumChannels(); ++i)
+                outputBuffer.clear (i, 0, numFrames);
 
-            auto result = player->render (rc);
-            juce::ignoreUnused (result);
-            jassert (result == PatchPlayer::RenderResult::ok);
+            rc.outputChannels = outputBuffer.getArrayOfWritePointers();
+        }
 
-            if (rc.numMIDIMessagesOut != 0)
-            {
-                // The numMIDIMessagesOut value could be greater than the buffer size we provided,
-                // which lets us know if there was an overflow, but we need to be careful not to
-                // copy beyond the end
-                auto numMessagesOut = std::min (rc.numMIDIMessagesOut, rc.maximumMIDIMessagesOut);
+        rc.numInputChannels = (uint32_t) numPatchInputChannels;
+        rc.numOutputChannels = (uint32_t) numPatchOutputChannels;
+        rc.numFrames = (uint32_t) numFrames;
+        rc.incomingMIDI = messageSpaceIn.data();
+        rc.numMIDIMessagesIn = collectIncomingMIDI (midi, numFrames);
+        rc.outgoingMIDI = messageSpaceOut.data();
+        rc.maximumMIDIMessagesOut = (uint32_t) messageSpaceOut.size();
+        rc.numMIDIMessagesOut = 0;
+        midi.clear();
+
+        auto result = player->render (rc);
+        juce::ignoreUnused (result);
+        jassert (result == PatchPlayer::RenderResult::ok);
+
+        if (rc.numMIDIMessagesOut != 0)
+        {
+            // The numMIDIMessagesOut value could be greater than the buffer size we provided,
+            // which lets us know if there was an overflow, but we need to be careful not to
+            // copy beyond the end
+            auto numMessagesOut = std::min (rc.numMIDIMessagesOut, rc.maximumMIDIMessagesOut);
 
-                for (uint32_t i = 0; i < numMessagesOut; ++i)
-                    midi.addEvent (messageSpaceOut[i].message.data, 3, (int) messageSpaceOut[i].frameIndex);
+            for (uint32_t i = 0; i < numMessagesOut; ++i)
+            {
+                auto& e = messageSpaceOut[i];
+                midi.addEvent (e.message.data, juce::MidiMessage::getMessageLengthFromFirstByte (e.message.data[0]), (int) e.frameIndex);
             }
         }
 
-        if (postprocessOutputData != nullptr)
-            postprocessOutputData (outputBuffer);
+        if (writeOutputInPlace)
+        {
+            for (int i = numPatchOutputChannels; i < getTotalNumOutputChannels(); ++i)
+                audio.clear (i, 0, numFrames);
+        }
+        else
+        {
+            if (postprocessOutputData != nullptr)
+                postprocessOutputData (outputBuffer);
 
-        for (int i = 0; i < getTotalNumOutputChannels(); ++i)
-            audio.copyFrom (i, 0, outputBuffer, i, 0, numFrames);
+            for (int i = 0; i < getTotalNumOutputChannels(); ++i)
+                audio.copyFrom (i, 0, outputBuffer, i, 0, numFrames);
+        }
     }
 
+    /** Queues a short MIDI message to be sent to the patch during the next block, at a
+        position that reflects the time at which it was injected. This can be called from
+        any thread.
+    */
     void injectMIDIMessage (uint8_t byte0, uint8_t byte1, uint8_t byte2)
     {
-        auto message = choc::midi::ShortMessage (byte0, byte1, byte2);
-        midiCollector.addMessageToQueue (juce::MidiMessage (message.data, message.length(), 0.0));
+        injectedMIDI.push ({ juce::Time::getMillisecondCounterHiRes() * 0.001,
+                             choc::midi::ShortMessage (byte0, byte1, byte2) });
     }
 
     bool sendInputEvent (const std::string& endpointID, const juce::var& value)
@@ -750,7 +782,18 @@ private:
     std::vector<soul::MIDIEvent> messageSpaceIn, messageSpaceOut;
     int numPatchInputChannels = 0, numPatchOutputChannels = 0;
     std::function<void(juce::AudioBuffer<float>&)> preprocessInputData, postprocessOutputData;
-    juce::MidiMessageCollector midiCollector;
+
+    struct InjectedMIDIMessage
+    {
+        double time;
+        choc::midi::ShortMessage message;
+    };
+
+    choc::fifo::SingleReaderMultipleWriterFIFO<InjectedMIDIMessage> injectedMIDI;
+    std::vector<soul::MIDIEvent> injectedMIDIForBlock;
+    static constexpr size_t maxInjectedMIDIMessages = 1024;
+    double lastMIDIBlockTime = 0;
+    static inline thread_local bool isUpdatingKeyboardFromHost = false;
     const int millisecsBetweenFileChecks;
     juce::ValueTree lastValidState;
 
@@ -774,10 +817,110 @@ private:
             fn (frameIndex, message);
     }
 
+    //==============================================================================
+    // The on-screen keyboard's notes go into the same queue as injectMIDIMessage(), so the
+    // audio thread never has to merge them into the host's MidiBuffer. Notes which the audio
+    // thread passes to the keyboard from the host have already been sent to the patch.
+    void handleNoteOn (juce::MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity) override
+    {
+        if (! isUpdatingKeyboardFromHost)
+        {
+            auto m = juce::MidiMessage::noteOn (midiChannel, midiNoteNumber, velocity);
+            injectMIDIMessage (m.getRawData()[0], m.getRawData()[1], m.getRawData()[2]);
+        }
+    }
+
+    void handleNoteOff (juce::MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity) override
+    {
+        if (! isUpdatingKeyboardFromHost)
+        {
+            auto m = juce::MidiMessage::noteOff (midiChannel, midiNoteNumber, velocity);
+            injectMIDIMessage (m.getRawData()[0], m.getRawData()[1], m.getRawData()[2]);
+        }
+    }
+
+    /** Pops the injected messages and gives each one a frame within the block, in the same
+        way as juce::MidiMessageCollector: the time since the last block is mapped onto the
+        end of this one, and squashed to fit if it's longer than the block.
+    */
+    size_t collectInjectedMIDI (int numFrames)
+    {
+        auto now = juce::Time::getMillisecondCounterHiRes() * 0.001;
+        auto sampleRate = getSampleRate();
+        auto elapsedFrames = std::max (1.0, (now - lastMIDIBlockTime) * sampleRate);
+        auto scale = std::min (1.0, numFrames / elapsedFrames);
+        auto lastFrameInBlock = static_cast<double> (std::max (0, numFrames - 1));
+        lastMIDIBlockTime = now;
+
+        InjectedMIDIMessage injected;
+        uint32_t lastFrame = 0;
+        size_t num = 0;
+
+        while (num < injectedMIDIForBlock.size() && injectedMIDI.pop (injected))
+        {
+            auto framesBeforeEnd = (now - injected.time) * sampleRate * scale;
+            auto frame = static_cast<uint32_t> (juce::jlimit (0.0, lastFrameInBlock, lastFrameInBlock - framesBeforeEnd));
+            lastFrame = std::max (lastFrame, frame);
+            injectedMIDIForBlock[num++] = { lastFrame, injected.message };
+        }
+
+        return num;
+    }
+
+    /** Fills messageSpaceIn with the host's messages, which are read in-place from the
+        MidiBuffer's storage, merged in time order with any injected messages. The host's
+        notes are also passed on to midiKeyboardState.
+
+        Messages longer than 3 bytes, such as SysEx or MIDI 2.0 packets, are dropped: a
+        soul::MIDIEvent only holds a ShortMessage, and a patch's MIDI input endpoints receive
+        soul::midi::Message, which packs the bytes into an int32. Supporting them would need a
+        new endpoint type in the language as well as a change to the patch API.
+    */
+    uint32_t collectIncomingMIDI (const juce::MidiBuffer& midi, int numFrames)
+    {
+        auto capacity = messageSpaceIn.size();
+        auto numInjected = collectInjectedMIDI (numFrames);
+        size_t num = 0, nextInjected = 0;
+
+        isUpdatingKeyboardFromHost = true;
+
+        for (auto message : midi)
+        {
+            if (message.numBytes > 3)
+                continue;  // can't be represented by a MIDIEvent - see above
+
+            while (nextInjected < numInjected && num < capacity
+                    && injectedMIDIForBlock[nextInjected].frameIndex <= static_cast<uint32_t> (message.samplePosition))
+                messageSpaceIn[num++] = injectedMIDIForBlock[nextInjected++];
+
+            midiKeyboardState.processNextMidiEvent (message.getMessage());
+
+            if (num < capacity)
+                messageSpaceIn[num++] = { static_cast<uint32_t> (message.samplePosition),
+                                          { message.data[0],
+                                            message.numBytes > 1 ? message.data[1] : uint8_t(),
+                                            message.numBytes > 2 ? message.data[2] : uint8_t() } };
+        }
+
+        isUpdatingKeyboardFromHost = false;
+
+        while (nextInjected < numInjected && num < capacity)
+            messageSpaceIn[num++] = injectedMIDIForBlock[nextInjected++];
+
+        return static_cast<uint32_t> (num);
+    }
+
     void timerCallback() override
     {
         if (player != nullptr)
+        {
             player->handleOutgoingEvents (this, handleEvent, handleConsole);
+
+            auto newLatency = static_cast<int> (player->getLatencySamples());
+
+            if (newLatency != getLatencySamples())
+                setLatencySamples (newLatency);
+        }
     }
 
     //==============================================================================
@@ -0,0 +1,547 @@
+/*
+     _____ _____ _____ __
+    |   __|     |  |  |  |
+    |__   |  |  |  |  |  |__
+    |_____|_____|_____|_____|
+
+    Copyright (c) 2018 - ROLI Ltd.
+*/
+
+#pragma once
+
+#ifndef JUCE_AUDIO_FORMATS_H_INCLUDED
+ #error "this header is designed to be included in JUCE projects that contain the juce_audio_formats module"
+#endif
+
+#include "../../soul_patch.h"
+#include "../../patch/helper_classes/soul_patch_Utilities.h"
+#include "../../common/soul_ProgramDefinitions.h"
+#include "../../3rdParty/choc/text/choc_JSON.h"
+#include "../../3rdParty/choc/text/choc_FloatToString.h"
+
+#if __clang__
+ #pragma clang diagnostic push
+ #pragma clang diagnostic ignored "-Wnon-virtual-dtor"
+#endif
+
+namespace soul
+{
+namespace patch
+{
+
+//==============================================================================
+/**
+    Renders patches offline with a fixed stimulus, and checks the output against a
+    "golden" render that was stored by an earlier run.
+
+    Every patch gets exactly the same input: a sequence of MIDI notes, controller moves
+    and pitch-bends, and seeded noise on any audio inputs, which all stop part-way
+    through so that the tails get rendered too. As long as the Options are the same,
+    two renders of an unchanged patch will produce the same output, so any difference
+    larger than Options::tolerance means that a change to the compiler or runtime has
+    changed what the patch sounds like.
+
+    Each result also records how much faster than realtime the patch was rendered, and
+    this can be checked against the JSON from a previous run, so one run validates both
+    the correctness and the speed of an optimisation.
+
+    The golden renders are stored as 32-bit float WAV files, one per patch.
+*/
+struct GoldenRenderer
+{
+    struct Options
+    {
+        double sampleRate = 44100.0;
+        uint32_t blockSize = 512;
+        double secondsToRender = 6.0;
+
+        /** The stimulus stops after this proportion of the render, leaving the rest for tails. */
+        double stimulusProportion = 0.75;
+
+        /** The seed for the noise that is fed into any audio inputs. */
+        juce::int64 noiseSeed = 1234;
+
+        /** The largest difference from the golden render that any sample may have. */
+        float tolerance = 1.0e-4f;
+
+        /** If true, any golden files that don't exist yet are written, rather than the
+            patch being reported as failing. The existing files are never overwritten
+            unless overwriteGoldenFiles is also set.
+        */
+        bool createMissingGoldenFiles = true;
+        bool overwriteGoldenFiles = false;
+
+        /** The results of a previous run, as returned by toJSON(). A patch fails if its
+            realtime factor has dropped by more than maxSlowdown (as a proportion) from
+            what it was in the baseline.
+        */
+        choc::value::Value baseline;
+        double maxSlowdown = 0.1;
+    };
+
+    enum class Status
+    {
+        passed,
+        failed,
+        created
+    };
+
+    struct Result
+    {
+        std::string patchFile, goldenFile, message;
+        Status status = Status::passed;
+
+        uint32_t numOutputChannels = 0;
+        uint64_t numFrames = 0, stateSize = 0;
+        double compileSeconds = 0, renderSeconds = 0;
+
+        /** The number of seconds of audio rendered per second of CPU time. */
+        double realtimeFactor = 0;
+
+        /** The largest difference from the golden render, and the first frame where the
+            difference was larger than the tolerance (or -1 if it never was).
+        */
+        float maxDifference = 0;
+        int64_t firstFailingFrame = -1;
+    };
+
+    //==============================================================================
+    /** Builds a patch, renders it, and compares the output with the golden file. */
+    static Result renderPatch (PatchInstance& patch, const juce::File& goldenFile, const Options& options)
+    {
+        Result result;
+        result.patchFile = getPatchPath (patch);
+        result.goldenFile = goldenFile.getFullPathName().toStdString();
+
+        auto fail = [&] (std::string message)
+        {
+            result.status = Status::failed;
+            result.message = std::move (message);
+            return result;
+        };
+
+        PatchPlayerConfiguration config;
+        config.sampleRate = options.sampleRate;
+        config.maxFramesPerBlock = options.blockSize;
+
+        auto compileStart = juce::Time::getMillisecondCounterHiRes();
+        auto player = PatchPlayer::Ptr (patch.compileNewPlayer (config, nullptr, nullptr, nullptr));
+        result.compileSeconds = (juce::Time::getMillisecondCounterHiRes() - compileStart) / 1000.0;
+
+        if (player == nullptr)
+            return fail ("Failed to create a player");
+
+        if (! player->isPlayable())
+        {
+            std::string errors;
+
+            for (auto& m : player->getCompileMessages())
+                if (m.isError)
+                    errors += m.fullMessage.toString<std::string>() + "\n";
+
+            return fail (errors.empty() ? "The patch is not playable" : choc::text::trim (errors));
+        }
+
+        auto numFrames = static_cast<int> (options.sampleRate * options.secondsToRender);
+        auto input = createInputStimulus (countTotalChannels (player->getInputBuses()), numFrames, options);
+        auto midi = createMIDIStimulus (numFrames, options);
+        juce::AudioBuffer<float> output (static_cast<int> (countTotalChannels (player->getOutputBuses())), numFrames);
+        output.clear();
+
+        result.numFrames = static_cast<uint64_t> (numFrames);
+        result.numOutputChannels = static_cast<uint32_t> (output.getNumChannels());
+        result.stateSize = player->getMemoryReport().stateSize;
+
+        auto renderError = render (*player, input, output, midi, options, result.renderSeconds);
+
+        if (! renderError.empty())
+            return fail (renderError);
+
+        if (result.renderSeconds > 0)
+            result.realtimeFactor = options.secondsToRender / result.renderSeconds;
+
+        if (! goldenFile.existsAsFile() || options.overwriteGoldenFiles)
+        {
+            if (! (options.createMissingGoldenFiles || options.overwriteGoldenFiles))
+                return fail ("The golden file doesn't exist");
+
+            if (! writeWAVFile (goldenFile, output, options.sampleRate))
+                return fail ("Failed to write the golden file");
+
+            result.status = Status::created;
+            return result;
+        }
+
+        juce::AudioBuffer<float> golden;
+
+        if (! readWAVFile (goldenFile, golden))
+            return fail ("Failed to read the golden file");
+
+        if (golden.getNumChannels() != output.getNumChannels() || golden.getNumSamples() != output.getNumSamples())
+            return fail ("The golden file has " + std::to_string (golden.getNumChannels()) + " channels and "
+                          + std::to_string (golden.getNumSamples()) + " frames, but the patch rendered "
+                          + std::to_string (output.getNumChannels()) + " channels and " + std::to_string (numFrames) + " frames");
+
+        compare (output, golden, options.tolerance, result);
+
+        if (result.firstFailingFrame >= 0)
+            return fail ("The output differs from the golden file by up to " + std::to_string (result.maxDifference)
+                          + ", starting at frame " + std::to_string (result.firstFailingFrame));
+
+        checkAgainstBaseline (result, options);
+        return result;
+    }
+
+    /** Finds all the .soulpatch files inside a folder, and renders each one, using a
+        golden file in goldenFolder with the same name as the patch. The PatchLibrary
+        type must have a createPatchInstance (const std::string&) method, like the
+        PatchLibraryDLL class does.
+    */
+    template <typename PatchLibrary>
+    static std::vector<Result> renderFolder (PatchLibrary& library, const juce::File& patchFolder,
+                                             const juce::File& goldenFolder, const Options& options)
+    {
+        std::vector<Result> results;
+        goldenFolder.createDirectory();
+
+        auto patchFiles = patchFolder.findChildFiles (juce::File::findFiles, true, getManifestWildcard());
+        patchFiles.sort();
+
+        for (auto& patchFile : patchFiles)
+        {
+            auto goldenFile = goldenFolder.getChildFile (patchFile.getFileNameWithoutExtension() + ".wav");
+
+            if (auto patch = library.createPatchInstance (patchFile.getFullPathName().toStdString()))
+            {
+                results.push_back (renderPatch (*patch, goldenFile, options));
+            }
+            else
+            {
+                Result result;
+                result.patchFile = patchFile.getFullPathName().toStdString();
+                result.goldenFile = goldenFile.getFullPathName().toStdString();
+                result.status = Status::failed;
+                result.message = "Failed to load the patch";
+                results.push_back (std::move (result));
+            }
+        }
+
+        return results;
+    }
+
+    /** Returns true if none of the results are failures. */
+    static bool allPassed (const std::vector<Result>& results)
+    {
+        for (auto& r : results)
+            if (r.status == Status::failed)
+                return false;
+
+        return true;
+    }
+
+    static const char* getStatusName (Status status)
+    {
+        if (status == Status::failed)   return "failed";
+        if (status == Status::created)  return "created";
+        return "passed";
+    }
+
+    static choc::value::Value toJSON (const std::vector<Result>& results)
+    {
+        auto patches = choc::value::createEmptyArray();
+        int32_t numPassed = 0, numFailed = 0, numCreated = 0;
+
+        for (auto& r : results)
+        {
+            auto patch = choc::value::createObject ("Patch",
+                                                    "patchFile", r.patchFile,
+                                                    "goldenFile", r.goldenFile,
+                                                    "status", std::string (getStatusName (r.status)));
+
+            if (! r.message.empty())
+                patch.addMember ("message", r.message);
+
+            if (r.numFrames != 0)
+            {
+                patch.addMember ("numFrames", static_cast<int64_t> (r.numFrames));
+                patch.addMember ("numOutputChannels", static_cast<int32_t> (r.numOutputChannels));
+                patch.addMember ("stateSize", static_cast<int64_t> (r.stateSize));
+                patch.addMember ("compileSeconds", r.compileSeconds);
+                patch.addMember ("renderSeconds", r.renderSeconds);
+                patch.addMember ("realtimeFactor", r.realtimeFactor);
+                patch.addMember ("maxDifference", static_cast<double> (r.maxDifference));
+            }
+
+            patches.addArrayElement (patch);
+
+            if (r.status == Status::passed)   ++numPassed;
+            if (r.status == Status::failed)   ++numFailed;
+            if (r.status == Status::created)  ++numCreated;
+        }
+
+        return choc::value::createObject ("GoldenRenderResults",
+                                          "numPassed", numPassed,
+                                          "numFailed", numFailed,
+                                          "numCreated", numCreated,
+                                          "patches", patches);
+    }
+
+    //==============================================================================
+    /** Creates the MIDI that every patch is sent: a repeating pattern of notes across
+        the keyboard (including the General MIDI drum range), with a chord on every
+        fourth one, a slow mod-wheel sweep and a pitch-bend up and back.
+    */
+    static std::vector<MIDIEvent> createMIDIStimulus (int numFrames, const Options& options)
+    {
+        static constexpr uint8_t notes[]      = { 36, 38, 42, 46, 48, 55, 60, 64, 67, 72, 76, 79, 84, 62, 69, 57 };
+        static constexpr uint8_t velocities[] = { 100, 64, 127, 80, 40, 110 };
+
+        std::vector<MIDIEvent> events;
+        auto stimulusEnd = static_cast<uint32_t> (numFrames * options.stimulusProportion);
+        auto noteInterval = static_cast<uint32_t> (options.sampleRate * 0.25);
+        auto noteLength   = static_cast<uint32_t> (options.sampleRate * 0.2);
+        auto controllerInterval = static_cast<uint32_t> (options.sampleRate * 0.05);
+
+        auto add = [&] (uint32_t frame, uint8_t b0, uint8_t b1, uint8_t b2)
+        {
+            events.push_back ({ frame, { b0, b1, b2 } });
+        };
+
+        for (uint32_t i = 0; (i + 1) * noteInterval < stimulusEnd; ++i)
+        {
+            auto start = i * noteInterval;
+            auto note = notes[i % std::size (notes)];
+            auto velocity = velocities[i % std::size (velocities)];
+
+            add (start, 0x90, note, velocity);
+            add (start + noteLength, 0x80, note, 0);
+
+            if (i % 4 == 3)
+            {
+                add (start, 0x90, static_cast<uint8_t> (note + 7), velocity);
+                add (start + noteLength, 0x80, static_cast<uint8_t> (note + 7), 0);
+            }
+        }
+
+        for (uint32_t frame = 0, i = 0; frame < stimulusEnd; frame += controllerInterval, ++i)
+            add (frame, 0xb0, 1, static_cast<uint8_t> (i % 128));
+
+        auto bendStart = stimulusEnd / 2, bendLength = stimulusEnd / 8;
+
+        for (uint32_t i = 0; i <= 16; ++i)
+        {
+            auto bend = static_cast<uint32_t> (0x2000 + (i <= 8 ? i : 16 - i) * 0x3ff);
+            add (bendStart + bendLength * i / 16, 0xe0, static_cast<uint8_t> (bend & 0x7f), static_cast<uint8_t> ((bend >> 7) & 0x7f));
+        }
+
+        add (stimulusEnd, 0xb0, 123, 0);
+
+        std::stable_sort (events.begin(), events.end(),
+                          [] (const MIDIEvent& a, const MIDIEvent& b) { return a.frameIndex < b.frameIndex; });
+        return events;
+    }
+
+    /** Creates the audio that is fed into any audio inputs: seeded white noise, followed
+        by silence once the stimulus has finished.
+    */
+    static juce::AudioBuffer<float> createInputStimulus (uint32_t numChannels, int numFrames, const Options& options)
+    {
+        juce::AudioBuffer<float> input (static_cast<int> (numChannels), numFrames);
+        input.clear();
+
+        juce::Random random (options.noiseSeed);
+        auto stimulusEnd = static_cast<int> (numFrames * options.stimulusProportion);
+
+        for (int chan = 0; chan < input.getNumChannels(); ++chan)
+        {
+            auto dest = input.getWritePointer (chan);
+
+            for (int i = 0; i < stimulusEnd; ++i)
+                dest[i] = (random.nextFloat() - 0.5f) * 0.5f;
+        }
+
+        return input;
+    }
+
+private:
+    //==============================================================================
+    static std::string render (PatchPlayer& player, const juce::AudioBuffer<float>& input, juce::AudioBuffer<float>& output,
+                               const std::vector<MIDIEvent>& midi, const Options& options, double& renderSeconds)
+    {
+        player.applyNewTempo (120.0f);
+        player.applyNewTimeSignature ({ 4, 4 });
+        player.applyNewTransportState (TransportState::playing);
+
+        std::vector<MIDIEvent> midiIn, midiOut (1024);
+        midiIn.reserve (midi.size());
+        std::vector<const float*> inputChannels (static_cast<size_t> (input.getNumChannels()));
+        std::vector<float*> outputChannels (static_cast<size_t> (output.getNumChannels()));
+
+        auto ignoreEvent   = [] (void*, uint64_t, const char*, const choc::value::ValueView&) {};
+        auto ignoreMessage = [] (void*, uint64_t, const char*) {};
+
+        auto numFrames = static_cast<uint32_t> (output.getNumSamples());
+        size_t nextMIDIEvent = 0;
+        renderSeconds = 0;
+
+        for (uint32_t start = 0; start < numFrames;)
+        {
+            auto numToDo = std::min (options.blockSize, numFrames - start);
+
+            for (size_t i = 0; i < inputChannels.size(); ++i)
+                inputChannels[i] = input.getReadPointer (static_cast<int> (i), static_cast<int> (start));
+
+            for (size_t i = 0; i < outputChannels.size(); ++i)
+                outputChannels[i] = output.getWritePointer (static_cast<int> (i), static_cast<int> (start));
+
+            midiIn.clear();
+
+            while (nextMIDIEvent < midi.size() && midi[nextMIDIEvent].frameIndex < start + numToDo)
+            {
+                auto e = midi[nextMIDIEvent++];
+                e.frameIndex -= start;
+                midiIn.push_back (e);
+            }
+
+            PatchPlayer::RenderContext rc;
+            rc.inputChannels          = inputChannels.data();
+            rc.outputChannels         = outputChannels.data();
+            rc.incomingMIDI           = midiIn.data();
+            rc.outgoingMIDI           = midiOut.data();
+            rc.numFrames              = numToDo;
+            rc.numInputChannels       = static_cast<uint32_t> (inputChannels.size());
+            rc.numOutputChannels      = static_cast<uint32_t> (outputChannels.size());
+            rc.numMIDIMessagesIn      = static_cast<uint32_t> (midiIn.size());
+            rc.maximumMIDIMessagesOut = static_cast<uint32_t> (midiOut.size());
+            rc.numMIDIMessagesOut     = 0;
+
+            auto renderStart = juce::Time::getMillisecondCounterHiRes();
+            auto renderResult = player.render (rc);
+            renderSeconds += (juce::Time::getMillisecondCounterHiRes() - renderStart) / 1000.0;
+
+            if (renderResult != PatchPlayer::RenderResult::ok)
+                return "The render failed at frame " + std::to_string (start);
+
+            player.handleOutgoingEvents (nullptr, ignoreEvent, ignoreMessage);
+            start += numToDo;
+        }
+
+        return {};
+    }
+
+    static void compare (const juce::AudioBuffer<float>& output, const juce::AudioBuffer<float>& golden,
+                         float tolerance, Result& result)
+    {
+        for (int chan = 0; chan < output.getNumChannels(); ++chan)
+        {
+            auto a = output.getReadPointer (chan);
+            auto b = golden.getReadPointer (chan);
+
+            for (int i = 0; i < output.getNumSamples(); ++i)
+            {
+                auto diff = std::abs (a[i] - b[i]);
+
+                // NaNs never compare as different, so treat them as a failure explicitly
+                if (std::isnan (diff))
+                    diff = std::numeric_limits<float>::infinity();
+
+                result.maxDifference = std::max (result.maxDifference, diff);
+
+                if (diff > tolerance && (result.firstFailingFrame < 0 || i < result.firstFailingFrame))
+                    result.firstFailingFrame = i;
+            }
+        }
+    }
+
+    static void checkAgainstBaseline (Result& result, const Options& options)
+    {
+        if (! (options.baseline.isObject() && options.baseline.hasObjectMember ("patches")))
+            return;
+
+        auto patches = options.baseline["patches"];
+
+        for (uint32_t i = 0; i < patches.size(); ++i)
+        {
+            auto patch = patches[i];
+
+            if (patch.isObject() && patch.hasObjectMember ("realtimeFactor")
+                 && patch["patchFile"].getWithDefault<std::string_view> ({}) == result.patchFile)
+            {
+                auto previous = patch["realtimeFactor"].getWithDefault<double> (0);
+
+                if (previous > 0 && result.realtimeFactor < previous / (1.0 + options.maxSlowdown))
+                {
+                    result.status = Status::failed;
+                    result.message = "The realtime factor went down from " + choc::text::floatToString (previous, 4)
+                                        + " to " + choc::text::floatToString (result.realtimeFactor, 4);
+                }
+
+                return;
+            }
+        }
+    }
+
+    static uint32_t countTotalChannels (Span<Bus> buses)
+    {
+        uint32_t total = 0;
+
+        for (auto& b : buses)
+            total += b.numChannels;
+
+        return total;
+    }
+
+    static std::string getPatchPath (PatchInstance& patch)
+    {
+        if (auto location = VirtualFile::Ptr (patch.getLocation()))
+            return String::Ptr (location->getAbsolutePath()).toString<std::string>();
+
+        return {};
+    }
+
+    static bool writeWAVFile (const juce::File& file, const juce::AudioBuffer<float>& buffer, double sampleRate)
+    {
+        file.getParentDirectory().createDirectory();
+        juce::TemporaryFile temp (file);
+
+        if (auto out = std::unique_ptr<juce::OutputStream> (temp.getFile().createOutputStream()))
+        {
+            juce::WavAudioFormat wav;
+
+            if (auto writer = std::unique_ptr<juce::AudioFormatWriter> (wav.createWriterFor (out.get(), sampleRate,
+                                                                                              static_cast<unsigned int> (buffer.getNumChannels()),
+                                                                                              32, {}, 0)))
+            {
+                out.release();
+
+                if (! writer->writeFromFloatArrays (buffer.getArrayOfReadPointers(), buffer.getNumChannels(), buffer.getNumSamples()))
+                    return false;
+
+                writer.reset();
+                return temp.overwriteTargetFileWithTemporary();
+            }
+        }
+
+        return false;
+    }
+
+    static bool readWAVFile (const juce::File& file, juce::AudioBuffer<float>& buffer)
+    {
+        juce::WavAudioFormat wav;
+
+        if (auto reader = std::unique_ptr<juce::AudioFormatReader> (wav.createReaderFor (file.createInputStream().release(), true)))
+        {
+            buffer.setSize (static_cast<int> (reader->numChannels), static_cast<int> (reader->lengthInSamples));
+            return reader->read (&buffer, 0, buffer.getNumSamples(), 0, true, true);
+        }
+
+        return false;
+    }
+};
+
+} // namespace patch
+} // namespace soul
+
+#if __clang__
+ #pragma clang diagnostic pop
+#endif
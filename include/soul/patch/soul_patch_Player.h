@@ -129,6 +129,12 @@ struct PatchPlayerConfiguration
 {
     double sampleRate = 0;
     uint32_t maxFramesPerBlock = 0;
+
+    /** The largest number of console messages that the player will pass on for each
+        second of audio that it renders. Any more are dropped, so that a processor which
+        logs on every frame can't flood the host. A value of 0 removes the limit.
+    */
+    uint32_t maxConsoleMessagesPerSecond = 1000;
 };
 
 //==============================================================================
@@ -194,7 +200,11 @@ public:
 
     virtual EndpointDescription getEndpointDetails (const char* endpointID) const = 0;
 
-    /** Returns the patch's internal latency. */
+    /** Returns the patch's internal latency.
+        This is read back from the performer after each call to render(), so if the
+        performer's latency changes, a host that checks it periodically can report the
+        change rather than rebuilding the player.
+    */
     virtual uint32_t getLatencySamples() const = 0;
 
     //==============================================================================
@@ -322,6 +332,97 @@ public:
         It should avoid calling it except when the value has actually changed.
     */
     virtual void applyNewTimelinePosition (TimelinePosition) = 0;
+
+    //==============================================================================
+    /** Contains the info needed for a call to the PatchPlayer::renderInterleaved() method.
+
+        Unlike render(), the channel counts don't need to match the patch's buses: any
+        channels that the patch needs but which aren't provided are treated as silent, and
+        any extra output channels are cleared.
+    */
+    struct InterleavedRenderContext
+    {
+        /** The interleaved input data, which contains numFrames * numInputChannels samples. */
+        const float* input;
+
+        /** The interleaved output data, which has space for numFrames * numOutputChannels
+            samples. If numInputChannels == numOutputChannels, this may point to the same
+            memory as the input.
+        */
+        float* output;
+
+        /** An array of MIDI messages for the render method to process. */
+        const soul::MIDIEvent* incomingMIDI;
+
+        /** An array of MIDI messages for the render method to write to. */
+        soul::MIDIEvent* outgoingMIDI;
+
+        uint32_t numFrames, numInputChannels, numOutputChannels;
+        uint32_t numMIDIMessagesIn, maximumMIDIMessagesOut;
+
+        /** On return, this is set in the same way as RenderContext::numMIDIMessagesOut. */
+        uint32_t numMIDIMessagesOut;
+    };
+
+    /** Contains the info needed for a call to the PatchPlayer::renderFloat64() method.
+
+        This works like RenderContext, except that the channel counts don't need to match
+        the patch's buses (in the same way as for InterleavedRenderContext).
+    */
+    struct Float64RenderContext
+    {
+        /** A set of pointers to input channel data, none of which may be null. */
+        const double* const* inputChannels;
+
+        /** A set of pointers to output channel data, none of which may be null. Any of these
+            can be the same as the corresponding input channel, to render in-place.
+        */
+        double* const* outputChannels;
+
+        /** An array of MIDI messages for the render method to process. */
+        const soul::MIDIEvent* incomingMIDI;
+
+        /** An array of MIDI messages for the render method to write to. */
+        soul::MIDIEvent* outgoingMIDI;
+
+        uint32_t numFrames, numInputChannels, numOutputChannels;
+        uint32_t numMIDIMessagesIn, maximumMIDIMessagesOut;
+
+        /** On return, this is set in the same way as RenderContext::numMIDIMessagesOut. */
+        uint32_t numMIDIMessagesOut;
+    };
+
+    /** Renders the next block of audio from and to interleaved float buffers.
+        This behaves like render(), but avoids the need for the host to de-interleave
+        its data into a temporary buffer first.
+    */
+    virtual RenderResult renderInterleaved (InterleavedRenderContext&) = 0;
+
+    /** Renders the next block of audio from and to non-interleaved double buffers.
+        This behaves like render(), but avoids the need for the host to convert its
+        data to and from float in temporary buffers first.
+    */
+    virtual RenderResult renderFloat64 (Float64RenderContext&) = 0;
+
+    //==============================================================================
+    /** A breakdown of the memory that a PatchPlayer is using, in bytes. */
+    struct MemoryReport
+    {
+        /** The program's mutable state. */
+        uint64_t stateSize;
+
+        /** The data that was loaded into external variables. */
+        uint64_t externalsSize;
+
+        /** The FIFOs which carry audio, MIDI, parameters and events in and out of the player. */
+        uint64_t fifoSize;
+
+        /** The temporary buffers used while rendering. */
+        uint64_t scratchSize;
+    };
+
+    /** Returns a breakdown of the memory that this player is using. */
+    virtual MemoryReport getMemoryReport() const = 0;
 };
 
 } // namespace patch
@@ -154,6 +154,13 @@ struct AST
         Allocator (const Allocator&) = delete;
         Allocator (Allocator&&) = default;
 
+        /** Creates an allocator whose identifier pool is layered on top of a shared,
+            read-only pool, so that strings which are already in the shared pool aren't
+            duplicated for each compile.
+        */
+        Allocator (std::shared_ptr<const Identifier::Pool> sharedIdentifiers)
+            : identifiers (std::move (sharedIdentifiers)) {}
+
         template <typename Type, typename... Args>
         Type& allocate (Args&&... args)   { return pool.allocate<Type> (std::forward<Args> (args)...); }
 
@@ -747,6 +754,7 @@ struct AST
         Annotation annotation;
         pool_ptr<ProcessorInstance> owningInstance;
         pool_ptr<ProcessorBase> originalBeforeSpecialisation;
+        ArrayWithPreallocation<pool_ref<Expression>, 4> specialisationArgs;
     };
 
     //==============================================================================
@@ -1432,6 +1440,8 @@ struct AST
         }
 
     private:
+        friend struct ASTCloner;
+
         struct ScopedResolver
         {
             ScopedResolver (bool& b) : flag (b) { flag = true; }
@@ -2338,6 +2348,10 @@ struct AST
         Type getOperandType() const                 { resolveOpTypes(); return resolvedOpTypes.operandType; }
         Type getResultType() const override         { resolveOpTypes(); return resolvedOpTypes.resultType; }
 
+        /** Returns the operand and result types that have been cached, which may not have been worked out yet. */
+        const TypeRules::BinaryOperatorTypes& getCachedOpTypes() const                  { return resolvedOpTypes; }
+        void setCachedOpTypes (TypeRules::BinaryOperatorTypes types) const             { resolvedOpTypes = std::move (types); }
+
         Constness getConstness() const override
         {
             auto const1 = lhs->getConstness();
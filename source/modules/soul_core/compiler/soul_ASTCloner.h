@@ -0,0 +1,813 @@
+/*
+    _____ _____ _____ __
+   |   __|     |  |  |  |      The SOUL language
+   |__   |  |  |  |  |  |__    Copyright (c) 2019 - ROLI Ltd.
+   |_____|_____|_____|_____|
+
+   The code in this file is provided under the terms of the ISC license:
+
+   Permission to use, copy, modify, and/or distribute this software for any purpose
+   with or without fee is hereby granted, provided that the above copyright notice and
+   this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+   TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+   NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+   IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+   CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+namespace soul
+{
+
+//==============================================================================
+/**
+    Makes a deep copy of an AST namespace and everything that can be reached from it,
+    so that a tree which has already been parsed and resolved can be used as the
+    starting point for another compile.
+
+    All the references between objects are remapped to point at the new copies, and
+    the structures and source code text are duplicated too, so nothing in the copy
+    refers back to the original. That means the original stays untouched while the
+    copy is resolved and linked, and a program built from the copy doesn't share any
+    (non thread-safe) ref-counted objects with it.
+
+    Objects are created on demand as references to them are found, and have their
+    remaining members filled in afterwards, so that the order in which things appear
+    in the tree doesn't matter.
+
+    If a phase is supplied and a profiler is attached, the number of objects of each
+    type that were copied is added to the phase's counters.
+*/
+struct ASTCloner
+{
+    static AST::Namespace& clone (AST::Allocator& allocator, AST::Namespace& namespaceToClone,
+                                  CompileProfiler::ScopedPhase* phaseToCountObjectsIn = nullptr)
+    {
+        ASTCloner cloner (allocator);
+        auto& result = cloner.getClone (namespaceToClone);
+
+        while (! cloner.pendingTasks.empty())
+        {
+            auto task = std::move (cloner.pendingTasks.back());
+            cloner.pendingTasks.pop_back();
+            task();
+        }
+
+        if (phaseToCountObjectsIn != nullptr && CompileProfiler::getCurrent() != nullptr)
+            cloner.addObjectCounts (*phaseToCountObjectsIn);
+
+        return result;
+    }
+
+private:
+    //==============================================================================
+    ASTCloner (AST::Allocator& a) : allocator (a) {}
+
+    AST::Allocator& allocator;
+    std::vector<int64_t> numObjectsCloned;
+    std::unordered_map<const AST::ASTObject*, AST::ASTObject*> objectMappings;
+    std::unordered_map<const AST::EndpointDetails*, AST::EndpointDetails*> endpointDetailMappings;
+    std::unordered_map<const AST::Connection::SharedEndpoint*, AST::Connection::SharedEndpoint*> sharedEndpointMappings;
+    std::unordered_map<const Structure*, StructurePtr> structMappings;
+    std::unordered_map<const SourceCodeText*, SourceCodeText::Ptr> sourceCodeMappings;
+    std::vector<std::function<void()>> pendingTasks;
+
+    //==============================================================================
+    template <typename ObjectType>
+    ObjectType& getClone (ObjectType& old)
+    {
+        static_assert (std::is_base_of<AST::ASTObject, ObjectType>::value, "expected an AST object");
+        auto& mapping = objectMappings[std::addressof (old)];
+
+        if (mapping == nullptr)
+        {
+            auto& newObject = createObject (old);
+            auto typeIndex = static_cast<size_t> (old.objectType);
+
+            if (typeIndex >= numObjectsCloned.size())
+                numObjectsCloned.resize (typeIndex + 1);
+
+            ++numObjectsCloned[typeIndex];
+
+            if (auto e = dynamic_cast<AST::Expression*> (std::addressof (old)))
+                static_cast<AST::Expression&> (newObject).kind = e->kind;
+
+            objectMappings[std::addressof (old)] = std::addressof (newObject);
+            pendingTasks.push_back ([this, &old, &newObject] { fillObject (old, newObject); });
+            return static_cast<ObjectType&> (newObject);
+        }
+
+        return static_cast<ObjectType&> (*mapping);
+    }
+
+    template <typename ObjectType>
+    pool_ptr<ObjectType> getClone (pool_ptr<ObjectType> old)
+    {
+        if (old == nullptr)
+            return {};
+
+        return getClone (*old);
+    }
+
+    template <typename ObjectType>
+    pool_ref<ObjectType> getClone (pool_ref<ObjectType> old)
+    {
+        return getClone (old.get());
+    }
+
+    template <typename ArrayType>
+    ArrayType cloneArray (const ArrayType& old)
+    {
+        ArrayType result;
+        result.reserve (old.size());
+
+        for (auto& item : old)
+            result.push_back (getClone (item));
+
+        return result;
+    }
+
+    AST::Scope* cloneScope (AST::Scope* old)
+    {
+        if (old == nullptr)
+            return nullptr;
+
+        auto oldObject = dynamic_cast<AST::ASTObject*> (old);
+        SOUL_ASSERT (oldObject != nullptr);
+        return dynamic_cast<AST::Scope*> (std::addressof (getClone (*oldObject)));
+    }
+
+    //==============================================================================
+    SourceCodeText& cloneSourceCode (const SourceCodeText& old)
+    {
+        auto& mapping = sourceCodeMappings[std::addressof (old)];
+
+        if (mapping == nullptr)
+            mapping = old.isInternal ? SourceCodeText::createInternal (old.filename, old.content)
+                                     : SourceCodeText::createForFile (old.filename, old.content);
+
+        return *mapping;
+    }
+
+    CodeLocation cloneLocation (const CodeLocation& old)
+    {
+        if (old.sourceCode.get() == nullptr)
+            return {};
+
+        auto& newSourceCode = cloneSourceCode (*old.sourceCode);
+        CodeLocation l (newSourceCode);
+        l.location = UTF8Reader (newSourceCode.utf8.getAddress() + old.getByteOffsetInFile());
+        return l;
+    }
+
+    AST::Context cloneContext (const AST::Context& old)
+    {
+        return { cloneLocation (old.location), cloneScope (old.parentScope) };
+    }
+
+    Structure& cloneStructure (const Structure& old)
+    {
+        auto& mapping = structMappings[std::addressof (old)];
+
+        if (mapping == nullptr)
+        {
+            void* backlink = nullptr;
+
+            if (auto decl = static_cast<AST::StructDeclaration*> (old.backlinkToASTObject))
+                backlink = std::addressof (getClone (*decl));
+
+            mapping = StructurePtr (new Structure (old.getName(), backlink));
+            auto& newStruct = *mapping;
+
+            for (auto& m : old.getMembers())
+            {
+                newStruct.addMember (cloneType (m.type), m.name);
+                newStruct.getMembers().back().readWriteCount = m.readWriteCount;
+            }
+
+            return newStruct;
+        }
+
+        return *mapping;
+    }
+
+    // NB: the original types and values are never copied, as that would touch the
+    // reference counts of structs that other threads may also be reading
+    Type cloneType (const Type& old)
+    {
+        if (auto s = old.getStructIfPresent())
+            return old.createCopyWithNewStruct (cloneStructure (*s));
+
+        return old;
+    }
+
+    Value cloneValue (const Value& old)
+    {
+        auto& oldType = old.getType();
+
+        if (oldType.getStructIfPresent() == nullptr)
+            return old;
+
+        auto v = Value::zeroInitialiser (cloneType (oldType));
+        memcpy (v.getPackedData(), old.getPackedData(), old.getPackedDataSize());
+        return v;
+    }
+
+    AST::Annotation cloneAnnotation (const AST::Annotation& old)
+    {
+        AST::Annotation a;
+
+        for (auto& p : old.properties)
+            a.properties.push_back ({ getClone (p.name), getClone (p.value) });
+
+        return a;
+    }
+
+    AST::EndpointDetails& cloneDetails (const AST::EndpointDetails& old)
+    {
+        auto& mapping = endpointDetailMappings[std::addressof (old)];
+
+        if (mapping == nullptr)
+        {
+            auto& newDetails = allocator.allocate<AST::EndpointDetails> (old.endpointType);
+            mapping = std::addressof (newDetails);
+
+            pendingTasks.push_back ([this, &old, &newDetails]
+            {
+                for (auto& t : old.dataTypes)
+                    newDetails.dataTypes.push_back (getClone (t));
+
+                newDetails.arraySize = getClone (old.arraySize);
+            });
+        }
+
+        return *mapping;
+    }
+
+    AST::Connection::SharedEndpoint& cloneSharedEndpoint (const AST::Connection::SharedEndpoint& old)
+    {
+        auto& mapping = sharedEndpointMappings[std::addressof (old)];
+
+        if (mapping == nullptr)
+            mapping = std::addressof (allocator.allocate<AST::Connection::SharedEndpoint> (getClone (old.endpoint.get())));
+
+        return *mapping;
+    }
+
+    //==============================================================================
+    #define SOUL_CLONE_OBJECT_OF_TYPE(ASTType) \
+        case AST::ObjectType::ASTType:  return create (static_cast<AST::ASTType&> (old));
+
+    AST::ASTObject& createObject (AST::ASTObject& old)
+    {
+        switch (old.objectType)
+        {
+            SOUL_AST_ALL_TYPES (SOUL_CLONE_OBJECT_OF_TYPE)
+            default: throwInternalCompilerError ("Unknown AST object"); break;
+        }
+    }
+
+    #undef SOUL_CLONE_OBJECT_OF_TYPE
+    #define SOUL_FILL_OBJECT_OF_TYPE(ASTType) \
+        case AST::ObjectType::ASTType:  fill (static_cast<AST::ASTType&> (old), static_cast<AST::ASTType&> (newObject)); break;
+
+    void fillObject (AST::ASTObject& old, AST::ASTObject& newObject)
+    {
+        switch (old.objectType)
+        {
+            SOUL_AST_ALL_TYPES (SOUL_FILL_OBJECT_OF_TYPE)
+            default: throwInternalCompilerError ("Unknown AST object"); break;
+        }
+    }
+
+    #undef SOUL_FILL_OBJECT_OF_TYPE
+    #define SOUL_ADD_OBJECT_COUNT(ASTType) \
+        addObjectCount (phase, AST::ObjectType::ASTType, #ASTType);
+
+    void addObjectCounts (CompileProfiler::ScopedPhase& phase) const
+    {
+        SOUL_AST_ALL_TYPES (SOUL_ADD_OBJECT_COUNT)
+    }
+
+    #undef SOUL_ADD_OBJECT_COUNT
+
+    void addObjectCount (CompileProfiler::ScopedPhase& phase, AST::ObjectType type, const char* typeName) const
+    {
+        auto typeIndex = static_cast<size_t> (type);
+
+        if (typeIndex < numObjectsCloned.size() && numObjectsCloned[typeIndex] != 0)
+            phase.addCounter (typeName, numObjectsCloned[typeIndex]);
+    }
+
+    //==============================================================================
+    // Each create() method makes a new object using whatever it needs to be passed
+    // to its constructor, and the matching fill() copies across everything else.
+
+    template <typename ModuleType>
+    ModuleType& createModule (ModuleType& old)
+    {
+        return allocator.allocate<ModuleType> (cloneLocation (old.processorKeywordLocation), cloneContext (old.context), old.name);
+    }
+
+    void fillModule (AST::ModuleBase& old, AST::ModuleBase& m)
+    {
+        m.isFullyResolved      = old.isFullyResolved;
+        m.specialisationParams = cloneArray (old.specialisationParams);
+        m.usings               = cloneArray (old.usings);
+        m.namespaceAliases     = cloneArray (old.namespaceAliases);
+        m.structures           = cloneArray (old.structures);
+        m.staticAssertions     = cloneArray (old.staticAssertions);
+        m.originalModule       = getClone (old.originalModule);
+
+        // A module's clone function re-parses its source, so it needs to refer to the new
+        // module (and its new copy of the source code) rather than to the original
+        if (old.createClone != nullptr)
+            StructuralParser::setCloneFunction (m);
+    }
+
+    void fillProcessorBase (AST::ProcessorBase& old, AST::ProcessorBase& p)
+    {
+        fillModule (old, p);
+        p.endpoints                    = cloneArray (old.endpoints);
+        p.annotation                   = cloneAnnotation (old.annotation);
+        p.owningInstance               = getClone (old.owningInstance);
+        p.originalBeforeSpecialisation = getClone (old.originalBeforeSpecialisation);
+        p.specialisationArgs           = cloneArray (old.specialisationArgs);
+
+        // A processor that was specialised for an instance applies its args to any copies
+        // that its clone function makes, so that function needs to use the new args
+        if (old.originalBeforeSpecialisation != nullptr && old.originalBeforeSpecialisation->isTemplateModule())
+            ResolutionPass::setSpecialisedCloneFunction (p);
+    }
+
+    AST::Namespace& create (AST::Namespace& old)   { return createModule (old); }
+    AST::Processor& create (AST::Processor& old)   { return createModule (old); }
+    AST::Graph&     create (AST::Graph& old)       { return createModule (old); }
+
+    void fill (AST::Namespace& old, AST::Namespace& n)
+    {
+        fillModule (old, n);
+        n.importsList = old.importsList;
+        n.functions   = cloneArray (old.functions);
+        n.subModules  = cloneArray (old.subModules);
+        n.constants   = cloneArray (old.constants);
+
+        for (auto& i : old.namespaceInstances)
+            n.namespaceInstances.push_back ({ i.key, getClone (i.instance) });
+    }
+
+    void fill (AST::Processor& old, AST::Processor& p)
+    {
+        fillProcessorBase (old, p);
+        p.functions      = cloneArray (old.functions);
+        p.stateVariables = cloneArray (old.stateVariables);
+        p.latency        = getClone (old.latency);
+    }
+
+    void fill (AST::Graph& old, AST::Graph& g)
+    {
+        fillProcessorBase (old, g);
+        g.processorInstances = cloneArray (old.processorInstances);
+        g.connections        = cloneArray (old.connections);
+        g.constants          = cloneArray (old.constants);
+        g.processorAliases   = cloneArray (old.processorAliases);
+    }
+
+    //==============================================================================
+    AST::Function& create (AST::Function& old)
+    {
+        return allocator.allocate<AST::Function> (cloneContext (old.context));
+    }
+
+    void fill (AST::Function& old, AST::Function& f)
+    {
+        SOUL_ASSERT (old.generatedFunction == nullptr);
+
+        f.returnType                          = getClone (old.returnType);
+        f.name                                = old.name;
+        f.nameLocation                        = cloneContext (old.nameLocation);
+        f.parameters                          = cloneArray (old.parameters);
+        f.genericWildcards                    = cloneArray (old.genericWildcards);
+        f.genericSpecialisations              = cloneArray (old.genericSpecialisations);
+        f.originalGenericFunction             = getClone (old.originalGenericFunction);
+        f.originalCallLeadingToSpecialisation = getClone (old.originalCallLeadingToSpecialisation);
+        f.annotation                          = cloneAnnotation (old.annotation);
+        f.intrinsic                           = old.intrinsic;
+        f.eventFunction                       = old.eventFunction;
+        f.block                               = getClone (old.block);
+    }
+
+    AST::ProcessorAliasDeclaration& create (AST::ProcessorAliasDeclaration& old)
+    {
+        return allocator.allocate<AST::ProcessorAliasDeclaration> (cloneContext (old.context), old.name);
+    }
+
+    void fill (AST::ProcessorAliasDeclaration& old, AST::ProcessorAliasDeclaration& a)
+    {
+        a.targetProcessor   = getClone (old.targetProcessor);
+        a.resolvedProcessor = getClone (old.resolvedProcessor);
+    }
+
+    AST::NamespaceAliasDeclaration& create (AST::NamespaceAliasDeclaration& old)
+    {
+        return allocator.allocate<AST::NamespaceAliasDeclaration> (cloneContext (old.context), old.name);
+    }
+
+    void fill (AST::NamespaceAliasDeclaration& old, AST::NamespaceAliasDeclaration& a)
+    {
+        a.targetNamespace    = getClone (old.targetNamespace);
+        a.specialisationArgs = getClone (old.specialisationArgs);
+        a.resolvedNamespace  = getClone (old.resolvedNamespace);
+    }
+
+    AST::Connection& create (AST::Connection& old)
+    {
+        return allocator.allocate<AST::Connection> (cloneContext (old.context), old.interpolationType,
+                                                    cloneSharedEndpoint (old.source), cloneSharedEndpoint (old.dest),
+                                                    getClone (old.delayLength));
+    }
+
+    void fill (AST::Connection&, AST::Connection&) {}
+
+    AST::ProcessorInstance& create (AST::ProcessorInstance& old)
+    {
+        return allocator.allocate<AST::ProcessorInstance> (cloneContext (old.context));
+    }
+
+    void fill (AST::ProcessorInstance& old, AST::ProcessorInstance& i)
+    {
+        i.instanceName         = getClone (old.instanceName);
+        i.targetProcessor      = getClone (old.targetProcessor);
+        i.specialisationArgs   = getClone (old.specialisationArgs);
+        i.clockMultiplierRatio = getClone (old.clockMultiplierRatio);
+        i.clockDividerRatio    = getClone (old.clockDividerRatio);
+        i.arraySize            = getClone (old.arraySize);
+
+        if (old.implicitInstanceSource != nullptr)
+            i.implicitInstanceSource = cloneSharedEndpoint (*old.implicitInstanceSource);
+    }
+
+    AST::EndpointDeclaration& create (AST::EndpointDeclaration& old)
+    {
+        // The details are needed straight away, because creating an InputEndpointRef looks at them
+        auto& e = allocator.allocate<AST::EndpointDeclaration> (cloneContext (old.context), old.isInput);
+
+        if (old.details != nullptr)
+            e.details = cloneDetails (*old.details);
+
+        return e;
+    }
+
+    void fill (AST::EndpointDeclaration& old, AST::EndpointDeclaration& e)
+    {
+        SOUL_ASSERT (old.generatedInput == nullptr && old.generatedOutput == nullptr);
+
+        e.name                     = old.name;
+        e.annotation               = cloneAnnotation (old.annotation);
+        e.needsToBeExposedInParent = old.needsToBeExposedInParent;
+        e.isConsoleEndpoint        = old.isConsoleEndpoint;
+
+        if (old.childPath != nullptr)
+        {
+            auto& path = allocator.allocate<AST::ChildEndpointPath>();
+
+            for (auto& s : old.childPath->sections)
+                path.sections.push_back ({ getClone (s.name), getClone (s.index) });
+
+            e.childPath = path;
+        }
+    }
+
+    //==============================================================================
+    AST::Block& create (AST::Block& old)
+    {
+        return allocator.allocate<AST::Block> (cloneContext (old.context), getClone (old.functionForWhichThisIsMain));
+    }
+
+    void fill (AST::Block& old, AST::Block& b)
+    {
+        b.statements = cloneArray (old.statements);
+    }
+
+    AST::BreakStatement&    create (AST::BreakStatement& old)     { return allocator.allocate<AST::BreakStatement> (cloneContext (old.context)); }
+    AST::ContinueStatement& create (AST::ContinueStatement& old)  { return allocator.allocate<AST::ContinueStatement> (cloneContext (old.context)); }
+    AST::NoopStatement&     create (AST::NoopStatement& old)      { return allocator.allocate<AST::NoopStatement> (cloneContext (old.context)); }
+
+    void fill (AST::BreakStatement&, AST::BreakStatement&) {}
+    void fill (AST::ContinueStatement&, AST::ContinueStatement&) {}
+    void fill (AST::NoopStatement&, AST::NoopStatement&) {}
+
+    AST::IfStatement& create (AST::IfStatement& old)
+    {
+        return allocator.allocate<AST::IfStatement> (cloneContext (old.context), old.isConstIf, getClone (old.condition.get()),
+                                                     getClone (old.trueBranch.get()), getClone (old.falseBranch));
+    }
+
+    void fill (AST::IfStatement&, AST::IfStatement&) {}
+
+    AST::LoopStatement& create (AST::LoopStatement& old)
+    {
+        return allocator.allocate<AST::LoopStatement> (cloneContext (old.context));
+    }
+
+    void fill (AST::LoopStatement& old, AST::LoopStatement& l)
+    {
+        l.iterator             = getClone (old.iterator);
+        l.body                 = getClone (old.body);
+        l.condition            = getClone (old.condition);
+        l.numIterations        = getClone (old.numIterations);
+        l.rangeLoopInitialiser = getClone (old.rangeLoopInitialiser);
+    }
+
+    AST::ReturnStatement& create (AST::ReturnStatement& old)
+    {
+        return allocator.allocate<AST::ReturnStatement> (cloneContext (old.context));
+    }
+
+    void fill (AST::ReturnStatement& old, AST::ReturnStatement& r)
+    {
+        r.returnValue = getClone (old.returnValue);
+    }
+
+    AST::VariableDeclaration& create (AST::VariableDeclaration& old)
+    {
+        return allocator.allocate<AST::VariableDeclaration> (cloneContext (old.context), getClone (old.declaredType),
+                                                             getClone (old.initialValue), old.isConstant);
+    }
+
+    void fill (AST::VariableDeclaration& old, AST::VariableDeclaration& v)
+    {
+        SOUL_ASSERT (old.generatedVariable == nullptr);
+
+        v.name                = old.name;
+        v.annotation          = cloneAnnotation (old.annotation);
+        v.isFunctionParameter = old.isFunctionParameter;
+        v.isExternal          = old.isExternal;
+        v.isSpecialisation    = old.isSpecialisation;
+        v.doNotConstantFold   = old.doNotConstantFold;
+        v.numReads            = old.numReads;
+        v.numWrites           = old.numWrites;
+    }
+
+    //==============================================================================
+    AST::ConcreteType& create (AST::ConcreteType& old)
+    {
+        return allocator.allocate<AST::ConcreteType> (cloneContext (old.context), cloneType (old.type));
+    }
+
+    AST::SubscriptWithBrackets& create (AST::SubscriptWithBrackets& old)
+    {
+        return allocator.allocate<AST::SubscriptWithBrackets> (cloneContext (old.context), getClone (old.lhs.get()), getClone (old.rhs));
+    }
+
+    AST::SubscriptWithChevrons& create (AST::SubscriptWithChevrons& old)
+    {
+        return allocator.allocate<AST::SubscriptWithChevrons> (cloneContext (old.context), getClone (old.lhs.get()), getClone (*old.rhs));
+    }
+
+    AST::TypeMetaFunction& create (AST::TypeMetaFunction& old)
+    {
+        return allocator.allocate<AST::TypeMetaFunction> (cloneContext (old.context), getClone (old.source.get()), old.operation);
+    }
+
+    AST::Assignment& create (AST::Assignment& old)
+    {
+        return allocator.allocate<AST::Assignment> (cloneContext (old.context), getClone (old.target.get()), getClone (old.newValue.get()));
+    }
+
+    AST::BinaryOperator& create (AST::BinaryOperator& old)
+    {
+        return allocator.allocate<AST::BinaryOperator> (cloneContext (old.context), getClone (old.lhs.get()),
+                                                        getClone (old.rhs.get()), old.operation);
+    }
+
+    AST::Constant& create (AST::Constant& old)
+    {
+        return allocator.allocate<AST::Constant> (cloneContext (old.context), cloneValue (old.value));
+    }
+
+    AST::DotOperator& create (AST::DotOperator& old)
+    {
+        return allocator.allocate<AST::DotOperator> (cloneContext (old.context), getClone (old.lhs.get()), getClone (old.rhs));
+    }
+
+    AST::CallOrCast& create (AST::CallOrCast& old)
+    {
+        auto& c = allocator.allocate<AST::CallOrCast> (getClone (old.nameOrType.get()), getClone (old.arguments), old.isMethodCall);
+        c.context = cloneContext (old.context);
+        return c;
+    }
+
+    AST::FunctionCall& create (AST::FunctionCall& old)
+    {
+        return allocator.allocate<AST::FunctionCall> (cloneContext (old.context), getClone (old.targetFunction),
+                                                      getClone (old.arguments), old.isMethodCall);
+    }
+
+    AST::TypeCast& create (AST::TypeCast& old)
+    {
+        return allocator.allocate<AST::TypeCast> (cloneContext (old.context), cloneType (old.targetType), getClone (old.source.get()));
+    }
+
+    AST::PreOrPostIncOrDec& create (AST::PreOrPostIncOrDec& old)
+    {
+        return allocator.allocate<AST::PreOrPostIncOrDec> (cloneContext (old.context), getClone (old.target.get()),
+                                                           old.isIncrement, old.isPost);
+    }
+
+    AST::InPlaceOperator& create (AST::InPlaceOperator& old)
+    {
+        return allocator.allocate<AST::InPlaceOperator> (cloneContext (old.context), getClone (old.target.get()),
+                                                         getClone (old.source.get()), old.operation);
+    }
+
+    AST::ArrayElementRef& create (AST::ArrayElementRef& old)
+    {
+        auto& a = allocator.allocate<AST::ArrayElementRef> (cloneContext (old.context), getClone (*old.object),
+                                                            getClone (old.startIndex), getClone (old.endIndex), old.isSlice);
+        a.suppressWrapWarning = old.suppressWrapWarning;
+        return a;
+    }
+
+    AST::StructMemberRef& create (AST::StructMemberRef& old)
+    {
+        return allocator.allocate<AST::StructMemberRef> (cloneContext (old.context), getClone (old.object.get()),
+                                                         StructurePtr (cloneStructure (*old.structure)), old.memberName);
+    }
+
+    AST::ComplexMemberRef& create (AST::ComplexMemberRef& old)
+    {
+        return allocator.allocate<AST::ComplexMemberRef> (cloneContext (old.context), getClone (old.object.get()),
+                                                          cloneType (old.complexType), old.memberName);
+    }
+
+    AST::StructDeclaration& create (AST::StructDeclaration& old)
+    {
+        return allocator.allocate<AST::StructDeclaration> (cloneContext (old.context), old.name);
+    }
+
+    void fill (AST::StructDeclaration& old, AST::StructDeclaration& s)
+    {
+        for (auto& m : old.getMembers())
+            s.addMember (getClone (m.type.get()), cloneContext (m.nameLocation), m.name);
+
+        // Only copy the structure if the original has already created it, so that the
+        // copy is created lazily in the same way if it hasn't
+        if (old.structure != nullptr)
+            s.structure = cloneStructure (*old.structure);
+    }
+
+    AST::StructDeclarationRef& create (AST::StructDeclarationRef& old)
+    {
+        return allocator.allocate<AST::StructDeclarationRef> (cloneContext (old.context), getClone (old.structure));
+    }
+
+    AST::UsingDeclaration& create (AST::UsingDeclaration& old)
+    {
+        return allocator.allocate<AST::UsingDeclaration> (cloneContext (old.context), old.name, getClone (old.targetType));
+    }
+
+    AST::TernaryOp& create (AST::TernaryOp& old)
+    {
+        return allocator.allocate<AST::TernaryOp> (cloneContext (old.context), getClone (old.condition.get()),
+                                                   getClone (old.trueBranch.get()), getClone (old.falseBranch.get()));
+    }
+
+    AST::UnaryOperator& create (AST::UnaryOperator& old)
+    {
+        return allocator.allocate<AST::UnaryOperator> (cloneContext (old.context), getClone (old.source.get()), old.operation);
+    }
+
+    AST::QualifiedIdentifier& create (AST::QualifiedIdentifier& old)
+    {
+        return allocator.allocate<AST::QualifiedIdentifier> (cloneContext (old.context));
+    }
+
+    void fill (AST::QualifiedIdentifier& old, AST::QualifiedIdentifier& q)
+    {
+        for (auto& s : old.pathSections)
+            q.addToPath (s.path, getClone (s.specialisationArgs));
+
+        q.pathPrefix = old.pathPrefix;
+    }
+
+    AST::UnqualifiedName& create (AST::UnqualifiedName& old)
+    {
+        return allocator.allocate<AST::UnqualifiedName> (cloneContext (old.context), old.identifier);
+    }
+
+    AST::VariableRef& create (AST::VariableRef& old)
+    {
+        return allocator.allocate<AST::VariableRef> (cloneContext (old.context), getClone (old.variable.get()));
+    }
+
+    AST::InputEndpointRef& create (AST::InputEndpointRef& old)
+    {
+        return allocator.allocate<AST::InputEndpointRef> (cloneContext (old.context), getClone (old.input.get()));
+    }
+
+    AST::OutputEndpointRef& create (AST::OutputEndpointRef& old)
+    {
+        return allocator.allocate<AST::OutputEndpointRef> (cloneContext (old.context), getClone (old.output.get()));
+    }
+
+    AST::ConnectionEndpointRef& create (AST::ConnectionEndpointRef& old)
+    {
+        return allocator.allocate<AST::ConnectionEndpointRef> (cloneContext (old.context), getClone (old.parentProcessorInstance),
+                                                               getClone (old.endpointName));
+    }
+
+    AST::ProcessorRef& create (AST::ProcessorRef& old)
+    {
+        return allocator.allocate<AST::ProcessorRef> (cloneContext (old.context), getClone (old.processor));
+    }
+
+    AST::NamespaceRef& create (AST::NamespaceRef& old)
+    {
+        return allocator.allocate<AST::NamespaceRef> (cloneContext (old.context), getClone (old.ns));
+    }
+
+    AST::ProcessorInstanceRef& create (AST::ProcessorInstanceRef& old)
+    {
+        return allocator.allocate<AST::ProcessorInstanceRef> (cloneContext (old.context), getClone (old.processorInstance));
+    }
+
+    AST::CommaSeparatedList& create (AST::CommaSeparatedList& old)
+    {
+        return allocator.allocate<AST::CommaSeparatedList> (cloneContext (old.context));
+    }
+
+    void fill (AST::CommaSeparatedList& old, AST::CommaSeparatedList& l)
+    {
+        l.items = cloneArray (old.items);
+    }
+
+    AST::ProcessorProperty& create (AST::ProcessorProperty& old)
+    {
+        return allocator.allocate<AST::ProcessorProperty> (cloneContext (old.context), old.property);
+    }
+
+    AST::WriteToEndpoint& create (AST::WriteToEndpoint& old)
+    {
+        return allocator.allocate<AST::WriteToEndpoint> (cloneContext (old.context), getClone (old.target.get()), getClone (old.value.get()));
+    }
+
+    AST::AdvanceClock& create (AST::AdvanceClock& old)
+    {
+        return allocator.allocate<AST::AdvanceClock> (cloneContext (old.context));
+    }
+
+    AST::StaticAssertion& create (AST::StaticAssertion& old)
+    {
+        return allocator.allocate<AST::StaticAssertion> (cloneContext (old.context), getClone (old.condition.get()), old.errorMessage);
+    }
+
+    // An operator's types get cached the first time they're needed, and later passes can
+    // change its operands without updating them, so the copy has to use the same types
+    void fill (AST::BinaryOperator& old, AST::BinaryOperator& b)
+    {
+        auto& types = old.getCachedOpTypes();
+        b.setCachedOpTypes ({ cloneType (types.resultType), cloneType (types.operandType) });
+    }
+
+    // These expressions are completely set up by their constructors
+    void fill (AST::ConcreteType&, AST::ConcreteType&) {}
+    void fill (AST::SubscriptWithBrackets&, AST::SubscriptWithBrackets&) {}
+    void fill (AST::SubscriptWithChevrons&, AST::SubscriptWithChevrons&) {}
+    void fill (AST::TypeMetaFunction&, AST::TypeMetaFunction&) {}
+    void fill (AST::Assignment&, AST::Assignment&) {}
+    void fill (AST::Constant&, AST::Constant&) {}
+    void fill (AST::DotOperator&, AST::DotOperator&) {}
+    void fill (AST::CallOrCast&, AST::CallOrCast&) {}
+    void fill (AST::FunctionCall&, AST::FunctionCall&) {}
+    void fill (AST::TypeCast&, AST::TypeCast&) {}
+    void fill (AST::PreOrPostIncOrDec&, AST::PreOrPostIncOrDec&) {}
+    void fill (AST::InPlaceOperator&, AST::InPlaceOperator&) {}
+    void fill (AST::ArrayElementRef&, AST::ArrayElementRef&) {}
+    void fill (AST::StructMemberRef&, AST::StructMemberRef&) {}
+    void fill (AST::StructDeclarationRef&, AST::StructDeclarationRef&) {}
+    void fill (AST::UsingDeclaration&, AST::UsingDeclaration&) {}
+    void fill (AST::TernaryOp&, AST::TernaryOp&) {}
+    void fill (AST::UnaryOperator&, AST::UnaryOperator&) {}
+    void fill (AST::UnqualifiedName&, AST::UnqualifiedName&) {}
+    void fill (AST::VariableRef&, AST::VariableRef&) {}
+    void fill (AST::InputEndpointRef&, AST::InputEndpointRef&) {}
+    void fill (AST::OutputEndpointRef&, AST::OutputEndpointRef&) {}
+    void fill (AST::ConnectionEndpointRef&, AST::ConnectionEndpointRef&) {}
+    void fill (AST::ProcessorRef&, AST::ProcessorRef&) {}
+    void fill (AST::NamespaceRef&, AST::NamespaceRef&) {}
+    void fill (AST::ProcessorInstanceRef&, AST::ProcessorInstanceRef&) {}
+    void fill (AST::ProcessorProperty&, AST::ProcessorProperty&) {}
+    void fill (AST::WriteToEndpoint&, AST::WriteToEndpoint&) {}
+    void fill (AST::AdvanceClock&, AST::AdvanceClock&) {}
+    void fill (AST::StaticAssertion&, AST::StaticAssertion&) {}
+
+    void fill (AST::ComplexMemberRef& old, AST::ComplexMemberRef& c)
+    {
+        c.memberType = cloneType (old.memberType);
+    }
+};
+
+} // namespace soul
@@ -25,7 +25,92 @@
 namespace soul
 {
 
-Compiler::Compiler (bool i) : includeStandardLibrary (i)
+//==============================================================================
+/** Returns a read-only pool containing all the identifiers that appear in the built-in
+    library code. This is created once and then shared by every Compiler, so concurrent
+    compiles on different threads don't each have to allocate their own copies of them.
+*/
+static std::shared_ptr<const Identifier::Pool> getSharedLibraryIdentifiers()
+{
+    struct IdentifierScanner  : public SOULTokeniser
+    {
+        static void addAllIdentifiers (Identifier::Pool& pool, CodeLocation code)
+        {
+            IdentifierScanner scanner;
+            scanner.initialise (code);
+
+            while (! scanner.matches (Token::eof))
+            {
+                if (scanner.matches (Token::identifier))
+                    pool.get (scanner.currentStringValue);
+
+                scanner.skip();
+            }
+        }
+
+        [[noreturn]] void throwError (const CompileMessage& message) const override
+        {
+            soul::throwInternalCompilerError ("Error in built-in code: " + message.getFullDescription());
+        }
+    };
+
+    static const auto sharedPool = []
+    {
+        auto pool = std::make_shared<Identifier::Pool>();
+
+        IdentifierScanner::addAllIdentifiers (*pool, getDefaultLibraryCode());
+
+        for (auto name : { "soul.audio.utils", "soul.midi", "soul.notes", "soul.frequency", "soul.mixing",
+                           "soul.oscillators", "soul.noise", "soul.timeline", "soul.filters", "soul.complex" })
+            IdentifierScanner::addAllIdentifiers (*pool, getSystemModule (name));
+
+        return std::shared_ptr<const Identifier::Pool> (std::move (pool));
+    }();
+
+    return sharedPool;
+}
+
+//==============================================================================
+/** The built-in library modules, parsed and resolved just once. Rather than compiling
+    the library code again, each Compiler starts from an ASTCloner copy of this tree in
+    its own allocator, so the original is never modified after it has been built.
+
+    The copying never touches the reference counts of anything in this tree (which
+    aren't thread-safe), so a single instance can be shared by all threads.
+*/
+struct Compiler::BuiltInLibrary
+{
+    BuiltInLibrary() : compiler (false)
+    {
+        compiler.topLevelNamespace = AST::createRootNamespace (compiler.allocator);
+        compiler.addDefaultBuiltInLibrary();
+
+        // The copies' identifier pools use this one as their base, so that the identifiers
+        // in a copied tree still match any that the new compile creates
+        identifiers = std::make_shared<Identifier::Pool> (std::move (compiler.allocator.identifiers));
+    }
+
+    AST::Namespace& createCopy (AST::Allocator& targetAllocator) const
+    {
+        CompileProfiler::ScopedPhase phase ("copy built-in library", "compile", std::addressof (targetAllocator.pool));
+        targetAllocator.stringDictionary = compiler.allocator.stringDictionary;
+        return ASTCloner::clone (targetAllocator, *compiler.topLevelNamespace, std::addressof (phase));
+    }
+
+    Compiler compiler;
+    std::shared_ptr<const Identifier::Pool> identifiers;
+};
+
+const Compiler::BuiltInLibrary& Compiler::getBuiltInLibrary()
+{
+    static BuiltInLibrary library;
+    return library;
+}
+
+//==============================================================================
+Compiler::Compiler (bool i)
+    : allocator (i ? getBuiltInLibrary().identifiers : getSharedLibraryIdentifiers()),
+      includeStandardLibrary (i)
 {
     reset();
 }
@@ -43,10 +128,10 @@ bool Compiler::addCode (CompileMessageList& messageList, CodeLocation code)
 
     if (topLevelNamespace == nullptr)
     {
-        topLevelNamespace = AST::createRootNamespace (allocator);
-
         if (includeStandardLibrary)
-            addDefaultBuiltInLibrary();
+            topLevelNamespace = getBuiltInLibrary().createCopy (allocator);
+        else
+            topLevelNamespace = AST::createRootNamespace (allocator);
     }
 
     try
@@ -56,7 +141,7 @@ bool Compiler::addCode (CompileMessageList& messageList, CodeLocation code)
 
         SOUL_LOG_TIME_OF_SCOPE ("initial resolution pass: " + code.getFilename());
         soul::CompileMessageHandler handler (messageList);
-        compile (std::move (code));
+        compile (std::move (code), copySyntaxTree);
         return true;
     }
     catch (soul::AbortCompilationException) {}
@@ -105,6 +190,19 @@ static void sanityCheckBuildSettings (const BuildSettings& settings,
         CodeLocation().throwError (Errors::unsupportedOptimisationLevel());
 }
 
+static void checkStateSize (const Program& program, const BuildSettings& settings)
+{
+    if (settings.maxStateSize != 0 && ! program.isEmpty())
+    {
+        auto& mainProcessor = program.getMainProcessor();
+        auto stateSize = heart::Utilities::getStateSize (program, mainProcessor);
+
+        if (stateSize > settings.maxStateSize)
+            mainProcessor.location.throwError (Errors::programStateTooLarge (getReadableDescriptionOfByteSize (stateSize),
+                                                                             getReadableDescriptionOfByteSize (settings.maxStateSize)));
+    }
+}
+
 static ArrayWithPreallocation<CodeLocation, 4> getHEARTFiles (const BuildBundle& bundle)
 {
     ArrayWithPreallocation<CodeLocation, 4> result;
@@ -120,13 +218,14 @@ static ArrayWithPreallocation<CodeLocation, 4> getHEARTFiles (const BuildBundle&
     return result;
 }
 
-static Program buildHEART (CompileMessageList& messageList, CodeLocation code)
+static Program buildHEART (CompileMessageList& messageList, CodeLocation code, const BuildSettings& settings)
 {
     try
     {
         CompileMessageHandler handler (messageList);
         auto program = heart::Parser::parse (code);
         heart::Checker::sanityCheck (program);
+        checkStateSize (program, settings);
         return program;
     }
     catch (AbortCompilationException) {}
@@ -135,9 +234,213 @@ static Program buildHEART (CompileMessageList& messageList, CodeLocation code)
 }
 
 
+static std::string getCompileProfileFile (const BuildSettings& settings)
+{
+    if (! settings.compileProfileFile.empty())
+        return settings.compileProfileFile;
+
+    if (auto file = std::getenv ("SOUL_COMPILE_PROFILE"))
+        return file;
+
+    return {};
+}
+
+static void countHEARTObjects (CompileProfiler::ScopedPhase& phase, const Program& program)
+{
+    if (CompileProfiler::getCurrent() == nullptr)
+        return;
+
+    int64_t numFunctions = 0, numBlocks = 0, numStatements = 0;
+
+    for (auto& m : program.getModules())
+    {
+        for (auto& f : m->functions.get())
+        {
+            ++numFunctions;
+
+            for (auto& b : f->blocks)
+            {
+                ++numBlocks;
+
+                for (auto s : b->statements)
+                {
+                    ignoreUnused (s);
+                    ++numStatements;
+                }
+            }
+        }
+    }
+
+    phase.addCounter ("modules", static_cast<int64_t> (program.getModules().size()));
+    phase.addCounter ("functions", numFunctions);
+    phase.addCounter ("blocks", numBlocks);
+    phase.addCounter ("statements", numStatements);
+}
+
 //==============================================================================
 Program Compiler::build (CompileMessageList& messageList, const BuildBundle& bundle)
 {
+    if (CompileProfiler::getCurrent() != nullptr)
+        return buildWithoutProfiling (messageList, bundle);
+
+    auto profileFile = getCompileProfileFile (bundle.settings);
+
+    if (profileFile.empty())
+        return buildWithoutProfiling (messageList, bundle);
+
+    CompileProfiler profiler;
+    Program program;
+
+    {
+        CompileProfiler::ScopedAttachment attachment (profiler);
+        program = buildWithoutProfiling (messageList, bundle);
+    }
+
+    std::ofstream (profileFile) << profiler.toChromeTraceJSON();
+    SOUL_LOG ("compile profile", [&] { return profiler.getSummary(); });
+    return program;
+}
+
+static std::string getProgramCacheKey (const BuildBundle& bundle)
+{
+    HashBuilder hash;
+    hash << getLibraryVersion().toString();
+
+    for (auto& f : bundle.sourceFiles)
+        hash << f.filename << std::string (1, 0) << f.content << std::string (1, 0);
+
+    for (auto& f : bundle.settings.overrideStandardLibrary)
+        hash << f.filename << std::string (1, 0) << f.content << std::string (1, 0);
+
+    auto& settings = bundle.settings;
+
+    hash << choc::text::floatToString (settings.sampleRate)
+         << std::to_string (settings.maxBlockSize)
+         << std::to_string (settings.maxStateSize)
+         << std::to_string (settings.optimisationLevel)
+         << std::to_string (settings.sessionID)
+         << settings.mainProcessor
+         << choc::json::toString (settings.customSettings);
+
+    return "heart" + hash.toString();
+}
+
+static Program loadCachedProgram (LinkerCache& cache, const std::string& key)
+{
+    auto size = cache.readItem (key.c_str(), nullptr, 0);
+
+    if (size != 0)
+    {
+        std::vector<uint8_t> data (static_cast<size_t> (size));
+
+        if (cache.readItem (key.c_str(), data.data(), size) == size)
+        {
+            // Data written by an incompatible version is rejected here, in which
+            // case the program just gets rebuilt and re-cached
+            CompileMessageList messages;
+            return Program::createFromBinary (messages, data.data(), data.size());
+        }
+    }
+
+    return {};
+}
+
+Program Compiler::build (CompileMessageList& messageList, const BuildBundle& bundle, LinkerCache* cache)
+{
+    if (cache == nullptr)
+        return build (messageList, bundle);
+
+    auto key = getProgramCacheKey (bundle);
+
+    // When a compile profile has been asked for, the compiler has to run to produce it
+    if (getCompileProfileFile (bundle.settings).empty())
+    {
+        auto cachedProgram = loadCachedProgram (*cache, key);
+
+        if (! cachedProgram.isEmpty())
+            return cachedProgram;
+    }
+
+    auto program = build (messageList, bundle);
+
+    if (! program.isEmpty() && messageList.messages.empty())
+    {
+        auto data = program.toBinary();
+        cache->storeItem (key.c_str(), data.data(), data.size());
+    }
+
+    return program;
+}
+
+std::vector<Program> Compiler::buildConcurrently (std::vector<CompileMessageList>& messageLists,
+                                                 ArrayView<BuildBundle> bundles, uint32_t maxNumThreads)
+{
+    auto numBundles = bundles.size();
+    std::vector<Program> programs (numBundles);
+    messageLists.resize (numBundles);
+
+    if (maxNumThreads == 0)
+        maxNumThreads = std::max (1u, std::thread::hardware_concurrency());
+
+    std::atomic<size_t> nextBundle { 0 };
+    std::vector<std::exception_ptr> exceptions (numBundles);
+
+    auto buildNextBundles = [&]
+    {
+        for (;;)
+        {
+            auto index = nextBundle++;
+
+            if (index >= numBundles)
+                return;
+
+            auto& messageList = messageLists[index];
+
+            try
+            {
+                CompileMessageHandler handler (messageList);
+                programs[index] = build (messageList, bundles[index]);
+            }
+            catch (AbortCompilationException) {}
+            catch (...)
+            {
+                exceptions[index] = std::current_exception();
+            }
+        }
+    };
+
+    auto numThreads = std::min (static_cast<size_t> (maxNumThreads), numBundles);
+    std::vector<std::thread> threads;
+
+    for (size_t i = 1; i < numThreads; ++i)
+        threads.emplace_back (buildNextBundles);
+
+    buildNextBundles();
+
+    for (auto& t : threads)
+        t.join();
+
+    for (auto& e : exceptions)
+        if (e != nullptr)
+            std::rethrow_exception (e);
+
+    return programs;
+}
+
+Program Compiler::buildUnoptimised (CompileMessageList& messageList, const BuildBundle& bundle)
+{
+    return buildWithoutProfiling (messageList, bundle, false);
+}
+
+Program Compiler::buildFromCopiedSyntaxTree (CompileMessageList& messageList, const BuildBundle& bundle)
+{
+    return buildWithoutProfiling (messageList, bundle, true, true);
+}
+
+Program Compiler::buildWithoutProfiling (CompileMessageList& messageList, const BuildBundle& bundle,
+                                         bool optimiseHEART, bool copySyntaxTree)
+{
+    CompileProfiler::ScopedPhase phase ("build", "build");
     sanityCheckBuildSettings (bundle.settings);
 
     auto heartFiles = getHEARTFiles (bundle);
@@ -147,10 +450,15 @@ Program Compiler::build (CompileMessageList& messageList, const BuildBundle& bun
         if (heartFiles.size() > 1 || heartFiles.size() < bundle.sourceFiles.size())
             CodeLocation().throwError (Errors::onlyOneHeartFileAllowed());
 
-        return buildHEART (messageList, heartFiles.front());
+        CompileProfiler::ScopedPhase parsePhase ("parse HEART", "build");
+        auto program = buildHEART (messageList, heartFiles.front(), bundle.settings);
+        countHEARTObjects (parsePhase, program);
+        return program;
     }
 
     Compiler c (bundle.settings.overrideStandardLibrary.empty());
+    c.optimiseHEART = optimiseHEART;
+    c.copySyntaxTree = copySyntaxTree;
 
     if (! bundle.settings.overrideStandardLibrary.empty())
         for (auto& file : bundle.settings.overrideStandardLibrary)
@@ -171,17 +479,38 @@ std::vector<pool_ref<AST::ModuleBase>> Compiler::parseTopLevelDeclarations (AST:
 }
 
 //==============================================================================
-void Compiler::compile (CodeLocation code)
+void Compiler::compile (CodeLocation code, bool copyTreeAfterEachStage)
 {
     SOUL_LOG_TIME_OF_SCOPE ("compile: " + code.getFilename());
+    CompileProfiler::ScopedPhase phase (code.getFilename(), "compile", std::addressof (allocator.pool));
+
+    {
+        CompileProfiler::ScopedPhase parsePhase ("parse", "compile", std::addressof (allocator.pool));
 
-    for (auto& m : StructuralParser::parseTopLevelDeclarations (allocator, code, *topLevelNamespace))
-        SanityCheckPass::runPreResolution (m);
+        for (auto& m : StructuralParser::parseTopLevelDeclarations (allocator, code, *topLevelNamespace))
+            SanityCheckPass::runPreResolution (m);
+    }
 
-    ResolutionPass::run (allocator, *topLevelNamespace, true);
+    if (copyTreeAfterEachStage)
+        replaceSyntaxTreeWithCopy ("copy parsed syntax tree");
+
+    {
+        CompileProfiler::ScopedPhase resolutionPhase ("resolve", "compile", std::addressof (allocator.pool));
+        ResolutionPass::run (allocator, *topLevelNamespace, true);
+    }
 
     ASTUtilities::mergeDuplicateNamespaces (*topLevelNamespace);
     SanityCheckPass::runDuplicateNameChecker (*topLevelNamespace);
+
+    if (copyTreeAfterEachStage)
+        replaceSyntaxTreeWithCopy ("copy resolved syntax tree");
+}
+
+void Compiler::replaceSyntaxTreeWithCopy (const char* phaseName)
+{
+    // The old tree is left in the allocator, but nothing refers to it any more
+    CompileProfiler::ScopedPhase phase (phaseName, "compile", std::addressof (allocator.pool));
+    topLevelNamespace = ASTCloner::clone (allocator, *topLevelNamespace, std::addressof (phase));
 }
 
 //==============================================================================
@@ -232,7 +561,9 @@ Program Compiler::link (CompileMessageList& messageList, const BuildSettings& se
     {
         CompileMessageHandler handler (messageList);
         sanityCheckBuildSettings (settings);
-        return link (messageList, findMainProcessor (settings));
+        auto program = link (messageList, findMainProcessor (settings));
+        checkStateSize (program, settings);
+        return program;
     }
     catch (AbortCompilationException) {}
 
@@ -244,30 +575,62 @@ Program Compiler::link (CompileMessageList& messageList, AST::ProcessorBase& pro
     try
     {
         SOUL_LOG_TIME_OF_SCOPE ("link time");
+        CompileProfiler::ScopedPhase phase ("link", "link");
         CompileMessageHandler handler (messageList);
-        ASTUtilities::resolveHoistedEndpoints (allocator, *topLevelNamespace);
-        ASTUtilities::mergeDuplicateNamespaces (*topLevelNamespace);
-        ASTUtilities::removeModulesWithSpecialisationParams (*topLevelNamespace);
-        ResolutionPass::run (allocator, *topLevelNamespace, false);
+
+        {
+            CompileProfiler::ScopedPhase resolutionPhase ("resolve", "link", std::addressof (allocator.pool));
+            ASTUtilities::resolveHoistedEndpoints (allocator, *topLevelNamespace);
+            ASTUtilities::mergeDuplicateNamespaces (*topLevelNamespace);
+            ASTUtilities::removeModulesWithSpecialisationParams (*topLevelNamespace);
+            ResolutionPass::run (allocator, *topLevelNamespace, false);
+        }
 
         compile (getSystemModule ("soul.complex"));
-        ConvertComplexPass::run (allocator, *topLevelNamespace);
+
+        {
+            CompileProfiler::ScopedPhase complexPhase ("convert complex types", "link", std::addressof (allocator.pool));
+            ConvertComplexPass::run (allocator, *topLevelNamespace);
+        }
 
         ASTUtilities::connectAnyChildEndpointsNeedingToBeExposed (allocator, processorToRun);
 
         Program program;
         program.getStringDictionary() = allocator.stringDictionary;  // Bring the existing string dictionary along so that the handles match
-        compileAllModules (*topLevelNamespace, program, processorToRun);
-        heart::Utilities::inlineFunctionsThatUseAdvanceOrStreams<Optimisations> (program);
-        heart::Checker::sanityCheck (program);
+
+        {
+            CompileProfiler::ScopedPhase generatePhase ("generate HEART", "link", std::addressof (program.getAllocator().pool));
+            compileAllModules (*topLevelNamespace, program, processorToRun);
+            countHEARTObjects (generatePhase, program);
+        }
+
+        {
+            CompileProfiler::ScopedPhase inlinePhase ("inline stream functions", "link", std::addressof (program.getAllocator().pool));
+            heart::Utilities::inlineFunctionsThatUseAdvanceOrStreams<Optimisations> (program);
+        }
+
+        {
+            CompileProfiler::ScopedPhase checkPhase ("sanity check", "link");
+            heart::Checker::sanityCheck (program);
+        }
+
         reset();
 
         SOUL_LOG (program.getMainProcessor().originalFullName + ": linked HEART",
                   [&] { return program.toHEART(); });
 
-        heart::Checker::testHEARTRoundTrip (program);
-        Optimisations::optimiseFunctionBlocks (program);
-        Optimisations::removeUnusedVariables (program);
+        {
+            CompileProfiler::ScopedPhase roundTripPhase ("HEART round-trip test", "link");
+            heart::Checker::testHEARTRoundTrip (program);
+        }
+
+        if (optimiseHEART)
+        {
+            CompileProfiler::ScopedPhase optimisePhase ("optimise", "link", std::addressof (program.getAllocator().pool));
+            optimise (program);
+            countHEARTObjects (optimisePhase, program);
+        }
+
         return program;
     }
     catch (AbortCompilationException) {}
@@ -275,6 +638,24 @@ Program Compiler::link (CompileMessageList& messageList, AST::ProcessorBase& pro
     return {};
 }
 
+void Compiler::optimise (Program& program)
+{
+    Optimisations::optimiseFunctionBlocks (program);
+    Optimisations::removeUnusedVariables (program);
+}
+
+void Compiler::lowerGraphs (Program& program, bool optimiseAfterwards)
+{
+    CompileProfiler::ScopedPhase phase ("lower graphs", "link", std::addressof (program.getAllocator().pool));
+    GraphLowering::apply (program);
+    heart::Checker::sanityCheck (program);
+
+    if (optimiseAfterwards)
+        optimise (program);
+
+    countHEARTObjects (phase, program);
+}
+
 static Module& createHEARTModule (Program& p, pool_ptr<AST::ModuleBase> module, bool isMainProcessor)
 {
     int index = isMainProcessor ? 0 : -1;
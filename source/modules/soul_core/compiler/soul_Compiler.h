@@ -21,6 +21,8 @@
 namespace soul
 {
 
+class LinkerCache;
+
 //==============================================================================
 /**
     Compiles and links some source code to create a Program that can be
@@ -37,10 +39,58 @@ public:
 
     /** This static method runs a complete build and link for a BuildBundle, and returns
         the resulting program.
+
+        If a CompileProfiler is attached to the calling thread, the build's phases are
+        recorded in it. Otherwise, if BuildSettings::compileProfileFile or the
+        SOUL_COMPILE_PROFILE environment variable specifies a file, a profile is recorded
+        and written to that file as a Chrome trace, and a summary is sent to the Logger.
     */
     static Program build (CompileMessageList& messageList,
                           const BuildBundle& buildBundle);
 
+    /** Like build(), but if a cache is provided, the program is looked up in it using a hash
+        of the bundle's sources and settings, so that an unchanged bundle can skip the compiler
+        entirely. On a miss, the program that gets built is stored in the cache in the binary
+        HEART format - but only if it produced no messages, so that a cache hit can never hide
+        warnings which the caller would otherwise have seen.
+    */
+    static Program build (CompileMessageList& messageList,
+                          const BuildBundle& buildBundle,
+                          LinkerCache* cache);
+
+    /** Like build(), but skips the HEART optimisation passes, so the program is left as the
+        front-end generated it. This is meant for tools which need an unoptimised reference,
+        such as OptimisationFuzzer; such a program can be passed to optimise() later, which
+        will give the same result as build(). Unlike BuildSettings::optimisationLevel, which
+        only tells a performer how hard to optimise its own code, this changes the HEART.
+    */
+    static Program buildUnoptimised (CompileMessageList& messageList,
+                                     const BuildBundle& buildBundle);
+
+    /** Like build(), but each time the compiler has parsed or resolved a source file, it
+        replaces its whole syntax tree with an ASTCloner copy before carrying on, so that the
+        program is linked from copies of every kind of object that the front-end creates. The
+        result should be identical to build()'s, which makes this a way to test the cloner that
+        gives each build its copy of the built-in library. If a CompileProfiler is attached, the
+        number of objects of each type that got copied is added to its "copy" phases.
+    */
+    static Program buildFromCopiedSyntaxTree (CompileMessageList& messageList,
+                                              const BuildBundle& buildBundle);
+
+    /** Builds a set of independent BuildBundles, running up to maxNumThreads compiles
+        concurrently (or one per hardware thread if this is 0).
+
+        The messageLists vector is resized to match the number of bundles, and each
+        bundle's messages are added to its corresponding list. The programs are returned
+        in the same order as the bundles, with an empty Program for any that failed.
+
+        Separate Compiler objects share only immutable state (i.e. the pre-compiled built-in
+        library and its identifiers), so calling build() from several threads at once is safe.
+    */
+    static std::vector<Program> buildConcurrently (std::vector<CompileMessageList>& messageLists,
+                                                   ArrayView<BuildBundle> buildBundles,
+                                                   uint32_t maxNumThreads = 0);
+
     /** Compiles a chunk of code which is expected to contain a list of top-level
         processor/graph/namespace decls, and these are added to the program.
     */
@@ -52,6 +102,15 @@ public:
     */
     Program link (CompileMessageList& messageList, const BuildSettings&);
 
+    /** Runs the optimisation passes that link() applies to the HEART code it generates. */
+    static void optimise (Program&);
+
+    /** Flattens the program's main graph with GraphLowering, and optionally re-optimises
+        the result. This is experimental: link() never does it, so a program only gets
+        lowered if its caller asks for it.
+    */
+    static void lowerGraphs (Program&, bool optimiseAfterwards);
+
     /** Just parses the top-level objects from a chunk of code */
     static std::vector<pool_ref<AST::ModuleBase>> parseTopLevelDeclarations (AST::Allocator&,
                                                                              CodeLocation code,
@@ -62,15 +121,22 @@ private:
     AST::Allocator allocator;
     pool_ptr<AST::Namespace> topLevelNamespace;
 
+    struct BuiltInLibrary;
+    static const BuiltInLibrary& getBuiltInLibrary();
+
+    static Program buildWithoutProfiling (CompileMessageList&, const BuildBundle&,
+                                          bool optimiseHEART = true, bool copySyntaxTree = false);
+
     void reset();
     void addDefaultBuiltInLibrary();
-    void compile (CodeLocation);
+    void compile (CodeLocation, bool copyTreeAfterEachStage = false);
+    void replaceSyntaxTreeWithCopy (const char* phaseName);
     Program link (CompileMessageList&, AST::ProcessorBase& processorToRun);
     AST::ProcessorBase& findMainProcessor (const BuildSettings&);
 
     void compileAllModules (const AST::Namespace& parentNamespace, Program&, AST::ProcessorBase& processorToRun);
 
-    bool includeStandardLibrary;
+    bool includeStandardLibrary, optimiseHEART = true, copySyntaxTree = false;
 };
 
 } // namespace soul
@@ -40,7 +40,11 @@ struct HEARTGenerator  : public ASTVisitor
             generators.push_back ({ sourceModules[i], targetModules[i], maxNestedExpressionDepth });
 
         for (size_t i = 0; i < sourceModules.size(); ++i)
+        {
+            CompileProfiler::ScopedPhase phase (targetModules[i]->fullName, "generate HEART",
+                                                std::addressof (targetModules[i]->allocator.pool));
             generators[i].visitObject (sourceModules[i]);
+        }
     }
 
 private:
@@ -119,6 +119,15 @@ struct StructuralParser   : public SOULTokeniser
         return functionList->back();
     }
 
+    /** Gives a module a createClone function which makes copies of it by re-parsing its source. */
+    static void setCloneFunction (AST::ModuleBase& module)
+    {
+        module.createClone = [&module] (AST::Allocator& a, AST::Namespace& parentNS, const std::string& newName) -> AST::ModuleBase&
+        {
+            return cloneModuleWithNewName (a, parentNS, module, newName);
+        };
+    }
+
     [[noreturn]] void throwError (const CompileMessage& message) const override
     {
         getContext().throwError (message);
@@ -241,11 +250,7 @@ private:
 
         module = oldModule;
 
-        newModule.createClone = [&newModule] (AST::Allocator& a, AST::Namespace& parentNS, const std::string& newName) -> AST::ModuleBase&
-        {
-            return cloneModuleWithNewName (a, parentNS, newModule, newName);
-        };
-
+        setCloneFunction (newModule);
         return newModule;
     }
 
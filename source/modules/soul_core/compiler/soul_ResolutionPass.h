@@ -33,6 +33,22 @@ struct ResolutionPass  final
         ResolutionPass (a, m).run (ignoreTypeAndConstantErrors);
     }
 
+    /** Gives a processor which was specialised for a graph instance a createClone function
+        that re-parses it and then applies the same specialisation args to the copy.
+    */
+    static void setSpecialisedCloneFunction (AST::ProcessorBase& p)
+    {
+        StructuralParser::setCloneFunction (p);
+        auto parserCloneFn = p.createClone;
+
+        p.createClone = [parserCloneFn, &p] (AST::Allocator& a, AST::Namespace& parentNS, const std::string& newName) -> AST::ModuleBase&
+        {
+            auto& m = parserCloneFn (a, parentNS, newName);
+            ModuleInstanceResolver::resolveAllSpecialisationArgs (p.specialisationArgs, m.specialisationParams);
+            return m;
+        };
+    }
+
 private:
     ResolutionPass (AST::Allocator& a, AST::ModuleBase& m) : allocator (a), module (m)
     {
@@ -73,9 +89,12 @@ private:
             return runStats;
         }
 
+        uint32_t numIterations = 0;
+
         for (;;)
         {
             runStats.clear();
+            ++numIterations;
 
             tryPass<QualifiedIdentifierResolver> (runStats, true);
             tryPass<TypeResolver> (runStats, true);
@@ -118,6 +137,11 @@ private:
 
         SanityCheckPass::runPostResolutionChecks (module);
 
+        if (CompileProfiler::getCurrent() != nullptr)
+            CompileProfiler::addInstantEvent (module.getFullyQualifiedDisplayPath().toString(), "resolution",
+                                              { { "iterations", numIterations },
+                                                { "itemsReplaced", static_cast<int64_t> (runStats.numReplaced) } });
+
         module.isFullyResolved = true;
         return runStats;
     }
@@ -2136,15 +2160,8 @@ private:
 
                     if (requiresSpecialisation)
                     {
-                        auto oldCloneFn = target->createClone;
-
-                        target->createClone = [=] (AST::Allocator& a, AST::Namespace& parentNS, const std::string& newName) -> AST::ModuleBase&
-                        {
-                            auto& m = oldCloneFn (a, parentNS, newName);
-                            resolveAllSpecialisationArgs (specialisationArgs, m.specialisationParams);
-                            return m;
-                        };
-
+                        target->specialisationArgs = specialisationArgs;
+                        setSpecialisedCloneFunction (target.get());
                         resolveAllSpecialisationArgs (specialisationArgs, target->specialisationParams);
                     }
                 }
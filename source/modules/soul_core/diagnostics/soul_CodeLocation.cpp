@@ -43,6 +43,58 @@ SourceCodeText::Ptr SourceCodeText::createInternal (std::string name, std::strin
     return Ptr (*new SourceCodeText (std::move (name), std::move (text), true));
 }
 
+void SourceCodeText::buildLineTable() const
+{
+    std::call_once (lineTableBuilt, [this]
+    {
+        auto size = content.length();
+        auto text = content.data();
+        lineStarts.reserve (size / 32 + 1);
+        lineStarts.push_back (0);
+        uint8_t allBits = 0;
+
+        for (size_t i = 0; i < size; ++i)
+        {
+            auto c = static_cast<uint8_t> (text[i]);
+            allBits |= c;
+
+            if (c == '\n')
+                lineStarts.push_back (static_cast<uint32_t> (i + 1));
+            else if (c == '\r')
+                hasCarriageReturns = true;
+        }
+
+        pureASCII = (allBits & 0x80) == 0;
+    });
+}
+
+uint32_t SourceCodeText::getLineIndex (size_t byteOffset) const
+{
+    buildLineTable();
+    auto nextLine = std::upper_bound (lineStarts.begin(), lineStarts.end(), byteOffset);
+    SOUL_ASSERT (nextLine != lineStarts.begin());
+    return static_cast<uint32_t> (std::distance (lineStarts.begin(), nextLine) - 1);
+}
+
+size_t SourceCodeText::getLineStartOffset (uint32_t lineIndex) const
+{
+    buildLineTable();
+    SOUL_ASSERT (lineIndex < lineStarts.size());
+    return lineStarts[lineIndex];
+}
+
+bool SourceCodeText::isPureASCII() const
+{
+    buildLineTable();
+    return pureASCII;
+}
+
+bool SourceCodeText::containsCarriageReturns() const
+{
+    buildLineTable();
+    return hasCarriageReturns;
+}
+
 //==============================================================================
 CodeLocation::CodeLocation (SourceCodeText::Ptr code)  : sourceCode (std::move (code)), location (sourceCode->utf8) {}
 
@@ -96,14 +148,23 @@ CodeLocation::LineAndColumn CodeLocation::getLineAndColumn() const
     if (sourceCode == nullptr)
         return { 0, 0 };
 
-    LineAndColumn lc = { 1, 1 };
+    auto offset = std::min (getByteOffsetInFile(), sourceCode->content.length());
+    auto lineIndex = sourceCode->getLineIndex (offset);
+    auto lineStart = sourceCode->getLineStartOffset (lineIndex);
+
+    LineAndColumn lc = { lineIndex + 1, 1 };
 
-    for (auto i = sourceCode->utf8; i < location && ! i.isEmpty(); ++i)
+    if (sourceCode->isPureASCII())
     {
-        ++lc.column;
-        if (*i == '\n')  { lc.column = 1; lc.line++; }
+        lc.column += static_cast<uint32_t> (offset - lineStart);
+        return lc;
     }
 
+    auto end = UTF8Reader (sourceCode->content.c_str() + offset);
+
+    for (auto i = UTF8Reader (sourceCode->content.c_str() + lineStart); i < end && ! i.isEmpty(); ++i)
+        ++lc.column;
+
     return lc;
 }
 
@@ -113,7 +174,15 @@ CodeLocation CodeLocation::getStartOfLine() const
         return {};
 
     auto l = *this;
-    auto start = sourceCode->utf8;
+    auto offset = std::min (getByteOffsetInFile(), sourceCode->content.length());
+    auto start = UTF8Reader (sourceCode->content.c_str()
+                               + sourceCode->getLineStartOffset (sourceCode->getLineIndex (offset)));
+
+    if (! sourceCode->containsCarriageReturns())
+    {
+        l.location = start;
+        return l;
+    }
 
     while (l.location > start)
     {
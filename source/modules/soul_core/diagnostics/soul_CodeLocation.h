@@ -34,10 +34,31 @@ struct SourceCodeText  final : public RefCountedObject
     const UTF8Reader utf8;
     const bool isInternal;
 
+    /** Returns the zero-based index of the line which contains the given byte offset.
+        The first call builds a table of line-start offsets, so that subsequent lookups
+        are just a binary search.
+    */
+    uint32_t getLineIndex (size_t byteOffset) const;
+
+    /** Returns the byte offset of the start of a line, as found by getLineIndex(). */
+    size_t getLineStartOffset (uint32_t lineIndex) const;
+
+    /** Returns true if the text contains no bytes above 0x7f. */
+    bool isPureASCII() const;
+
+    /** Returns true if the text contains any '\r' characters. */
+    bool containsCarriageReturns() const;
+
 private:
     SourceCodeText() = delete;
     SourceCodeText (const SourceCodeText&) = delete;
     SourceCodeText (std::string, std::string, bool internal);
+
+    mutable std::once_flag lineTableBuilt;
+    mutable std::vector<uint32_t> lineStarts;
+    mutable bool pureASCII = true, hasCarriageReturns = false;
+
+    void buildLineTable() const;
 };
 
 
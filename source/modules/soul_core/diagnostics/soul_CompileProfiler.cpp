@@ -0,0 +1,209 @@
+/*
+    _____ _____ _____ __
+   |   __|     |  |  |  |      The SOUL language
+   |__   |  |  |  |  |  |__    Copyright (c) 2019 - ROLI Ltd.
+   |_____|_____|_____|_____|
+
+   The code in this file is provided under the terms of the ISC license:
+
+   Permission to use, copy, modify, and/or distribute this software for any purpose
+   with or without fee is hereby granted, provided that the above copyright notice and
+   this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+   TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+   NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+   IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+   CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#if ! SOUL_INSIDE_CORE_CPP
+ #error "Don't add this cpp file to your build, it gets included indirectly by soul_core.cpp"
+#endif
+
+namespace soul
+{
+
+static thread_local CompileProfiler* currentProfiler = nullptr;
+
+CompileProfiler::CompileProfiler() = default;
+CompileProfiler::~CompileProfiler() = default;
+
+CompileProfiler* CompileProfiler::getCurrent() noexcept    { return currentProfiler; }
+
+double CompileProfiler::getSecondsSinceStart() const
+{
+    return std::chrono::duration<double> (clock::now() - startTime).count();
+}
+
+//==============================================================================
+CompileProfiler::ScopedAttachment::ScopedAttachment (CompileProfiler& p)  : lastProfiler (currentProfiler)
+{
+    currentProfiler = std::addressof (p);
+}
+
+CompileProfiler::ScopedAttachment::~ScopedAttachment()
+{
+    currentProfiler = lastProfiler;
+}
+
+//==============================================================================
+CompileProfiler::ScopedPhase::ScopedPhase (std::string name, std::string category, const PoolAllocator* allocatorToMeasure)
+    : profiler (currentProfiler), allocator (allocatorToMeasure)
+{
+    if (profiler != nullptr)
+    {
+        Event e;
+        e.name = std::move (name);
+        e.category = std::move (category);
+        e.startSeconds = profiler->getSecondsSinceStart();
+        e.depth = profiler->currentDepth++;
+
+        eventIndex = profiler->events.size();
+        profiler->events.push_back (std::move (e));
+
+        if (allocator != nullptr)
+        {
+            startBytes = allocator->getTotalBytesAllocated();
+            startItems = allocator->getTotalItemsAllocated();
+        }
+    }
+}
+
+CompileProfiler::ScopedPhase::~ScopedPhase()
+{
+    if (profiler != nullptr)
+    {
+        auto& e = profiler->events[eventIndex];
+        e.durationSeconds = profiler->getSecondsSinceStart() - e.startSeconds;
+        --(profiler->currentDepth);
+
+        // An allocator may have been cleared during the phase, in which case there's nothing meaningful to report
+        if (allocator != nullptr && allocator->getTotalBytesAllocated() >= startBytes)
+        {
+            e.counters.push_back ({ "bytesAllocated", static_cast<int64_t> (allocator->getTotalBytesAllocated() - startBytes) });
+            e.counters.push_back ({ "objectsAllocated", static_cast<int64_t> (allocator->getTotalItemsAllocated() - startItems) });
+        }
+    }
+}
+
+void CompileProfiler::ScopedPhase::addCounter (std::string name, int64_t value)
+{
+    if (profiler != nullptr)
+        profiler->events[eventIndex].counters.push_back ({ std::move (name), value });
+}
+
+void CompileProfiler::addInstantEvent (std::string name, std::string category, Counters counters)
+{
+    if (auto profiler = currentProfiler)
+    {
+        Event e;
+        e.name = std::move (name);
+        e.category = std::move (category);
+        e.startSeconds = profiler->getSecondsSinceStart();
+        e.isInstant = true;
+        e.depth = profiler->currentDepth;
+        e.counters = std::move (counters);
+        profiler->events.push_back (std::move (e));
+    }
+}
+
+//==============================================================================
+std::string CompileProfiler::toChromeTraceJSON() const
+{
+    auto traceEvents = choc::value::createEmptyArray();
+
+    for (auto& e : events)
+    {
+        auto args = choc::value::createObject ({});
+
+        for (auto& c : e.counters)
+            args.addMember (c.first, c.second);
+
+        auto event = choc::value::createObject ({},
+                                                "name", e.name,
+                                                "cat", e.category,
+                                                "ph", e.isInstant ? "i" : "X",
+                                                "ts", e.startSeconds * 1.0e6,
+                                                "pid", 1,
+                                                "tid", 1,
+                                                "args", args);
+        if (e.isInstant)
+            event.addMember ("s", "t");
+        else
+            event.addMember ("dur", e.durationSeconds * 1.0e6);
+
+        traceEvents.addArrayElement (event);
+    }
+
+    return choc::json::toString (choc::value::createObject ({},
+                                                            "traceEvents", traceEvents,
+                                                            "displayTimeUnit", "ms"));
+}
+
+std::string CompileProfiler::getSummary() const
+{
+    struct Total
+    {
+        std::string name;
+        size_t count = 0;
+        double seconds = 0;
+        int64_t bytes = 0, objects = 0;
+    };
+
+    std::vector<Total> totals;
+
+    auto getTotal = [&] (const std::string& name) -> Total&
+    {
+        for (auto& t : totals)
+            if (t.name == name)
+                return t;
+
+        totals.push_back ({ name });
+        return totals.back();
+    };
+
+    for (auto& e : events)
+    {
+        auto& t = getTotal (e.category + ": " + e.name);
+        ++t.count;
+
+        if (! e.isInstant)
+            t.seconds += e.durationSeconds;
+
+        for (auto& c : e.counters)
+        {
+            if (c.first == "bytesAllocated")    t.bytes += c.second;
+            if (c.first == "objectsAllocated")  t.objects += c.second;
+        }
+    }
+
+    std::stable_sort (totals.begin(), totals.end(), [] (const Total& a, const Total& b) { return a.seconds > b.seconds; });
+
+    PaddedStringTable table;
+    table.numExtraSpaces = 2;
+
+    table.startRow();
+    table.appendItem ("Phase");
+    table.appendItem ("Count");
+    table.appendItem ("Time");
+    table.appendItem ("Allocated");
+    table.appendItem ("Objects");
+
+    for (auto& t : totals)
+    {
+        table.startRow();
+        table.appendItem (t.name);
+        table.appendItem (std::to_string (t.count));
+        table.appendItem (t.seconds > 0 ? getDescriptionOfTimeInSeconds (t.seconds) : std::string ("-"));
+        table.appendItem (t.bytes > 0 ? getReadableDescriptionOfByteSize (static_cast<uint64_t> (t.bytes)) : std::string ("-"));
+        table.appendItem (t.objects > 0 ? std::to_string (t.objects) : std::string ("-"));
+    }
+
+    std::string result;
+    table.iterateRows ([&] (const std::string& row) { result += choc::text::trimEnd (row) + "\n"; });
+    return result;
+}
+
+} // namespace soul
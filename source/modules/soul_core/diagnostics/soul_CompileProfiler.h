@@ -0,0 +1,105 @@
+/*
+    _____ _____ _____ __
+   |   __|     |  |  |  |      The SOUL language
+   |__   |  |  |  |  |  |__    Copyright (c) 2019 - ROLI Ltd.
+   |_____|_____|_____|_____|
+
+   The code in this file is provided under the terms of the ISC license:
+
+   Permission to use, copy, modify, and/or distribute this software for any purpose
+   with or without fee is hereby granted, provided that the above copyright notice and
+   this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+   TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+   NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+   IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+   CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+namespace soul
+{
+
+//==============================================================================
+/**
+    Records a timeline of the phases that a build goes through, along with how much
+    memory and how many objects each phase allocated, so that the cost of compiling
+    a program can be examined.
+
+    A profiler only collects data while it's attached to the current thread with a
+    CompileProfiler::ScopedAttachment, and the compiler's instrumentation does nothing
+    when no profiler is attached.
+
+    The results can be exported in the Chrome trace-event format (which can be opened
+    with chrome://tracing or https://ui.perfetto.dev), or as a plain-text summary table.
+
+    @see BuildSettings::compileProfileFile
+*/
+struct CompileProfiler  final
+{
+    CompileProfiler();
+    ~CompileProfiler();
+
+    using Counters = std::vector<std::pair<std::string, int64_t>>;
+
+    struct Event
+    {
+        std::string name, category;
+        double startSeconds = 0, durationSeconds = 0;
+        bool isInstant = false;
+        uint32_t depth = 0;
+        Counters counters;
+    };
+
+    std::vector<Event> events;
+
+    /** Returns the events as a JSON string in the Chrome trace-event format. */
+    std::string toChromeTraceJSON() const;
+
+    /** Returns a table of the total time and allocations for each category and phase. */
+    std::string getSummary() const;
+
+    //==============================================================================
+    /** Returns the profiler attached to the current thread, or nullptr if there isn't one. */
+    static CompileProfiler* getCurrent() noexcept;
+
+    /** An RAII class which attaches a profiler to the current thread. */
+    struct ScopedAttachment
+    {
+        ScopedAttachment (CompileProfiler&);
+        ~ScopedAttachment();
+
+        CompileProfiler* const lastProfiler;
+    };
+
+    /** An RAII class which records the time spent inside its scope as an event.
+        If an allocator is supplied, the number of bytes and objects that were allocated
+        from it during the scope are added to the event's counters.
+    */
+    struct ScopedPhase
+    {
+        ScopedPhase (std::string name, std::string category, const PoolAllocator* allocatorToMeasure = nullptr);
+        ~ScopedPhase();
+
+        void addCounter (std::string name, int64_t value);
+
+    private:
+        CompileProfiler* const profiler;
+        size_t eventIndex = 0;
+        const PoolAllocator* const allocator;
+        size_t startBytes = 0, startItems = 0;
+    };
+
+    /** Records an event with no duration, if a profiler is attached to the current thread. */
+    static void addInstantEvent (std::string name, std::string category, Counters counters);
+
+private:
+    using clock = std::chrono::high_resolution_clock;
+    clock::time_point startTime = clock::now();
+    uint32_t currentDepth = 0;
+
+    double getSecondsSinceStart() const;
+};
+
+} // namespace soul
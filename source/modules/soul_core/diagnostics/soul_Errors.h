@@ -76,6 +76,7 @@ namespace soul
     X(processorSpecialisationNotAllowed,    "Processor specialisations may only be used in graphs") \
     X(namespaceSpecialisationNotAllowed,    "Namespace specialisations may only be used in namespaces") \
     X(wrongAPIVersion,                      "Cannot parse code that was generated by a later version of the API") \
+    X(malformedBinaryHEART,                 "The binary HEART data is corrupt or truncated") \
     X(semicolonAfterBrace,                  "A brace-enclosed declaration should not be followed by a semicolon") \
     X(nameInUse,                            "The name $Q0$ is already in use") \
     X(invalidEndpointName,                  "The name $Q0$ is not a valid endpoint name") \
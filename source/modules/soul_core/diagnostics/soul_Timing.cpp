@@ -22,6 +22,10 @@
  #error "Don't add this cpp file to your build, it gets included indirectly by soul_core.cpp"
 #endif
 
+#if defined (_MSC_VER) && (defined (_M_X64) || defined (_M_IX86))
+ #include <intrin.h>
+#endif
+
 namespace soul
 {
 
@@ -115,5 +119,20 @@ float getBelaLoadFromString (const std::string& input)
     return 0;
 }
 
+int64_t readCycleCounter() noexcept
+{
+   #if defined (_MSC_VER) && (defined (_M_X64) || defined (_M_IX86))
+    return static_cast<int64_t> (__rdtsc());
+   #elif (defined (__GNUC__) || defined (__clang__)) && (defined (__x86_64__) || defined (__i386__))
+    return static_cast<int64_t> (__builtin_ia32_rdtsc());
+   #elif (defined (__GNUC__) || defined (__clang__)) && SOUL_ARM64
+    int64_t ticks;
+    asm volatile ("mrs %0, cntvct_el0" : "=r" (ticks));
+    return ticks;
+   #else
+    return std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now().time_since_epoch()).count();
+   #endif
+}
+
 
 } // namespace soul
@@ -44,6 +44,12 @@ private:
 // Helper method to read the bela audio load
 float getBelaLoadFromString (const std::string& input);
 
+/** Returns the CPU's time-stamp counter, or on platforms which don't have one that can
+    be read cheaply, a count of nanoseconds. This is intended for measuring short intervals
+    on a single thread, so the values shouldn't be compared between different threads.
+*/
+int64_t readCycleCounter() noexcept;
+
 //==============================================================================
 /** Keeps a running count of the proportion of time spent in a block. */
 struct CPULoadMeasurer
@@ -123,6 +123,7 @@ namespace CompileTimeIntrinsicEvaluation
             case IntrinsicType::get_array_size:          return {};
             case IntrinsicType::read:                    return {};
             case IntrinsicType::readLinearInterpolated:  return {};
+            case IntrinsicType::readCycleCounter:        return {};
         }
 
         return {};
@@ -131,6 +132,9 @@ namespace CompileTimeIntrinsicEvaluation
 
 Value performIntrinsic (IntrinsicType i, ArrayView<Value> args)
 {
+    if (args.empty())
+        return {};
+
     auto argType = args.front().getType();
 
     for (auto& a : args)
@@ -197,6 +201,7 @@ Value performIntrinsic (IntrinsicType i, ArrayView<Value> args)
     X(get_array_size) \
     X(read) \
     X(readLinearInterpolated) \
+    X(readCycleCounter) \
 
 IntrinsicType getIntrinsicTypeFromName (std::string_view s)
 {
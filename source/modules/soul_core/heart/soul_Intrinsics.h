@@ -59,7 +59,8 @@ namespace soul
         product,
         get_array_size,
         read,
-        readLinearInterpolated
+        readLinearInterpolated,
+        readCycleCounter
     };
 
     /** Used for compile-time evaluation of an intrinsic function */
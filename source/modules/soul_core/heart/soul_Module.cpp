@@ -96,6 +96,11 @@ void Module::StateVariables::add (heart::Variable& v)
     stateVariables.push_back (v);
 }
 
+bool Module::StateVariables::remove (heart::Variable& v)
+{
+    return removeItem (stateVariables, v);
+}
+
 //==============================================================================
 size_t Module::Structs::size() const  { return structs.size(); }
 
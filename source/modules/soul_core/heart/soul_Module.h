@@ -66,6 +66,7 @@ public:
         ArrayView<pool_ref<heart::Variable>> get() const;
         pool_ptr<heart::Variable> find (std::string_view name) const;
         void add (heart::Variable&);
+        bool remove (heart::Variable&);
         void clear();
 
     private:
@@ -81,6 +81,12 @@ struct ModuleCloner
     const Module& oldModule;
     Module& newModule;
 
+    /** This can be set if the destination program's identifier pool was made with
+        Identifier::Pool::shareStringsOf() from the source program's pool, in which case
+        identifiers can be reused without looking them up again.
+    */
+    bool identifiersAreShared = false;
+
     FunctionMappings& functionMappings;
     StructMappings& structMappings;
     VariableMappings& variableMappings;
@@ -135,11 +141,12 @@ struct ModuleCloner
 
     heart::Variable& getRemappedVariable (heart::Variable& old)
     {
-        auto v = variableMappings[old];
-        return v == nullptr ? cloneVariable (old) : *v;
+        auto found = variableMappings.find (old);
+        return found == variableMappings.end() ? cloneVariable (old) : *found->second;
     }
 
-    Value getRemappedValue (Value v)                                            { return v.cloneWithEquivalentType (cloneType (v.getType())); }
+    Identifier getRemappedIdentifier (Identifier old)                           { return identifiersAreShared ? old : newModule.allocator.get (old); }
+    Value getRemappedValue (const Value& v)                                     { return v.cloneWithEquivalentType (cloneType (v.getType())); }
     heart::Block& getRemappedBlock (heart::Block& old)                          { return *blockMappings[old]; }
     heart::Function& getRemappedFunction (heart::Function& old)                 { return *functionMappings[old]; }
     heart::InputDeclaration& getRemappedInput (heart::InputDeclaration& old)    { return *inputMappings[old]; }
@@ -179,7 +186,7 @@ struct ModuleCloner
         auto& mapping = inputMappings[old];
         SOUL_ASSERT (mapping == nullptr);
         mapping = io;
-        io.name = newModule.allocator.get (old.name);
+        io.name = getRemappedIdentifier (old.name);
         io.index = old.index;
         io.endpointType = old.endpointType;
         io.dataTypes = cloneTypes (old.dataTypes);
@@ -194,7 +201,7 @@ struct ModuleCloner
         auto& mapping = outputMappings[old];
         SOUL_ASSERT (mapping == nullptr);
         mapping = io;
-        io.name = newModule.allocator.get (old.name);
+        io.name = getRemappedIdentifier (old.name);
         io.index = old.index;
         io.endpointType = old.endpointType;
         io.dataTypes = cloneTypes (old.dataTypes);
@@ -243,7 +250,7 @@ struct ModuleCloner
         auto& mapping = variableMappings[old];
         SOUL_ASSERT (mapping == nullptr);
         auto& v = newModule.allocate<heart::Variable> (old.location, cloneType (old.type),
-                                                       newModule.allocator.get (old.name),
+                                                       getRemappedIdentifier (old.name),
                                                        old.role);
         v.externalHandle = old.externalHandle;
 
@@ -293,7 +300,7 @@ struct ModuleCloner
 
     heart::Block& createNewBlock (const heart::Block& old)
     {
-        auto& b = newModule.allocate<heart::Block> (newModule.allocator.get (old.name));
+        auto& b = newModule.allocate<heart::Block> (getRemappedIdentifier (old.name));
         blockMappings[old] = b;
         return b;
     }
@@ -418,10 +425,11 @@ struct ModuleCloner
     void clone (heart::Function& f, const heart::Function& old)
     {
         blockMappings.clear();
+        blockMappings.reserve (old.blocks.size());
 
         f.location = old.location;
         f.returnType = cloneType (old.returnType);
-        f.name = newModule.allocator.get (old.name);
+        f.name = getRemappedIdentifier (old.name);
         f.functionType = old.functionType;
         f.intrinsicType = old.intrinsicType;
         f.isExported = old.isExported;
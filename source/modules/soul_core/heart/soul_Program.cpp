@@ -141,6 +141,7 @@ struct Program::ProgramImpl  : public RefCountedObject
     {
         Program newProgram;
         newProgram.pimpl->stringDictionary = stringDictionary;
+        newProgram.pimpl->allocator.identifiers.shareStringsOf (allocator.identifiers);
 
         ModuleCloner::FunctionMappings functionMappings;
         ModuleCloner::StructMappings structMappings;
@@ -152,6 +153,7 @@ struct Program::ProgramImpl  : public RefCountedObject
             auto& newModule = newProgram.getAllocator().allocate<Module> (newProgram, m);
             newProgram.pimpl->insert (-1, newModule);
             cloners.emplace_back (m, newModule, functionMappings, structMappings, variableMappings);
+            cloners.back().identifiersAreShared = true;
         }
 
         for (auto& c : cloners)
@@ -285,10 +287,25 @@ Program Program::createFromHEART (CompileMessageList& messageList, CodeLocation
     return {};
 }
 
+Program Program::createFromBinary (CompileMessageList& messageList, const void* data, size_t size)
+{
+    try
+    {
+        CompileMessageHandler handler (messageList);
+        auto program = heart::BinaryFormat::read (data, size);
+        heart::Checker::sanityCheck (program);
+        return program;
+    }
+    catch (AbortCompilationException) {}
+
+    return {};
+}
+
 Program Program::clone() const                                                          { return pimpl->clone(); }
 bool Program::isEmpty() const                                                           { return getModules().empty(); }
 Program::operator bool() const                                                          { return ! isEmpty(); }
 std::string Program::toHEART() const                                                    { return heart::Printer::getDump (*this); }
+std::vector<uint8_t> Program::toBinary() const                                          { return heart::BinaryFormat::write (*this); }
 const std::vector<pool_ref<Module>>& Program::getModules() const                        { return pimpl->modules; }
 void Program::removeModule (Module& module)                                             { return pimpl->removeModule (module); }
 
@@ -55,6 +55,20 @@ public:
     */
     static Program createFromHEART (CompileMessageList&, CodeLocation heartCode);
 
+    /** Creates a compact binary representation of this program, which can be loaded
+        much more quickly than the equivalent HEART code.
+        The data is only intended for caching on the machine that created it.
+        @see createFromBinary()
+    */
+    std::vector<uint8_t> toBinary() const;
+
+    /** Converts a chunk of data that was created by toBinary() back to a Program.
+        If the data is invalid or was written by a different version, this will add
+        an error to the message list and return an empty program.
+        @see toBinary()
+    */
+    static Program createFromBinary (CompileMessageList&, const void* data, size_t size);
+
     //==============================================================================
     /** Return true if the program contains no modules. */
     bool isEmpty() const;
@@ -74,7 +74,9 @@ struct heart
     struct Parser;
     struct Printer;
     struct Checker;
+    struct BinaryFormat;
     struct Utilities;
+    struct Analyser;
 
     static constexpr const char* getRunFunctionName()               { return "run"; }
     static constexpr const char* getUserInitFunctionName()          { return "init"; }
@@ -280,6 +282,9 @@ struct heart
         bool hasValue() const         { return multiplier.has_value() || divider.has_value(); }
         double getRatio() const       { return static_cast<double> (multiplier.value_or (1)) / static_cast<double> (divider.value_or (1)); }
 
+        std::optional<int64_t> getMultiplier() const    { return multiplier; }
+        std::optional<int64_t> getDivider() const       { return divider; }
+
         std::string toString() const
         {
             std::ostringstream oss;
@@ -0,0 +1,826 @@
+/*
+    _____ _____ _____ __
+   |   __|     |  |  |  |      The SOUL language
+   |__   |  |  |  |  |  |__    Copyright (c) 2019 - ROLI Ltd.
+   |_____|_____|_____|_____|
+
+   The code in this file is provided under the terms of the ISC license:
+
+   Permission to use, copy, modify, and/or distribute this software for any purpose
+   with or without fee is hereby granted, provided that the above copyright notice and
+   this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+   TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+   NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+   IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+   CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#if ! SOUL_INSIDE_CORE_CPP
+ #error "Don't add this cpp file to your build, it gets included indirectly by soul_core.cpp"
+#endif
+
+namespace soul
+{
+
+//==============================================================================
+void heart::Analyser::OperationCounts::add (const OperationCounts& other, double scale)
+{
+    flops           += other.flops * scale;
+    integerOps      += other.integerOps * scale;
+    transcendentals += other.transcendentals * scale;
+    memoryReads     += other.memoryReads * scale;
+    memoryWrites    += other.memoryWrites * scale;
+    streamReads     += other.streamReads * scale;
+    streamWrites    += other.streamWrites * scale;
+    eventWrites     += other.eventWrites * scale;
+    functionCalls   += other.functionCalls * scale;
+    intrinsicCalls  += other.intrinsicCalls * scale;
+    branches        += other.branches * scale;
+}
+
+double heart::Analyser::OperationCounts::getWeightedTotal() const
+{
+    return flops + integerOps + transcendentals * 20.0
+            + memoryReads + memoryWrites + streamReads + streamWrites + eventWrites
+            + functionCalls * 5.0 + branches * 2.0;
+}
+
+choc::value::Value heart::Analyser::OperationCounts::toJSON() const
+{
+    return choc::value::createObject ("OperationCounts",
+                                      "flops", flops,
+                                      "integerOps", integerOps,
+                                      "transcendentals", transcendentals,
+                                      "memoryReads", memoryReads,
+                                      "memoryWrites", memoryWrites,
+                                      "streamReads", streamReads,
+                                      "streamWrites", streamWrites,
+                                      "eventWrites", eventWrites,
+                                      "functionCalls", functionCalls,
+                                      "intrinsicCalls", intrinsicCalls,
+                                      "branches", branches,
+                                      "weightedTotal", getWeightedTotal());
+}
+
+//==============================================================================
+struct heart::Analyser::FunctionAnalyser
+{
+    FunctionAnalyser (Analyser& a, const Options& o) : analyser (a), options (o) {}
+
+    Analyser& analyser;
+    const Options& options;
+
+    struct LoopBody
+    {
+        const heart::Block* header;
+        std::vector<const heart::Block*> blocks;
+        Loop loop;
+    };
+
+    std::unordered_map<const heart::Function*, OperationCounts> perCallCosts;
+    std::unordered_set<const heart::Function*> functionsInProgress;
+
+    //==============================================================================
+    FunctionStats analyse (heart::Function& f)
+    {
+        FunctionStats stats;
+        stats.name = f.getReadableName();
+        stats.numBlocks = static_cast<uint32_t> (f.blocks.size());
+
+        #define SOUL_ADD_STATEMENT_KIND(Type)  stats.statementCounts.push_back ({ #Type, 0u });
+        SOUL_HEART_STATEMENTS (SOUL_ADD_STATEMENT_KIND)
+        SOUL_HEART_TERMINATORS (SOUL_ADD_STATEMENT_KIND)
+        #undef SOUL_ADD_STATEMENT_KIND
+
+        for (auto& b : f.blocks)
+        {
+            for (auto s : b->statements)
+                incrementStatementCount (stats, *s);
+
+            if (b->terminator != nullptr)
+                incrementStatementCount (stats, *b->terminator);
+        }
+
+        auto loops = findLoops (f);
+
+        for (auto& l : loops)
+        {
+            stats.maxLoopDepth = std::max (stats.maxLoopDepth, l.loop.depth);
+            stats.loops.push_back (l.loop);
+        }
+
+        auto hasFrameLoop = std::any_of (loops.begin(), loops.end(), [] (const LoopBody& l) { return l.loop.isFrameLoop; });
+
+        for (auto& b : f.blocks)
+        {
+            BlockInfo info;
+
+            for (auto& l : loops)
+            {
+                if (contains (l.blocks, b.getPointer()))
+                {
+                    ++info.loopDepth;
+
+                    if (l.loop.isFrameLoop)
+                        info.isInFrameLoop = true;
+                    else
+                        info.weight *= static_cast<double> (l.loop.tripCount);
+                }
+            }
+
+            auto cost = getBlockCost (b);
+            stats.perCall.add (cost, info.weight);
+
+            if (f.functionType.isRun() && (info.isInFrameLoop || ! hasFrameLoop))
+                stats.perFrame.add (cost, info.weight);
+
+            analyser.blockInfo[b.getPointer()] = info;
+        }
+
+        perCallCosts[std::addressof (f)] = stats.perCall;
+        return stats;
+    }
+
+    //==============================================================================
+    static void incrementStatementCount (FunctionStats& stats, const heart::Object& s)
+    {
+        size_t index = 0;
+
+        #define SOUL_COUNT_STATEMENT_KIND(Type) \
+            if (cast<const heart::Type> (s) != nullptr) { ++stats.statementCounts[index].second; return; } \
+            ++index;
+
+        SOUL_HEART_STATEMENTS (SOUL_COUNT_STATEMENT_KIND)
+        SOUL_HEART_TERMINATORS (SOUL_COUNT_STATEMENT_KIND)
+        #undef SOUL_COUNT_STATEMENT_KIND
+    }
+
+    //==============================================================================
+    // Finds the natural loops, i.e. the blocks which can reach the source of a back-edge
+    // without going through its header. SOUL's control flow is always reducible, so the
+    // back-edges are just the edges that go to a block on the current depth-first path.
+    std::vector<LoopBody> findLoops (heart::Function& f)
+    {
+        std::vector<LoopBody> loops;
+
+        if (f.blocks.empty())
+            return loops;
+
+        std::unordered_set<const heart::Block*> visited, onPath;
+        std::unordered_map<const heart::Block*, std::vector<heart::Block*>> predecessors;
+        std::vector<std::pair<heart::Block*, const heart::Block*>> backEdges;
+
+        std::function<void(heart::Block&)> visit = [&] (heart::Block& b)
+        {
+            visited.insert (std::addressof (b));
+            onPath.insert (std::addressof (b));
+
+            for (auto dest : b.terminator->getDestinationBlocks())
+            {
+                predecessors[dest.getPointer()].push_back (std::addressof (b));
+
+                if (onPath.find (dest.getPointer()) != onPath.end())
+                    backEdges.push_back ({ std::addressof (b), dest.getPointer() });
+                else if (visited.find (dest.getPointer()) == visited.end())
+                    visit (dest);
+            }
+
+            onPath.erase (std::addressof (b));
+        };
+
+        visit (f.blocks.front());
+
+        for (auto& edge : backEdges)
+        {
+            auto header = edge.second;
+
+            auto loop = std::find_if (loops.begin(), loops.end(), [&] (const LoopBody& l) { return l.header == header; });
+
+            if (loop == loops.end())
+            {
+                loops.push_back ({ header, { header }, {} });
+                loop = std::prev (loops.end());
+            }
+
+            std::vector<heart::Block*> toVisit { edge.first };
+
+            while (! toVisit.empty())
+            {
+                auto b = toVisit.back();
+                toVisit.pop_back();
+
+                if (! contains (loop->blocks, b))
+                {
+                    loop->blocks.push_back (b);
+
+                    for (auto pred : predecessors[b])
+                        toVisit.push_back (pred);
+                }
+            }
+        }
+
+        for (auto& l : loops)
+        {
+            l.loop.headerBlock = l.header->name.toString();
+
+            for (auto& other : loops)
+                if (contains (other.blocks, l.header))
+                    ++l.loop.depth;
+
+            for (auto b : l.blocks)
+                for (auto s : b->statements)
+                    if (is_type<heart::AdvanceClock> (*s))
+                        l.loop.isFrameLoop = f.functionType.isRun();
+
+            if (! l.loop.isFrameLoop)
+                estimateTripCount (f, l);
+        }
+
+        std::sort (loops.begin(), loops.end(), [] (const LoopBody& a, const LoopBody& b) { return a.loop.depth < b.loop.depth; });
+        return loops;
+    }
+
+    void estimateTripCount (heart::Function& f, LoopBody& l)
+    {
+        l.loop.tripCount = options.unknownTripCount;
+
+        auto branch = cast<const heart::BranchIf> (*l.header->terminator);
+
+        if (branch == nullptr || ! branch->isConditional())
+            return;
+
+        auto& condition = getDefinition (*l.header, branch->condition);
+        auto op = cast<heart::BinaryOperator> (condition);
+
+        if (op == nullptr)
+            return;
+
+        auto counter = cast<heart::Variable> (op->lhs);
+        auto limit = op->rhs->getAsConstant();
+
+        if (counter == nullptr || ! limit.isValid() || ! limit.getType().isPrimitiveInteger())
+            return;
+
+        auto limitValue = limit.getAsInt64();
+        auto initialValue = findInitialValue (f, l, *counter);
+
+        // A "loop (n)" counts down to zero from n..
+        if (op->operation == BinaryOp::Op::greaterThan && limitValue == 0)
+        {
+            if (initialValue.has_value())
+                setTripCount (l, *initialValue);
+
+            return;
+        }
+
+        // ..and a range-based or simple for loop counts up to a limit
+        if (op->operation == BinaryOp::Op::lessThan || op->operation == BinaryOp::Op::lessThanOrEqual)
+        {
+            auto start = initialValue.value_or (0);
+            auto end = op->operation == BinaryOp::Op::lessThan ? limitValue : limitValue + 1;
+            setTripCount (l, end - start);
+        }
+    }
+
+    static void setTripCount (LoopBody& l, int64_t count)
+    {
+        l.loop.tripCount = static_cast<uint64_t> (std::max (count, (int64_t) 0));
+        l.loop.isTripCountKnown = true;
+    }
+
+    // If a condition is held in a local variable that the header block assigns, this
+    // returns the expression that it was assigned
+    static heart::Expression& getDefinition (const heart::Block& block, heart::Expression& e)
+    {
+        if (auto v = cast<heart::Variable> (e))
+        {
+            if (v->isFunctionLocal())
+            {
+                for (auto s : block.statements)
+                    if (auto a = cast<heart::AssignFromValue> (*s))
+                        if (a->target == v)
+                            return a->source;
+            }
+        }
+
+        return e;
+    }
+
+    // Returns the value that a counter has when the loop is entered, if all the assignments
+    // to it from outside the loop set it to the same constant
+    static std::optional<int64_t> findInitialValue (heart::Function& f, const LoopBody& l, heart::Variable& counter)
+    {
+        std::optional<int64_t> result;
+
+        for (auto& b : f.blocks)
+        {
+            if (contains (l.blocks, b.getPointer()))
+                continue;
+
+            for (auto s : b->statements)
+            {
+                if (auto a = cast<heart::Assignment> (*s))
+                {
+                    if (a->target == counter)
+                    {
+                        auto assign = cast<heart::AssignFromValue> (*s);
+
+                        if (assign == nullptr)
+                            return {};
+
+                        auto value = assign->source->getAsConstant();
+
+                        if (! (value.isValid() && value.getType().isPrimitiveInteger()))
+                            return {};
+
+                        auto intValue = value.getAsInt64();
+
+                        if (result.has_value() && *result != intValue)
+                            return {};
+
+                        result = intValue;
+                    }
+                }
+            }
+        }
+
+        return result;
+    }
+
+    //==============================================================================
+    OperationCounts getBlockCost (heart::Block& b)
+    {
+        OperationCounts counts;
+
+        for (auto s : b.statements)
+            addStatementCost (counts, *s);
+
+        if (auto branchIf = cast<heart::BranchIf> (*b.terminator))
+        {
+            counts.branches += 1;
+            addExpressionCost (counts, branchIf->condition, false);
+
+            for (auto& args : branchIf->targetArgs)
+                for (auto& arg : args)
+                    addExpressionCost (counts, arg, false);
+        }
+        else if (auto branch = cast<heart::Branch> (*b.terminator))
+        {
+            for (auto& arg : branch->targetArgs)
+                addExpressionCost (counts, arg, false);
+        }
+        else if (auto returnValue = cast<heart::ReturnValue> (*b.terminator))
+        {
+            addExpressionCost (counts, returnValue->returnValue, false);
+        }
+
+        return counts;
+    }
+
+    void addStatementCost (OperationCounts& counts, heart::Statement& s)
+    {
+        if (auto a = cast<heart::Assignment> (s))
+            if (a->target != nullptr)
+                addExpressionCost (counts, *a->target, true);
+
+        if (auto a = cast<heart::AssignFromValue> (s))
+            return addExpressionCost (counts, a->source, false);
+
+        if (auto call = cast<heart::FunctionCall> (s))
+            return addCallCost (counts, call->getFunction(), call->arguments, call->target != nullptr ? call->target->getType() : Type());
+
+        if (auto r = cast<heart::ReadStream> (s))
+        {
+            counts.streamReads += 1;
+
+            if (r->element != nullptr)
+                addExpressionCost (counts, *r->element, false);
+
+            return;
+        }
+
+        if (auto w = cast<heart::WriteStream> (s))
+        {
+            if (w->target->isStreamEndpoint())
+                counts.streamWrites += 1;
+            else
+                counts.eventWrites += 1;
+
+            if (w->element != nullptr)
+                addExpressionCost (counts, *w->element, false);
+
+            addExpressionCost (counts, w->value, false);
+        }
+    }
+
+    static double getNumElements (const Type& type)
+    {
+        if (type.isVector())
+            return static_cast<double> (type.getVectorSize());
+
+        return 1.0;
+    }
+
+    static void addArithmetic (OperationCounts& counts, const Type& type)
+    {
+        if (type.isFloatingPoint())
+            counts.flops += getNumElements (type);
+        else
+            counts.integerOps += getNumElements (type);
+    }
+
+    void addExpressionCost (OperationCounts& counts, heart::Expression& e, bool isWrite)
+    {
+        if (auto v = cast<heart::Variable> (e))
+        {
+            if (v->isExternalToFunction())
+            {
+                if (isWrite)
+                    counts.memoryWrites += 1;
+                else
+                    counts.memoryReads += 1;
+            }
+
+            return;
+        }
+
+        if (auto a = cast<heart::ArrayElement> (e))
+        {
+            addExpressionCost (counts, a->parent, isWrite);
+
+            if (a->dynamicIndex != nullptr)
+                addExpressionCost (counts, *a->dynamicIndex, false);
+
+            return;
+        }
+
+        if (auto s = cast<heart::StructElement> (e))
+            return addExpressionCost (counts, s->parent, isWrite);
+
+        if (auto c = cast<heart::TypeCast> (e))
+        {
+            addExpressionCost (counts, c->source, false);
+
+            if (! c->source->getType().isEqual (c->destType, Type::ignoreConst | Type::ignoreReferences))
+                addArithmetic (counts, c->source->getType().isFloatingPoint() ? c->source->getType() : c->destType);
+
+            return;
+        }
+
+        if (auto list = cast<heart::AggregateInitialiserList> (e))
+        {
+            for (auto& item : list->items)
+                addExpressionCost (counts, item, false);
+
+            return;
+        }
+
+        if (auto u = cast<heart::UnaryOperator> (e))
+        {
+            addExpressionCost (counts, u->source, false);
+            addArithmetic (counts, u->source->getType());
+            return;
+        }
+
+        if (auto b = cast<heart::BinaryOperator> (e))
+        {
+            addExpressionCost (counts, b->lhs, false);
+            addExpressionCost (counts, b->rhs, false);
+            addArithmetic (counts, b->lhs->getType());
+            return;
+        }
+
+        if (auto call = cast<heart::PureFunctionCall> (e))
+            return addCallCost (counts, call->function, call->arguments, call->getType());
+    }
+
+    template <typename ArgList>
+    void addCallCost (OperationCounts& counts, heart::Function& f, ArgList& args, const Type& resultType)
+    {
+        for (auto& arg : args)
+            addExpressionCost (counts, arg, false);
+
+        if (f.intrinsicType != IntrinsicType::none)
+        {
+            counts.intrinsicCalls += 1;
+            return addIntrinsicCost (counts, f.intrinsicType, args.empty() ? resultType : args.front()->getType());
+        }
+
+        counts.functionCalls += 1;
+        counts.add (getPerCallCost (f), 1.0);
+    }
+
+    static void addIntrinsicCost (OperationCounts& counts, IntrinsicType type, const Type& argType)
+    {
+        switch (type)
+        {
+            case IntrinsicType::fmod:       case IntrinsicType::remainder:
+            case IntrinsicType::sqrt:       case IntrinsicType::pow:
+            case IntrinsicType::exp:        case IntrinsicType::log:        case IntrinsicType::log10:
+            case IntrinsicType::sin:        case IntrinsicType::cos:        case IntrinsicType::tan:
+            case IntrinsicType::sinh:       case IntrinsicType::cosh:       case IntrinsicType::tanh:
+            case IntrinsicType::asinh:      case IntrinsicType::acosh:      case IntrinsicType::atanh:
+            case IntrinsicType::asin:       case IntrinsicType::acos:       case IntrinsicType::atan:
+            case IntrinsicType::atan2:
+                counts.transcendentals += getNumElements (argType);
+                break;
+
+            case IntrinsicType::sum:
+            case IntrinsicType::product:
+                addArithmetic (counts, argType);
+                break;
+
+            case IntrinsicType::read:
+            case IntrinsicType::readLinearInterpolated:
+                counts.memoryReads += type == IntrinsicType::read ? 1 : 2;
+                break;
+
+            case IntrinsicType::get_array_size:
+            case IntrinsicType::readCycleCounter:
+            case IntrinsicType::none:
+                break;
+
+            case IntrinsicType::abs:        case IntrinsicType::min:        case IntrinsicType::max:
+            case IntrinsicType::clamp:      case IntrinsicType::wrap:       case IntrinsicType::floor:
+            case IntrinsicType::ceil:       case IntrinsicType::addModulo2Pi:
+            case IntrinsicType::isnan:      case IntrinsicType::isinf:      case IntrinsicType::roundToInt:
+            default:
+                addArithmetic (counts, argType);
+                break;
+        }
+    }
+
+    OperationCounts getPerCallCost (heart::Function& f)
+    {
+        auto existing = perCallCosts.find (std::addressof (f));
+
+        if (existing != perCallCosts.end())
+            return existing->second;
+
+        // SOUL doesn't allow recursion, but don't hang if a program has got this far with some
+        if (f.hasNoBody || functionsInProgress.find (std::addressof (f)) != functionsInProgress.end())
+            return {};
+
+        functionsInProgress.insert (std::addressof (f));
+        auto loops = findLoops (f);
+        OperationCounts counts;
+
+        for (auto& b : f.blocks)
+        {
+            double weight = 1.0;
+
+            for (auto& l : loops)
+                if (contains (l.blocks, b.getPointer()))
+                    weight *= static_cast<double> (l.loop.tripCount);
+
+            counts.add (getBlockCost (b), weight);
+        }
+
+        functionsInProgress.erase (std::addressof (f));
+        perCallCosts[std::addressof (f)] = counts;
+        return counts;
+    }
+};
+
+//==============================================================================
+template <typename EndpointList>
+static uint64_t getStreamBytesPerFrame (const EndpointList& endpoints)
+{
+    uint64_t total = 0;
+
+    for (auto& e : endpoints)
+        if (e->isStreamEndpoint() && ! e->dataTypes.empty())
+            total += e->arraySize.value_or (1) * e->dataTypes.front().getPackedSizeInBytes();
+
+    return total;
+}
+
+heart::Analyser heart::Analyser::analyse (const Program& program, const Options& options)
+{
+    Analyser analyser;
+    FunctionAnalyser functionAnalyser (analyser, options);
+
+    for (auto& m : program.getModules())
+    {
+        ModuleStats stats;
+        stats.name = Program::stripRootNamespaceFromQualifiedPath (m->fullName);
+        stats.kind = m->isProcessor() ? "processor" : (m->isGraph() ? "graph" : "namespace");
+
+        if (! m->isNamespace())
+        {
+            stats.stateSize = heart::Utilities::getStateSize (program, m);
+            stats.streamInputBytesPerFrame  = getStreamBytesPerFrame (m->inputs);
+            stats.streamOutputBytesPerFrame = getStreamBytesPerFrame (m->outputs);
+        }
+
+        auto moduleIndex = analyser.modules.size();
+        analyser.moduleIndexes[m.getPointer()] = moduleIndex;
+
+        for (auto& f : m->functions.get())
+        {
+            if (f->hasNoBody)
+                continue;
+
+            analyser.functionIndexes[f.getPointer()] = { moduleIndex, stats.functions.size() };
+            stats.functions.push_back (functionAnalyser.analyse (f));
+
+            if (f->functionType.isRun())
+                stats.perFrame = stats.functions.back().perFrame;
+        }
+
+        analyser.modules.push_back (std::move (stats));
+    }
+
+    // Graphs are done afterwards, because their nodes may refer to modules that come later
+    std::function<OperationCounts(const Module&)> getGraphCost = [&] (const Module& graph)
+    {
+        OperationCounts total;
+
+        for (auto& node : graph.processorInstances)
+        {
+            auto& source = program.getModuleWithName (node->sourceName);
+            auto cost = source.isGraph() ? getGraphCost (source)
+                                         : analyser.modules[analyser.moduleIndexes[std::addressof (source)]].perFrame;
+
+            total.add (cost, node->arraySize * node->clockMultiplier.getRatio());
+        }
+
+        return total;
+    };
+
+    for (auto& m : program.getModules())
+        if (m->isGraph())
+            analyser.modules[analyser.moduleIndexes[m.getPointer()]].perFrame = getGraphCost (m);
+
+    std::function<void(const Module&, double)> addHotSpots = [&] (const Module& module, double instances)
+    {
+        if (module.isGraph())
+        {
+            for (auto& node : module.processorInstances)
+                addHotSpots (program.getModuleWithName (node->sourceName),
+                             instances * node->arraySize * node->clockMultiplier.getRatio());
+
+            return;
+        }
+
+        auto& stats = analyser.modules[analyser.moduleIndexes[std::addressof (module)]];
+
+        auto existing = std::find_if (analyser.hotSpots.begin(), analyser.hotSpots.end(),
+                                      [&] (const HotSpot& h) { return h.name == stats.name; });
+
+        if (existing == analyser.hotSpots.end())
+        {
+            analyser.hotSpots.push_back ({ stats.name, 0, 0 });
+            existing = std::prev (analyser.hotSpots.end());
+        }
+
+        existing->instancesPerFrame += instances;
+        existing->costPerFrame += instances * stats.perFrame.getWeightedTotal();
+    };
+
+    if (auto main = program.findMainProcessor())
+        addHotSpots (*main, 1.0);
+
+    std::stable_sort (analyser.hotSpots.begin(), analyser.hotSpots.end(),
+                      [] (const HotSpot& a, const HotSpot& b) { return a.costPerFrame > b.costPerFrame; });
+
+    return analyser;
+}
+
+choc::value::Value heart::Analyser::toJSON() const
+{
+    auto moduleList = choc::value::createEmptyArray();
+
+    for (auto& m : modules)
+    {
+        auto functionList = choc::value::createEmptyArray();
+
+        for (auto& f : m.functions)
+        {
+            auto statements = choc::value::createObject ("StatementCounts");
+
+            for (auto& count : f.statementCounts)
+                statements.addMember (count.first, static_cast<int32_t> (count.second));
+
+            auto loops = choc::value::createEmptyArray();
+
+            for (auto& l : f.loops)
+                loops.addArrayElement (choc::value::createObject ("Loop",
+                                                                  "header", l.headerBlock,
+                                                                  "depth", static_cast<int32_t> (l.depth),
+                                                                  "tripCount", static_cast<int64_t> (l.tripCount),
+                                                                  "isTripCountKnown", l.isTripCountKnown,
+                                                                  "isFrameLoop", l.isFrameLoop));
+
+            auto function = choc::value::createObject ("Function",
+                                                       "name", f.name,
+                                                       "numBlocks", static_cast<int32_t> (f.numBlocks),
+                                                       "maxLoopDepth", static_cast<int32_t> (f.maxLoopDepth),
+                                                       "statements", statements,
+                                                       "loops", loops,
+                                                       "perCall", f.perCall.toJSON());
+
+            if (f.perFrame.getWeightedTotal() > 0)
+                function.addMember ("perFrame", f.perFrame.toJSON());
+
+            functionList.addArrayElement (function);
+        }
+
+        moduleList.addArrayElement (choc::value::createObject ("Module",
+                                                               "name", m.name,
+                                                               "kind", std::string (m.kind),
+                                                               "stateSize", static_cast<int64_t> (m.stateSize),
+                                                               "streamInputBytesPerFrame", static_cast<int64_t> (m.streamInputBytesPerFrame),
+                                                               "streamOutputBytesPerFrame", static_cast<int64_t> (m.streamOutputBytesPerFrame),
+                                                               "perFrame", m.perFrame.toJSON(),
+                                                               "functions", functionList));
+    }
+
+    auto hotSpotList = choc::value::createEmptyArray();
+
+    for (auto& h : hotSpots)
+        hotSpotList.addArrayElement (choc::value::createObject ("HotSpot",
+                                                                "name", h.name,
+                                                                "instancesPerFrame", h.instancesPerFrame,
+                                                                "costPerFrame", h.costPerFrame));
+
+    return choc::value::createObject ("HEARTAnalysis",
+                                      "modules", moduleList,
+                                      "hotSpots", hotSpotList);
+}
+
+std::string heart::Analyser::createAnnotatedHEART (const Program& program) const
+{
+    auto describeCounts = [] (const OperationCounts& c)
+    {
+        auto format = [] (double n) { return choc::text::floatToString (n, 2); };
+
+        return format (c.flops) + " flops, " + format (c.integerOps) + " int ops, "
+                + format (c.transcendentals) + " transcendentals, "
+                + format (c.memoryReads) + " reads, " + format (c.memoryWrites) + " writes, "
+                + format (c.streamReads + c.streamWrites + c.eventWrites) + " stream/event ops, "
+                + format (c.functionCalls) + " calls, " + format (c.intrinsicCalls) + " intrinsic calls, "
+                + format (c.branches) + " branches";
+    };
+
+    Printer::Comments comments;
+
+    comments.getModuleComment = [&] (const Module& module) -> std::string
+    {
+        auto i = moduleIndexes.find (std::addressof (module));
+
+        if (i == moduleIndexes.end() || module.isNamespace())
+            return {};
+
+        auto& m = modules[i->second];
+
+        return "State: " + std::to_string (m.stateSize) + " bytes, streams in/out per frame: "
+                + std::to_string (m.streamInputBytesPerFrame) + "/" + std::to_string (m.streamOutputBytesPerFrame) + " bytes\n"
+                + "Per frame: " + describeCounts (m.perFrame);
+    };
+
+    comments.getFunctionComment = [&] (const heart::Function& function) -> std::string
+    {
+        auto i = functionIndexes.find (std::addressof (function));
+
+        if (i == functionIndexes.end())
+            return {};
+
+        auto& f = modules[i->second.first].functions[i->second.second];
+        std::string statements;
+
+        for (auto& count : f.statementCounts)
+            if (count.second != 0)
+                statements += (statements.empty() ? "" : ", ") + std::to_string (count.second) + " " + count.first;
+
+        auto text = "Statements: " + statements + "\n"
+                      + "Blocks: " + std::to_string (f.numBlocks) + ", max loop depth: " + std::to_string (f.maxLoopDepth) + "\n"
+                      + "Per call: " + describeCounts (f.perCall);
+
+        if (f.perFrame.getWeightedTotal() > 0)
+            text += "\nPer frame: " + describeCounts (f.perFrame);
+
+        return text;
+    };
+
+    comments.getBlockComment = [&] (const heart::Block& block) -> std::string
+    {
+        auto i = blockInfo.find (std::addressof (block));
+
+        if (i == blockInfo.end() || i->second.loopDepth == 0)
+            return {};
+
+        return "Loop depth " + std::to_string (i->second.loopDepth)
+                + (i->second.isInFrameLoop ? ", once per frame" : "")
+                + ", runs x" + choc::text::floatToString (i->second.weight, 2);
+    };
+
+    choc::text::CodePrinter out;
+    Printer::print (program, out, comments);
+    return out.toString();
+}
+
+} // namespace soul
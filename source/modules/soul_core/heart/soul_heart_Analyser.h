@@ -0,0 +1,159 @@
+/*
+    _____ _____ _____ __
+   |   __|     |  |  |  |      The SOUL language
+   |__   |  |  |  |  |  |__    Copyright (c) 2019 - ROLI Ltd.
+   |_____|_____|_____|_____|
+
+   The code in this file is provided under the terms of the ISC license:
+
+   Permission to use, copy, modify, and/or distribute this software for any purpose
+   with or without fee is hereby granted, provided that the above copyright notice and
+   this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+   TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+   NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+   IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+   CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+namespace soul
+{
+
+//==============================================================================
+/**
+    Works out a static cost profile for a program, without running it.
+
+    For each module and function it counts the statements of each kind, finds the loops
+    and how deeply they're nested, and estimates how many operations of each type (flops,
+    integer ops, transcendental calls, state reads and writes, etc.) it'll perform. The
+    counts for a block are multiplied by the trip counts of the loops it's inside, and the
+    cost of a call includes the cost of the function it calls.
+
+    A loop's trip count comes from its condition when it compares a counter with a constant,
+    as the loops that SOUL generates for "loop (n)", range-based for loops and simple "for"
+    loops do. Any other loop is assumed to run Options::unknownTripCount times. Every block
+    in a loop body is assumed to run on every iteration, so both sides of an "if" are counted.
+
+    In a run() function, the loops that contain an advance() are the frame loops, which
+    don't multiply the counts. Only the blocks inside a frame loop are included in its
+    per-frame cost, and a graph's per-frame cost is the sum of its nodes' costs, scaled by
+    their array sizes and clock ratios.
+*/
+struct heart::Analyser
+{
+    struct Options
+    {
+        /** The number of iterations assumed for a loop whose trip count can't be worked out. */
+        uint64_t unknownTripCount = 16;
+    };
+
+    /** Estimated numbers of operations, which may be fractional for nodes with a clock divider. */
+    struct OperationCounts
+    {
+        double flops = 0, integerOps = 0, transcendentals = 0,
+               memoryReads = 0, memoryWrites = 0,
+               streamReads = 0, streamWrites = 0, eventWrites = 0,
+               functionCalls = 0, intrinsicCalls = 0, branches = 0;
+
+        void add (const OperationCounts&, double scale);
+
+        /** Returns a rough single figure for comparing the costs of two pieces of code, in
+            which a transcendental function counts as 20 operations, a call as 5, a branch
+            as 2, and everything else as 1. Calls to intrinsics aren't weighted, as they're
+            already counted as the operations that the intrinsics perform.
+        */
+        double getWeightedTotal() const;
+
+        choc::value::Value toJSON() const;
+    };
+
+    struct Loop
+    {
+        std::string headerBlock;
+
+        /** 1 for an outermost loop, 2 for a loop inside that, etc. */
+        uint32_t depth = 0;
+
+        uint64_t tripCount = 0;
+        bool isTripCountKnown = false;
+        bool isFrameLoop = false;
+    };
+
+    struct FunctionStats
+    {
+        std::string name;
+        uint32_t numBlocks = 0, maxLoopDepth = 0;
+
+        /** The number of statements and terminators of each kind, using the names of
+            the heart classes, in the order that SOUL_HEART_STATEMENTS and
+            SOUL_HEART_TERMINATORS declare them.
+        */
+        std::vector<std::pair<const char*, uint32_t>> statementCounts;
+
+        std::vector<Loop> loops;
+
+        /** The estimated cost of one call to this function, including its callees. */
+        OperationCounts perCall;
+
+        /** For a run() function, the estimated cost of one frame. */
+        OperationCounts perFrame;
+    };
+
+    struct ModuleStats
+    {
+        std::string name;
+        const char* kind = "";
+
+        /** The size of the module's state, including that of any nodes if it's a graph. */
+        uint64_t stateSize = 0;
+
+        /** The number of bytes that the module's stream endpoints consume and produce per frame. */
+        uint64_t streamInputBytesPerFrame = 0, streamOutputBytesPerFrame = 0;
+
+        std::vector<FunctionStats> functions;
+        OperationCounts perFrame;
+    };
+
+    /** A processor that the main processor uses, and its share of the program's cost. */
+    struct HotSpot
+    {
+        std::string name;
+
+        /** The number of times the processor runs per frame of the main processor, i.e. the
+            number of nodes that use it, multiplied by their array sizes and clock ratios.
+        */
+        double instancesPerFrame = 0;
+
+        /** The weighted total of the processor's per-frame cost, multiplied by instancesPerFrame. */
+        double costPerFrame = 0;
+    };
+
+    std::vector<ModuleStats> modules;
+
+    /** The processors that the main processor uses, most expensive first. */
+    std::vector<HotSpot> hotSpots;
+
+    //==============================================================================
+    static Analyser analyse (const Program&, const Options&);
+
+    /** Returns an object containing all the statistics, followed by the hot-spots. */
+    choc::value::Value toJSON() const;
+
+    /** Returns a HEART dump of the program with the statistics added as comments to
+        the modules, functions and blocks. The program must be the one that was analysed,
+        and must not have been modified since.
+    */
+    std::string createAnnotatedHEART (const Program&) const;
+
+private:
+    struct FunctionAnalyser;
+    struct BlockInfo { uint32_t loopDepth = 0; double weight = 1.0; bool isInFrameLoop = false; };
+
+    std::unordered_map<const Module*, size_t> moduleIndexes;
+    std::unordered_map<const heart::Function*, std::pair<size_t, size_t>> functionIndexes;
+    std::unordered_map<const heart::Block*, BlockInfo> blockInfo;
+};
+
+} // namespace soul
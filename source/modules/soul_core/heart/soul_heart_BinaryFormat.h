@@ -0,0 +1,1409 @@
+/*
+    _____ _____ _____ __
+   |   __|     |  |  |  |      The SOUL language
+   |__   |  |  |  |  |  |__    Copyright (c) 2019 - ROLI Ltd.
+   |_____|_____|_____|_____|
+
+   The code in this file is provided under the terms of the ISC license:
+
+   Permission to use, copy, modify, and/or distribute this software for any purpose
+   with or without fee is hereby granted, provided that the above copyright notice and
+   this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+   TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+   NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+   IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+   CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+namespace soul
+{
+
+//==============================================================================
+/**
+    Reads and writes a compact binary equivalent of the HEART text format.
+
+    The binary form holds the same information as a HEART dump, but because it refers
+    to modules, functions, blocks, variables and structs by index rather than by name,
+    it can be turned back into a Program without any tokenising or name resolution.
+
+    The data is written in the host's byte order and isn't intended as an interchange
+    format - it's for caching programs on the machine that built them. CodeLocations
+    aren't stored, so any errors reported for a program that was loaded this way will
+    have no source position.
+*/
+struct heart::BinaryFormat
+{
+    /** Bump this whenever the layout changes, so that stale cached data gets rejected. */
+    static constexpr uint32_t formatVersion = 2;
+
+    static std::vector<uint8_t> write (const Program& program)
+    {
+        Writer w (program);
+        w.writeProgram();
+        return std::move (w.data);
+    }
+
+    /** Throws a compile error if the data is malformed. */
+    static Program read (const void* data, size_t size)
+    {
+        Reader r (static_cast<const uint8_t*> (data), size);
+        return r.readProgram();
+    }
+
+private:
+    static constexpr const char* magic = "SOULHRTB";
+    static constexpr size_t magicLength = 8;
+
+    enum class ModuleKind : uint8_t { processor, graph, namespace_ };
+
+    enum class ExpressionKind : uint8_t
+    {
+        variable,
+        constant,
+        arrayElement,
+        structElement,
+        typeCast,
+        aggregateInitialiserList,
+        unaryOperator,
+        binaryOperator,
+        pureFunctionCall,
+        processorProperty
+    };
+
+    enum class TypeKind : uint8_t
+    {
+        invalid,
+        primitive,
+        vector,
+        array,
+        wrap,
+        clamp,
+        structure,
+        stringLiteral
+    };
+
+    #define SOUL_DECLARE_BINARY_TAG(Type)  Type,
+    enum class StatementKind  : uint8_t { SOUL_HEART_STATEMENTS (SOUL_DECLARE_BINARY_TAG) };
+    enum class TerminatorKind : uint8_t { SOUL_HEART_TERMINATORS (SOUL_DECLARE_BINARY_TAG) };
+    #undef SOUL_DECLARE_BINARY_TAG
+
+    //==============================================================================
+    struct Writer
+    {
+        Writer (const Program& p) : program (p) {}
+
+        const Program& program;
+        std::vector<uint8_t> data;
+
+        std::unordered_map<std::string, uint32_t> identifierIndexes;
+        std::unordered_map<std::string, uint32_t> valueIndexes;
+        std::unordered_map<const Structure*, uint32_t> structIndexes;
+        std::unordered_map<const heart::Function*, uint32_t> functionIndexes;
+        std::unordered_map<const heart::Variable*, uint32_t> variableIndexes;
+        std::unordered_map<const heart::Block*, uint32_t> blockIndexes;
+        pool_ptr<const Module> module;
+
+        void writeProgram()
+        {
+            data.reserve (65536);
+            writeRaw (magic, magicLength);
+            writeInt (formatVersion);
+            writeInt (static_cast<uint64_t> (getHEARTFormatVersion()));
+
+            auto& dictionary = program.getStringDictionary();
+            writeInt (dictionary.strings.size());
+
+            for (auto& s : dictionary.strings)
+            {
+                writeInt (s.handle.handle);
+                writeString (s.text);
+            }
+
+            auto& modules = program.getModules();
+            writeInt (modules.size());
+
+            for (auto& m : modules)
+                writeModuleDeclaration (m);
+
+            for (auto& m : modules)
+                for (auto& s : m->structs.get())
+                    writeStructMembers (*s);
+
+            for (auto& m : modules)
+                writeModuleContent (m);
+
+            auto& constants = program.getConstantTable();
+            writeInt (constants.size());
+
+            for (auto& c : constants)
+            {
+                writeSignedInt (c.handle);
+                writeValue (*c.value);
+            }
+        }
+
+        void writeModuleDeclaration (const Module& m)
+        {
+            writeByte (static_cast<uint8_t> (m.isProcessor() ? ModuleKind::processor
+                                                             : (m.isGraph() ? ModuleKind::graph : ModuleKind::namespace_)));
+            writeString (m.shortName);
+            writeString (m.fullName);
+            writeString (m.originalFullName);
+            writeAnnotation (m.annotation);
+            writeDouble (m.sampleRate);
+            writeInt (m.latency);
+
+            writeInt (m.structs.size());
+
+            for (auto& s : m.structs.get())
+            {
+                structIndexes[s.get()] = static_cast<uint32_t> (structIndexes.size());
+                writeString (s->getName());
+            }
+
+            writeInt (m.functions.size());
+
+            for (auto& f : m.functions.get())
+            {
+                functionIndexes[std::addressof (f.get())] = static_cast<uint32_t> (functionIndexes.size());
+                writeIdentifier (f->name);
+                writeByte (static_cast<uint8_t> (f->functionType.type));
+            }
+        }
+
+        void writeStructMembers (const Structure& s)
+        {
+            writeInt (s.getNumMembers());
+
+            for (auto& member : s.getMembers())
+            {
+                writeType (member.type);
+                writeString (member.name);
+            }
+        }
+
+        void writeModuleContent (const Module& m)
+        {
+            module = m;
+
+            writeInt (m.inputs.size());
+
+            for (auto& i : m.inputs)
+                writeIODeclaration (i);
+
+            writeInt (m.outputs.size());
+
+            for (auto& o : m.outputs)
+                writeIODeclaration (o);
+
+            writeInt (m.processorInstances.size());
+
+            for (auto& p : m.processorInstances)
+                writeProcessorInstance (p);
+
+            writeInt (m.connections.size());
+
+            for (auto& c : m.connections)
+                writeConnection (c);
+
+            writeInt (m.stateVariables.size());
+
+            for (auto& v : m.stateVariables.get())
+                writeVariable (v);
+
+            for (auto& f : m.functions.get())
+                writeFunction (f);
+
+            module.reset();
+        }
+
+        void writeIODeclaration (const heart::IODeclaration& io)
+        {
+            writeIdentifier (io.name);
+            writeInt (io.index);
+            writeByte (static_cast<uint8_t> (io.endpointType));
+            writeInt (io.dataTypes.size());
+
+            for (auto& t : io.dataTypes)
+                writeType (t);
+
+            writeBool (io.arraySize.has_value());
+
+            if (io.arraySize.has_value())
+                writeInt (*io.arraySize);
+
+            writeAnnotation (io.annotation);
+        }
+
+        void writeProcessorInstance (const heart::ProcessorInstance& p)
+        {
+            writeString (p.instanceName);
+            writeString (p.sourceName);
+            writeInt (p.arraySize);
+
+            auto multiplier = p.clockMultiplier.getMultiplier();
+            auto divider = p.clockMultiplier.getDivider();
+
+            writeByte (multiplier.has_value() ? 1 : (divider.has_value() ? 2 : 0));
+
+            if (multiplier.has_value())  writeSignedInt (*multiplier);
+            if (divider.has_value())     writeSignedInt (*divider);
+        }
+
+        void writeConnection (const heart::Connection& c)
+        {
+            writeByte (static_cast<uint8_t> (c.interpolationType));
+            writeEndpointReference (c.source);
+            writeEndpointReference (c.dest);
+            writeBool (c.delayLength.has_value());
+
+            if (c.delayLength.has_value())
+                writeSignedInt (*c.delayLength);
+        }
+
+        void writeEndpointReference (const heart::EndpointReference& e)
+        {
+            writeInt (e.processor == nullptr ? 0 : (getIndexOf (module->processorInstances, *e.processor) + 1));
+            writeString (e.endpointName);
+            writeBool (e.endpointIndex.has_value());
+
+            if (e.endpointIndex.has_value())
+                writeInt (*e.endpointIndex);
+        }
+
+        void writeFunction (const heart::Function& f)
+        {
+            writeType (f.returnType);
+            writeByte (static_cast<uint8_t> (f.intrinsicType));
+            writeBool (f.isExported);
+            writeBool (f.hasNoBody);
+            writeAnnotation (f.annotation);
+
+            writeInt (f.parameters.size());
+
+            for (auto& p : f.parameters)
+                writeVariable (p);
+
+            writeInt (f.stateParameter == nullptr ? 0 : (getIndexOf (f.parameters, *f.stateParameter) + 1));
+            writeInt (f.ioParameter == nullptr ? 0 : (getIndexOf (f.parameters, *f.ioParameter) + 1));
+
+            blockIndexes.clear();
+            writeInt (f.blocks.size());
+
+            for (auto& b : f.blocks)
+            {
+                blockIndexes[std::addressof (b.get())] = static_cast<uint32_t> (blockIndexes.size());
+                writeIdentifier (b->name);
+            }
+
+            for (auto& b : f.blocks)
+                writeBlock (b);
+        }
+
+        void writeBlock (const heart::Block& b)
+        {
+            SOUL_ASSERT (b.isTerminated());
+            writeBool (b.doNotOptimiseAway);
+            writeInt (b.parameters.size());
+
+            for (auto& p : b.parameters)
+                writeVariable (p);
+
+            size_t numStatements = 0;
+
+            for (auto s : b.statements)
+            {
+                ignoreUnused (s);
+                ++numStatements;
+            }
+
+            writeInt (numStatements);
+
+            for (auto s : b.statements)
+                writeStatement (*s);
+
+            writeTerminator (*b.terminator);
+        }
+
+        void writeStatement (const heart::Statement& s)
+        {
+            if (auto a = cast<const heart::AssignFromValue> (s))
+            {
+                writeByte (static_cast<uint8_t> (StatementKind::AssignFromValue));
+                writeExpression (*a->target);
+                writeExpression (a->source);
+                return;
+            }
+
+            if (auto fc = cast<const heart::FunctionCall> (s))
+            {
+                writeByte (static_cast<uint8_t> (StatementKind::FunctionCall));
+                writeOptionalExpression (fc->target);
+                writeFunctionReference (fc->getFunction());
+                writeExpressionList (fc->arguments);
+                return;
+            }
+
+            if (auto r = cast<const heart::ReadStream> (s))
+            {
+                writeByte (static_cast<uint8_t> (StatementKind::ReadStream));
+                writeExpression (*r->target);
+                writeInt (getIndexOf (module->inputs, r->source.get()));
+                writeOptionalExpression (r->element);
+                return;
+            }
+
+            if (auto w = cast<const heart::WriteStream> (s))
+            {
+                writeByte (static_cast<uint8_t> (StatementKind::WriteStream));
+                writeInt (getIndexOf (module->outputs, w->target.get()));
+                writeOptionalExpression (w->element);
+                writeExpression (w->value);
+                return;
+            }
+
+            if (cast<const heart::AdvanceClock> (s) != nullptr)
+            {
+                writeByte (static_cast<uint8_t> (StatementKind::AdvanceClock));
+                return;
+            }
+
+            SOUL_ASSERT_FALSE;
+        }
+
+        void writeTerminator (const heart::Terminator& t)
+        {
+            if (auto b = cast<const heart::Branch> (t))
+            {
+                writeByte (static_cast<uint8_t> (TerminatorKind::Branch));
+                writeBlockReference (b->target);
+                writeExpressionList (b->targetArgs);
+                return;
+            }
+
+            if (auto b = cast<const heart::BranchIf> (t))
+            {
+                writeByte (static_cast<uint8_t> (TerminatorKind::BranchIf));
+                writeExpression (b->condition);
+                writeBlockReference (b->targets[0]);
+                writeBlockReference (b->targets[1]);
+                writeExpressionList (b->targetArgs[0]);
+                writeExpressionList (b->targetArgs[1]);
+                return;
+            }
+
+            if (cast<const heart::ReturnVoid> (t) != nullptr)
+            {
+                writeByte (static_cast<uint8_t> (TerminatorKind::ReturnVoid));
+                return;
+            }
+
+            if (auto r = cast<const heart::ReturnValue> (t))
+            {
+                writeByte (static_cast<uint8_t> (TerminatorKind::ReturnValue));
+                writeExpression (r->returnValue);
+                return;
+            }
+
+            SOUL_ASSERT_FALSE;
+        }
+
+        void writeExpression (const heart::Expression& e)
+        {
+            if (auto v = cast<const heart::Variable> (e))
+            {
+                writeByte (static_cast<uint8_t> (ExpressionKind::variable));
+                return writeVariable (*v);
+            }
+
+            if (auto c = cast<const heart::Constant> (e))
+            {
+                writeByte (static_cast<uint8_t> (ExpressionKind::constant));
+                return writeValue (c->value);
+            }
+
+            if (auto a = cast<const heart::ArrayElement> (e))
+            {
+                writeByte (static_cast<uint8_t> (ExpressionKind::arrayElement));
+                writeExpression (a->parent);
+                writeOptionalExpression (a->dynamicIndex);
+                writeInt (a->fixedStartIndex);
+                writeInt (a->fixedEndIndex);
+                writeByte (static_cast<uint8_t> ((a->isRangeTrusted ? 1 : 0) | (a->suppressWrapWarning ? 2 : 0)));
+                return;
+            }
+
+            if (auto s = cast<const heart::StructElement> (e))
+            {
+                writeByte (static_cast<uint8_t> (ExpressionKind::structElement));
+                writeExpression (s->parent);
+                writeString (s->memberName);
+                return;
+            }
+
+            if (auto t = cast<const heart::TypeCast> (e))
+            {
+                writeByte (static_cast<uint8_t> (ExpressionKind::typeCast));
+                writeExpression (t->source);
+                writeType (t->destType);
+                return;
+            }
+
+            if (auto l = cast<const heart::AggregateInitialiserList> (e))
+            {
+                writeByte (static_cast<uint8_t> (ExpressionKind::aggregateInitialiserList));
+                writeType (l->type);
+                writeExpressionList (l->items);
+                return;
+            }
+
+            if (auto u = cast<const heart::UnaryOperator> (e))
+            {
+                writeByte (static_cast<uint8_t> (ExpressionKind::unaryOperator));
+                writeExpression (u->source);
+                writeByte (static_cast<uint8_t> (u->operation));
+                return;
+            }
+
+            if (auto b = cast<const heart::BinaryOperator> (e))
+            {
+                writeByte (static_cast<uint8_t> (ExpressionKind::binaryOperator));
+                writeExpression (b->lhs);
+                writeExpression (b->rhs);
+                writeByte (static_cast<uint8_t> (b->operation));
+                return;
+            }
+
+            if (auto fc = cast<const heart::PureFunctionCall> (e))
+            {
+                writeByte (static_cast<uint8_t> (ExpressionKind::pureFunctionCall));
+                writeFunctionReference (fc->function);
+                writeExpressionList (fc->arguments);
+                return;
+            }
+
+            if (auto pp = cast<const heart::ProcessorProperty> (e))
+            {
+                writeByte (static_cast<uint8_t> (ExpressionKind::processorProperty));
+                writeByte (static_cast<uint8_t> (pp->property));
+                return;
+            }
+
+            SOUL_ASSERT_FALSE;
+        }
+
+        void writeOptionalExpression (pool_ptr<heart::Expression> e)
+        {
+            writeBool (e != nullptr);
+
+            if (e != nullptr)
+                writeExpression (*e);
+        }
+
+        template <typename ListType>
+        void writeExpressionList (const ListType& list)
+        {
+            writeInt (list.size());
+
+            for (auto& e : list)
+                writeExpression (e);
+        }
+
+        // Variables are identified by an index, and the first time an index is used, the
+        // variable's declaration follows it. This lets state variables from other modules be
+        // referenced before their own module has been written.
+        void writeVariable (const heart::Variable& v)
+        {
+            auto found = variableIndexes.find (std::addressof (v));
+
+            if (found != variableIndexes.end())
+                return writeInt (found->second);
+
+            auto index = static_cast<uint32_t> (variableIndexes.size());
+            variableIndexes[std::addressof (v)] = index;
+            writeInt (index);
+
+            writeType (v.type);
+            writeIdentifier (v.name);
+            writeByte (static_cast<uint8_t> (v.role));
+            writeAnnotation (v.annotation);
+            writeSignedInt (v.externalHandle);
+            writeOptionalExpression (v.initialValue);
+        }
+
+        void writeFunctionReference (const heart::Function& f)
+        {
+            auto found = functionIndexes.find (std::addressof (f));
+            SOUL_ASSERT (found != functionIndexes.end());
+            writeInt (found->second);
+        }
+
+        void writeBlockReference (const heart::Block& b)
+        {
+            auto found = blockIndexes.find (std::addressof (b));
+            SOUL_ASSERT (found != blockIndexes.end());
+            writeInt (found->second);
+        }
+
+        void writeType (const Type& t)
+        {
+            writeByte (static_cast<uint8_t> ((t.isConst() ? 1 : 0) | (t.isReference() ? 2 : 0)));
+
+            if (t.isPrimitive())
+            {
+                writeByte (static_cast<uint8_t> (TypeKind::primitive));
+                writeByte (static_cast<uint8_t> (t.getPrimitiveType().type));
+            }
+            else if (t.isVector())
+            {
+                writeByte (static_cast<uint8_t> (TypeKind::vector));
+                writeByte (static_cast<uint8_t> (t.getVectorElementType().type));
+                writeInt (t.getVectorSize());
+            }
+            else if (t.isArray())
+            {
+                writeByte (static_cast<uint8_t> (TypeKind::array));
+                writeInt (t.isUnsizedArray() ? 0 : t.getArraySize());
+                writeType (t.getArrayElementType());
+            }
+            else if (t.isBoundedInt())
+            {
+                writeByte (static_cast<uint8_t> (t.isWrapped() ? TypeKind::wrap : TypeKind::clamp));
+                writeInt (static_cast<uint64_t> (t.getBoundedIntLimit()));
+            }
+            else if (t.isStruct())
+            {
+                writeByte (static_cast<uint8_t> (TypeKind::structure));
+                auto found = structIndexes.find (t.getStruct().get());
+                SOUL_ASSERT (found != structIndexes.end());
+                writeInt (found->second);
+            }
+            else if (t.isStringLiteral())
+            {
+                writeByte (static_cast<uint8_t> (TypeKind::stringLiteral));
+            }
+            else
+            {
+                SOUL_ASSERT (! t.isValid());
+                writeByte (static_cast<uint8_t> (TypeKind::invalid));
+            }
+        }
+
+        // Values are pooled like identifiers, because programs tend to repeat the same
+        // constants many times: 0 introduces a new value, and anything else is a
+        // back-reference to one that has already been written.
+        void writeValue (const Value& v)
+        {
+            auto markerPos = data.size();
+            writeInt (0);
+            auto start = data.size();
+            writeType (v.getType());
+            writePackedData (static_cast<const uint8_t*> (v.getPackedData()), v.getPackedDataSize());
+
+            std::string encoding (data.begin() + static_cast<std::ptrdiff_t> (start), data.end());
+            auto found = valueIndexes.find (encoding);
+
+            if (found != valueIndexes.end())
+            {
+                data.resize (markerPos);
+                return writeInt (found->second + 1);
+            }
+
+            valueIndexes[std::move (encoding)] = static_cast<uint32_t> (valueIndexes.size());
+        }
+
+        // Packed value data is stored as alternating runs of zero bytes and literal bytes,
+        // since the initialisers for things like delay-line buffers are mostly zeros.
+        void writePackedData (const uint8_t* source, size_t size)
+        {
+            writeInt (size);
+
+            for (size_t i = 0; i < size;)
+            {
+                auto literalStart = i;
+
+                while (literalStart < size && source[literalStart] == 0)
+                    ++literalStart;
+
+                auto literalEnd = literalStart;
+
+                while (literalEnd < size && ! isStartOfZeroRun (source + literalEnd, size - literalEnd))
+                    ++literalEnd;
+
+                writeInt (literalStart - i);
+                writeInt (literalEnd - literalStart);
+                writeRaw (source + literalStart, literalEnd - literalStart);
+                i = literalEnd;
+            }
+        }
+
+        static bool isStartOfZeroRun (const uint8_t* source, size_t numRemaining)
+        {
+            // shorter runs than this cost more to encode than to store as literals
+            constexpr size_t minZeroRunLength = 4;
+
+            for (size_t i = 0; i < std::min (numRemaining, minZeroRunLength); ++i)
+                if (source[i] != 0)
+                    return false;
+
+            return true;
+        }
+
+        void writeAnnotation (const Annotation& a)
+        {
+            auto names = a.getNames();
+            writeInt (names.size());
+
+            for (auto& name : names)
+            {
+                auto value = a.getValue (name);
+                writeString (name);
+                writeValue (value);
+
+                if (value.getType().isStringLiteral())
+                    writeString (std::string (a.getDictionary().getStringForHandle (value.getStringLiteral())));
+            }
+        }
+
+        // Identifiers are pooled: 0 is a null identifier, 1 introduces a new string,
+        // and anything else is a back-reference to a string that has already been written.
+        void writeIdentifier (const Identifier& i)
+        {
+            if (! i.isValid())
+                return writeInt (0);
+
+            auto found = identifierIndexes.find (i.toString());
+
+            if (found != identifierIndexes.end())
+                return writeInt (found->second + 2);
+
+            identifierIndexes[i.toString()] = static_cast<uint32_t> (identifierIndexes.size());
+            writeInt (1);
+            writeString (i.toString());
+        }
+
+        template <typename ArrayType, typename ItemType>
+        static size_t getIndexOf (const ArrayType& array, const ItemType& item)
+        {
+            for (size_t i = 0; i < array.size(); ++i)
+                if (std::addressof (array[i].get()) == std::addressof (item))
+                    return i;
+
+            SOUL_ASSERT_FALSE;
+            return 0;
+        }
+
+        void writeRaw (const void* source, size_t size)
+        {
+            auto start = static_cast<const uint8_t*> (source);
+            data.insert (data.end(), start, start + size);
+        }
+
+        void writeByte (uint8_t b)                 { data.push_back (b); }
+        void writeBool (bool b)                    { writeByte (b ? 1 : 0); }
+        void writeDouble (double d)                { writeRaw (std::addressof (d), sizeof (d)); }
+        void writeSignedInt (int64_t n)            { writeInt ((static_cast<uint64_t> (n) << 1) ^ static_cast<uint64_t> (n >> 63)); }
+
+        void writeInt (uint64_t n)
+        {
+            while (n >= 0x80)
+            {
+                writeByte (static_cast<uint8_t> (n | 0x80));
+                n >>= 7;
+            }
+
+            writeByte (static_cast<uint8_t> (n));
+        }
+
+        void writeString (const std::string& s)
+        {
+            writeInt (s.length());
+            writeRaw (s.data(), s.length());
+        }
+    };
+
+    //==============================================================================
+    struct Reader
+    {
+        Reader (const uint8_t* d, size_t size) : data (d), end (d + size) {}
+
+        const uint8_t* data;
+        const uint8_t* const end;
+
+        Program program;
+        pool_ptr<Module> module;
+        std::vector<Identifier> identifiers;
+        std::vector<Value> values;
+        std::vector<StructurePtr> structs;
+        std::vector<pool_ref<heart::Function>> functions;
+        std::vector<pool_ref<heart::Variable>> variables;
+        std::vector<pool_ref<heart::Block>> blocks;
+
+        Program readProgram()
+        {
+            if (static_cast<size_t> (end - data) < magicLength || memcmp (data, magic, magicLength) != 0)
+                throwMalformed();
+
+            data += magicLength;
+
+            if (readInt() != formatVersion || readInt() != static_cast<uint64_t> (getHEARTFormatVersion()))
+                CodeLocation().throwError (Errors::wrongAPIVersion());
+
+            auto& dictionary = program.getStringDictionary();
+
+            for (auto numStrings = readInt(); numStrings > 0; --numStrings)
+            {
+                auto handle = readIntAs<uint32_t>();
+                dictionary.addItem ({ { handle }, readString() });
+            }
+
+            auto numModules = readInt();
+            std::vector<pool_ref<Module>> modules;
+
+            for (uint64_t i = 0; i < numModules; ++i)
+                modules.push_back (readModuleDeclaration());
+
+            for (auto& m : modules)
+                for (auto& s : m->structs.get())
+                    readStructMembers (*s);
+
+            for (auto& m : modules)
+                readModuleContent (m);
+
+            for (auto numConstants = readInt(); numConstants > 0; --numConstants)
+            {
+                auto handle = static_cast<ConstantTable::Handle> (readSignedInt());
+                program.getConstantTable().addItem ({ handle, std::make_unique<Value> (readValue()) });
+            }
+
+            if (data != end)
+                throwMalformed();
+
+            return program;
+        }
+
+        Module& readModuleDeclaration()
+        {
+            auto kind = readEnum (ModuleKind::namespace_);
+
+            auto& m = kind == ModuleKind::processor ? program.addProcessor()
+                                                    : (kind == ModuleKind::graph ? program.addGraph()
+                                                                                 : program.addNamespace());
+            m.shortName = readString();
+            m.fullName = readString();
+            m.originalFullName = readString();
+            m.annotation = readAnnotation();
+            m.sampleRate = readDouble();
+            m.latency = readIntAs<uint32_t>();
+
+            for (auto numStructs = readInt(); numStructs > 0; --numStructs)
+                structs.push_back (m.structs.add (readString()));
+
+            for (auto numFunctions = readInt(); numFunctions > 0; --numFunctions)
+            {
+                auto name = readIdentifier();
+                auto type = readEnum (heart::FunctionType::Type::intrinsic);
+
+                if (! name.isValid() || m.functions.find (name) != nullptr)
+                    throwMalformed();
+
+                auto& f = m.functions.add (name.toString(), type == heart::FunctionType::Type::event);
+                f.functionType = heart::FunctionType { type };
+                functions.push_back (f);
+            }
+
+            return m;
+        }
+
+        void readStructMembers (Structure& s)
+        {
+            for (auto numMembers = readInt(); numMembers > 0; --numMembers)
+            {
+                auto type = readType();
+                s.addMember (std::move (type), readString());
+            }
+        }
+
+        void readModuleContent (Module& m)
+        {
+            module = m;
+
+            for (auto numInputs = readInt(); numInputs > 0; --numInputs)
+            {
+                auto& io = m.allocate<heart::InputDeclaration> (CodeLocation());
+                readIODeclaration (io);
+                m.inputs.push_back (io);
+            }
+
+            for (auto numOutputs = readInt(); numOutputs > 0; --numOutputs)
+            {
+                auto& io = m.allocate<heart::OutputDeclaration> (CodeLocation());
+                readIODeclaration (io);
+                m.outputs.push_back (io);
+            }
+
+            for (auto numInstances = readInt(); numInstances > 0; --numInstances)
+                m.processorInstances.push_back (readProcessorInstance());
+
+            for (auto numConnections = readInt(); numConnections > 0; --numConnections)
+                m.connections.push_back (readConnection());
+
+            for (auto numVariables = readInt(); numVariables > 0; --numVariables)
+            {
+                auto& v = readVariable();
+
+                if (! v.isState())
+                    throwMalformed();
+
+                m.stateVariables.add (v);
+            }
+
+            for (auto& f : m.functions.get())
+                readFunction (f);
+
+            module.reset();
+        }
+
+        void readIODeclaration (heart::IODeclaration& io)
+        {
+            io.name = readIdentifier();
+            io.index = readIntAs<uint32_t>();
+            io.endpointType = readEnum (EndpointType::event);
+
+            for (auto numTypes = readInt(); numTypes > 0; --numTypes)
+                io.dataTypes.push_back (readType());
+
+            if (readBool())
+                io.arraySize = readIntAs<uint32_t>();
+
+            io.annotation = readAnnotation();
+        }
+
+        heart::ProcessorInstance& readProcessorInstance()
+        {
+            auto& p = module->allocate<heart::ProcessorInstance> (CodeLocation());
+            p.instanceName = readString();
+            p.sourceName = readString();
+            p.arraySize = readIntAs<uint32_t>();
+
+            auto clockType = readByte();
+
+            if (clockType > 2)
+                throwMalformed();
+
+            if (clockType == 1)  p.clockMultiplier.setMultiplier (CodeLocation(), Value::createInt64 (readSignedInt()));
+            if (clockType == 2)  p.clockMultiplier.setDivider    (CodeLocation(), Value::createInt64 (readSignedInt()));
+
+            return p;
+        }
+
+        heart::Connection& readConnection()
+        {
+            auto& c = module->allocate<heart::Connection> (CodeLocation());
+            c.interpolationType = readEnum (InterpolationType::best);
+            readEndpointReference (c.source);
+            readEndpointReference (c.dest);
+
+            if (readBool())
+                c.delayLength = readSignedInt();
+
+            return c;
+        }
+
+        void readEndpointReference (heart::EndpointReference& e)
+        {
+            if (auto processorIndex = readInt())
+                e.processor = getItem (module->processorInstances, processorIndex - 1);
+
+            e.endpointName = readString();
+
+            if (readBool())
+                e.endpointIndex = readIntAs<size_t>();
+        }
+
+        void readFunction (heart::Function& f)
+        {
+            f.returnType = readType();
+            f.intrinsicType = readEnum (IntrinsicType::readCycleCounter);
+            f.isExported = readBool();
+            f.hasNoBody = readBool();
+            f.annotation = readAnnotation();
+
+            for (auto numParams = readInt(); numParams > 0; --numParams)
+                f.parameters.push_back (readVariable());
+
+            if (auto stateParam = readInt())
+                f.stateParameter = getItem (f.parameters, stateParam - 1);
+
+            if (auto ioParam = readInt())
+                f.ioParameter = getItem (f.parameters, ioParam - 1);
+
+            blocks.clear();
+
+            for (auto numBlocks = readInt(); numBlocks > 0; --numBlocks)
+            {
+                auto name = readIdentifier();
+
+                if (! name.isValid() || name.toString()[0] != '@')
+                    throwMalformed();
+
+                blocks.push_back (module->allocate<heart::Block> (name));
+            }
+
+            for (auto& b : blocks)
+                readBlock (b);
+
+            f.blocks = blocks;
+        }
+
+        void readBlock (heart::Block& b)
+        {
+            b.doNotOptimiseAway = readBool();
+
+            for (auto numParams = readInt(); numParams > 0; --numParams)
+                b.parameters.push_back (readVariable());
+
+            LinkedList<heart::Statement>::Iterator last;
+
+            for (auto numStatements = readInt(); numStatements > 0; --numStatements)
+                last = b.statements.insertAfter (last, readStatement());
+
+            b.terminator = readTerminator();
+        }
+
+        heart::Statement& readStatement()
+        {
+            switch (static_cast<StatementKind> (readByte()))
+            {
+                case StatementKind::AssignFromValue:
+                {
+                    auto& target = readExpression();
+                    return module->allocate<heart::AssignFromValue> (CodeLocation(), target, readExpression());
+                }
+
+                case StatementKind::FunctionCall:
+                {
+                    auto target = readOptionalExpression();
+                    auto& fc = module->allocate<heart::FunctionCall> (CodeLocation(), target, readFunctionReference());
+                    readExpressionList (fc.arguments);
+                    return fc;
+                }
+
+                case StatementKind::ReadStream:
+                {
+                    auto& target = readExpression();
+                    auto& r = module->allocate<heart::ReadStream> (CodeLocation(), target, getItem (module->inputs, readInt()).get());
+                    r.element = readOptionalExpression();
+                    return r;
+                }
+
+                case StatementKind::WriteStream:
+                {
+                    auto& output = getItem (module->outputs, readInt()).get();
+                    auto element = readOptionalExpression();
+                    return module->allocate<heart::WriteStream> (CodeLocation(), output, element, readExpression());
+                }
+
+                case StatementKind::AdvanceClock:
+                    return module->allocate<heart::AdvanceClock> (CodeLocation());
+
+                default:
+                    throwMalformed();
+            }
+        }
+
+        heart::Terminator& readTerminator()
+        {
+            switch (static_cast<TerminatorKind> (readByte()))
+            {
+                case TerminatorKind::Branch:
+                {
+                    auto& b = module->allocate<heart::Branch> (readBlockReference());
+                    readExpressionList (b.targetArgs);
+                    return b;
+                }
+
+                case TerminatorKind::BranchIf:
+                {
+                    auto& condition = readExpression();
+                    auto& trueTarget = readBlockReference();
+                    auto& falseTarget = readBlockReference();
+
+                    if (std::addressof (trueTarget) == std::addressof (falseTarget))
+                        throwMalformed();
+
+                    auto& b = module->allocate<heart::BranchIf> (condition, trueTarget, falseTarget);
+                    readExpressionList (b.targetArgs[0]);
+                    readExpressionList (b.targetArgs[1]);
+                    return b;
+                }
+
+                case TerminatorKind::ReturnVoid:
+                    return module->allocate<heart::ReturnVoid>();
+
+                case TerminatorKind::ReturnValue:
+                    return module->allocate<heart::ReturnValue> (readExpression());
+
+                default:
+                    throwMalformed();
+            }
+        }
+
+        heart::Expression& readExpression()
+        {
+            switch (static_cast<ExpressionKind> (readByte()))
+            {
+                case ExpressionKind::variable:
+                    return readVariable();
+
+                case ExpressionKind::constant:
+                    return module->allocate<heart::Constant> (CodeLocation(), readValue());
+
+                case ExpressionKind::arrayElement:
+                {
+                    auto& parent = readExpression();
+
+                    if (! parent.getType().isArrayOrVector())
+                        throwMalformed();
+
+                    auto dynamicIndex = readOptionalExpression();
+                    auto startIndex = readIntAs<size_t>();
+                    auto endIndex = readIntAs<size_t>();
+                    auto flags = readByte();
+
+                    auto& a = dynamicIndex != nullptr
+                                ? module->allocate<heart::ArrayElement> (CodeLocation(), parent, *dynamicIndex)
+                                : module->allocate<heart::ArrayElement> (CodeLocation(), parent, startIndex, endIndex);
+
+                    a.fixedStartIndex = startIndex;
+                    a.fixedEndIndex = endIndex;
+                    a.isRangeTrusted = (flags & 1) != 0;
+                    a.suppressWrapWarning = (flags & 2) != 0;
+                    return a;
+                }
+
+                case ExpressionKind::structElement:
+                {
+                    auto& parent = readExpression();
+                    auto member = readString();
+
+                    if (! (parent.getType().isStruct() && parent.getType().getStructRef().hasMemberWithName (member)))
+                        throwMalformed();
+
+                    return module->allocate<heart::StructElement> (CodeLocation(), parent, std::move (member));
+                }
+
+                case ExpressionKind::typeCast:
+                {
+                    auto& source = readExpression();
+                    return module->allocate<heart::TypeCast> (CodeLocation(), source, readType());
+                }
+
+                case ExpressionKind::aggregateInitialiserList:
+                {
+                    auto& l = module->allocate<heart::AggregateInitialiserList> (CodeLocation(), readType());
+                    readExpressionList (l.items);
+                    return l;
+                }
+
+                case ExpressionKind::unaryOperator:
+                {
+                    auto& source = readExpression();
+                    return module->allocate<heart::UnaryOperator> (CodeLocation(), source, readOperator<UnaryOp::Op>());
+                }
+
+                case ExpressionKind::binaryOperator:
+                {
+                    auto& lhs = readExpression();
+                    auto& rhs = readExpression();
+                    return module->allocate<heart::BinaryOperator> (CodeLocation(), lhs, rhs, readOperator<BinaryOp::Op>());
+                }
+
+                case ExpressionKind::pureFunctionCall:
+                {
+                    auto& fc = module->allocate<heart::PureFunctionCall> (CodeLocation(), readFunctionReference());
+                    readExpressionList (fc.arguments);
+                    return fc;
+                }
+
+                case ExpressionKind::processorProperty:
+                    return module->allocate<heart::ProcessorProperty> (CodeLocation(), readEnum (heart::ProcessorProperty::Property::latency));
+
+                default:
+                    throwMalformed();
+            }
+        }
+
+        pool_ptr<heart::Expression> readOptionalExpression()
+        {
+            if (readBool())
+                return readExpression();
+
+            return {};
+        }
+
+        template <typename ListType>
+        void readExpressionList (ListType& list)
+        {
+            for (auto numItems = readInt(); numItems > 0; --numItems)
+                list.push_back (readExpression());
+        }
+
+        heart::Variable& readVariable()
+        {
+            auto index = readInt();
+
+            if (index < variables.size())
+                return variables[static_cast<size_t> (index)];
+
+            if (index != variables.size())
+                throwMalformed();
+
+            auto type = readType();
+            auto name = readIdentifier();
+            auto role = readEnum (heart::Variable::Role::external);
+
+            auto& v = program.getAllocator().allocate<heart::Variable> (CodeLocation(), std::move (type), name, role);
+            variables.push_back (v);
+
+            v.annotation = readAnnotation();
+            v.externalHandle = static_cast<ConstantTable::Handle> (readSignedInt());
+            v.initialValue = readOptionalExpression();
+            return v;
+        }
+
+        heart::Function& readFunctionReference()   { return getItem (functions, readInt()); }
+        heart::Block& readBlockReference()         { return getItem (blocks, readInt()); }
+
+        Type readType()
+        {
+            auto flags = readByte();
+            Type t;
+
+            switch (static_cast<TypeKind> (readByte()))
+            {
+                case TypeKind::invalid:         return {};
+                case TypeKind::primitive:       t = Type (readPrimitiveType()); break;
+                case TypeKind::stringLiteral:   t = Type::createStringLiteral(); break;
+                case TypeKind::structure:       t = Type::createStruct (*getItem (structs, readInt())); break;
+                case TypeKind::wrap:            t = Type::createWrappedInt (readBoundedIntSize()); break;
+                case TypeKind::clamp:           t = Type::createClampedInt (readBoundedIntSize()); break;
+
+                case TypeKind::vector:
+                {
+                    auto elementType = readPrimitiveType();
+                    auto size = readInt();
+
+                    if (! (elementType.canBeVectorElementType() && Type::isLegalVectorSize (static_cast<int64_t> (size))))
+                        throwMalformed();
+
+                    t = Type::createVector (elementType, static_cast<Type::ArraySize> (size));
+                    break;
+                }
+
+                case TypeKind::array:
+                {
+                    auto size = readInt();
+                    auto elementType = readType();
+
+                    if (size >= Type::maxArraySize || ! elementType.canBeArrayElementType())
+                        throwMalformed();
+
+                    t = elementType.createArray (static_cast<Type::ArraySize> (size));
+                    break;
+                }
+
+                default:
+                    throwMalformed();
+            }
+
+            return t.withConstAndRefFlags ((flags & 1) != 0, (flags & 2) != 0);
+        }
+
+        template <typename EnumType>
+        EnumType readEnum (EnumType lastValue)
+        {
+            auto value = readByte();
+
+            if (value > static_cast<uint8_t> (lastValue))
+                throwMalformed();
+
+            return static_cast<EnumType> (value);
+        }
+
+        template <typename OperatorType>
+        OperatorType readOperator()
+        {
+            auto op = readEnum (OperatorType::unknown);
+
+            if (op == OperatorType::unknown)
+                throwMalformed();
+
+            return op;
+        }
+
+        PrimitiveType readPrimitiveType()
+        {
+            auto type = readByte();
+
+            if (type > static_cast<uint8_t> (PrimitiveType::bool_))
+                throwMalformed();
+
+            return PrimitiveType (static_cast<PrimitiveType::Primitive> (type));
+        }
+
+        Type::BoundedIntSize readBoundedIntSize()
+        {
+            auto size = readInt();
+
+            if (! Type::isLegalBoundedIntSize (size))
+                throwMalformed();
+
+            return static_cast<Type::BoundedIntSize> (size);
+        }
+
+        Value readValue()
+        {
+            if (auto index = readInt())
+                return getItem (values, index - 1);
+
+            auto type = readType();
+            auto size = readIntAs<size_t>();
+
+            if (! type.isValid() || type.getPackedSizeInBytes() != size)
+                throwMalformed();
+
+            auto value = Value::zeroInitialiser (std::move (type));
+            auto dest = static_cast<uint8_t*> (value.getPackedData());
+
+            for (size_t i = 0; i < size;)
+            {
+                auto numZeros = readIntAs<size_t>();
+                auto numLiterals = readIntAs<size_t>();
+
+                if ((numZeros == 0 && numLiterals == 0) || numZeros > size - i || numLiterals > size - i - numZeros)
+                    throwMalformed();
+
+                i += numZeros;
+                memcpy (dest + i, readRaw (numLiterals), numLiterals);
+                i += numLiterals;
+            }
+
+            values.push_back (value);
+            return value;
+        }
+
+        Annotation readAnnotation()
+        {
+            Annotation a;
+
+            for (auto numProperties = readInt(); numProperties > 0; --numProperties)
+            {
+                auto name = readString();
+                auto value = readValue();
+
+                if (value.getType().isStringLiteral())
+                    a.set (name, readString());
+                else
+                    a.set (name, std::move (value), program.getStringDictionary());
+            }
+
+            return a;
+        }
+
+        Identifier readIdentifier()
+        {
+            auto index = readInt();
+
+            if (index == 0)
+                return {};
+
+            if (index == 1)
+            {
+                auto name = readString();
+
+                if (name.empty())
+                    throwMalformed();
+
+                identifiers.push_back (program.getAllocator().get (name));
+                return identifiers.back();
+            }
+
+            return getItem (identifiers, index - 2);
+        }
+
+        template <typename ArrayType>
+        static auto getItem (ArrayType& array, uint64_t index) -> decltype (array[0])
+        {
+            if (index >= array.size())
+                throwMalformed();
+
+            return array[static_cast<size_t> (index)];
+        }
+
+        const uint8_t* readRaw (size_t size)
+        {
+            if (static_cast<size_t> (end - data) < size)
+                throwMalformed();
+
+            auto start = data;
+            data += size;
+            return start;
+        }
+
+        uint8_t readByte()          { return *readRaw (1); }
+        bool readBool()             { return readByte() != 0; }
+        int64_t readSignedInt()     { auto n = readInt(); return static_cast<int64_t> (n >> 1) ^ -static_cast<int64_t> (n & 1); }
+
+        double readDouble()
+        {
+            double d;
+            memcpy (std::addressof (d), readRaw (sizeof (d)), sizeof (d));
+            return d;
+        }
+
+        uint64_t readInt()
+        {
+            uint64_t n = 0;
+
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                auto byte = readByte();
+                n |= static_cast<uint64_t> (byte & 0x7f) << shift;
+
+                if ((byte & 0x80) == 0)
+                    return n;
+            }
+
+            throwMalformed();
+        }
+
+        template <typename IntType>
+        IntType readIntAs()
+        {
+            auto n = readInt();
+
+            if (n > static_cast<uint64_t> (std::numeric_limits<IntType>::max()))
+                throwMalformed();
+
+            return static_cast<IntType> (n);
+        }
+
+        std::string readString()
+        {
+            auto length = readIntAs<size_t>();
+            auto start = reinterpret_cast<const char*> (readRaw (length));
+            return std::string (start, start + length);
+        }
+
+        [[noreturn]] static void throwMalformed()
+        {
+            CodeLocation().throwError (Errors::malformedBinaryHEART());
+        }
+    };
+};
+
+} // namespace soul
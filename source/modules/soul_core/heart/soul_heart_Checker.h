@@ -421,6 +421,9 @@ struct heart::Checker
         auto dump = program.toHEART();
         SOUL_ASSERT (dump == program.clone().toHEART());
         SOUL_ASSERT (dump == heart::Parser::parse (CodeLocation::createFromString ("internal test dump", dump)).toHEART());
+
+        auto binary = program.toBinary();
+        SOUL_ASSERT (dump == heart::BinaryFormat::read (binary.data(), binary.size()).toHEART());
        #endif
     }
 };
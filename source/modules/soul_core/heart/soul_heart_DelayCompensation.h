@@ -24,21 +24,30 @@ namespace soul
 //==============================================================================
 /**
     Inserts delays into connections in a graph in order to correct for any
-    internal delays on its child processors.
+    internal delays on its child processors, and for the latency of any filters
+    which resample the streams between processors with different clock rates.
+
+    The nodes are visited in topological order, so the work is linear in the size
+    of the graph.
 */
 struct DelayCompensation
 {
+    using LatencyProvider = std::function<uint32_t(const heart::ProcessorInstance&)>;
+
     // Adjusts delays on the connections in the module, and returns the final overall latency.
     static uint32_t apply (Module& module)
     {
         if (module.isGraph())
         {
-            DelayCompensation dc (module);
+            DelayCompensation dc (module, [&] (const heart::ProcessorInstance& instance)
+            {
+                return apply (module.program.getModuleWithName (instance.sourceName));
+            });
 
             if (! dc.buildNodes())
                 return 0;
 
-            dc.calculateInputLatenciesForAllNodes();
+            module.latency = dc.calculateInputLatenciesForAllNodes();
             dc.addCompensatoryDelaysOnConnections();
         }
         else
@@ -49,32 +58,52 @@ struct DelayCompensation
         return module.latency;
     }
 
+    /** Returns the latency that a graph would have if its processor instances had the
+        latencies given by the provider, without changing anything. This is cheap enough
+        to be used when the latency of one of the processors changes at runtime.
+    */
+    static uint32_t calculateLatency (Module& graph, LatencyProvider getProcessorLatency)
+    {
+        SOUL_ASSERT (graph.isGraph());
+        DelayCompensation dc (graph, std::move (getProcessorLatency));
+
+        if (! dc.buildNodes())
+            return 0;
+
+        return dc.calculateInputLatenciesForAllNodes();
+    }
+
 private:
-    DelayCompensation (Module& g) : graph (g) {}
+    DelayCompensation (Module& g, LatencyProvider p) : graph (g), getProcessorLatency (std::move (p)) {}
 
     struct Node
     {
         struct Source
         {
             Node& node;
-            const heart::Connection& connection;
+            uint32_t connectionLatency;
         };
 
         const heart::ProcessorInstance& processorInstance;
-        uint32_t internalLatency = 0, absoluteLatencyAtInput = 0;
+        uint32_t internalLatency = 0, absoluteLatencyAtInput = 0, latencyFromGraphInputs = 0;
         ArrayWithPreallocation<Source, 4> sources;
     };
 
     Module& graph;
+    LatencyProvider getProcessorLatency;
     std::vector<Node> nodes;
-    std::vector<const Node*> visitedStack;
+    std::unordered_map<const heart::ProcessorInstance*, Node*> nodesByInstance;
+    std::vector<Node*> sortedNodes;
 
-    Node* findNode (pool_ptr<heart::ProcessorInstance> p)
+    Node* findNode (pool_ptr<heart::ProcessorInstance> p) const
     {
         if (p != nullptr)
-            for (auto& n : nodes)
-                if (std::addressof (n.processorInstance) == std::addressof (*p))
-                    return std::addressof (n);
+        {
+            auto n = nodesByInstance.find (p.get());
+
+            if (n != nodesByInstance.end())
+                return n->second;
+        }
 
         return {};
     }
@@ -89,42 +118,131 @@ private:
 
         for (auto& instance : graph.processorInstances)
         {
-            auto latency = apply (graph.program.getModuleWithName (instance->sourceName));
+            auto latency = getProcessorLatency (instance);
             nodes.push_back ({ instance, latency });
 
             if (latency != 0)
                 anyNodesWithInternalLatency = true;
         }
 
+        for (auto& n : nodes)
+            nodesByInstance[std::addressof (n.processorInstance)] = std::addressof (n);
+
+        for (auto& c : graph.connections)
+            if (getConnectionLatency (c) != 0)
+                anyNodesWithInternalLatency = true;
+
         if (! anyNodesWithInternalLatency)
             return false; // skip building the connections if there's nothing to do..
 
         for (auto& c : graph.connections)
-            if (auto src = findNode (c->source.processor))
-                if (auto dst = findNode (c->dest.processor))
-                    dst->sources.push_back ({ *src, c });
+        {
+            if (auto dst = findNode (c->dest.processor))
+            {
+                if (auto src = findNode (c->source.processor))
+                    dst->sources.push_back ({ *src, getConnectionLatency (c) });
+                else
+                    dst->latencyFromGraphInputs = std::max (dst->latencyFromGraphInputs, getConnectionLatency (c));
+            }
+        }
 
+        sortNodes();
         return true;
     }
 
-    void calculateInputLatenciesForAllNodes()
+    uint32_t getConnectionLatency (const heart::Connection& c) const
     {
-        graph.latency = 0;
-        visitedStack.reserve (256);
+        pool_ptr<heart::IODeclaration> source;
 
-        for (auto& c : graph.connections)
+        if (c.source.processor != nullptr)
+            source = graph.program.getModuleWithName (c.source.processor->sourceName).findOutput (c.source.endpointName);
+        else
+            source = graph.findInput (c.source.endpointName);
+
+        if (source == nullptr || ! source->isStreamEndpoint() || ! ResamplerKernel::canInterpolate (source->getSingleDataType()))
+            return 0;
+
+        auto getClock = [] (pool_ptr<heart::ProcessorInstance> p)
         {
-            if (c->dest.processor == nullptr)
+            return p != nullptr ? p->clockMultiplier : heart::ClockMultiplier();
+        };
+
+        return ResamplerKernel::getLatency (c.interpolationType, getClock (c.source.processor), getClock (c.dest.processor));
+    }
+
+    // Orders the nodes so that each one comes after all of its sources. A connection which
+    // closes a cycle (which must be broken by a delay) is ignored, and its source's latency
+    // at input is taken to be zero.
+    void sortNodes()
+    {
+        enum class State { unvisited, visiting, done };
+        std::vector<State> states (nodes.size(), State::unvisited);
+        std::vector<std::pair<Node*, size_t>> stack;
+        sortedNodes.reserve (nodes.size());
+
+        auto getState = [&] (const Node& n) -> State& { return states[(size_t) (std::addressof (n) - nodes.data())]; };
+
+        for (auto& start : nodes)
+        {
+            if (getState (start) != State::unvisited)
+                continue;
+
+            getState (start) = State::visiting;
+            stack.push_back ({ std::addressof (start), 0 });
+
+            while (! stack.empty())
             {
-                if (auto src = findNode (c->source.processor))
+                auto& top = stack.back();
+                auto node = top.first;
+
+                if (top.second < node->sources.size())
+                {
+                    auto& source = node->sources[top.second++].node;
+                    auto& state = getState (source);
+
+                    if (state == State::unvisited)
+                    {
+                        state = State::visiting;
+                        stack.push_back ({ std::addressof (source), 0 });
+                    }
+                }
+                else
                 {
-                    visitedStack.clear();
-                    graph.latency = std::max (graph.latency, calculateAbsoluteLatencyOutOfNode (*src));
+                    getState (*node) = State::done;
+                    sortedNodes.push_back (node);
+                    stack.pop_back();
                 }
             }
         }
     }
 
+    uint32_t calculateInputLatenciesForAllNodes()
+    {
+        for (auto node : sortedNodes)
+        {
+            auto maxSourceLatency = node->latencyFromGraphInputs;
+
+            for (auto& source : node->sources)
+                maxSourceLatency = std::max (maxSourceLatency, getLatencyOutOfNode (source.node) + source.connectionLatency);
+
+            node->absoluteLatencyAtInput = maxSourceLatency;
+        }
+
+        uint32_t latency = 0;
+
+        for (auto& c : graph.connections)
+            if (c->dest.processor == nullptr)
+                if (auto src = findNode (c->source.processor))
+                    latency = std::max (latency, getLatencyOutOfNode (*src) + getConnectionLatency (c));
+
+        return latency;
+    }
+
+    static uint32_t getLatencyOutOfNode (const Node& node)
+    {
+        return node.absoluteLatencyAtInput + node.internalLatency;
+    }
+
     void addCompensatoryDelaysOnConnections()
     {
         for (auto& c : graph.connections)
@@ -133,7 +251,9 @@ private:
             uint32_t latencyAtEndOfConnection = graph.latency;
 
             if (auto src = findNode (c->source.processor))
-                latencyAtStartOfConnection = src->absoluteLatencyAtInput + src->internalLatency;
+                latencyAtStartOfConnection = getLatencyOutOfNode (*src);
+
+            latencyAtStartOfConnection += getConnectionLatency (c);
 
             if (auto dst = findNode (c->dest.processor))
                 latencyAtEndOfConnection = dst->absoluteLatencyAtInput;
@@ -142,22 +262,6 @@ private:
                 c->delayLength = c->delayLength.value_or (0) + (latencyAtEndOfConnection - latencyAtStartOfConnection);
         }
     }
-
-    uint32_t calculateAbsoluteLatencyOutOfNode (Node& node)
-    {
-        if (std::find (visitedStack.begin(), visitedStack.end(), std::addressof (node)) != visitedStack.end())
-            return node.internalLatency;
-
-        visitedStack.push_back (std::addressof (node));
-        auto maxSourceLatency = node.absoluteLatencyAtInput;
-
-        for (auto& source : node.sources)
-            maxSourceLatency = std::max (maxSourceLatency, calculateAbsoluteLatencyOutOfNode (source.node));
-
-        visitedStack.pop_back();
-        node.absoluteLatencyAtInput = maxSourceLatency;
-        return maxSourceLatency + node.internalLatency;
-    }
 };
 
 }
@@ -0,0 +1,355 @@
+/*
+    _____ _____ _____ __
+   |   __|     |  |  |  |      The SOUL language
+   |__   |  |  |  |  |  |__    Copyright (c) 2019 - ROLI Ltd.
+   |_____|_____|_____|_____|
+
+   The code in this file is provided under the terms of the ISC license:
+
+   Permission to use, copy, modify, and/or distribute this software for any purpose
+   with or without fee is hereby granted, provided that the above copyright notice and
+   this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+   TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+   NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+   IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+   CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#if ! SOUL_INSIDE_CORE_CPP
+ #error "Don't add this cpp file to your build, it gets included indirectly by soul_core.cpp"
+#endif
+
+namespace soul
+{
+
+//==============================================================================
+struct ExecutionProfile::Instrumenter
+{
+    Instrumenter (Program& p, Level l) : program (p), processor (p.getMainProcessor()), level (l)
+    {
+        SOUL_ASSERT (processor.isProcessor());
+
+        for (auto& m : program.getModules())
+            for (auto& f : m->functions.get())
+                functionModules[f.getPointer()] = m.getPointer();
+    }
+
+    ExecutionProfile instrument()
+    {
+        ExecutionProfile profile;
+        size_t numRegions = 0;
+
+        for (auto& f : processor.functions.get())
+            if (! f->hasNoBody)
+                numRegions += countRegions (f);
+
+        if (numRegions == 0)
+            return profile;
+
+        counters = BlockBuilder::createVariable (processor, Type (PrimitiveType::int64).createArray (numRegions * 2),
+                                                 "_profileCounters", heart::Variable::Role::state);
+        processor.stateVariables.add (*counters);
+        profile.counterVariableName = counters->name.toString();
+
+        for (auto& f : processor.functions.get())
+            if (! f->hasNoBody)
+                instrumentFunction (f, profile.regions);
+
+        SOUL_ASSERT (profile.regions.size() == numRegions);
+        return profile;
+    }
+
+private:
+    Program& program;
+    Module& processor;
+    const Level level;
+    std::unordered_map<const heart::Function*, const Module*> functionModules;
+    pool_ptr<heart::Variable> counters;
+    pool_ptr<heart::Function> readCycleCounterFunction;
+
+    static bool isEntryPoint (const heart::Function& f)
+    {
+        return f.functionType.isRun() || f.functionType.isEvent();
+    }
+
+    bool shouldTimeCallsIn (const heart::Function& f) const
+    {
+        return level == Level::functions || isEntryPoint (f);
+    }
+
+    static pool_ptr<heart::FunctionCall> getTimedCall (heart::Statement& s)
+    {
+        if (auto call = cast<heart::FunctionCall> (s))
+        {
+            auto& fn = call->getFunction();
+
+            if (! (fn.functionType.isIntrinsic() || fn.intrinsicType != IntrinsicType::none))
+                return call;
+        }
+
+        return {};
+    }
+
+    size_t countRegions (heart::Function& f) const
+    {
+        size_t num = isEntryPoint (f) ? 1 : 0;
+
+        if (shouldTimeCallsIn (f))
+            for (auto& b : f.blocks)
+                for (auto s : b->statements)
+                    if (getTimedCall (*s) != nullptr)
+                        ++num;
+
+        return num;
+    }
+
+    std::string getQualifiedName (const heart::Function& f) const
+    {
+        auto module = functionModules.find (std::addressof (f));
+        SOUL_ASSERT (module != functionModules.end());
+        return TokenisedPathString::join (module->second->fullName, f.name.toString());
+    }
+
+    std::string getDisplayName (const heart::Function& f) const
+    {
+        auto module = functionModules.find (std::addressof (f));
+        SOUL_ASSERT (module != functionModules.end());
+
+        if (module->second == std::addressof (processor))
+            return f.getReadableName();
+
+        return TokenisedPathString::join (module->second->originalFullName, f.getReadableName());
+    }
+
+    heart::Function& getReadCycleCounterFunction()
+    {
+        if (readCycleCounterFunction == nullptr)
+        {
+            auto& internalModule = program.getOrCreateNamespace ("_internal");
+            readCycleCounterFunction = internalModule.functions.find ("_readCycleCounter");
+
+            if (readCycleCounterFunction == nullptr)
+            {
+                auto& fn = FunctionBuilder::createEmptyFunction (internalModule, "_readCycleCounter", PrimitiveType::int64);
+                fn.functionType = heart::FunctionType::intrinsic();
+                fn.intrinsicType = IntrinsicType::readCycleCounter;
+                fn.annotation.set ("intrin", getIntrinsicName (IntrinsicType::readCycleCounter));
+                readCycleCounterFunction = fn;
+                functionModules[std::addressof (fn)] = std::addressof (internalModule);
+            }
+        }
+
+        return *readCycleCounterFunction;
+    }
+
+    void readCycleCounter (BlockBuilder& builder, heart::Variable& dest)
+    {
+        builder.addFunctionCall (dest, getReadCycleCounterFunction(), {});
+    }
+
+    void addElapsedCycles (BlockBuilder& builder, heart::Variable& startTime, size_t regionIndex)
+    {
+        auto& now = builder.createRegisterVariable (PrimitiveType::int64);
+        readCycleCounter (builder, now);
+
+        builder.addAssignment (builder.createFixedArrayElement (*counters, regionIndex * 2),
+                               builder.createAdd (builder.createFixedArrayElement (*counters, regionIndex * 2),
+                                                  builder.createSubtract (now, startTime)));
+
+        builder.incrementValue (builder.createFixedArrayElement (*counters, regionIndex * 2 + 1));
+    }
+
+    void instrumentFunction (heart::Function& f, std::vector<Region>& regions)
+    {
+        auto timeCalls = shouldTimeCallsIn (f);
+
+        if (! (isEntryPoint (f) || timeCalls))
+            return;
+
+        pool_ptr<heart::Variable> startTime;
+        size_t entryRegion = 0;
+
+        if (isEntryPoint (f))
+        {
+            entryRegion = regions.size();
+            regions.push_back ({ getQualifiedName (f), {}, getDisplayName (f), f.location });
+            startTime = BlockBuilder (processor).createMutableLocalVariable (PrimitiveType::int64, "_profileStart");
+        }
+
+        for (auto& b : f.blocks)
+        {
+            std::vector<heart::Statement*> statements;
+
+            for (auto s : b->statements)
+                statements.push_back (s);
+
+            b->statements.clear();
+            BlockBuilder builder (processor, b);
+
+            if (startTime != nullptr && b == f.blocks.front())
+                readCycleCounter (builder, *startTime);
+
+            for (auto s : statements)
+            {
+                s->nextObject = nullptr;
+
+                if (timeCalls)
+                {
+                    if (auto call = getTimedCall (*s))
+                    {
+                        auto& callee = call->getFunction();
+                        regions.push_back ({ getQualifiedName (callee), getQualifiedName (f), getDisplayName (callee),
+                                             call->location.isEmpty() ? callee.location : call->location });
+
+                        auto& callStartTime = builder.createRegisterVariable (PrimitiveType::int64);
+                        readCycleCounter (builder, callStartTime);
+                        builder.addStatement (*s);
+                        addElapsedCycles (builder, callStartTime, regions.size() - 1);
+                        continue;
+                    }
+                }
+
+                if (startTime != nullptr && is_type<heart::AdvanceClock> (*s))
+                {
+                    addElapsedCycles (builder, *startTime, entryRegion);
+                    builder.addStatement (*s);
+                    readCycleCounter (builder, *startTime);
+                    continue;
+                }
+
+                builder.addStatement (*s);
+            }
+
+            if (startTime != nullptr && b->terminator != nullptr && b->terminator->isReturn())
+                addElapsedCycles (builder, *startTime, entryRegion);
+        }
+    }
+};
+
+//==============================================================================
+ExecutionProfile ExecutionProfile::apply (Program& program, Level level)
+{
+    if (level == Level::none)
+        return {};
+
+    return Instrumenter (program, level).instrument();
+}
+
+ExecutionProfile ExecutionProfile::apply (Program& program, const BuildSettings& settings)
+{
+    if (settings.executionProfileLevel <= 0)
+        return {};
+
+    if (program.getMainProcessor().isGraph())
+    {
+        GraphLowering::apply (program);
+        heart::Checker::sanityCheck (program);
+    }
+
+    return apply (program, settings.executionProfileLevel == 1 ? Level::processors : Level::functions);
+}
+
+// A performer exposes the counters in the program's state as atomics, so they need the same layout
+static_assert (sizeof (std::atomic<int64_t>) == sizeof (int64_t) && std::atomic<int64_t>::is_always_lock_free);
+
+std::vector<int64_t> ExecutionProfile::readCounters (ArrayView<const std::atomic<int64_t>> counters)
+{
+    std::vector<int64_t> values;
+    values.reserve (counters.size());
+
+    for (auto& c : counters)
+        values.push_back (c.load (std::memory_order_relaxed));
+
+    return values;
+}
+
+size_t ExecutionProfile::getNumCounters() const
+{
+    return regions.size() * 2;
+}
+
+static std::string getFrameName (const ExecutionProfile::Region& region)
+{
+    auto name = region.displayName;
+
+    if (! region.location.isEmpty())
+    {
+        auto lineAndColumn = region.location.getLineAndColumn();
+        name += " (" + region.location.getFilename() + ":" + std::to_string (lineAndColumn.line)
+                  + ":" + std::to_string (lineAndColumn.column) + ")";
+    }
+
+    // semicolons separate the frames in a folded stack
+    return choc::text::replace (name, ";", ",");
+}
+
+std::string ExecutionProfile::createFoldedStacks (ArrayView<const int64_t> counterValues) const
+{
+    SOUL_ASSERT (counterValues.size() >= getNumCounters());
+
+    std::unordered_map<std::string, double> totalCycles;
+    std::unordered_map<std::string, std::vector<size_t>> callsMadeBy;
+
+    for (size_t i = 0; i < regions.size(); ++i)
+    {
+        totalCycles[regions[i].function] += static_cast<double> (counterValues[i * 2]);
+
+        if (! regions[i].caller.empty())
+            callsMadeBy[regions[i].caller].push_back (i);
+    }
+
+    std::ostringstream out;
+
+    std::function<void(const std::string&, const std::string&, double)> addStack
+        = [&] (const std::string& function, const std::string& stack, double cycles)
+    {
+        auto selfCycles = cycles;
+        auto total = totalCycles[function];
+
+        for (auto call : callsMadeBy[function])
+        {
+            auto share = total > 0 ? cycles * static_cast<double> (counterValues[call * 2]) / total : 0.0;
+            selfCycles -= share;
+            addStack (regions[call].function, stack + ";" + getFrameName (regions[call]), share);
+        }
+
+        auto roundedCycles = std::llround (selfCycles);
+
+        if (roundedCycles > 0)
+            out << stack << ' ' << roundedCycles << '\n';
+    };
+
+    for (size_t i = 0; i < regions.size(); ++i)
+        if (regions[i].caller.empty())
+            addStack (regions[i].function, getFrameName (regions[i]), static_cast<double> (counterValues[i * 2]));
+
+    return out.str();
+}
+
+choc::value::Value ExecutionProfile::toJSON (ArrayView<const int64_t> counterValues) const
+{
+    SOUL_ASSERT (counterValues.size() >= getNumCounters());
+    auto list = choc::value::createEmptyArray();
+
+    for (size_t i = 0; i < regions.size(); ++i)
+    {
+        auto region = choc::value::createObject ("Region",
+                                                 "function", regions[i].displayName,
+                                                 "frame", getFrameName (regions[i]),
+                                                 "cycles", counterValues[i * 2],
+                                                 "calls", counterValues[i * 2 + 1]);
+
+        if (! regions[i].caller.empty())
+            region.addMember ("caller", regions[i].caller);
+
+        list.addArrayElement (region);
+    }
+
+    return choc::value::createObject ("ExecutionProfile",
+                                      "regions", list);
+}
+
+} // namespace soul
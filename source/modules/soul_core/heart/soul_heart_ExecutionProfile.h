@@ -0,0 +1,119 @@
+/*
+    _____ _____ _____ __
+   |   __|     |  |  |  |      The SOUL language
+   |__   |  |  |  |  |  |__    Copyright (c) 2019 - ROLI Ltd.
+   |_____|_____|_____|_____|
+
+   The code in this file is provided under the terms of the ISC license:
+
+   Permission to use, copy, modify, and/or distribute this software for any purpose
+   with or without fee is hereby granted, provided that the above copyright notice and
+   this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+   TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+   NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+   IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+   CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+namespace soul
+{
+
+//==============================================================================
+/**
+    Instruments a program so that it measures how many CPU cycles it spends in each
+    part of its code, and turns those measurements into a profile.
+
+    The timed regions are the main processor's run() function (measured from one
+    advance() to the next), its event handlers, and the calls that are made from them.
+    At the functions level, every call from one function in the main processor to
+    another is timed too. Because GraphLowering gives each node of a graph its own copy
+    of its processor's functions, running this after a graph has been lowered means that
+    each processor instance gets its own counters, although the elements of a processor
+    array share a set.
+
+    The counter is read by calling the readCycleCounter intrinsic, which a back-end must
+    implement natively, e.g. with soul::readCycleCounter(). Calls that happen inside an
+    expression, and calls to intrinsics, aren't timed, so their cost is included in the
+    function that makes them.
+
+    The counts are accumulated in an int64 array in the main processor's state, with two
+    elements per Region: the number of cycles spent in it, followed by the number of times
+    it was entered. Each counter is updated with a single aligned 64-bit store, so a
+    performer can let a host read them as std::atomic<int64_t> with relaxed loads at any
+    time, without needing a lock, as long as it doesn't mind a value being slightly out
+    of date.
+*/
+struct ExecutionProfile
+{
+    enum class Level
+    {
+        none,
+        processors,
+        functions
+    };
+
+    /** A piece of code whose execution time is measured. */
+    struct Region
+    {
+        /** The fully-qualified name of the function that this region runs. */
+        std::string function;
+
+        /** For a function call, the fully-qualified name of the function that makes the
+            call, or an empty string for run() and the event handlers, which the host calls.
+        */
+        std::string caller;
+
+        /** A readable version of the function name to use in reports. */
+        std::string displayName;
+
+        /** The position of the call in the source code, or of the function if this is one
+            of the functions that the host calls.
+        */
+        CodeLocation location;
+    };
+
+    std::vector<Region> regions;
+
+    /** The name of the main processor's state variable which holds the counters. */
+    std::string counterVariableName;
+
+    /** Instruments the program's main processor, which must not be a graph, so should be
+        called after GraphLowering::apply(). Returns the layout of the counters that the
+        program will write to.
+    */
+    static ExecutionProfile apply (Program&, Level);
+
+    /** Instruments the program at the level given by BuildSettings::executionProfileLevel,
+        lowering its main graph first if it has one. Returns an empty profile if profiling
+        isn't enabled.
+    */
+    static ExecutionProfile apply (Program&, const BuildSettings&);
+
+    /** Takes a snapshot of a set of counters which are being updated by another thread,
+        such as the ones returned by Performer::getExecutionProfileCounters().
+    */
+    static std::vector<int64_t> readCounters (ArrayView<const std::atomic<int64_t>>);
+
+    /** Returns the number of int64 elements in the counter array. */
+    size_t getNumCounters() const;
+
+    /** Turns a set of counter values into the "folded stacks" format that flame-graph tools
+        use, in which each line is a semicolon-separated list of frames followed by the number
+        of cycles spent in the last one. When a function is called from more than one place,
+        the cycles that it spent in its own callees are shared between its callers in
+        proportion to how long each of their calls took.
+    */
+    std::string createFoldedStacks (ArrayView<const int64_t> counters) const;
+
+    /** Returns an object listing each region with its counter values. */
+    choc::value::Value toJSON (ArrayView<const int64_t> counters) const;
+
+private:
+    struct Instrumenter;
+};
+
+} // namespace soul
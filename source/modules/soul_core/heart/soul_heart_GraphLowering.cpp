@@ -0,0 +1,2761 @@
+/*
+    _____ _____ _____ __
+   |   __|     |  |  |  |      The SOUL language
+   |__   |  |  |  |  |  |__    Copyright (c) 2019 - ROLI Ltd.
+   |_____|_____|_____|_____|
+
+   The code in this file is provided under the terms of the ISC license:
+
+   Permission to use, copy, modify, and/or distribute this software for any purpose
+   with or without fee is hereby granted, provided that the above copyright notice and
+   this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+   TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+   NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+   IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+   CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#if ! SOUL_INSIDE_CORE_CPP
+ #error "Don't add this cpp file to your build, it gets included indirectly by soul_core.cpp"
+#endif
+
+namespace soul
+{
+
+//==============================================================================
+struct GraphLowering::GraphFlattener
+{
+    // An external variable that has been copied into a flattened processor, and the
+    // module and name that it was originally declared with
+    struct ExternalOrigin
+    {
+        pool_ref<heart::Variable> variable;
+        std::string shortName, fullName, originalFullName;
+        Identifier name;
+    };
+
+    GraphFlattener (Program& p, Module& g, std::vector<ExternalOrigin>& origins, bool reportFramesSkipped)
+        : program (p), graph (g), processor (p.addProcessor (getModuleIndex (p, g))), externalOrigins (origins),
+          shouldReportFramesSkipped (reportFramesSkipped)
+    {
+    }
+
+    Module& flatten()
+    {
+        addIdentityMappings();
+        createProcessorModule();
+        createNodes();
+        remapSharedFunctionTypes();
+        createRoutes();
+        calculateExecutionOrder();
+        fuseStreamChains();
+        populateEventRouters();
+        createInputEventHandlers();
+        createInitFunction();
+        createRunFunction();
+        planBufferMemory();
+        inlineFusedNodes();
+
+        program.removeModule (graph);
+        return processor;
+    }
+
+    // The processor's copies of the externals are moved back into namespaces with the names
+    // of the processors that declared them, so that a host can find them by their old names
+    static void moveExternalsToNamespaces (Program& program, Module& processor, ArrayView<ExternalOrigin> origins)
+    {
+        for (auto& origin : origins)
+        {
+            // (the copies made in a sub-graph will have gone when it was flattened into its parent)
+            if (! processor.stateVariables.remove (origin.variable))
+                continue;
+
+            pool_ptr<Module> ns;
+
+            for (auto& m : program.getModules())
+                if (m->fullName == origin.fullName)
+                    ns = m;
+
+            if (ns == nullptr)
+            {
+                ns = program.addNamespace (getModuleIndex (program, processor));
+                ns->shortName        = origin.shortName;
+                ns->fullName         = origin.fullName;
+                ns->originalFullName = origin.originalFullName;
+            }
+
+            origin.variable->name = origin.name;
+            ns->stateVariables.add (origin.variable);
+        }
+    }
+
+    uint32_t getNumFusedConnections() const     { return numFusedConnections; }
+    uint32_t getNumQuiescentNodes() const       { return numQuiescentNodes; }
+    size_t getBufferSizeBeforePlanning() const  { return bufferSizeBeforePlanning; }
+    size_t getBufferSizeAfterPlanning() const   { return bufferSizeAfterPlanning; }
+
+private:
+    //==============================================================================
+    struct Node;
+    struct Route;
+
+    struct EndpointRef
+    {
+        Node* node;     // null for the graph's own inputs and outputs
+        heart::IODeclaration* io;
+        std::optional<uint32_t> element;
+    };
+
+    // All the delayed connections from the same source share one circular buffer, whose
+    // size is the power of two above the longest of their delays, and each one reads
+    // from it at its own offset behind the write position.
+    struct DelayLine
+    {
+        Route& writer;
+        std::string name;
+        uint32_t maxLength;
+        pool_ptr<heart::Variable> buffer, position;
+    };
+
+    // The recent values that a resampler kernel gets applied to. The buffer holds two
+    // copies of them so that the values, oldest first, always start at the position.
+    struct FilterHistory
+    {
+        heart::Variable& buffer;
+        heart::Variable& position;
+        heart::Variable& coefficients;
+        uint32_t length;
+    };
+
+    struct Route
+    {
+        Route (EndpointRef s, EndpointRef d, const heart::Connection& c)
+            : source (s), dest (d), connection (c) {}
+
+        EndpointRef source, dest;
+        const heart::Connection& connection;
+        DelayLine* delayLine = nullptr;
+        uint32_t delayLength = 0;
+        bool fused = false;
+
+        // Converting from the source's rate to the base rate..
+        pool_ptr<heart::Variable> resampled, sourceAccumulator, rampStart, rampEnd;
+        // ..and from the base rate to the destination's rate
+        pool_ptr<heart::Variable> previous, destAccumulator;
+        // ..or when the connection uses one of the filtering interpolation types
+        std::unique_ptr<FilterHistory> sourceFilter, destFilter;
+
+        // Between two multiplied nodes, the source's values for a whole frame are collected,
+        // preceded by the last value from the previous frame
+        pool_ptr<heart::Variable> block;
+        bool interpolateBlock = false;
+    };
+
+    struct Node
+    {
+        Node (const heart::ProcessorInstance& i, Module& m, uint32_t index, std::string p)
+            : instance (i), module (m), arrayIndex (index), prefix (std::move (p)) {}
+
+        const heart::ProcessorInstance& instance;
+        Module& module;
+        uint32_t arrayIndex;
+        std::string prefix;
+        int64_t multiplier = 1, divider = 1;
+        uint32_t numSharedElements = 1;   // the number of array elements which share this node's code
+
+        ModuleCloner::FunctionMappings functions;
+        pool_ptr<heart::Function> step, init, systemInit;
+        std::unordered_map<const heart::IODeclaration*, pool_ptr<heart::Variable>> buffers;
+        std::vector<Route*> inputRoutes, outputRoutes;
+        std::vector<Node*> sources;
+        bool isOrdered = false;
+
+        // For a processor that's annotated as quiescent: how many frames it keeps running
+        // after its inputs go quiet, how long they've been quiet, where its count of skipped
+        // frames goes in the framesSkipped array, and the last values of its value inputs,
+        // to see when they change
+        int64_t quiescentTail = 0;
+        pool_ptr<heart::Variable> framesSinceActivity;
+        uint32_t framesSkippedIndex = 0;
+        std::unordered_map<const heart::IODeclaration*, pool_ptr<heart::Variable>> previousValues;
+    };
+
+    // An element of the framesSkipped array, which counts either the frames skipped by one
+    // of this graph's quiescent nodes, or those of a node inside a sub-graph, which are
+    // copied from the sub-graph's own framesSkipped output
+    struct SkippedFramesCount
+    {
+        std::string nodeName;
+        Node& node;
+        pool_ptr<const heart::IODeclaration> subGraphOutput;
+        uint32_t subGraphIndex;
+    };
+
+    struct EventRouter
+    {
+        Node& node;
+        const heart::IODeclaration& output;
+        Type type;
+        heart::Function& function;
+    };
+
+    struct ClockPhase
+    {
+        int64_t divider;
+        heart::Variable& phase;
+    };
+
+    struct KernelTable
+    {
+        InterpolationType interpolationType;
+        bool isDecimation;
+        uint32_t factor;
+        Type type;
+        heart::Variable& coefficients;
+    };
+
+    struct BufferLifetime
+    {
+        heart::Variable* buffer;
+        uint32_t start, end;
+        bool canBeShared;
+    };
+
+    Program& program;
+    Module& graph;
+    Module& processor;
+    std::vector<ExternalOrigin>& externalOrigins;
+    const bool shouldReportFramesSkipped;
+
+    ModuleCloner::StructMappings structMappings;
+    ModuleCloner::FunctionMappings sharedFunctions;
+    ModuleCloner::VariableMappings sharedVariables;
+    std::unordered_set<const Module*> modulesWithCopiedStructs;
+    std::unordered_set<std::string> usedNames;
+    std::unordered_set<const heart::Variable*> wrappedPerElementArrays;
+
+    std::vector<std::unique_ptr<Node>> nodes;
+    std::vector<Node*> executionOrder;
+    std::vector<std::unique_ptr<Route>> streamRoutes, eventRoutes;
+    std::vector<std::unique_ptr<EventRouter>> eventRouters;
+    std::unordered_map<const heart::IODeclaration*, pool_ptr<heart::Variable>> graphBuffers;
+    std::vector<ClockPhase> clockPhases;
+    std::vector<std::unique_ptr<DelayLine>> delayLines;
+    std::vector<KernelTable> kernelTables;
+    std::vector<SkippedFramesCount> skippedFramesCounts;
+    pool_ptr<heart::Variable> framesSkipped;
+    pool_ptr<heart::OutputDeclaration> framesSkippedOutput;
+    uint32_t numFusedConnections = 0, numQuiescentNodes = 0;
+    size_t bufferSizeBeforePlanning = 0, bufferSizeAfterPlanning = 0;
+    uint32_t nextBlockIndex = 0;
+
+    //==============================================================================
+    static int getModuleIndex (Program& p, Module& m)
+    {
+        auto& modules = p.getModules();
+        return (int) std::distance (modules.begin(), std::find (modules.begin(), modules.end(), m));
+    }
+
+    static bool isAtBaseRate (const Node* n)
+    {
+        return n == nullptr || (n->multiplier == 1 && n->divider == 1);
+    }
+
+    std::string getUniqueName (const std::string& name)
+    {
+        auto uniqueName = addSuffixToMakeUnique (makeSafeIdentifierName (name),
+                                                 [this] (const std::string& nm) { return usedNames.find (nm) != usedNames.end(); });
+        usedNames.insert (uniqueName);
+        return uniqueName;
+    }
+
+    heart::Variable& addStateVariable (const std::string& name, const Type& type)
+    {
+        auto& v = BlockBuilder::createVariable (processor, type, getUniqueName (name), heart::Variable::Role::state);
+        processor.stateVariables.add (v);
+        return v;
+    }
+
+    heart::Block& createBlock (FunctionBuilder& builder, const std::string& name)
+    {
+        return builder.createBlock (("@" + name + "_").c_str(), nextBlockIndex++);
+    }
+
+    Type cloneType (const Type& t)
+    {
+        return ModuleCloner::cloneType (structMappings, t);
+    }
+
+    //==============================================================================
+    void addIdentityMappings()
+    {
+        for (auto& m : program.getModules())
+        {
+            for (auto& s : m->structs.get())
+                structMappings[s.get()] = s;
+
+            if (m->isNamespace())
+            {
+                for (auto& f : m->functions.get())
+                    sharedFunctions[f] = f;
+
+                for (auto& v : m->stateVariables.get())
+                    sharedVariables[v] = v;
+            }
+        }
+
+        usedNames.insert (heart::getRunFunctionName());
+        usedNames.insert (heart::getUserInitFunctionName());
+        usedNames.insert (heart::getSystemInitFunctionName());
+
+        for (auto& input : graph.inputs)
+            for (auto& type : input->dataTypes)
+                usedNames.insert (getInputEventHandlerName (input, type));
+    }
+
+    static std::string getInputEventHandlerName (const heart::InputDeclaration& input, const Type& type)
+    {
+        return heart::getEventFunctionName (input.name, input.arraySize.has_value() ? Type (PrimitiveType::int32) : type);
+    }
+
+    void copyStructs (const Module& source)
+    {
+        if (! modulesWithCopiedStructs.insert (std::addressof (source)).second)
+            return;
+
+        for (auto& s : source.structs.get())
+        {
+            auto& copy = processor.structs.add (addSuffixToMakeUnique (s->getName(),
+                                                                       [this] (const std::string& nm) { return processor.structs.find (nm) != nullptr; }));
+            structMappings[s.get()] = copy;
+            structMappings[std::addressof (copy)] = copy;
+        }
+
+        for (auto& s : source.structs.get())
+        {
+            auto& copy = *structMappings[s.get()];
+
+            for (auto& m : s->getMembers())
+                copy.addMember (cloneType (m.type), m.name);
+        }
+    }
+
+    // The nodes' latencies are those of the modules they'll be running, which for a sub-graph is
+    // the processor that it has already been lowered into
+    uint32_t calculateLatency() const
+    {
+        if (graph.connections.empty())
+            return graph.latency;
+
+        return DelayCompensation::calculateLatency (graph, [this] (const heart::ProcessorInstance& instance)
+        {
+            return program.getModuleWithName (instance.sourceName).latency;
+        });
+    }
+
+    void createProcessorModule()
+    {
+        processor.shortName        = graph.shortName;
+        processor.fullName         = graph.fullName;
+        processor.originalFullName = graph.originalFullName;
+        processor.annotation       = graph.annotation;
+        processor.sampleRate       = graph.sampleRate;
+        processor.latency          = calculateLatency();
+        processor.location         = graph.location;
+
+        copyStructs (graph);
+
+        ModuleCloner::FunctionMappings functions;
+        ModuleCloner::VariableMappings variables;
+        ModuleCloner cloner (graph, processor, functions, structMappings, variables);
+
+        for (auto& input : graph.inputs)
+        {
+            auto& io = cloner.clone (input);
+            processor.inputs.push_back (io);
+
+            if (! io.isEventEndpoint())
+                graphBuffers[std::addressof (io)] = addStateVariable ("input_" + io.name.toString(), io.getSingleDataType());
+        }
+
+        for (auto& output : graph.outputs)
+        {
+            auto& io = cloner.clone (output);
+            processor.outputs.push_back (io);
+
+            if (! io.isEventEndpoint())
+                graphBuffers[std::addressof (io)] = addStateVariable ("output_" + io.name.toString(), io.getSingleDataType());
+        }
+    }
+
+    /** Namespace functions are shared rather than cloned, but specialised ones (e.g. the
+        intrinsics generated for a particular array type) can mention structs declared
+        inside the processors being flattened, so they need pointing at our copies.
+    */
+    void remapSharedFunctionTypes()
+    {
+        for (auto& m : program.getModules())
+        {
+            if (! m->isNamespace())
+                continue;
+
+            for (auto& f : m->functions.get())
+            {
+                f->returnType = cloneType (f->returnType);
+
+                for (auto& p : f->parameters)
+                    p->type = cloneType (p->type);
+
+                for (auto& b : f->blocks)
+                    for (auto& p : b->parameters)
+                        p->type = cloneType (p->type);
+
+                f->visitExpressions ([this] (pool_ref<heart::Expression>& value, AccessType)
+                {
+                    if (auto v = cast<heart::Variable> (value))
+                        v->type = cloneType (v->type);
+                    else if (auto a = cast<heart::AggregateInitialiserList> (value))
+                        a->type = cloneType (a->type);
+                    else if (auto c = cast<heart::TypeCast> (value))
+                        c->destType = cloneType (c->destType);
+                });
+            }
+        }
+    }
+
+    //==============================================================================
+    void createNodes()
+    {
+        for (auto& instance : graph.processorInstances)
+        {
+            auto& module = program.getModuleWithName (instance->sourceName);
+            SOUL_ASSERT (module.isProcessor());
+            copyStructs (module);
+
+            if (instance->arraySize > 1 && canShareCodeBetweenElements (instance, module))
+            {
+                nodes.push_back (createNode (instance, module, 0, instance->arraySize));
+                auto& firstElement = *nodes.back();
+                addSkippedFramesCounts (firstElement);
+
+                for (uint32_t i = 1; i < instance->arraySize; ++i)
+                {
+                    nodes.push_back (createArrayElementNode (firstElement, i));
+                    addSkippedFramesCounts (*nodes.back());
+                }
+            }
+            else
+            {
+                for (uint32_t i = 0; i < instance->arraySize; ++i)
+                {
+                    nodes.push_back (createNode (instance, module, i, 1));
+                    addSkippedFramesCounts (*nodes.back());
+                }
+            }
+        }
+
+        createFramesSkippedOutput();
+
+        if (numQuiescentNodes != 0 && CompileProfiler::getCurrent() != nullptr)
+            CompileProfiler::addInstantEvent (graph.fullName, "quiescence", { { "quiescentNodes", (int64_t) numQuiescentNodes } });
+    }
+
+    // The elements' copies of each state variable get packed into an array, which has to
+    // stay within the maximum object size.
+    static bool canShareCodeBetweenElements (const heart::ProcessorInstance& instance, const Module& module)
+    {
+        for (auto& v : module.stateVariables.get())
+            if (! v->isExternal() && v->type.getPackedSizeInBytes() * instance.arraySize > Type::maxPackedObjectSize)
+                return false;
+
+        return true;
+    }
+
+    void addExternalOrigin (heart::Variable& copy, heart::Variable& original, const Module& module)
+    {
+        for (auto& o : externalOrigins)
+        {
+            // If this is a copy of a copy from a sub-graph, it keeps the first one's origin
+            if (o.variable == original)
+            {
+                auto origin = o;
+                origin.variable = copy;
+                externalOrigins.push_back (std::move (origin));
+                return;
+            }
+        }
+
+        externalOrigins.push_back ({ copy, module.shortName, module.fullName, module.originalFullName, original.name });
+    }
+
+    // When the elements of a processor array share a single copy of its code, each of its
+    // state variables becomes an array indexed by the element, and all its functions take
+    // an extra parameter to say which element they should operate on. The code for each
+    // element still runs separately - this saves code size rather than vectorising them.
+    std::unique_ptr<Node> createNode (const heart::ProcessorInstance& instance, Module& module, uint32_t arrayIndex, uint32_t numSharedElements)
+    {
+        auto name = (instance.arraySize > 1 && numSharedElements == 1) ? instance.instanceName + "_" + std::to_string (arrayIndex)
+                                                                        : instance.instanceName;
+
+        auto node = std::make_unique<Node> (instance, module, arrayIndex, makeSafeIdentifierName (name) + "_");
+        node->multiplier        = instance.clockMultiplier.getMultiplier().value_or (1);
+        node->divider           = instance.clockMultiplier.getDivider().value_or (1);
+        node->numSharedElements = numSharedElements;
+        node->functions         = sharedFunctions;
+
+        auto firstNewStateVariable = processor.stateVariables.size();
+        auto variables = sharedVariables;
+        ModuleCloner cloner (module, processor, node->functions, structMappings, variables);
+
+        for (auto& v : module.stateVariables.get())
+        {
+            if (variables[v] != nullptr)
+                continue;
+
+            auto& copy = cloner.cloneVariable (v);
+            copy.name = processor.allocator.get (getUniqueName (v->isExternal() ? v->name.toString()
+                                                                                  : node->prefix + v->name.toString()));
+            processor.stateVariables.add (copy);
+
+            // all the instances of a processor must share the same copy of its externals
+            if (v->isExternal())
+            {
+                sharedVariables[v] = copy;
+                addExternalOrigin (copy, v, module);
+            }
+        }
+
+        for (auto& f : module.functions.get())
+            node->functions[f] = processor.functions.add (getUniqueName (node->prefix + f->name.toString()), false);
+
+        for (auto& input : module.inputs)
+        {
+            cloner.inputMappings[input] = input;
+
+            if (! input->isEventEndpoint())
+                node->buffers[input.getPointer()] = addStateVariable (node->prefix + input->name.toString(),
+                                                                      cloneType (input->getSingleDataType()));
+        }
+
+        for (auto& output : module.outputs)
+        {
+            cloner.outputMappings[output] = output;
+
+            if (! output->isEventEndpoint())
+                node->buffers[output.getPointer()] = addStateVariable (node->prefix + output->name.toString(),
+                                                                       cloneType (output->getSingleDataType()));
+        }
+
+        if (auto tail = getQuiescentTail (module))
+            if (isAtBaseRate (node.get()))
+                addQuiescenceState (*node, *tail);
+
+        for (auto& f : module.functions.get())
+        {
+            auto& copy = *node->functions[f];
+            auto copyName = copy.name;
+            cloner.clone (copy, f);
+            copy.name = copyName;
+            copy.functionType = heart::FunctionType::normal();
+
+            if (f->functionType.isRun())         node->step = copy;
+            if (f->functionType.isUserInit())    node->init = copy;
+            if (f->functionType.isSystemInit())  node->systemInit = copy;
+        }
+
+        if (node->numSharedElements > 1)
+            addArrayIndexParameters (*node);
+
+        for (auto& f : module.functions.get())
+        {
+            replaceProcessorProperties (*node, *node->functions[f]);
+            replaceStreamAccesses (*node, *node->functions[f]);
+        }
+
+        if (node->step != nullptr)
+            convertRunFunctionToStepFunction (*node, *node->step);
+
+        if (node->numSharedElements > 1)
+        {
+            auto stateVariables = processor.stateVariables.get().toVector();
+
+            for (auto i = firstNewStateVariable; i < stateVariables.size(); ++i)
+                if (! stateVariables[i]->isExternal())
+                    convertToPerElementArray (*node, stateVariables[i]);
+
+            node->prefix = makeSafeIdentifierName (instance.instanceName + "_0") + "_";
+        }
+
+        return node;
+    }
+
+    std::unique_ptr<Node> createArrayElementNode (const Node& firstElement, uint32_t arrayIndex)
+    {
+        auto& instance = firstElement.instance;
+        auto node = std::make_unique<Node> (instance, firstElement.module, arrayIndex,
+                                            makeSafeIdentifierName (instance.instanceName + "_" + std::to_string (arrayIndex)) + "_");
+        node->multiplier          = firstElement.multiplier;
+        node->divider             = firstElement.divider;
+        node->numSharedElements   = firstElement.numSharedElements;
+        node->functions           = firstElement.functions;
+        node->step                = firstElement.step;
+        node->init                = firstElement.init;
+        node->systemInit          = firstElement.systemInit;
+        node->buffers             = firstElement.buffers;
+        node->quiescentTail       = firstElement.quiescentTail;
+        node->framesSinceActivity = firstElement.framesSinceActivity;
+        node->previousValues      = firstElement.previousValues;
+
+        if (node->framesSinceActivity != nullptr)
+            ++numQuiescentNodes;
+
+        return node;
+    }
+
+    // A processor can be annotated with [[ quiescent: n ]] to promise that its output is a
+    // function of only its inputs and state, and that once its inputs have been silent
+    // for n frames, its state has settled and it'll output nothing but silence until they
+    // change. [[ quiescent ]] on its own means that its output goes silent immediately.
+    static std::optional<int64_t> getQuiescentTail (const Module& module)
+    {
+        auto value = module.annotation.getValue ("quiescent");
+
+        if (value.getType().isPrimitiveInteger())
+            return std::clamp (value.getAsInt64(), (int64_t) 0, (int64_t) std::numeric_limits<int32_t>::max() - 1);
+
+        if (value.getType().isBool() && value.getAsBool())
+            return 0;
+
+        return {};
+    }
+
+    void addQuiescenceState (Node& node, int64_t tail)
+    {
+        node.quiescentTail = tail;
+        node.framesSinceActivity = addStateVariable (node.prefix + "framesSinceActivity", PrimitiveType::int32);
+
+        for (auto& input : node.module.inputs)
+            if (input->isValueEndpoint())
+                node.previousValues[input.getPointer()] = addStateVariable (node.prefix + input->name.toString() + "_previous",
+                                                                            node.buffers[input.getPointer()]->type);
+
+        ++numQuiescentNodes;
+    }
+
+    static std::string getNodeName (const Node& node)
+    {
+        if (node.instance.arraySize > 1)
+            return node.instance.instanceName + "[" + std::to_string (node.arrayIndex) + "]";
+
+        return node.instance.instanceName;
+    }
+
+    void addSkippedFramesCounts (Node& node)
+    {
+        if (! shouldReportFramesSkipped)
+            return;
+
+        if (node.framesSinceActivity != nullptr)
+        {
+            node.framesSkippedIndex = (uint32_t) skippedFramesCounts.size();
+            skippedFramesCounts.push_back ({ getNodeName (node), node, {}, 0 });
+        }
+
+        if (auto output = node.module.findOutput (GraphLowering::getFramesSkippedEndpointName()))
+        {
+            auto names = choc::text::splitString (output->annotation.getString ("nodes"), ',', false);
+            SOUL_ASSERT (names.size() == output->getSingleDataType().getArraySize());
+
+            for (uint32_t i = 0; i < names.size(); ++i)
+                skippedFramesCounts.push_back ({ getNodeName (node) + "." + names[i], node, output, i });
+        }
+    }
+
+    // The counts are written to an output value, whose "nodes" annotation lists the names of
+    // the nodes in the same order
+    void createFramesSkippedOutput()
+    {
+        if (skippedFramesCounts.empty())
+            return;
+
+        auto type = Type (PrimitiveType::int64).createArray (skippedFramesCounts.size());
+        framesSkipped = addStateVariable ("framesSkipped", type);
+
+        framesSkippedOutput = processor.allocate<heart::OutputDeclaration> (graph.location);
+        framesSkippedOutput->name = processor.allocator.get (GraphLowering::getFramesSkippedEndpointName());
+        framesSkippedOutput->index = (uint32_t) processor.outputs.size();
+        framesSkippedOutput->endpointType = EndpointType::value;
+        framesSkippedOutput->dataTypes.push_back (type);
+        framesSkippedOutput->annotation.set ("nodes", joinStrings (skippedFramesCounts, ",", [] (const SkippedFramesCount& c) { return c.nodeName; }));
+        processor.outputs.push_back (*framesSkippedOutput);
+        graphBuffers[framesSkippedOutput.get()] = framesSkipped;
+    }
+
+    void addArrayIndexParameters (Node& node)
+    {
+        std::vector<heart::Function*> elementFunctions;
+
+        for (auto& f : node.module.functions.get())
+        {
+            auto& fn = *node.functions[f];
+            fn.parameters.push_back (BlockBuilder::createVariable (processor, PrimitiveType::int32, "arrayIndex", heart::Variable::Role::parameter));
+            elementFunctions.push_back (std::addressof (fn));
+        }
+
+        // calls between the shared functions have to pass the index along
+        for (auto f : elementFunctions)
+        {
+            auto& arrayIndex = f->parameters.back().get();
+
+            f->visitStatements<heart::FunctionCall> ([&] (heart::FunctionCall& call)
+            {
+                if (contains (elementFunctions, std::addressof (call.getFunction())))
+                    call.arguments.push_back (arrayIndex);
+            });
+
+            f->visitExpressions ([&] (pool_ref<heart::Expression>& value, AccessType)
+            {
+                if (auto call = cast<heart::PureFunctionCall> (value))
+                    if (contains (elementFunctions, std::addressof (call->function)))
+                        call->arguments.push_back (arrayIndex);
+            });
+        }
+    }
+
+    static pool_ptr<heart::Variable> getArrayIndexParameter (const Node& node, heart::Function& f)
+    {
+        if (node.numSharedElements > 1)
+            return pool_ptr<heart::Variable> (f.parameters.back());
+
+        return {};
+    }
+
+    void convertToPerElementArray (Node& node, heart::Variable& v)
+    {
+        auto elementType = v.type;
+        pool_ptr<Structure> wrapper;
+
+        // arrays can't contain arrays, so each element's copy of an array variable gets wrapped in a struct
+        if (! elementType.canBeArrayElementType())
+        {
+            wrapper = processor.structs.add (addSuffixToMakeUnique (v.name.toString() + "_element",
+                                                                    [this] (const std::string& nm) { return processor.structs.find (nm) != nullptr; }));
+            wrapper->addMember (elementType, "value");
+            elementType = Type::createStruct (*wrapper);
+            wrappedPerElementArrays.insert (std::addressof (v));
+        }
+
+        v.type = elementType.createArray (node.numSharedElements);
+
+        if (v.initialValue != nullptr)
+            v.initialValue = createPerElementInitialiser (v, wrapper, *v.initialValue);
+
+        BlockBuilder builder (processor);
+
+        for (auto& f : node.module.functions.get())
+        {
+            auto& fn = *node.functions[f];
+            auto& arrayIndex = fn.parameters.back().get();
+
+            fn.visitExpressions ([&] (pool_ref<heart::Expression>& value, AccessType)
+            {
+                if (value.getPointer() == std::addressof (v))
+                    value = getElementState (builder, v, arrayIndex);
+            });
+        }
+    }
+
+    heart::Expression& createPerElementInitialiser (heart::Variable& perElementArray, pool_ptr<Structure> wrapper, heart::Expression& elementValue)
+    {
+        auto numSharedElements = perElementArray.type.getArraySize();
+        auto value = elementValue.getAsConstant();
+
+        if (value.isValid())
+        {
+            if (wrapper != nullptr)
+                value = Value::createStruct (*wrapper, std::vector<Value> { value });
+
+            return BlockBuilder (processor).createConstant (Value::createArrayOrVector (perElementArray.type, std::vector<Value> (numSharedElements, value)));
+        }
+
+        auto& list = processor.allocate<heart::AggregateInitialiserList> (elementValue.location, perElementArray.type);
+
+        for (size_t i = 0; i < numSharedElements; ++i)
+        {
+            if (wrapper != nullptr)
+            {
+                auto& wrapped = processor.allocate<heart::AggregateInitialiserList> (elementValue.location, Type::createStruct (*wrapper));
+                wrapped.items.push_back (elementValue);
+                list.items.push_back (wrapped);
+            }
+            else
+            {
+                list.items.push_back (elementValue);
+            }
+        }
+
+        return list;
+    }
+
+    heart::Expression& getElementState (BlockBuilder& builder, heart::Variable& perElementArray, heart::Expression& arrayIndex)
+    {
+        auto constIndex = arrayIndex.getAsConstant();
+
+        auto& element = constIndex.isValid() ? builder.createFixedArrayElement (perElementArray, (size_t) constIndex.getAsInt64())
+                                            : builder.createTrustedDynamicSubElement (perElementArray, arrayIndex);
+
+        if (wrappedPerElementArrays.find (std::addressof (perElementArray)) != wrappedPerElementArrays.end())
+            return builder.createStructElement (element, "value");
+
+        return element;
+    }
+
+    // Returns the buffer for one of a node's endpoints, as used by the new run() function
+    heart::Expression& getNodeBuffer (BlockBuilder& builder, Node& node, const heart::IODeclaration& io)
+    {
+        return getNodeVariable (builder, node, *node.buffers[std::addressof (io)]);
+    }
+
+    heart::Expression& getNodeVariable (BlockBuilder& builder, Node& node, heart::Variable& v)
+    {
+        if (node.numSharedElements > 1)
+            return getElementState (builder, v, builder.createConstantInt32 (node.arrayIndex));
+
+        return v;
+    }
+
+    //==============================================================================
+    void replaceProcessorProperties (Node& node, heart::Function& f)
+    {
+        auto arrayIndex = getArrayIndexParameter (node, f);
+
+        f.visitExpressions ([&] (pool_ref<heart::Expression>& value, AccessType)
+        {
+            if (auto p = cast<heart::ProcessorProperty> (value))
+                if (auto replacement = getProcessorPropertyValue (node, *p, arrayIndex))
+                    value = *replacement;
+        });
+    }
+
+    pool_ptr<heart::Expression> getProcessorPropertyValue (Node& node, heart::ProcessorProperty& p, pool_ptr<heart::Variable> arrayIndex)
+    {
+        BlockBuilder builder (processor);
+
+        if (p.property == heart::ProcessorProperty::Property::id)
+        {
+            auto& id = builder.createConstantInt32 (program.getModuleID (node.module, node.instance.arraySize) + node.arrayIndex);
+
+            if (arrayIndex != nullptr)
+                return builder.createAdd (id, *arrayIndex);
+
+            return id;
+        }
+
+        if (p.property == heart::ProcessorProperty::Property::latency)
+            return builder.createConstantInt32 (node.module.latency);
+
+        if (! isAtBaseRate (std::addressof (node)))
+        {
+            auto& ratio = builder.createConstant (Value (node.instance.clockMultiplier.getRatio())
+                                                   .castToTypeExpectingSuccess (p.getType()));
+
+            if (p.property == heart::ProcessorProperty::Property::frequency)
+                return builder.createBinaryOp (p.location, p, ratio, BinaryOp::Op::multiply);
+
+            if (p.property == heart::ProcessorProperty::Property::period)
+                return builder.createBinaryOp (p.location, p, ratio, BinaryOp::Op::divide);
+        }
+
+        return {};
+    }
+
+    //==============================================================================
+    void replaceStreamAccesses (Node& node, heart::Function& f)
+    {
+        auto arrayIndex = getArrayIndexParameter (node, f);
+
+        for (auto& b : f.blocks)
+        {
+            std::vector<pool_ref<heart::Statement>> statements;
+            bool anyStreamAccesses = false;
+
+            for (auto s : b->statements)
+            {
+                statements.push_back (*s);
+
+                if (is_type<heart::ReadStream> (*s) || is_type<heart::WriteStream> (*s))
+                    anyStreamAccesses = true;
+            }
+
+            if (! anyStreamAccesses)
+                continue;
+
+            b->statements.clear();
+            BlockBuilder builder (processor, b);
+
+            for (auto& s : statements)
+            {
+                s->nextObject = nullptr;
+
+                if (auto r = cast<heart::ReadStream> (s))
+                {
+                    auto& value = getElement (builder, *node.buffers[r->source.getPointer()], r->element);
+                    builder.addAssignment (*r->target, builder.createCastIfNeeded (value, r->target->getType()));
+                }
+                else if (auto w = cast<heart::WriteStream> (s))
+                {
+                    writeToOutput (builder, node, *w, arrayIndex);
+                }
+                else
+                {
+                    builder.addStatement (s);
+                }
+            }
+        }
+    }
+
+    heart::Expression& getElement (BlockBuilder& builder, heart::Expression& parent, pool_ptr<heart::Expression> index)
+    {
+        if (index == nullptr)
+            return parent;
+
+        auto constIndex = index->getAsConstant();
+
+        if (constIndex.isValid())
+            return builder.createFixedArrayElement (parent, (size_t) constIndex.getAsInt64());
+
+        return builder.createDynamicSubElement (index->location, parent, *index, false, false);
+    }
+
+    heart::Expression& getBufferElement (BlockBuilder& builder, heart::Expression& parent, std::optional<uint32_t> index)
+    {
+        if (index.has_value())
+            return builder.createFixedArrayElement (parent, *index);
+
+        return parent;
+    }
+
+    void writeToOutput (BlockBuilder& builder, Node& node, heart::WriteStream& w, pool_ptr<heart::Variable> arrayIndex)
+    {
+        auto& output = w.target.get();
+
+        if (output.isEventEndpoint())
+        {
+            auto& router = getEventRouter (node, output, w.value->getType(), w.location);
+            heart::FunctionCall::ArgListType args;
+
+            if (output.arraySize.has_value())
+            {
+                if (w.element == nullptr)
+                    w.location.throwError (Errors::notYetImplemented ("Writing an event to all elements of an endpoint array"));
+
+                args.push_back (builder.createCastIfNeeded (*w.element, PrimitiveType::int32));
+            }
+
+            args.push_back (builder.createCastIfNeeded (w.value, router.type));
+
+            if (arrayIndex != nullptr)
+                args.push_back (*arrayIndex);
+
+            builder.addFunctionCall (nullptr, router.function, std::move (args));
+            return;
+        }
+
+        auto& buffer = *node.buffers[std::addressof (output)];
+        auto element = w.element;
+
+        if (output.isValueEndpoint())
+        {
+            auto& target = getElement (builder, buffer, element);
+            builder.addAssignment (target, builder.createCastIfNeeded (w.value, target.getType()));
+            return;
+        }
+
+        // Multiple writes to a stream during the same frame are summed
+        if (element != nullptr && ! (is_type<heart::Variable> (*element) || element->getAsConstant().isValid()))
+            element = builder.createRegisterVariable (*element);
+
+        // A write to the whole of an endpoint array is either an array with a value for
+        // each element, or a single value which goes to all of them
+        if (element == nullptr && buffer.getType().isArray())
+        {
+            auto elementType = buffer.getType().getArrayElementType();
+            bool isWholeArray = w.value->getType().isArray();
+            auto& value = builder.createRegisterVariable (isWholeArray ? w.value.get()
+                                                                       : builder.createCastIfNeeded (w.value, elementType));
+
+            for (uint32_t i = 0; i < buffer.getType().getArraySize(); ++i)
+            {
+                heart::Expression& elementValue = isWholeArray ? builder.createFixedArrayElement (value, i)
+                                                               : static_cast<heart::Expression&> (value);
+
+                builder.addAssignment (builder.createFixedArrayElement (buffer, i),
+                                       builder.createAdd (builder.createFixedArrayElement (buffer, i), elementValue));
+            }
+
+            return;
+        }
+
+        auto& target = getElement (builder, buffer, element);
+        builder.addAssignment (target, builder.createAdd (getElement (builder, buffer, element),
+                                                          builder.createCastIfNeeded (w.value, target.getType())));
+    }
+
+    //==============================================================================
+    static Type findEventType (const heart::IODeclaration& io, const Type& valueType)
+    {
+        for (auto& type : io.dataTypes)
+            if (type.isEqual (valueType, Type::ignoreConst | Type::ignoreReferences | Type::ignoreVectorSize1))
+                return type;
+
+        for (auto& type : io.dataTypes)
+            if (TypeRules::canSilentlyCastTo (type, valueType))
+                return type;
+
+        return {};
+    }
+
+    EventRouter& getEventRouter (Node& node, const heart::IODeclaration& output, const Type& valueType, const CodeLocation& location)
+    {
+        auto type = findEventType (output, valueType);
+
+        if (! type.isValid())
+            location.throwError (Errors::wrongTypeForEndpoint());
+
+        for (auto& r : eventRouters)
+            if (std::addressof (r->node) == std::addressof (node) && std::addressof (r->output) == std::addressof (output)
+                 && r->type.isIdentical (type))
+                return *r;
+
+        auto& fn = FunctionBuilder::createEmptyFunction (processor, getUniqueName (node.prefix + "route_" + output.name.toString()
+                                                                                      + "_" + type.getShortIdentifierDescription()),
+                                                         PrimitiveType::void_);
+
+        if (output.arraySize.has_value())
+            fn.parameters.push_back (BlockBuilder::createVariable (processor, PrimitiveType::int32, "index", heart::Variable::Role::parameter));
+
+        fn.parameters.push_back (BlockBuilder::createVariable (processor, type, "value", heart::Variable::Role::parameter));
+
+        if (node.numSharedElements > 1)
+            fn.parameters.push_back (BlockBuilder::createVariable (processor, PrimitiveType::int32, "arrayIndex", heart::Variable::Role::parameter));
+
+        eventRouters.push_back (std::make_unique<EventRouter> (EventRouter { node, output, type, fn }));
+        return *eventRouters.back();
+    }
+
+    void populateEventRouters()
+    {
+        for (auto& r : eventRouters)
+        {
+            FunctionBuilder::populateFunctionBody (processor, r->function, [&] (FunctionBuilder& builder)
+            {
+                auto& params = r->function.parameters;
+                auto hasIndex = r->output.arraySize.has_value();
+                auto& value = params[hasIndex ? 1 : 0].get();
+                pool_ptr<heart::Expression> key;
+
+                // an event written by one element only goes to that element's destinations, so
+                // the array index and the endpoint element are combined into a single dispatch key
+                if (r->node.numSharedElements > 1 && hasIndex)
+                    key = builder.createRegisterVariable (builder.createAdd (builder.createBinaryOp ({}, params.back(),
+                                                                                                     builder.createConstantInt32 (*r->output.arraySize),
+                                                                                                     BinaryOp::Op::multiply),
+                                                                             params.front()));
+                else if (r->node.numSharedElements > 1)
+                    key = params.back().get();
+                else if (hasIndex)
+                    key = params.front().get();
+
+                dispatchEvent (builder, std::addressof (r->node), r->output, key, value);
+                builder.addReturn();
+            });
+        }
+    }
+
+    Node& getArrayElementNode (const Node& firstElement, uint32_t arrayIndex)
+    {
+        for (auto& n : nodes)
+            if (std::addressof (n->instance) == std::addressof (firstElement.instance) && n->arrayIndex == arrayIndex)
+                return *n;
+
+        SOUL_ASSERT_FALSE;
+        return *nodes.front();
+    }
+
+    void createInputEventHandlers()
+    {
+        for (auto& input : processor.inputs)
+        {
+            if (! input->isEventEndpoint())
+                continue;
+
+            for (auto& type : input->dataTypes)
+            {
+                auto& fn = processor.functions.add (getInputEventHandlerName (input, type), true);
+                fn.hasNoBody = true;
+
+                FunctionBuilder::populateFunctionBody (processor, fn, [&] (FunctionBuilder& builder)
+                {
+                    pool_ptr<heart::Variable> index;
+
+                    if (input->arraySize.has_value())
+                        index = builder.addParameter ("index", PrimitiveType::int32);
+
+                    auto& value = builder.addParameter ("value", type);
+                    dispatchEvent (builder, nullptr, input, index, value);
+                    builder.addReturn();
+                });
+            }
+        }
+    }
+
+    //==============================================================================
+    // An event source is dispatched on a key made from the array index and endpoint element that
+    // the event came from. All the deliveries to the same target (an event handler, which
+    // the elements of a processor array share, or a graph output) where each key has at most
+    // one of them are made with a single call, whose arguments are looked up in constant
+    // tables indexed by the key. Anything that's left over is picked out with a binary search
+    // on the key.
+    struct DispatchTarget
+    {
+        pool_ptr<heart::Function> handler;
+        const heart::IODeclaration* output;
+        std::vector<Route*> routeForKey;
+        bool hasOneRoutePerKey;
+    };
+
+    std::vector<std::vector<Route*>> getRoutesForEachKey (const Node* sourceNode, const heart::IODeclaration& source)
+    {
+        auto numElements = source.arraySize.value_or (1);
+        auto numSharedElements = sourceNode != nullptr ? sourceNode->numSharedElements : 1u;
+        std::vector<std::vector<Route*>> routes (numSharedElements * numElements);
+
+        for (uint32_t arrayIndex = 0; arrayIndex < numSharedElements; ++arrayIndex)
+        {
+            auto node = numSharedElements > 1 ? std::addressof (getArrayElementNode (*sourceNode, arrayIndex)) : sourceNode;
+
+            for (auto& r : eventRoutes)
+            {
+                if (r->source.node == node && r->source.io == std::addressof (source))
+                {
+                    if (! source.arraySize.has_value())
+                        routes[arrayIndex].push_back (r.get());
+                    else if (r->source.element.has_value())
+                        routes[arrayIndex * numElements + *r->source.element].push_back (r.get());
+                }
+            }
+        }
+
+        return routes;
+    }
+
+    void dispatchEvent (FunctionBuilder& builder, const Node* sourceNode, const heart::IODeclaration& source,
+                        pool_ptr<heart::Expression> key, heart::Variable& value)
+    {
+        auto routes = getRoutesForEachKey (sourceNode, source);
+        auto numKeys = (uint32_t) routes.size();
+
+        if (numKeys == 1)
+        {
+            for (auto r : routes.front())
+                deliverEvent (builder, *r, value);
+
+            return;
+        }
+
+        std::vector<DispatchTarget> targets;
+
+        for (uint32_t k = 0; k < numKeys; ++k)
+        {
+            for (auto r : routes[k])
+            {
+                auto handler = r->dest.node != nullptr ? findEventHandler (*r->dest.node, *r->dest.io, value.getType()) : nullptr;
+
+                if (r->dest.node != nullptr && handler == nullptr)
+                    continue;
+
+                auto target = std::find_if (targets.begin(), targets.end(), [&] (const DispatchTarget& t)
+                {
+                    return handler != nullptr ? t.handler == handler : t.output == r->dest.io;
+                });
+
+                if (target == targets.end())
+                {
+                    targets.push_back ({ handler, handler != nullptr ? nullptr : r->dest.io, std::vector<Route*> (numKeys), true });
+                    target = std::prev (targets.end());
+                }
+
+                if (target->routeForKey[k] != nullptr)
+                    target->hasOneRoutePerKey = false;
+                else
+                    target->routeForKey[k] = r;
+            }
+        }
+
+        std::vector<std::vector<Route*>> remainingRoutes (numKeys);
+
+        for (auto& target : targets)
+        {
+            if (target.hasOneRoutePerKey)
+            {
+                dispatchToTarget (builder, target, *key, value);
+                continue;
+            }
+
+            for (uint32_t k = 0; k < numKeys; ++k)
+                for (auto r : routes[k])
+                    if (r->dest.node != nullptr ? findEventHandler (*r->dest.node, *r->dest.io, value.getType()) == target.handler
+                                                : r->dest.io == target.output)
+                        remainingRoutes[k].push_back (r);
+        }
+
+        std::vector<uint32_t> keysToSearch;
+
+        for (uint32_t k = 0; k < numKeys; ++k)
+            if (! remainingRoutes[k].empty())
+                keysToSearch.push_back (k);
+
+        dispatchBySearch (builder, *key, keysToSearch, remainingRoutes, value);
+    }
+
+    void dispatchToTarget (FunctionBuilder& builder, const DispatchTarget& target, heart::Expression& key, heart::Variable& value)
+    {
+        auto numKeys = (uint32_t) target.routeForKey.size();
+        auto firstRoute = *std::find_if (target.routeForKey.begin(), target.routeForKey.end(), [] (Route* r) { return r != nullptr; });
+        auto& dest = firstRoute->dest;
+        auto isForEveryKey = ! contains (target.routeForKey, nullptr);
+
+        auto getArgument = [&] (const std::string& name, const std::function<uint32_t(const Route&)>& getValue) -> heart::Expression&
+        {
+            std::vector<int32_t> values;
+            bool isIdentity = true, isConstant = true;
+
+            for (uint32_t k = 0; k < numKeys; ++k)
+            {
+                auto r = target.routeForKey[k];
+                values.push_back (r != nullptr ? (int32_t) getValue (*r) : 0);
+
+                if (r != nullptr)
+                {
+                    isIdentity = isIdentity && values.back() == (int32_t) k;
+                    isConstant = isConstant && values.back() == (int32_t) getValue (*firstRoute);
+                }
+            }
+
+            if (isConstant)
+                return builder.createConstantInt32 (getValue (*firstRoute));
+
+            if (isIdentity)
+                return key;
+
+            return builder.createTrustedDynamicSubElement (getDispatchTable (name, values), key);
+        };
+
+        auto addCall = [&] (FunctionBuilder& b)
+        {
+            if (dest.node == nullptr)
+            {
+                pool_ptr<heart::Expression> element;
+
+                if (dest.element.has_value())
+                    element = getArgument ("element", [] (const Route& r) { return *r.dest.element; });
+
+                deliverEventToOutput (b, *firstRoute, element, value);
+                return;
+            }
+
+            pool_ptr<heart::Expression> element, arrayIndex;
+
+            if (dest.io->arraySize.has_value())
+                element = getArgument ("element", [] (const Route& r) { return r.dest.element.value_or (0); });
+
+            if (dest.node->numSharedElements > 1)
+                arrayIndex = getArgument ("arrayIndex", [] (const Route& r) { return r.dest.node->arrayIndex; });
+
+            deliverEventToHandler (b, *dest.node, *target.handler, element, arrayIndex, value);
+        };
+
+        if (isForEveryKey)
+            return addCall (builder);
+
+        std::vector<int32_t> hasRoute;
+
+        for (auto r : target.routeForKey)
+            hasRoute.push_back (r != nullptr ? 1 : 0);
+
+        builder.createIfElse ("@event_" + std::to_string (nextBlockIndex++),
+                              builder.createComparisonOp (builder.createTrustedDynamicSubElement (getDispatchTable ("targets", hasRoute), key),
+                                                          builder.createConstantInt32 (0), BinaryOp::Op::notEquals),
+                              addCall, [] (FunctionBuilder&) {});
+    }
+
+    void dispatchBySearch (FunctionBuilder& builder, heart::Expression& key, ArrayView<uint32_t> keys,
+                           const std::vector<std::vector<Route*>>& routes, heart::Variable& value)
+    {
+        if (keys.empty())
+            return;
+
+        if (keys.size() == 1)
+        {
+            builder.createIfElse ("@event_" + std::to_string (nextBlockIndex++),
+                                  builder.createEqualsOp (key, builder.createConstantInt32 (keys.front())),
+                                  [&] (FunctionBuilder& b)  { for (auto r : routes[keys.front()]) deliverEvent (b, *r, value); },
+                                  [] (FunctionBuilder&) {});
+            return;
+        }
+
+        auto mid = keys.size() / 2;
+
+        builder.createIfElse ("@event_" + std::to_string (nextBlockIndex++),
+                              builder.createComparisonOp (key, builder.createConstantInt32 (keys[mid]), BinaryOp::Op::lessThan),
+                              [&] (FunctionBuilder& b)  { dispatchBySearch (b, key, { keys.data(), keys.data() + mid }, routes, value); },
+                              [&] (FunctionBuilder& b)  { dispatchBySearch (b, key, { keys.data() + mid, keys.end() }, routes, value); });
+    }
+
+    heart::Variable& getDispatchTable (const std::string& name, const std::vector<int32_t>& values)
+    {
+        std::vector<Value> elements;
+
+        for (auto v : values)
+            elements.push_back (Value::createInt32 (v));
+
+        auto type = Type (PrimitiveType::int32).createArray (values.size());
+        auto& table = addStateVariable ("dispatch_" + name, type);
+        table.initialValue = BlockBuilder (processor).createConstant (Value::createArrayOrVector (type, elements));
+        return table;
+    }
+
+    void deliverEvent (FunctionBuilder& builder, Route& route, heart::Variable& value)
+    {
+        auto& dest = route.dest;
+
+        if (dest.node == nullptr)
+        {
+            pool_ptr<heart::Expression> element;
+
+            if (dest.element.has_value())
+                element = builder.createConstantInt32 (*dest.element);
+
+            return deliverEventToOutput (builder, route, element, value);
+        }
+
+        // Events of a type that the destination has no handler for are ignored
+        if (auto handler = findEventHandler (*dest.node, *dest.io, value.getType()))
+        {
+            pool_ptr<heart::Expression> element, arrayIndex;
+
+            if (dest.io->arraySize.has_value())
+                element = builder.createConstantInt32 (dest.element.value_or (0));
+
+            if (dest.node->numSharedElements > 1)
+                arrayIndex = builder.createConstantInt32 (dest.node->arrayIndex);
+
+            deliverEventToHandler (builder, *dest.node, *handler, element, arrayIndex, value);
+        }
+    }
+
+    void deliverEventToOutput (FunctionBuilder& builder, Route& route, pool_ptr<heart::Expression> element, heart::Variable& value)
+    {
+        auto& output = static_cast<heart::OutputDeclaration&> (*route.dest.io);
+        auto type = findEventType (output, value.getType());
+
+        if (! type.isValid())
+            route.connection.location.throwError (Errors::wrongTypeForEndpoint());
+
+        builder.addWriteStream ({}, output, element, builder.createCastIfNeeded (value, type));
+    }
+
+    void deliverEventToHandler (FunctionBuilder& builder, Node& node, heart::Function& handler, pool_ptr<heart::Expression> element,
+                                pool_ptr<heart::Expression> arrayIndex, heart::Variable& value)
+    {
+        heart::FunctionCall::ArgListType args;
+
+        if (element != nullptr)
+            args.push_back (builder.createCastIfNeeded (*element, handler.parameters.front()->getType()));
+
+        args.push_back (builder.createCastIfNeeded (value, handler.parameters[element != nullptr ? 1 : 0]->getType()));
+
+        if (arrayIndex != nullptr)
+            args.push_back (*arrayIndex);
+
+        builder.addFunctionCall (nullptr, handler, std::move (args));
+
+        // an event wakes a quiescent node up
+        if (auto framesSinceActivity = node.framesSinceActivity)
+            builder.addZeroAssignment (arrayIndex != nullptr ? getElementState (builder, *framesSinceActivity, *arrayIndex)
+                                                       : *framesSinceActivity);
+    }
+
+    pool_ptr<heart::Function> findEventHandler (Node& node, const heart::IODeclaration& input, const Type& valueType)
+    {
+        auto numParams = input.arraySize.has_value() ? 2u : 1u;
+
+        for (int exactMatch = 1; exactMatch >= 0; --exactMatch)
+        {
+            for (auto& f : node.module.functions.get())
+            {
+                if (f->functionType.isEvent() && f->parameters.size() == numParams
+                     && f->name == heart::getEventFunctionName (input.name, f->parameters.front()->getType()))
+                {
+                    auto paramType = f->parameters.back()->getType().withConstAndRefFlags (false, false);
+
+                    if (exactMatch ? paramType.isEqual (valueType, Type::ignoreConst | Type::ignoreReferences | Type::ignoreVectorSize1)
+                                   : TypeRules::canSilentlyCastTo (paramType, valueType))
+                        return node.functions[f];
+                }
+            }
+        }
+
+        return {};
+    }
+
+    //==============================================================================
+    // The run() function becomes a function which performs a single frame of work and
+    // then returns. Each advance is replaced by a return, and a state variable records
+    // which block must be jumped to when the function is next called.
+    void convertRunFunctionToStepFunction (Node& node, heart::Function& f)
+    {
+        auto& resumePoint = addStateVariable (node.prefix + "resumePoint", PrimitiveType::int32);
+
+        for (auto& b : f.blocks)
+        {
+            if (b->terminator->isReturn())
+            {
+                BlockBuilder builder (processor, b);
+                builder.addAssignment (resumePoint, builder.createConstantInt32 (-1));
+            }
+        }
+
+        std::vector<pool_ref<heart::Block>> resumeBlocks;
+
+        for (size_t i = 0; i < f.blocks.size(); ++i)
+        {
+            auto& block = f.blocks[i].get();
+            LinkedList<heart::Statement>::Iterator previous;
+
+            for (auto s : block.statements)
+            {
+                if (is_type<heart::AdvanceClock> (*s))
+                {
+                    auto resumeIndex = (int32_t) resumeBlocks.size() + 1;
+                    resumeBlocks.push_back (heart::Utilities::splitBlock (processor, f, i, s,
+                                                                          getUniqueBlockName (f, "@resume_" + std::to_string (resumeIndex))));
+                    block.statements.removeNext (previous);
+
+                    BlockBuilder builder (processor, block);
+                    builder.addAssignment (resumePoint, builder.createConstantInt32 (resumeIndex));
+                    builder.setReturnTerminator();
+                    break;
+                }
+
+                previous = s;
+            }
+        }
+
+        std::vector<pool_ref<heart::Block>> dispatchBlocks;
+
+        for (size_t i = 0; i < resumeBlocks.size(); ++i)
+            dispatchBlocks.push_back (processor.allocate<heart::Block> (processor.allocator.get (getUniqueBlockName (f, "@dispatch_" + std::to_string (i + 1)))));
+
+        auto& startBlock    = processor.allocate<heart::Block> (processor.allocator.get (getUniqueBlockName (f, "@start")));
+        auto& finishedBlock = processor.allocate<heart::Block> (processor.allocator.get (getUniqueBlockName (f, "@finished")));
+        auto& entryBlock    = f.blocks.front().get();
+
+        for (size_t i = 0; i < dispatchBlocks.size(); ++i)
+        {
+            BlockBuilder builder (processor, dispatchBlocks[i]);
+            builder.setBranchIfTerminator (builder.createEqualsOp (resumePoint, builder.createConstantInt32 (i + 1)),
+                                           resumeBlocks[i], i + 1 < dispatchBlocks.size() ? dispatchBlocks[i + 1].get() : startBlock);
+        }
+
+        BlockBuilder startBuilder (processor, startBlock);
+        startBuilder.setBranchIfTerminator (startBuilder.createEqualsOp (resumePoint, startBuilder.createConstantInt32 (0)),
+                                            entryBlock, finishedBlock);
+
+        BlockBuilder (processor, finishedBlock).setReturnTerminator();
+
+        dispatchBlocks.push_back (startBlock);
+        dispatchBlocks.push_back (finishedBlock);
+        f.blocks.insert (f.blocks.begin(), dispatchBlocks.begin(), dispatchBlocks.end());
+        f.blocks.front()->doNotOptimiseAway = true;
+
+        for (auto v : findVariablesLiveAcrossResumePoints (f, resumeBlocks))
+        {
+            // the array index parameter gets passed in again on every call
+            if (std::any_of (f.parameters.begin(), f.parameters.end(), [v] (const pool_ref<heart::Variable>& p) { return p.getPointer() == v; }))
+                continue;
+
+            if (v->isParameter())
+                removeBlockParameters (f, *v);
+
+            v->role = heart::Variable::Role::state;
+            v->type = v->type.removeConstIfPresent();
+            v->name = processor.allocator.get (getUniqueName (node.prefix + (v->name.isValid() ? v->name.toString() : std::string ("temp"))));
+            processor.stateVariables.add (*v);
+        }
+    }
+
+    static std::string getUniqueBlockName (const heart::Function& f, const std::string& name)
+    {
+        return addSuffixToMakeUnique (name, [&] (const std::string& nm) { return heart::Utilities::findBlock (f, nm) != nullptr; });
+    }
+
+    struct BlockLiveness
+    {
+        std::unordered_set<heart::Variable*> uses, defs, liveIn;
+    };
+
+    static bool isLocal (const heart::Variable& v)
+    {
+        return v.isFunctionLocal() || v.isParameter();
+    }
+
+    static std::vector<heart::Variable*> findVariablesLiveAcrossResumePoints (heart::Function& f, ArrayView<pool_ref<heart::Block>> resumeBlocks)
+    {
+        std::unordered_map<const heart::Block*, BlockLiveness> liveness;
+
+        for (auto& b : f.blocks)
+        {
+            auto& l = liveness[b.getPointer()];
+
+            for (auto& p : b->parameters)
+                l.defs.insert (p.getPointer());
+
+            auto addUse = [&] (pool_ref<heart::Expression>& e, pool_ptr<heart::Variable> fullTarget, AccessType mode)
+            {
+                if (auto v = cast<heart::Variable> (e))
+                    if (isLocal (*v) && ! (v == fullTarget && mode == AccessType::write) && l.defs.find (v.get()) == l.defs.end())
+                        l.uses.insert (v.get());
+            };
+
+            for (auto s : b->statements)
+            {
+                pool_ptr<heart::Variable> fullTarget;
+
+                if (auto a = cast<heart::Assignment> (*s))
+                    fullTarget = cast<heart::Variable> (a->target);
+
+                s->visitExpressions ([&] (pool_ref<heart::Expression>& e, AccessType mode) { addUse (e, fullTarget, mode); });
+
+                if (fullTarget != nullptr && isLocal (*fullTarget))
+                    l.defs.insert (fullTarget.get());
+            }
+
+            b->terminator->visitExpressions ([&] (pool_ref<heart::Expression>& e, AccessType mode) { addUse (e, {}, mode); });
+        }
+
+        for (bool anyChanged = true; anyChanged;)
+        {
+            anyChanged = false;
+
+            for (auto b = f.blocks.rbegin(); b != f.blocks.rend(); ++b)
+            {
+                auto& l = liveness[b->getPointer()];
+                auto liveIn = l.uses;
+
+                for (auto dest : (*b)->terminator->getDestinationBlocks())
+                    for (auto v : liveness[dest.getPointer()].liveIn)
+                        if (l.defs.find (v) == l.defs.end())
+                            liveIn.insert (v);
+
+                if (liveIn.size() != l.liveIn.size())
+                {
+                    l.liveIn = std::move (liveIn);
+                    anyChanged = true;
+                }
+            }
+        }
+
+        std::unordered_set<heart::Variable*> live;
+
+        for (auto& b : resumeBlocks)
+            for (auto v : liveness[b.getPointer()].liveIn)
+                live.insert (v);
+
+        // return these in a repeatable order
+        std::vector<heart::Variable*> result;
+
+        auto addIfLive = [&] (heart::Variable& v)
+        {
+            if (live.find (std::addressof (v)) != live.end() && ! contains (result, std::addressof (v)))
+                result.push_back (std::addressof (v));
+        };
+
+        for (auto& b : f.blocks)
+        {
+            for (auto& p : b->parameters)
+                addIfLive (p);
+
+            b->visitExpressions ([&] (pool_ref<heart::Expression>& e, AccessType)
+            {
+                if (auto v = cast<heart::Variable> (e))
+                    addIfLive (*v);
+            });
+        }
+
+        return result;
+    }
+
+    // Replaces a block's parameters with variables which its predecessors assign
+    void removeBlockParameters (heart::Function& f, heart::Variable& param)
+    {
+        f.rebuildBlockPredecessors();
+
+        for (auto& b : f.blocks)
+        {
+            if (! contains (b->parameters, param))
+                continue;
+
+            for (auto& pred : b->predecessors)
+            {
+                auto branch = cast<heart::Branch> (pred->terminator);
+                SOUL_ASSERT (branch != nullptr && branch->targetArgs.size() == b->parameters.size());
+
+                BlockBuilder builder (processor, pred);
+                std::vector<pool_ref<heart::Variable>> values;
+
+                for (auto& arg : branch->targetArgs)
+                    values.push_back (builder.createRegisterVariable (arg));
+
+                for (size_t i = 0; i < values.size(); ++i)
+                    builder.addAssignment (b->parameters[i], values[i]);
+
+                branch->targetArgs.clear();
+            }
+
+            for (auto& p : b->parameters)
+                p->role = heart::Variable::Role::mutableLocal;
+
+            b->parameters.clear();
+            return;
+        }
+    }
+
+    //==============================================================================
+    void createRoutes()
+    {
+        for (auto& c : graph.connections)
+        {
+            auto sources = getEndpointRefs (c->source, true);
+            auto dests   = getEndpointRefs (c->dest, false);
+
+            if (sources.size() != dests.size() && sources.size() != 1 && dests.size() != 1)
+                c->location.throwError (Errors::notYetImplemented ("Connections between arrays of different sizes"));
+
+            auto numRoutes = std::max (sources.size(), dests.size());
+
+            for (size_t i = 0; i < numRoutes; ++i)
+                addRoute (c, sources[sources.size() == 1 ? 0 : i], dests[dests.size() == 1 ? 0 : i]);
+        }
+
+        createDelayLineBuffers();
+    }
+
+    std::vector<EndpointRef> getEndpointRefs (const heart::EndpointReference& endpoint, bool isSource)
+    {
+        std::vector<EndpointRef> refs;
+
+        auto addRefs = [&] (Node* node, heart::IODeclaration& io)
+        {
+            if (io.arraySize.has_value() && ! endpoint.endpointIndex.has_value())
+            {
+                for (uint32_t i = 0; i < *io.arraySize; ++i)
+                    refs.push_back ({ node, std::addressof (io), i });
+            }
+            else if (io.arraySize.has_value())
+            {
+                refs.push_back ({ node, std::addressof (io), (uint32_t) *endpoint.endpointIndex });
+            }
+            else
+            {
+                refs.push_back ({ node, std::addressof (io), {} });
+            }
+        };
+
+        // A connection's source is either a graph input or a node's output, and its
+        // destination is either a graph output or a node's input
+        auto findEndpoint = [&] (Module& m, bool isInput) -> heart::IODeclaration&
+        {
+            if (isInput)
+                return *m.findInput (endpoint.endpointName);
+
+            return *m.findOutput (endpoint.endpointName);
+        };
+
+        if (endpoint.processor == nullptr)
+        {
+            addRefs (nullptr, findEndpoint (processor, isSource));
+        }
+        else
+        {
+            for (auto& n : nodes)
+                if (std::addressof (n->instance) == endpoint.processor.get())
+                    addRefs (n.get(), findEndpoint (n->module, ! isSource));
+        }
+
+        return refs;
+    }
+
+    void addRoute (const heart::Connection& connection, EndpointRef source, EndpointRef dest)
+    {
+        auto route = std::make_unique<Route> (source, dest, connection);
+
+        if (source.io->isEventEndpoint())
+        {
+            if (connection.delayLength.has_value())
+                connection.location.throwError (Errors::notYetImplemented ("Delays on event connections"));
+
+            eventRoutes.push_back (std::move (route));
+            return;
+        }
+
+        auto srcAtBaseRate = isAtBaseRate (source.node);
+        auto dstAtBaseRate = isAtBaseRate (dest.node);
+        auto elementType = cloneType (source.io->dataTypes.front());
+        auto canInterpolate = source.io->isStreamEndpoint() && dest.io->isStreamEndpoint()
+                                && ResamplerKernel::canInterpolate (elementType);
+        auto interpolationType = connection.interpolationType;
+
+        auto routeName = (dest.node != nullptr ? dest.node->prefix : std::string ("output_")) + dest.io->name.toString()
+                           + (dest.element.has_value() ? "_" + std::to_string (*dest.element) : std::string()) + "_";
+
+        auto isStream = source.io->isStreamEndpoint() && dest.io->isStreamEndpoint();
+        auto isUndelayed = ! connection.delayLength.has_value();
+
+        if (! (srcAtBaseRate || dstAtBaseRate) && isUndelayed
+             && source.node->multiplier == dest.node->multiplier && source.node->divider == dest.node->divider
+             && source.node->multiplier == 1)
+        {
+            // nodes with the same clock divider are stepped on the same frames, so can share values directly
+        }
+        else if (! (srcAtBaseRate || dstAtBaseRate) && isUndelayed && isStream
+                  && source.node->multiplier > 1 && dest.node->multiplier > 1
+                  && (source.node->multiplier == dest.node->multiplier || ! ResamplerKernel::isFilter (interpolationType))
+                  && (source.node->multiplier % dest.node->multiplier == 0 || dest.node->multiplier % source.node->multiplier == 0))
+        {
+            route->block = addStateVariable (routeName + "block", elementType.createArray ((Type::ArraySize) source.node->multiplier + 1));
+            route->interpolateBlock = canInterpolate && interpolationType != InterpolationType::latch;
+        }
+        else
+        {
+            // Any other combination of rates gets converted to the base rate and back again
+            auto useFilter = canInterpolate && ResamplerKernel::isFilter (interpolationType);
+
+            if (! srcAtBaseRate && useFilter)
+            {
+                route->resampled = addStateVariable (routeName + "resampled", elementType);
+
+                if (source.node->multiplier > 1)
+                    route->sourceFilter = createFilterHistory (routeName + "sourceHistory", elementType, interpolationType, true, source.node->multiplier);
+                else
+                    route->sourceFilter = createFilterHistory (routeName + "sourceHistory", elementType, interpolationType, false, source.node->divider);
+            }
+            else if (! srcAtBaseRate && canInterpolate && shouldInterpolateLinearly (interpolationType, false))
+            {
+                route->resampled = addStateVariable (routeName + "resampled", elementType);
+
+                if (source.node->multiplier > 1)
+                {
+                    route->sourceAccumulator = addStateVariable (routeName + "sourceAccumulator", elementType);
+                }
+                else
+                {
+                    route->rampStart = addStateVariable (routeName + "rampStart", elementType);
+                    route->rampEnd   = addStateVariable (routeName + "rampEnd", elementType);
+                }
+            }
+
+            if (! dstAtBaseRate && useFilter)
+            {
+                if (dest.node->multiplier > 1)
+                    route->destFilter = createFilterHistory (routeName + "destHistory", elementType, interpolationType, false, dest.node->multiplier);
+                else
+                    route->destFilter = createFilterHistory (routeName + "destHistory", elementType, interpolationType, true, dest.node->divider);
+            }
+            else if (! dstAtBaseRate && canInterpolate && shouldInterpolateLinearly (interpolationType, dest.node->divider > 1))
+            {
+                if (dest.node->multiplier > 1)
+                    route->previous = addStateVariable (routeName + "previous", elementType);
+                else
+                    route->destAccumulator = addStateVariable (routeName + "destAccumulator", elementType);
+            }
+        }
+
+        if (connection.delayLength.has_value())
+        {
+            route->delayLength = (uint32_t) *connection.delayLength;
+            route->delayLine = std::addressof (getDelayLine (*route));
+            route->delayLine->maxLength = std::max (route->delayLine->maxLength, route->delayLength);
+        }
+        else if (source.node != nullptr && dest.node != nullptr && source.node != dest.node)
+        {
+            dest.node->sources.push_back (source.node);
+        }
+
+        if (source.node != nullptr)  source.node->outputRoutes.push_back (route.get());
+        if (dest.node != nullptr)    dest.node->inputRoutes.push_back (route.get());
+
+        streamRoutes.push_back (std::move (route));
+    }
+
+    // Routes can share a delay line if they delay the same value, which means that they
+    // come from the same source and it doesn't get resampled separately for each of them
+    DelayLine& getDelayLine (Route& route)
+    {
+        if (route.resampled == nullptr)
+            for (auto& d : delayLines)
+                if (d->writer.resampled == nullptr && isSameEndpoint (d->writer.source, route.source))
+                    return *d;
+
+        auto& source = route.source;
+        auto name = (source.node != nullptr ? source.node->prefix : std::string ("input_")) + source.io->name.toString()
+                      + (source.element.has_value() ? "_" + std::to_string (*source.element) : std::string()) + "_";
+
+        if (route.resampled != nullptr)
+            name = route.resampled->name.toString() + "_";
+
+        delayLines.push_back (std::make_unique<DelayLine> (DelayLine { route, name, 0, {}, {} }));
+        return *delayLines.back();
+    }
+
+    static bool isSameEndpoint (const EndpointRef& a, const EndpointRef& b)
+    {
+        return a.node == b.node && a.io == b.io && a.element == b.element;
+    }
+
+    void createDelayLineBuffers()
+    {
+        for (auto& d : delayLines)
+        {
+            uint32_t size = 1;
+
+            while (size < d->maxLength)
+                size *= 2;
+
+            auto elementType = cloneType (d->writer.source.io->dataTypes.front());
+
+            d->buffer   = addStateVariable (d->name + "delay", elementType.createArray (size));
+            d->position = addStateVariable (d->name + "delayPos", PrimitiveType::int32);
+        }
+    }
+
+    static bool shouldInterpolateLinearly (InterpolationType type, bool isIntoDividedNode)
+    {
+        if (type == InterpolationType::none)
+            return ! isIntoDividedNode;
+
+        return type == InterpolationType::linear;
+    }
+
+    // A filter which decimates needs the last (factor * taps) values at the higher rate,
+    // and one which interpolates needs the last few values at the lower rate
+    std::unique_ptr<FilterHistory> createFilterHistory (const std::string& name, const Type& elementType,
+                                                        InterpolationType interpolationType, bool isDecimation, int64_t factor)
+    {
+        auto length = ResamplerKernel::getNumTapsPerPhase (interpolationType);
+
+        if (isDecimation)
+            length *= (uint32_t) factor;
+
+        return std::make_unique<FilterHistory> (FilterHistory { addStateVariable (name, elementType.createArray (2 * length)),
+                                                                addStateVariable (name + "Pos", PrimitiveType::int32),
+                                                                getKernelTable (interpolationType, isDecimation, (uint32_t) factor,
+                                                                                getScalarType (elementType)),
+                                                                length });
+    }
+
+    // Routes which use the same kernel at the same precision share a single table of coefficients
+    heart::Variable& getKernelTable (InterpolationType interpolationType, bool isDecimation, uint32_t factor, const Type& type)
+    {
+        for (auto& k : kernelTables)
+            if (k.interpolationType == interpolationType && k.isDecimation == isDecimation
+                 && k.factor == factor && k.type.isIdentical (type))
+                return k.coefficients;
+
+        auto coefficients = isDecimation ? ResamplerKernel::createDecimationTable (interpolationType, factor)
+                                         : ResamplerKernel::createInterpolationTable (interpolationType, factor);
+
+        std::vector<Value> values;
+        values.reserve (coefficients.size());
+
+        for (auto c : coefficients)
+            values.push_back (Value (c).castToTypeExpectingSuccess (type));
+
+        auto tableType = type.createArray (coefficients.size());
+        auto& table = addStateVariable (std::string ("resampler_") + getInterpolationDescription (interpolationType)
+                                          + (isDecimation ? "_decimate_" : "_interpolate_") + std::to_string (factor),
+                                        tableType);
+        table.initialValue = BlockBuilder (processor).createConstant (Value::createArrayOrVector (tableType, values));
+
+        kernelTables.push_back ({ interpolationType, isDecimation, factor, type, table });
+        return table;
+    }
+
+    void calculateExecutionOrder()
+    {
+        for (auto& n : nodes)
+            addToExecutionOrder (*n);
+    }
+
+    void addToExecutionOrder (Node& node)
+    {
+        if (node.isOrdered)
+            return;
+
+        node.isOrdered = true;
+
+        for (auto source : node.sources)
+            addToExecutionOrder (*source);
+
+        executionOrder.push_back (std::addressof (node));
+    }
+
+    //==============================================================================
+    // A stream connection between two base-rate nodes, where neither end has any other
+    // connections, doesn't need a buffer of its own: the destination can read the value
+    // that the source wrote, and once both nodes' step functions have been inlined into
+    // run(), that variable only needs to live for the duration of a frame.
+    void fuseStreamChains()
+    {
+        for (auto& r : streamRoutes)
+        {
+            if (! canBeFused (*r))
+                continue;
+
+            auto& sourceBuffer = *r->source.node->buffers[r->source.io];
+            auto& destBuffer   = *r->dest.node->buffers[r->dest.io];
+
+            for (auto& f : processor.functions.get())
+                replaceVariable (f, destBuffer, sourceBuffer);
+
+            processor.stateVariables.remove (destBuffer);
+            r->dest.node->buffers[r->dest.io] = sourceBuffer;
+            r->fused = true;
+            ++numFusedConnections;
+        }
+
+        if (numFusedConnections != 0 && CompileProfiler::getCurrent() != nullptr)
+            CompileProfiler::addInstantEvent (graph.fullName, "fusion", { { "fusedConnections", (int64_t) numFusedConnections } });
+    }
+
+    bool canBeFused (const Route& r) const
+    {
+        auto source = r.source.node;
+        auto dest = r.dest.node;
+
+        return source != nullptr && dest != nullptr && source != dest
+                && source->numSharedElements == 1 && dest->numSharedElements == 1
+                && source->step != nullptr && dest->step != nullptr
+                && isAtBaseRate (source) && isAtBaseRate (dest)
+                && r.delayLine == nullptr
+                && ! (r.source.element.has_value() || r.dest.element.has_value())
+                && r.source.io->isStreamEndpoint() && r.dest.io->isStreamEndpoint()
+                && source->buffers.at (r.source.io)->type.isIdentical (dest->buffers.at (r.dest.io)->type)
+                && countRoutes (r.source, true) == 1 && countRoutes (r.dest, false) == 1;
+    }
+
+    size_t countRoutes (const EndpointRef& e, bool isSource) const
+    {
+        size_t num = 0;
+
+        for (auto& r : streamRoutes)
+        {
+            auto& end = isSource ? r->source : r->dest;
+
+            if (end.node == e.node && end.io == e.io)
+                ++num;
+        }
+
+        return num;
+    }
+
+    static void replaceVariable (heart::Function& f, heart::Variable& oldVariable, heart::Variable& newVariable)
+    {
+        f.visitExpressions ([&] (pool_ref<heart::Expression>& value, AccessType)
+        {
+            if (value.getPointer() == std::addressof (oldVariable))
+                value = newVariable;
+        });
+    }
+
+    // Once the nodes at both ends of a fused connection have been inlined, the variable
+    // that carries its value is written and read within a single frame of run(), so it
+    // can stop being part of the processor's state.
+    void inlineFusedNodes()
+    {
+        std::vector<Node*> nodesToInline;
+
+        for (auto& r : streamRoutes)
+        {
+            if (r->fused)
+            {
+                appendIfNotPresent (nodesToInline, r->source.node);
+                appendIfNotPresent (nodesToInline, r->dest.node);
+            }
+        }
+
+        std::vector<Node*> inlinedNodes;
+
+        for (auto node : nodesToInline)
+        {
+            if (Optimisations::inlineAllCallsToFunction (program, *node->step))
+            {
+                node->step = nullptr;
+                inlinedNodes.push_back (node);
+            }
+        }
+
+        for (auto& r : streamRoutes)
+        {
+            if (r->fused && contains (inlinedNodes, r->source.node) && contains (inlinedNodes, r->dest.node))
+            {
+                auto& buffer = *r->source.node->buffers[r->source.io];
+                processor.stateVariables.remove (buffer);
+                buffer.role = heart::Variable::Role::mutableLocal;
+            }
+        }
+    }
+
+    //==============================================================================
+    // Most of the buffers that carry streams between base-rate nodes are written and then
+    // read within a single frame, so buffers whose lifetimes don't overlap can share the
+    // same variable. A frame is divided into positions: the graph's inputs are read at 0,
+    // node n in the execution order has its inputs written at 2n and is stepped at 2n + 1,
+    // and after the nodes come the graph's outputs and then the delay line updates.
+    void planBufferMemory()
+    {
+        auto graphOutputPosition = 2 * (uint32_t) executionOrder.size() + 2;
+        auto delayLinePosition = graphOutputPosition + 1;
+
+        std::vector<BufferLifetime> lifetimes;
+        std::vector<const heart::Variable*> writtenBuffers;
+
+        auto addUse = [&] (heart::Variable& buffer, uint32_t position, bool canBeShared)
+        {
+            for (auto& l : lifetimes)
+            {
+                if (l.buffer == std::addressof (buffer))
+                {
+                    l.start = std::min (l.start, position);
+                    l.end = std::max (l.end, position);
+                    l.canBeShared = l.canBeShared && canBeShared;
+                    return;
+                }
+            }
+
+            lifetimes.push_back ({ std::addressof (buffer), position, position, canBeShared });
+        };
+
+        auto getPosition = [this] (const Node& node)
+        {
+            return 2 * (uint32_t) (1 + std::distance (executionOrder.begin(),
+                                                      std::find (executionOrder.begin(), executionOrder.end(), std::addressof (node))));
+        };
+
+        for (auto& input : processor.inputs)
+        {
+            if (! input->isEventEndpoint())
+            {
+                auto& buffer = *graphBuffers[input.getPointer()];
+                addUse (buffer, 0, input->isStreamEndpoint());
+                writtenBuffers.push_back (std::addressof (buffer));
+            }
+        }
+
+        for (auto node : executionOrder)
+        {
+            // nodes that aren't stepped every frame keep their values between frames, and
+            // the buffers of a processor array are indexed by the array index
+            auto isSteppedEveryFrame = isAtBaseRate (node) && node->step != nullptr && node->numSharedElements == 1;
+            auto position = getPosition (*node);
+
+            for (auto& input : node->module.inputs)
+            {
+                if (! input->isEventEndpoint())
+                {
+                    addUse (*node->buffers[input.getPointer()], position, isSteppedEveryFrame && input->isStreamEndpoint());
+                    addUse (*node->buffers[input.getPointer()], position + 1, true);
+                }
+            }
+
+            for (auto& output : node->module.outputs)
+            {
+                if (! output->isEventEndpoint())
+                {
+                    auto& buffer = *node->buffers[output.getPointer()];
+                    addUse (buffer, position + 1, isSteppedEveryFrame && output->isStreamEndpoint());
+                    writtenBuffers.push_back (std::addressof (buffer));
+                }
+            }
+        }
+
+        for (auto& output : processor.outputs)
+            if (! output->isEventEndpoint())
+                addUse (*graphBuffers[output.getPointer()], graphOutputPosition, output->isStreamEndpoint());
+
+        for (auto& r : streamRoutes)
+        {
+            auto& source = r->source.node != nullptr ? *r->source.node->buffers[r->source.io] : *graphBuffers[r->source.io];
+            auto& dest   = r->dest.node != nullptr   ? *r->dest.node->buffers[r->dest.io]     : *graphBuffers[r->dest.io];
+
+            auto writePosition = r->dest.node != nullptr ? getPosition (*r->dest.node) : graphOutputPosition;
+
+            // a delayed source gets read when the delay lines are updated at the end of the frame
+            addUse (source, r->delayLine != nullptr ? delayLinePosition : writePosition, ! r->fused);
+            addUse (dest, writePosition, ! (r->fused || r->dest.element.has_value()));
+            writtenBuffers.push_back (std::addressof (dest));
+        }
+
+        // a buffer that nothing writes to has to keep its initial value
+        for (auto& l : lifetimes)
+            if (! contains (writtenBuffers, l.buffer))
+                l.canBeShared = false;
+
+        removeIf (lifetimes, [] (const BufferLifetime& l) { return ! l.canBeShared; });
+
+        std::stable_sort (lifetimes.begin(), lifetimes.end(),
+                          [] (const BufferLifetime& a, const BufferLifetime& b) { return a.start < b.start; });
+
+        struct Slot
+        {
+            std::vector<heart::Variable*> buffers;
+            uint32_t end;
+        };
+
+        std::vector<Slot> slots;
+
+        for (auto& l : lifetimes)
+        {
+            bufferSizeBeforePlanning += l.buffer->type.getPackedSizeInBytes();
+
+            auto slot = std::find_if (slots.begin(), slots.end(), [&] (const Slot& s)
+            {
+                return s.end < l.start && s.buffers.front()->type.isIdentical (l.buffer->type);
+            });
+
+            if (slot == slots.end())
+            {
+                slots.push_back ({ { l.buffer }, l.end });
+                bufferSizeAfterPlanning += l.buffer->type.getPackedSizeInBytes();
+            }
+            else
+            {
+                slot->buffers.push_back (l.buffer);
+                slot->end = l.end;
+            }
+        }
+
+        for (auto& slot : slots)
+        {
+            if (slot.buffers.size() > 1)
+            {
+                auto& shared = addStateVariable ("sharedBuffer", slot.buffers.front()->type);
+
+                for (auto buffer : slot.buffers)
+                {
+                    for (auto& f : processor.functions.get())
+                        replaceVariable (f, *buffer, shared);
+
+                    processor.stateVariables.remove (*buffer);
+                }
+            }
+        }
+
+        if (bufferSizeBeforePlanning != 0 && CompileProfiler::getCurrent() != nullptr)
+            CompileProfiler::addInstantEvent (graph.fullName, "buffer planning",
+                                              { { "sizeBefore", (int64_t) bufferSizeBeforePlanning },
+                                                { "sizeAfter",  (int64_t) bufferSizeAfterPlanning } });
+    }
+
+    //==============================================================================
+    void createInitFunction()
+    {
+        std::vector<std::pair<pool_ref<heart::Function>, Node*>> initFunctions;
+
+        for (auto& n : nodes)
+        {
+            if (n->systemInit != nullptr)  initFunctions.push_back ({ *n->systemInit, n.get() });
+            if (n->init != nullptr)        initFunctions.push_back ({ *n->init, n.get() });
+        }
+
+        if (! initFunctions.empty())
+        {
+            FunctionBuilder::createFunction (processor, heart::getUserInitFunctionName(), PrimitiveType::void_, [&] (FunctionBuilder& builder)
+            {
+                for (auto& f : initFunctions)
+                    callNodeFunction (builder, *f.second, f.first);
+
+                builder.addReturn();
+            });
+        }
+    }
+
+    void callNodeFunction (FunctionBuilder& builder, Node& node, heart::Function& f)
+    {
+        if (node.numSharedElements > 1)
+            builder.addFunctionCall (f, { builder.createConstantInt32 (node.arrayIndex) });
+        else
+            builder.addFunctionCall (f, {});
+    }
+
+    void createRunFunction()
+    {
+        FunctionBuilder::createFunction (processor, heart::getRunFunctionName(), PrimitiveType::void_, [&] (FunctionBuilder& builder)
+        {
+            auto& frameBlock = createBlock (builder, "frame");
+            builder.addBranch (frameBlock, frameBlock);
+
+            for (auto& input : processor.inputs)
+                if (! input->isEventEndpoint())
+                    builder.addReadStream ({}, *graphBuffers[input.getPointer()], input);
+
+            for (auto node : executionOrder)
+                runNode (builder, *node);
+
+            writeGraphOutputs (builder);
+            writeFramesSkipped (builder);
+            updateDelayLines (builder);
+
+            for (auto& c : clockPhases)
+                builder.incrementAndWrap (c.phase, c.phase, (size_t) c.divider);
+
+            builder.addAdvance ({});
+            builder.addBranch (frameBlock, nullptr);
+        });
+    }
+
+    void runNode (FunctionBuilder& builder, Node& node)
+    {
+        if (node.step == nullptr)
+            return;
+
+        if (node.multiplier > 1)
+            return runMultipliedNode (builder, node);
+
+        if (node.divider > 1)
+            return runDividedNode (builder, node);
+
+        writeNodeInputs (builder, node, {});
+
+        if (node.framesSinceActivity != nullptr)
+            return stepQuiescentNode (builder, node);
+
+        callStepFunction (builder, node);
+    }
+
+    // A quiescent node is stepped while its inputs are active and for its tail after they
+    // go quiet. After that, its stream outputs are silent until something changes.
+    void stepQuiescentNode (FunctionBuilder& builder, Node& node)
+    {
+        auto& framesSinceActivity = *node.framesSinceActivity;
+
+        for (auto& input : node.module.inputs)
+        {
+            if (input->isStreamEndpoint())
+            {
+                resetIfChanged (builder, node, getNodeBuffer (builder, node, input), {});
+            }
+            else if (auto previous = node.previousValues[input.getPointer()])
+            {
+                resetIfChanged (builder, node, getNodeBuffer (builder, node, input), getNodeVariable (builder, node, *previous));
+                builder.addAssignment (getNodeVariable (builder, node, *previous), getNodeBuffer (builder, node, input));
+            }
+        }
+
+        builder.createIfElse ("@" + node.prefix + "active_" + std::to_string (nextBlockIndex++),
+                              builder.createComparisonOp (getNodeVariable (builder, node, framesSinceActivity),
+                                                          builder.createConstantInt32 (node.quiescentTail), BinaryOp::Op::lessThanOrEqual),
+                              [&] (FunctionBuilder& b)
+                              {
+                                  callStepFunction (b, node);
+                                  b.incrementValue (getNodeVariable (b, node, framesSinceActivity));
+                              },
+                              [&] (FunctionBuilder& b)
+                              {
+                                  for (auto& output : node.module.outputs)
+                                      if (output->isStreamEndpoint())
+                                          b.addZeroAssignment (getNodeBuffer (b, node, output));
+
+                                  if (framesSkipped != nullptr)
+                                      b.incrementValue (b.createFixedArrayElement (*framesSkipped, node.framesSkippedIndex));
+                              });
+    }
+
+    // Zeroes a quiescent node's count of inactive frames if any element of a value differs
+    // from the corresponding element of another, or if there isn't one, from zero
+    void resetIfChanged (FunctionBuilder& builder, Node& node, heart::Expression& value, pool_ptr<heart::Expression> reference)
+    {
+        auto type = value.getType();
+
+        if (type.isStruct())
+        {
+            for (auto& m : type.getStructRef().getMembers())
+                resetIfChanged (builder, node, builder.createStructElement (value, m.name),
+                                reference != nullptr ? builder.createStructElement (*reference, m.name) : pool_ptr<heart::Expression>());
+        }
+        else if (type.isFixedSizeArray() || type.isVector())
+        {
+            for (size_t i = 0; i < type.getArrayOrVectorSize(); ++i)
+                resetIfChanged (builder, node, builder.createFixedArrayElement (value, i),
+                                reference != nullptr ? builder.createFixedArrayElement (*reference, i) : pool_ptr<heart::Expression>());
+        }
+        else if (type.isPrimitive())
+        {
+            auto& comparand = reference != nullptr ? *reference : builder.createZeroInitialiser (type);
+
+            builder.createIfElse ("@" + node.prefix + "changed_" + std::to_string (nextBlockIndex++),
+                                  builder.createComparisonOp (value, comparand, BinaryOp::Op::notEquals),
+                                  [&] (FunctionBuilder& b)  { b.addZeroAssignment (getNodeVariable (b, node, *node.framesSinceActivity)); },
+                                  [] (FunctionBuilder&) {});
+        }
+    }
+
+    // A node with a clock multiplier is stepped several times per frame
+    void runMultipliedNode (FunctionBuilder& builder, Node& node)
+    {
+        auto& subStep = builder.createMutableLocalVariable (PrimitiveType::int32, getUniqueName (node.prefix + "subStep"));
+        builder.addZeroAssignment (subStep);
+
+        for (auto r : node.outputRoutes)
+        {
+            if (r->sourceAccumulator != nullptr)
+                builder.addZeroAssignment (*r->sourceAccumulator);
+
+            if (r->block != nullptr)
+                builder.addAssignment (builder.createFixedArrayElement (*r->block, 0),
+                                       builder.createFixedArrayElement (*r->block, (size_t) node.multiplier));
+        }
+
+        for (auto r : node.inputRoutes)
+            if (r->destFilter != nullptr)
+                addToFilterHistory (builder, *r->destFilter, getSourceValue (builder, *r));
+
+        auto& loopBlock = createBlock (builder, node.prefix + "loop");
+        auto& doneBlock = createBlock (builder, node.prefix + "done");
+        builder.addBranch (loopBlock, loopBlock);
+
+        writeNodeInputs (builder, node, subStep);
+        callStepFunction (builder, node);
+
+        for (auto r : node.outputRoutes)
+        {
+            if (r->sourceAccumulator != nullptr)
+                builder.addAssignment (*r->sourceAccumulator, builder.createAdd (*r->sourceAccumulator, getBufferValue (builder, r->source)));
+
+            if (r->block != nullptr)
+                builder.addAssignment (builder.createTrustedDynamicSubElement (*r->block, builder.createIntegerChangedByOne (subStep, BinaryOp::Op::add)),
+                                       getBufferValue (builder, r->source));
+
+            if (r->sourceFilter != nullptr)
+                addToFilterHistory (builder, *r->sourceFilter, getBufferValue (builder, r->source));
+        }
+
+        builder.incrementValue (subStep);
+        builder.addBranchIf (builder.createComparisonOp (subStep, builder.createConstantInt32 (node.multiplier), BinaryOp::Op::lessThan),
+                             loopBlock, doneBlock, doneBlock);
+
+        for (auto r : node.inputRoutes)
+            if (r->previous != nullptr)
+                builder.addAssignment (*r->previous, builder.createCastIfNeeded (getSourceValue (builder, *r), r->previous->getType()));
+
+        for (auto r : node.outputRoutes)
+        {
+            if (r->sourceAccumulator != nullptr)
+                builder.addAssignment (*r->resampled, createScaledValue (builder, *r->sourceAccumulator, node.multiplier));
+
+            if (r->sourceFilter != nullptr)
+                builder.addAssignment (*r->resampled, applyFilter (builder, *r->sourceFilter, builder.createConstantInt32 (0)));
+        }
+    }
+
+    // A node with a clock divider is stepped once every few frames
+    void runDividedNode (FunctionBuilder& builder, Node& node)
+    {
+        auto& phase = getClockPhase (node.divider);
+
+        for (auto r : node.inputRoutes)
+        {
+            if (r->destAccumulator != nullptr)
+                builder.addAssignment (*r->destAccumulator, builder.createAdd (*r->destAccumulator,
+                                                                               builder.createCastIfNeeded (getSourceValue (builder, *r),
+                                                                                                           r->destAccumulator->getType())));
+
+            if (r->destFilter != nullptr)
+                addToFilterHistory (builder, *r->destFilter, getSourceValue (builder, *r));
+        }
+
+        auto& stepBlock     = createBlock (builder, node.prefix + "step");
+        auto& continueBlock = createBlock (builder, node.prefix + "continue");
+
+        builder.addBranchIf (builder.createEqualsOp (phase, builder.createConstantInt32 (0)),
+                             stepBlock, continueBlock, stepBlock);
+
+        writeNodeInputs (builder, node, {});
+
+        for (auto r : node.inputRoutes)
+            if (r->destAccumulator != nullptr)
+                builder.addZeroAssignment (*r->destAccumulator);
+
+        callStepFunction (builder, node);
+
+        for (auto r : node.outputRoutes)
+        {
+            if (r->rampEnd != nullptr)
+            {
+                builder.addAssignment (*r->rampStart, *r->rampEnd);
+                builder.addAssignment (*r->rampEnd, getBufferValue (builder, r->source));
+            }
+
+            if (r->sourceFilter != nullptr)
+                addToFilterHistory (builder, *r->sourceFilter, getBufferValue (builder, r->source));
+        }
+
+        builder.addBranch (continueBlock, continueBlock);
+
+        for (auto r : node.outputRoutes)
+        {
+            if (r->rampEnd != nullptr)
+                builder.addAssignment (*r->resampled, createInterpolation (builder, *r->rampStart, *r->rampEnd,
+                                                                                  builder.createIntegerChangedByOne (phase, BinaryOp::Op::add),
+                                                                                  node.divider));
+
+            if (r->sourceFilter != nullptr)
+                builder.addAssignment (*r->resampled, applyFilter (builder, *r->sourceFilter, getPhaseCoefficientOffset (builder, phase, *r->sourceFilter)));
+        }
+    }
+
+    heart::Variable& getClockPhase (int64_t divider)
+    {
+        for (auto& c : clockPhases)
+            if (c.divider == divider)
+                return c.phase;
+
+        clockPhases.push_back ({ divider, addStateVariable ("clockPhase_" + std::to_string (divider), PrimitiveType::int32) });
+        return clockPhases.back().phase;
+    }
+
+    void callStepFunction (FunctionBuilder& builder, Node& node)
+    {
+        for (auto& output : node.module.outputs)
+            if (output->isStreamEndpoint())
+                builder.addZeroAssignment (getNodeBuffer (builder, node, output));
+
+        callNodeFunction (builder, node, *node.step);
+    }
+
+    void writeNodeInputs (FunctionBuilder& builder, Node& node, pool_ptr<heart::Variable> subStep)
+    {
+        for (auto& input : node.module.inputs)
+            if (! input->isEventEndpoint())
+                writeDestinationValues (builder, std::addressof (node), input, subStep);
+    }
+
+    void writeGraphOutputs (FunctionBuilder& builder)
+    {
+        for (auto& output : processor.outputs)
+        {
+            if (output->isEventEndpoint())
+                continue;
+
+            if (writeDestinationValues (builder, nullptr, output, {}) || output->isStreamEndpoint())
+                builder.addWriteStream ({}, output, nullptr, *graphBuffers[output.getPointer()]);
+        }
+    }
+
+    void writeFramesSkipped (FunctionBuilder& builder)
+    {
+        if (framesSkippedOutput == nullptr)
+            return;
+
+        for (uint32_t i = 0; i < skippedFramesCounts.size(); ++i)
+        {
+            auto& count = skippedFramesCounts[i];
+
+            if (count.subGraphOutput != nullptr)
+                builder.addAssignment (builder.createFixedArrayElement (*framesSkipped, i),
+                                       builder.createFixedArrayElement (getNodeBuffer (builder, count.node, *count.subGraphOutput), count.subGraphIndex));
+        }
+
+        builder.addWriteStream ({}, *framesSkippedOutput, nullptr, *framesSkipped);
+    }
+
+    // Sets the buffer for an input to the sum (or for a value, the latest) of the values that
+    // are connected to it, and returns false if nothing was connected.
+    bool writeDestinationValues (FunctionBuilder& builder, Node* node, heart::IODeclaration& io, pool_ptr<heart::Variable> subStep)
+    {
+        auto getBuffer = [&] () -> heart::Expression&
+        {
+            if (node != nullptr)
+                return getNodeBuffer (builder, *node, io);
+
+            return *graphBuffers[std::addressof (io)];
+        };
+
+        std::vector<std::optional<uint32_t>> elementsWritten;
+
+        for (auto& r : streamRoutes)
+        {
+            if (r->fused || r->dest.node != node || r->dest.io != std::addressof (io))
+                continue;
+
+            auto& target = getBufferElement (builder, getBuffer(), r->dest.element);
+            auto& value = builder.createCastIfNeeded (getDestinationValue (builder, *r, subStep), target.getType());
+
+            if (io.isStreamEndpoint() && contains (elementsWritten, r->dest.element))
+                builder.addAssignment (target, builder.createAdd (getBufferElement (builder, getBuffer(), r->dest.element), value));
+            else
+                builder.addAssignment (target, value);
+
+            elementsWritten.push_back (r->dest.element);
+        }
+
+        return ! elementsWritten.empty();
+    }
+
+    heart::Expression& getUndelayedSourceValue (BlockBuilder& builder, Route& r)
+    {
+        if (r.resampled != nullptr)
+            return *r.resampled;
+
+        return getBufferValue (builder, r.source);
+    }
+
+    heart::Expression& getBufferValue (BlockBuilder& builder, const EndpointRef& e)
+    {
+        if (e.node != nullptr)
+            return getBufferElement (builder, getNodeBuffer (builder, *e.node, *e.io), e.element);
+
+        return getBufferElement (builder, *graphBuffers[e.io], e.element);
+    }
+
+    heart::Expression& getSourceValue (BlockBuilder& builder, Route& r)
+    {
+        if (auto d = r.delayLine)
+        {
+            // the value from delayLength frames ago is at (position - delayLength) modulo the buffer size
+            auto size = d->buffer->type.getArraySize();
+
+            if (size == r.delayLength)
+                return builder.createTrustedDynamicSubElement (*d->buffer, *d->position);
+
+            auto& index = builder.createBinaryOp ({}, builder.createAdd (*d->position, builder.createConstantInt32 ((int64_t) (size - r.delayLength))),
+                                                  builder.createConstantInt32 ((int64_t) (size - 1)), BinaryOp::Op::bitwiseAnd);
+            return builder.createTrustedDynamicSubElement (*d->buffer, index);
+        }
+
+        return getUndelayedSourceValue (builder, r);
+    }
+
+    heart::Expression& getDestinationValue (FunctionBuilder& builder, Route& r, pool_ptr<heart::Variable> subStep)
+    {
+        if (r.block != nullptr)
+            return getBlockValue (builder, r, *subStep);
+
+        if (auto filter = r.destFilter.get())
+        {
+            if (subStep != nullptr)
+                return applyFilter (builder, *filter, getPhaseCoefficientOffset (builder, *subStep, *filter));
+
+            return applyFilter (builder, *filter, builder.createConstantInt32 (0));
+        }
+
+        if (r.previous != nullptr)
+            return createInterpolation (builder, *r.previous,
+                                        builder.createCastIfNeeded (getSourceValue (builder, r), r.previous->getType()),
+                                        builder.createIntegerChangedByOne (*subStep, BinaryOp::Op::add), r.dest.node->multiplier);
+
+        if (r.destAccumulator != nullptr)
+            return createScaledValue (builder, *r.destAccumulator, r.dest.node->divider);
+
+        return getSourceValue (builder, r);
+    }
+
+    // Returns the value for one of the destination's sub-steps from the block of values which
+    // the source produced during this frame. Element i + 1 of the block holds sub-step i of the
+    // source, and element 0 holds the last one from the previous frame.
+    heart::Expression& getBlockValue (BlockBuilder& builder, Route& r, heart::Variable& subStep)
+    {
+        auto sourceSteps = r.source.node->multiplier;
+        auto destSteps = r.dest.node->multiplier;
+
+        auto getElement = [&] (heart::Expression& index) -> heart::Expression&
+        {
+            return builder.createTrustedDynamicSubElement (*r.block, index);
+        };
+
+        auto createInt = [&] (int64_t n) -> heart::Expression&
+        {
+            return builder.createConstantInt32 (n);
+        };
+
+        if (sourceSteps == destSteps)
+            return getElement (builder.createIntegerChangedByOne (subStep, BinaryOp::Op::add));
+
+        if (sourceSteps > destSteps)
+        {
+            auto factor = sourceSteps / destSteps;
+            auto& firstIndex = builder.createRegisterVariable (builder.createBinaryOp ({}, subStep, createInt (factor), BinaryOp::Op::multiply));
+
+            // decimating takes the mean of the source values (or when latching, the latest one)
+            if (! r.interpolateBlock)
+                return getElement (builder.createAdd (firstIndex, createInt (factor)));
+
+            pool_ptr<heart::Expression> sum = getElement (builder.createAdd (firstIndex, createInt (1)));
+
+            for (int64_t i = 2; i <= factor; ++i)
+                sum = builder.createAdd (*sum, getElement (builder.createAdd (firstIndex, createInt (i))));
+
+            return createScaledValue (builder, *sum, factor);
+        }
+
+        // upsampling holds (or interpolates between) each source value for several sub-steps
+        auto factor = destSteps / sourceSteps;
+        auto& index = builder.createRegisterVariable (builder.createBinaryOp ({}, subStep, createInt (factor), BinaryOp::Op::divide));
+
+        if (! r.interpolateBlock)
+            return getElement (builder.createAdd (index, createInt (1)));
+
+        auto& start = builder.createRegisterVariable (getElement (index));
+        auto& end = builder.createRegisterVariable (getElement (builder.createAdd (index, createInt (1))));
+        auto& position = builder.createIntegerChangedByOne (builder.createBinaryOp ({}, subStep, createInt (factor), BinaryOp::Op::modulo),
+                                                            BinaryOp::Op::add);
+
+        return createInterpolation (builder, start, end, position, factor);
+    }
+
+    void addToFilterHistory (FunctionBuilder& builder, FilterHistory& history, heart::Expression& value)
+    {
+        auto elementType = history.buffer.type.getElementType();
+        auto& castValue = builder.createRegisterVariable (builder.createCastIfNeeded (value, elementType));
+
+        builder.addAssignment (builder.createTrustedDynamicSubElement (history.buffer, history.position), castValue);
+        builder.addAssignment (builder.createTrustedDynamicSubElement (history.buffer, builder.createAdd (history.position,
+                                                                                                        builder.createConstantInt32 (history.length))),
+                               castValue);
+        builder.incrementAndWrap (history.position, history.position, history.length);
+    }
+
+    heart::Expression& getPhaseCoefficientOffset (BlockBuilder& builder, heart::Variable& phase, const FilterHistory& history)
+    {
+        return builder.createBinaryOp ({}, phase, builder.createConstantInt32 (history.length), BinaryOp::Op::multiply);
+    }
+
+    // Returns the dot product of the filter's history with its coefficients, starting at the given offset
+    heart::Variable& applyFilter (FunctionBuilder& builder, FilterHistory& history, heart::Expression& coefficientOffset)
+    {
+        auto elementType = history.buffer.type.getElementType();
+        auto& total = builder.createMutableLocalVariable (elementType, getUniqueName ("filterTotal"));
+        auto& tap = builder.createMutableLocalVariable (PrimitiveType::int32, getUniqueName ("filterTap"));
+        auto& firstCoefficient = builder.createRegisterVariable (coefficientOffset);
+        builder.addZeroAssignment (total);
+        builder.addZeroAssignment (tap);
+
+        auto& loopBlock = createBlock (builder, "filter");
+        auto& doneBlock = createBlock (builder, "filter_done");
+        builder.addBranch (loopBlock, loopBlock);
+
+        auto& coefficient = builder.createTrustedDynamicSubElement (history.coefficients, builder.createAdd (firstCoefficient, tap));
+        auto& value = builder.createTrustedDynamicSubElement (history.buffer, builder.createAdd (history.position, tap));
+
+        builder.addAssignment (total, builder.createAdd (total, builder.createBinaryOp ({}, value,
+                                                                                        builder.createCastIfNeeded (coefficient, elementType),
+                                                                                        BinaryOp::Op::multiply)));
+        builder.incrementValue (tap);
+        builder.addBranchIf (builder.createComparisonOp (tap, builder.createConstantInt32 (history.length), BinaryOp::Op::lessThan),
+                             loopBlock, doneBlock, doneBlock);
+        return total;
+    }
+
+    void updateDelayLines (FunctionBuilder& builder)
+    {
+        for (auto& d : delayLines)
+        {
+            auto& target = builder.createTrustedDynamicSubElement (*d->buffer, *d->position);
+            builder.addAssignment (target, builder.createCastIfNeeded (getUndelayedSourceValue (builder, d->writer), target.getType()));
+            builder.incrementAndWrap (*d->position, *d->position, d->buffer->type.getArraySize());
+        }
+    }
+
+    //==============================================================================
+    static Type getScalarType (const Type& type)
+    {
+        return Type (type.getPrimitiveType());
+    }
+
+    heart::Expression& createScaledValue (BlockBuilder& builder, heart::Expression& value, int64_t divisor)
+    {
+        auto& type = value.getType();
+        auto& scale = builder.createConstant (Value (1.0 / (double) divisor).castToTypeExpectingSuccess (getScalarType (type)));
+        return builder.createBinaryOp ({}, value, builder.createCastIfNeeded (scale, type), BinaryOp::Op::multiply);
+    }
+
+    // Returns start + (end - start) * stepsDone / numSteps
+    heart::Expression& createInterpolation (BlockBuilder& builder, heart::Variable& start, heart::Expression& end,
+                                            heart::Expression& stepsDone, int64_t numSteps)
+    {
+        auto& type = start.getType();
+        auto& fraction = builder.createBinaryOp ({}, builder.createCast ({}, stepsDone, getScalarType (type)),
+                                                 builder.createConstant (Value (1.0 / (double) numSteps).castToTypeExpectingSuccess (getScalarType (type))),
+                                                 BinaryOp::Op::multiply);
+
+        return builder.createAdd (start, builder.createBinaryOp ({}, builder.createSubtract (end, start),
+                                                                 builder.createCastIfNeeded (fraction, type),
+                                                                 BinaryOp::Op::multiply));
+    }
+};
+
+//==============================================================================
+GraphLowering::Result GraphLowering::apply (Program& program, bool reportFramesSkipped)
+{
+    Result result;
+    auto mainProcessor = program.findMainProcessor();
+
+    if (mainProcessor == nullptr || ! mainProcessor->isGraph())
+        return result;
+
+    DelayCompensation::apply (*mainProcessor);
+
+    struct Lowerer
+    {
+        Program& program;
+        Result& result;
+        bool reportFramesSkipped;
+        std::vector<GraphFlattener::ExternalOrigin> externalOrigins;
+
+        Module& lower (Module& graph)
+        {
+            for (auto& instance : graph.processorInstances)
+            {
+                auto& child = program.getModuleWithName (instance->sourceName);
+
+                if (child.isGraph())
+                    lower (child);
+            }
+
+            GraphFlattener flattener (program, graph, externalOrigins, reportFramesSkipped);
+            auto& processor = flattener.flatten();
+            result.numFusedConnections += flattener.getNumFusedConnections();
+            result.numQuiescentNodes += flattener.getNumQuiescentNodes();
+            result.bufferSizeBeforePlanning += flattener.getBufferSizeBeforePlanning();
+            result.bufferSizeAfterPlanning += flattener.getBufferSizeAfterPlanning();
+            return processor;
+        }
+    };
+
+    Lowerer lowerer { program, result, reportFramesSkipped, {} };
+    auto& newMain = lowerer.lower (*mainProcessor);
+
+    auto modules = program.getModules();
+
+    for (auto& m : modules)
+        if (m != newMain && (m->isProcessor() || m->isGraph()))
+            program.removeModule (m);
+
+    GraphFlattener::moveExternalsToNamespaces (program, newMain, lowerer.externalOrigins);
+    return result;
+}
+
+} // namespace soul
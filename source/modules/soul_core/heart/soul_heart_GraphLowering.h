@@ -0,0 +1,121 @@
+/*
+    _____ _____ _____ __
+   |   __|     |  |  |  |      The SOUL language
+   |__   |  |  |  |  |  |__    Copyright (c) 2019 - ROLI Ltd.
+   |_____|_____|_____|_____|
+
+   The code in this file is provided under the terms of the ISC license:
+
+   Permission to use, copy, modify, and/or distribute this software for any purpose
+   with or without fee is hereby granted, provided that the above copyright notice and
+   this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+   TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+   NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+   IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+   CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+namespace soul
+{
+
+//==============================================================================
+/**
+    Flattens a graph into a single processor.
+
+    Each node of the graph gets its own copy of its processor's state and functions,
+    and its run() function is turned into a "step" function which performs one frame
+    of work and returns, remembering where it needs to resume on the next call. The
+    processor that replaces the graph has a run() function which reads the graph's
+    inputs, steps all the nodes in a statically-computed order, moving the data between
+    them via state variables, and then writes the graph's outputs.
+
+    The elements of a processor array share a single copy of its functions, which take
+    the index of the element as an extra parameter, and each of the processor's state
+    variables becomes an array with one entry per element. This only shares the code:
+    each element is still stepped separately, with scalar operations, and nothing is
+    vectorised across them.
+
+    Stream connections between base-rate nodes which have nothing else connected to
+    either end are fused: the nodes at each end get inlined into the new run() function
+    and the value passes between them in a local variable rather than a state buffer.
+
+    The remaining stream buffers are packed together: any which are only needed during
+    non-overlapping parts of a frame share the same state variable.
+
+    Delayed connections from the same source share a circular buffer with a read position
+    for each of their delays. Nodes with a clock multiplier or divider are stepped several
+    times per frame, or once every few frames, with their streams being resampled with
+    latch or linear interpolation, or for the fast, sinc and best interpolation types,
+    with the filters described by ResamplerKernel. A stream between two multiplied nodes
+    is passed as a block holding all the values that the source produced during the
+    frame, which the destination decimates or interpolates directly, and any other
+    connection between nodes running at different rates goes via the base rate.
+    Event connections turn into direct calls to the destination nodes' event handlers,
+    and events from an endpoint array or a processor array are dispatched to the right
+    element of their destinations with tables indexed by the element they came from.
+
+    A processor whose annotation includes "quiescent" promises that when its inputs have
+    been silent and unchanged for the number of frames given as the annotation's value,
+    its output will be silent too. Once that has happened, a node of that processor which
+    runs at the base rate stops being stepped until an input changes or an event arrives.
+    For debugging, apply() can also add an extra output value, whose name is
+    getFramesSkippedEndpointName(), which is written at the end of every frame with the
+    number of frames that each such node has skipped. It's an int64 array with an element
+    per node, and its "nodes" annotation is a comma-separated list of the nodes' names, in
+    the same order, e.g. "voices[0],voices[1],reverb", with the nodes inside a sub-graph
+    being named e.g. "synth.voices[0]".
+
+    Once a program has been lowered, a back-end only needs to know how to run a single
+    processor.
+
+    This is experimental: the code it generates is only checked by re-parsing it, and
+    hasn't been compared against the graph it replaces by running both. The compiler
+    never applies it by itself, so a program only gets lowered when Compiler::lowerGraphs()
+    or an ExecutionProfile is asked to do it.
+*/
+struct GraphLowering
+{
+    /** Some statistics about what happened when a program was lowered. */
+    struct Result
+    {
+        /** The number of connections which didn't need an intermediate buffer. */
+        uint32_t numFusedConnections = 0;
+
+        /** The number of nodes which can stop being stepped while their inputs are quiet. */
+        uint32_t numQuiescentNodes = 0;
+
+        /** The total size in bytes of the stream buffers which were candidates for sharing,
+            and the size of the variables that they ended up packed into.
+        */
+        size_t bufferSizeBeforePlanning = 0, bufferSizeAfterPlanning = 0;
+    };
+
+    /** If the program's main processor is a graph, this replaces it (and any sub-graphs
+        that it uses) with an equivalent processor, and removes all the other processor
+        modules, which will no longer be needed.
+
+        The graph's delay compensation is applied before it gets flattened. Any external
+        variables are left in namespaces with the names of the processors that declared
+        them, so they can still be resolved by the same names as before.
+
+        If reportFramesSkipped is true, the new processor gets an output which reports how
+        many frames its quiescent nodes have skipped. This is only meant for debugging, as
+        it changes the processor's set of endpoints.
+
+        If the graph uses a feature that can't be lowered, a compile error is thrown.
+    */
+    static Result apply (Program&, bool reportFramesSkipped = false);
+
+    /** The name of the debugging output value which reports how many frames quiescent nodes
+        have skipped.
+    */
+    static const char* getFramesSkippedEndpointName()   { return "_framesSkipped"; }
+
+private:
+    struct GraphFlattener;
+};
+
+}
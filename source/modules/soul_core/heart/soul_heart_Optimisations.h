@@ -58,12 +58,12 @@ struct Optimisations
 
         for (auto f : mainModule.functions.get())
             if (f->isExported)
-                recursivelyFlagFunctionUse (f);
+                heart::Utilities::recursivelyFlagFunctionUse (f);
 
         for (auto& m : program.getModules())
             for (auto& f : m->functions.get())
                 if (! f->functionUseTestFlag && f->annotation.getBool ("do_not_optimise"))
-                    recursivelyFlagFunctionUse (f);
+                    heart::Utilities::recursivelyFlagFunctionUse (f);
 
         for (auto& m : program.getModules())
             m->functions.removeIf ([] (heart::Function& f) { return ! f.functionUseTestFlag; });
@@ -177,6 +177,17 @@ struct Optimisations
     static bool inlineAllCallsToFunction (Program& program, heart::Function& functionToInline)
     {
         bool anyChanged = false;
+        int64_t numCallersChanged = 0;
+
+        auto recordDecision = [&] (bool succeeded)
+        {
+            if (CompileProfiler::getCurrent() != nullptr)
+                CompileProfiler::addInstantEvent (TokenisedPathString::join (program.getModuleContainingFunction (functionToInline).fullName, functionToInline.name), "inlining",
+                                                  { { "succeeded", succeeded ? 1 : 0 },
+                                                    { "callersChanged", numCallersChanged } });
+
+            return succeeded;
+        };
 
         for (auto& m : program.getModules())
         {
@@ -185,16 +196,20 @@ struct Optimisations
                 auto result = inlineAllCallsToFunction (program, f, functionToInline);
 
                 if (result == InlineResult::failed)
-                    return false;
+                    return recordDecision (false);
 
                 if (result == InlineResult::ok)
+                {
                     anyChanged = true;
+                    ++numCallersChanged;
+                }
             }
         }
 
         if (! anyChanged)
-            return false;
+            return recordDecision (false);
 
+        recordDecision (true);
         program.getModuleContainingFunction (functionToInline).functions.remove (functionToInline);
         return true;
     }
@@ -327,25 +342,6 @@ private:
     }
 
     //==============================================================================
-    static void recursivelyFlagFunctionUse (heart::Function& sourceFn)
-    {
-        if (! sourceFn.functionUseTestFlag)
-        {
-            sourceFn.functionUseTestFlag = true;
-
-            sourceFn.visitStatements<heart::FunctionCall> ([] (heart::FunctionCall& fc)
-            {
-                recursivelyFlagFunctionUse (fc.getFunction());
-            });
-
-            sourceFn.visitExpressions ([] (pool_ref<heart::Expression>& value, AccessType)
-            {
-                if (auto fc = cast<heart::PureFunctionCall> (value))
-                    recursivelyFlagFunctionUse (fc->function);
-            });
-        }
-    }
-
     static void removeCallsToVoidFunctionsWithoutSideEffects (Program& program)
     {
         for (auto& m : program.getModules())
@@ -24,12 +24,22 @@ namespace soul
 //==============================================================================
 struct heart::Printer
 {
-    static void print (const Program& p, choc::text::CodePrinter& out)
+    /** Provides extra text to be written as comments before each module, function and
+        block in a dump. Any of these can be empty, as can the strings that they return.
+    */
+    struct Comments
+    {
+        std::function<std::string(const Module&)> getModuleComment;
+        std::function<std::string(const heart::Function&)> getFunctionComment;
+        std::function<std::string(const heart::Block&)> getBlockComment;
+    };
+
+    static void print (const Program& p, choc::text::CodePrinter& out, const Comments& comments = {})
     {
         out << '#' << getHEARTFormatVersionPrefix() << ' ' << getHEARTFormatVersion() << blankLine;
 
         for (auto& module : p.getModules())
-            PrinterStream (module, out).printAll();
+            PrinterStream (module, out, comments).printAll();
     }
 
     static std::string getDump (const Program& p)
@@ -46,11 +56,12 @@ private:
 
     struct PrinterStream
     {
-        PrinterStream (const Module& m, choc::text::CodePrinter& o)
-           : module (m), out (o) {}
+        PrinterStream (const Module& m, choc::text::CodePrinter& o, const Comments& c)
+           : module (m), out (o), comments (c) {}
 
         const Module& module;
         choc::text::CodePrinter& out;
+        const Comments& comments;
 
         std::unordered_map<pool_ref<heart::Variable>, std::string> localVariableNames;
         std::vector<std::string> allVisibleVariables;
@@ -60,6 +71,9 @@ private:
             for (auto& v : module.stateVariables.get())
                 allVisibleVariables.push_back (v->name);
 
+            if (comments.getModuleComment != nullptr)
+                printComment (comments.getModuleComment (module));
+
             if (module.isProcessor())   out << "processor ";
             if (module.isGraph())       out << "graph ";
             if (module.isNamespace())   out << "namespace ";
@@ -93,6 +107,13 @@ private:
             out << blankLine;
         }
 
+        void printComment (const std::string& text)
+        {
+            if (! text.empty())
+                for (auto& line : choc::text::splitIntoLines (text, false))
+                    out << "// " << line << newLine;
+        }
+
         void printDescription (const std::vector<Type>& types)
         {
             if (types.size() == 1)
@@ -276,6 +297,10 @@ private:
         void printBlock (heart::Block& b)
         {
             auto labelIndent = out.createIndent (2);
+
+            if (comments.getBlockComment != nullptr)
+                printComment (comments.getBlockComment (b));
+
             out << getBlockName (b);
 
             if (!b.parameters.empty())
@@ -299,6 +324,9 @@ private:
         {
             SOUL_ASSERT (f.name.isValid());
 
+            if (comments.getFunctionComment != nullptr)
+                printComment (comments.getFunctionComment (f));
+
             out << (f.functionType.isEvent() ? "event " : "function ");
             out << getFunctionName (f);
 
@@ -0,0 +1,165 @@
+/*
+    _____ _____ _____ __
+   |   __|     |  |  |  |      The SOUL language
+   |__   |  |  |  |  |  |__    Copyright (c) 2019 - ROLI Ltd.
+   |_____|_____|_____|_____|
+
+   The code in this file is provided under the terms of the ISC license:
+
+   Permission to use, copy, modify, and/or distribute this software for any purpose
+   with or without fee is hereby granted, provided that the above copyright notice and
+   this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+   TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+   NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+   IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+   CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+namespace soul
+{
+
+//==============================================================================
+/**
+    Describes the filters that are used to resample streams for the `fast`, `sinc` and
+    `best` interpolation types when they cross between processors running at different
+    clock rates.
+
+    Each one is a windowed-sinc low-pass filter, designed at the higher of the two rates
+    with its cutoff just below the Nyquist frequency of the lower one. Interpolation uses
+    it as a polyphase filter over the recent values at the lower rate, and decimation runs
+    the whole filter over the recent values at the higher rate. The coefficients are laid
+    out so that both kinds of filter are a dot product between a contiguous run of the
+    table and a history of values ordered from oldest to newest.
+*/
+struct ResamplerKernel
+{
+    /** Returns true for the interpolation types which are implemented with a filter kernel. */
+    static bool isFilter (InterpolationType type)
+    {
+        return type == InterpolationType::fast
+            || type == InterpolationType::sinc
+            || type == InterpolationType::best;
+    }
+
+    /** Returns true if a stream of this type can be resampled with anything other than latching. */
+    static bool canInterpolate (const Type& type)
+    {
+        return type.isFloatingPoint() && (type.isPrimitive() || type.isVector());
+    }
+
+    /** The length of the filter, in samples at the lower of the two rates. */
+    static uint32_t getNumTapsPerPhase (InterpolationType type)
+    {
+        switch (type)
+        {
+            case InterpolationType::fast:  return 8;
+            case InterpolationType::sinc:  return 16;
+            case InterpolationType::best:  return 32;
+            case InterpolationType::none:
+            case InterpolationType::latch:
+            case InterpolationType::linear:
+            default:                       return 0;
+        }
+    }
+
+    /** Returns the coefficients for reducing the rate by the given factor, which are
+        to be applied to the last (factor * getNumTapsPerPhase()) values.
+    */
+    static std::vector<double> createDecimationTable (InterpolationType type, uint32_t factor)
+    {
+        auto filter = createPrototype (type, factor);
+        normalise (filter.data(), filter.size());
+        return filter;
+    }
+
+    /** Returns the coefficients for increasing the rate by the given factor. These are
+        made up of one set of getNumTapsPerPhase() coefficients for each of the output
+        sub-steps in turn, to be applied to the last getNumTapsPerPhase() input values.
+    */
+    static std::vector<double> createInterpolationTable (InterpolationType type, uint32_t factor)
+    {
+        auto filter = createPrototype (type, factor);
+        auto numTaps = getNumTapsPerPhase (type);
+        std::vector<double> table;
+        table.reserve (filter.size());
+
+        for (uint32_t phase = 0; phase < factor; ++phase)
+        {
+            for (uint32_t tap = 0; tap < numTaps; ++tap)
+                table.push_back (filter[phase + (numTaps - 1 - tap) * factor]);
+
+            normalise (table.data() + phase * numTaps, numTaps);
+        }
+
+        return table;
+    }
+
+    /** Returns the delay, in frames at the base rate of the graph, that resampling a stream
+        from the source's clock rate to the destination's will introduce.
+    */
+    static uint32_t getLatency (InterpolationType type, const heart::ClockMultiplier& source, const heart::ClockMultiplier& dest)
+    {
+        if (! isFilter (type) || source.getRatio() == dest.getRatio())
+            return 0;
+
+        return getLatencyOfConversion (type, source) + getLatencyOfConversion (type, dest);
+    }
+
+private:
+    static uint32_t getLatencyOfConversion (InterpolationType type, const heart::ClockMultiplier& clock)
+    {
+        if (clock.getRatio() == 1.0)
+            return 0;
+
+        auto filterLength = (double) getNumTapsPerPhase (type);
+
+        if (auto divider = clock.getDivider())
+            filterLength *= (double) *divider;
+
+        // the group delay of a symmetrical filter is half its length
+        return (uint32_t) std::lround (filterLength / 2.0);
+    }
+
+    static double getCutoffProportion (InterpolationType type)
+    {
+        return type == InterpolationType::fast ? 0.8
+             : type == InterpolationType::sinc ? 0.9 : 0.95;
+    }
+
+    static std::vector<double> createPrototype (InterpolationType type, uint32_t factor)
+    {
+        SOUL_ASSERT (isFilter (type) && factor > 0);
+
+        auto length = factor * getNumTapsPerPhase (type);
+        auto centre = (length - 1) * 0.5;
+        auto cutoff = getCutoffProportion (type) / factor;
+        std::vector<double> filter;
+        filter.reserve (length);
+
+        for (uint32_t i = 0; i < length; ++i)
+        {
+            auto x = (i - centre) * cutoff;
+            auto sinc = x == 0 ? 1.0 : std::sin (pi * x) / (pi * x);
+            auto window = 0.5 + 0.5 * std::cos (twoPi * (i - centre) / (double) length);
+            filter.push_back (sinc * window);
+        }
+
+        return filter;
+    }
+
+    static void normalise (double* coefficients, size_t num)
+    {
+        double total = 0;
+
+        for (size_t i = 0; i < num; ++i)
+            total += coefficients[i];
+
+        for (size_t i = 0; i < num; ++i)
+            coefficients[i] /= total;
+    }
+};
+
+}
@@ -127,6 +127,24 @@ struct heart::Utilities
         }
     };
 
+    //==============================================================================
+    /** Returns the number of bytes of state needed by a processor, including that of all
+        the processor instances inside it (if it's a graph), but not its external variables.
+    */
+    static uint64_t getStateSize (const Program& program, const Module& module)
+    {
+        uint64_t size = 0;
+
+        for (auto& v : module.stateVariables.get())
+            if (! v->isExternal())
+                size += v->type.getPackedSizeInBytes();
+
+        for (auto& i : module.processorInstances)
+            size += i->arraySize * getStateSize (program, program.getModuleWithName (i->sourceName));
+
+        return size;
+    }
+
     //==============================================================================
     static pool_ptr<Statement> findFirstStreamAccess (Function& f)
     {
@@ -165,6 +183,28 @@ struct heart::Utilities
         return false;
     }
 
+    /** Sets the functionUseTestFlag of a function and of everything that it calls.
+        The caller is expected to have cleared the flags of all the functions first.
+    */
+    static void recursivelyFlagFunctionUse (Function& sourceFn)
+    {
+        if (! sourceFn.functionUseTestFlag)
+        {
+            sourceFn.functionUseTestFlag = true;
+
+            sourceFn.visitStatements<FunctionCall> ([] (FunctionCall& fc)
+            {
+                recursivelyFlagFunctionUse (fc.getFunction());
+            });
+
+            sourceFn.visitExpressions ([] (pool_ref<Expression>& value, AccessType)
+            {
+                if (auto fc = cast<PureFunctionCall> (value))
+                    recursivelyFlagFunctionUse (fc->function);
+            });
+        }
+    }
+
     static bool canFunctionBeInlined (Program& program,
                                       Function& parentFunction,
                                       FunctionCall& call)
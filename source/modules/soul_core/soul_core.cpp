@@ -72,6 +72,7 @@
 #include "types/soul_EndpointType.cpp"
 #include "heart/soul_heart_Printer.h"
 #include "heart/soul_heart_Parser.h"
+#include "heart/soul_heart_BinaryFormat.h"
 #include "heart/soul_heart_Checker.h"
 #include "types/soul_Type.cpp"
 #include "compiler/soul_StandardLibrary.h"
@@ -81,17 +82,24 @@
 #include "compiler/soul_ResolutionPass.h"
 #include "compiler/soul_ConvertComplexPass.h"
 #include "compiler/soul_HeartGenerator.h"
+#include "compiler/soul_ASTCloner.h"
 #include "compiler/soul_Compiler.cpp"
 #include "heart/soul_Intrinsics.cpp"
 #include "heart/soul_heart_FunctionBuilder.cpp"
 #include "heart/soul_ModuleCloner.h"
 #include "heart/soul_Module.cpp"
 #include "heart/soul_Program.cpp"
+#include "heart/soul_heart_GraphLowering.cpp"
+#include "heart/soul_heart_ExecutionProfile.cpp"
+#include "heart/soul_heart_Analyser.cpp"
 #include "venue/soul_RenderingVenue.cpp"
+#include "venue/soul_TestRunner.cpp"
+#include "venue/soul_OptimisationFuzzer.cpp"
 #include "diagnostics/soul_CodeLocation.cpp"
 #include "diagnostics/soul_Logging.cpp"
 #include "diagnostics/soul_CompileMessageList.cpp"
 #include "diagnostics/soul_Timing.cpp"
+#include "diagnostics/soul_CompileProfiler.cpp"
 #include "venue/soul_Endpoints.cpp"
 
 #include "documentation/soul_SourceCodeUtilities.cpp"
@@ -51,6 +51,7 @@
 #include <sstream>
 #include <array>
 #include <unordered_map>
+#include <unordered_set>
 #include <algorithm>
 #include <functional>
 #include <mutex>
@@ -116,6 +117,7 @@ namespace soul
 
 #include "diagnostics/soul_Logging.h"
 #include "diagnostics/soul_Timing.h"
+#include "diagnostics/soul_CompileProfiler.h"
 #include "diagnostics/soul_CodeLocation.h"
 #include "diagnostics/soul_CompileMessageList.h"
 #include "diagnostics/soul_Errors.h"
@@ -140,7 +142,11 @@ namespace soul
 #include "heart/soul_heart_FunctionBuilder.h"
 #include "heart/soul_heart_CallFlowGraph.h"
 #include "heart/soul_heart_Optimisations.h"
+#include "heart/soul_heart_ResamplerKernels.h"
 #include "heart/soul_heart_DelayCompensation.h"
+#include "heart/soul_heart_GraphLowering.h"
+#include "heart/soul_heart_ExecutionProfile.h"
+#include "heart/soul_heart_Analyser.h"
 
 #include "compiler/soul_AST.h"
 #include "compiler/soul_Compiler.h"
@@ -149,6 +155,8 @@ namespace soul
 #include "venue/soul_Performer.h"
 #include "venue/soul_Venue.h"
 #include "venue/soul_RenderingVenue.h"
+#include "venue/soul_TestRunner.h"
+#include "venue/soul_OptimisationFuzzer.h"
 
 #include "utilities/soul_EventQueue.h"
 #include "utilities/soul_MultiEndpointFIFO.h"
@@ -53,4 +53,10 @@ namespace soul
         SOUL_ASSERT_FALSE;
         return {};
     }
+
+    void StringDictionary::addItem (Item i)
+    {
+        nextIndex = std::max (nextIndex, i.handle.handle + 1);
+        strings.push_back (std::move (i));
+    }
 }
@@ -40,6 +40,9 @@ public:
 
     std::vector<Item> strings;
 
+    /** Manually adds an item - obviously to be used with care. */
+    void addItem (Item);
+
 private:
     uint32_t nextIndex = 1;
 };
@@ -391,6 +391,23 @@ bool Type::isBoundedIntWithinLimit (BoundedIntSize maxSize) const
 Type Type::createStruct (Structure& s)           { return Type (s); }
 StructurePtr Type::getStruct() const             { SOUL_ASSERT (isStruct()); return structure; }
 Structure& Type::getStructRef() const            { SOUL_ASSERT (isStruct()); return *structure; }
+Structure* Type::getStructIfPresent() const      { return structure.get(); }
+
+Type Type::createCopyWithNewStruct (Structure& newStruct) const
+{
+    SOUL_ASSERT (structure != nullptr);
+
+    // NB: this deliberately avoids copying the old structure pointer
+    Type t (category);
+    t.arrayElementCategory = arrayElementCategory;
+    t.isRef = isRef;
+    t.isConstant = isConstant;
+    t.primitiveType = primitiveType;
+    t.boundingSize = boundingSize;
+    t.arrayElementBoundingSize = arrayElementBoundingSize;
+    t.structure = newStruct;
+    return t;
+}
 
 bool Type::usesStruct (const Structure& s) const
 {
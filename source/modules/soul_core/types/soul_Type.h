@@ -183,6 +183,14 @@ struct Type  final
     Structure& getStructRef() const;
     bool usesStruct (const Structure&) const;
 
+    /** Returns the struct used by either a struct or an array-of-struct type, or nullptr
+        if there isn't one. Unlike getStruct(), this doesn't add a reference to the struct.
+    */
+    Structure* getStructIfPresent() const;
+
+    /** Returns a copy of a struct or array-of-struct type which uses a different struct. */
+    Type createCopyWithNewStruct (Structure&) const;
+
     //==============================================================================
     static Type createStringLiteral();
 
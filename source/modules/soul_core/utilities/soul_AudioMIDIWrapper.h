@@ -117,7 +117,7 @@ struct AudioInputList
     template <typename PerformerOrSession>
     void connectEndpoint (PerformerOrSession& p, EndpointID endpointID, choc::buffer::ChannelRange channels)
     {
-        mappings.push_back ({ p.getEndpointHandle (endpointID), channels });
+        mappings.push_back ({ p.getEndpointHandle (endpointID), channels, getMaxFramesPerFIFOItem (channels.size()) });
 
         if (channels.size() > scratchBuffer.getNumChannels())
             scratchBuffer.resize ({ channels.size(), maxBlockSize });
@@ -125,27 +125,26 @@ struct AudioInputList
         totalNumChannels = std::max (totalNumChannels, channels.end);
     }
 
-    bool addToFIFO (MultiEndpointFIFO& fifo, uint64_t time, choc::buffer::ChannelArrayView<const float> inputChannels)
+    /** Adds a block of input data to the FIFO. The input can be any kind of choc buffer view
+        with float or double samples, and if it has fewer channels than the endpoints need,
+        the missing ones are treated as silent. Where a channel array or interleaved float
+        buffer has the layout that an endpoint expects, it's passed straight to the FIFO,
+        and the rest get converted via a scratch buffer. Because the FIFO takes a copy of
+        everything, the caller is free to overwrite the input as soon as this returns.
+    */
+    template <typename SampleType, template<typename> typename LayoutType>
+    bool addToFIFO (MultiEndpointFIFO& fifo, uint64_t time, choc::buffer::BufferView<SampleType, LayoutType> inputChannels)
     {
         auto numFrames = inputChannels.getNumFrames();
 
         for (auto& mapping : mappings)
         {
-            if (mapping.channels.size() == 1)
-            {
-                auto channel = inputChannels.getChannel (mapping.channels.start);
-
-                if (! fifo.addInputData (mapping.endpoint, time,
-                                         choc::value::createArrayView (const_cast<float*> (channel.data.data), numFrames)))
-                    return false;
-            }
-            else
+            for (uint32_t start = 0; start < numFrames; start += mapping.maxFramesPerFIFOItem)
             {
-                copy (scratchBuffer.getStart (numFrames), inputChannels.getChannelRange (mapping.channels));
+                auto end = std::min (numFrames, start + mapping.maxFramesPerFIFOItem);
 
-                if (! fifo.addInputData (mapping.endpoint, time,
-                                         choc::value::create2DArrayView (scratchBuffer.getView().data.data,
-                                                                         numFrames, mapping.channels.size())))
+                if (! fifo.addInputData (mapping.endpoint, time + start,
+                                         getChannelData (inputChannels.getFrameRange ({ start, end }), mapping.channels)))
                     return false;
             }
         }
@@ -153,15 +152,94 @@ struct AudioInputList
         return true;
     }
 
+    /** Adds the FIFO space needed for a block of the given number of frames. */
+    void addFIFOSpaceNeeded (MultiEndpointFIFO::SpaceNeeded& space, uint32_t numFrames) const
+    {
+        for (auto& mapping : mappings)
+            space.add (getFrameArrayType (mapping.channels.size(), mapping.maxFramesPerFIFOItem),
+                       (numFrames + mapping.maxFramesPerFIFOItem - 1) / mapping.maxFramesPerFIFOItem);
+    }
+
+    size_t getScratchMemoryUsage() const
+    {
+        return scratchBuffer.getNumChannels() * static_cast<size_t> (maxBlockSize) * sizeof (float);
+    }
+
     struct InputMapping
     {
         EndpointHandle endpoint;
         choc::buffer::ChannelRange channels;
+        uint32_t maxFramesPerFIFOItem;
     };
 
     std::vector<InputMapping> mappings;
     uint32_t maxBlockSize = 0, totalNumChannels = 0;
     choc::buffer::InterleavedBuffer<float> scratchBuffer;
+
+private:
+    static choc::value::Type getFrameArrayType (uint32_t numChannels, uint32_t numFrames)
+    {
+        if (numChannels == 1)
+            return choc::value::Type::createArray (choc::value::Type::createFloat32(), numFrames);
+
+        return choc::value::Type::createArray (choc::value::Type::createVectorFloat32 (numChannels), numFrames);
+    }
+
+    // A FIFO item can't be bigger than MultiEndpointFIFO::maxItemSize, so a block for an
+    // endpoint with several channels may need to be split into more than one item
+    static uint32_t getMaxFramesPerFIFOItem (uint32_t numChannels)
+    {
+        uint32_t numFrames = 1;
+
+        while (numFrames < 65536 && MultiEndpointFIFO::getItemSize (getFrameArrayType (numChannels, numFrames * 2))
+                                      <= MultiEndpointFIFO::maxItemSize)
+            numFrames *= 2;
+
+        return numFrames;
+    }
+
+    template <typename SampleType, template<typename> typename LayoutType>
+    choc::value::ValueView getChannelData (choc::buffer::BufferView<SampleType, LayoutType> input, choc::buffer::ChannelRange channels)
+    {
+        using Layout = LayoutType<std::remove_const_t<SampleType>>;
+        auto numFrames = input.getNumFrames();
+
+        if constexpr (std::is_same<std::remove_const_t<SampleType>, float>::value)
+        {
+            if (channels.end <= input.getNumChannels())
+            {
+                if constexpr (std::is_same<Layout, choc::buffer::SeparateChannelLayout<float>>::value)
+                {
+                    if (channels.size() == 1)
+                        return choc::value::createArrayView (const_cast<float*> (input.getChannel (channels.start).data.data), numFrames);
+                }
+                else if constexpr (std::is_same<Layout, choc::buffer::InterleavedLayout<float>>::value)
+                {
+                    if (channels.size() == input.data.stride)
+                    {
+                        auto start = const_cast<float*> (input.data.data) + channels.start;
+
+                        if (channels.size() == 1)
+                            return choc::value::createArrayView (start, numFrames);
+
+                        return choc::value::create2DArrayView (start, numFrames, channels.size());
+                    }
+                }
+            }
+        }
+
+        auto scratch = choc::buffer::createInterleavedView (scratchBuffer.getView().data.data, channels.size(), numFrames);
+
+        if (channels.start < input.getNumChannels())
+            copyIntersectionAndClearOutside (scratch, input.getChannelRange ({ channels.start, std::min (channels.end, input.getNumChannels()) }));
+        else
+            scratch.clear();
+
+        if (channels.size() == 1)
+            return choc::value::createArrayView (scratch.data.data, numFrames);
+
+        return choc::value::create2DArrayView (scratch.data.data, numFrames, channels.size());
+    }
 };
 
 //==============================================================================
@@ -189,21 +267,58 @@ struct AudioOutputList
     {
         mappings.clear();
         totalNumChannels = 0;
+        anyChannelsShared = false;
     }
 
     template <typename PerformerOrSession>
     void connectEndpoint (PerformerOrSession& p, EndpointID endpointID, choc::buffer::ChannelRange channels)
     {
+        for (auto& m : mappings)
+            if (channels.start < m.channels.end && m.channels.start < channels.end)
+                anyChannelsShared = true;
+
         mappings.push_back ({ p.getEndpointHandle (endpointID), channels });
         totalNumChannels = std::max (totalNumChannels, channels.end);
     }
 
-    template <typename PerformerOrSession>
-    void handleOutputData (PerformerOrSession& p, choc::buffer::ChannelArrayView<float> outputChannels)
+    /** Adds the performer's output to a choc buffer view of float or double samples. Any
+        endpoint channels which are beyond the end of the buffer are ignored.
+    */
+    template <typename PerformerOrSession, typename SampleType, template<typename> typename LayoutType>
+    void handleOutputData (PerformerOrSession& p, choc::buffer::BufferView<SampleType, LayoutType> outputChannels)
     {
+        auto numChannels = outputChannels.getNumChannels();
+
         for (auto& mapping : mappings)
-            addIntersection (outputChannels.getChannelRange (mapping.channels),
-                             getChannelSetFromArray (p.getOutputStreamFrames (mapping.endpoint)));
+            if (mapping.channels.start < numChannels)
+                addIntersection (outputChannels.getChannelRange ({ mapping.channels.start, std::min (mapping.channels.end, numChannels) }),
+                                 getChannelSetFromArray (p.getOutputStreamFrames (mapping.endpoint)));
+    }
+
+    /** Writes the performer's output to a buffer, overwriting its previous contents, so
+        unlike handleOutputData() it doesn't need the buffer to have been cleared first.
+        Only the channels which no endpoint writes to get cleared, unless several endpoints
+        share a channel, in which case their outputs have to be summed.
+    */
+    template <typename PerformerOrSession, typename SampleType, template<typename> typename LayoutType>
+    void replaceOutputData (PerformerOrSession& p, choc::buffer::BufferView<SampleType, LayoutType> outputChannels)
+    {
+        if (anyChannelsShared)
+        {
+            outputChannels.clear();
+            return handleOutputData (p, outputChannels);
+        }
+
+        auto numChannels = outputChannels.getNumChannels();
+
+        for (auto& mapping : mappings)
+            if (mapping.channels.start < numChannels)
+                copyIntersection (outputChannels.getChannelRange ({ mapping.channels.start, std::min (mapping.channels.end, numChannels) }),
+                                  getChannelSetFromArray (p.getOutputStreamFrames (mapping.endpoint)));
+
+        for (uint32_t i = 0; i < numChannels; ++i)
+            if (! isChannelMapped (i))
+                outputChannels.getChannelRange ({ i, i + 1 }).clear();
     }
 
     struct OutputMapping
@@ -214,6 +329,17 @@ struct AudioOutputList
 
     uint32_t totalNumChannels = 0;
     std::vector<OutputMapping> mappings;
+    bool anyChannelsShared = false;
+
+private:
+    bool isChannelMapped (uint32_t channel) const
+    {
+        for (auto& m : mappings)
+            if (m.channels.contains (channel))
+                return true;
+
+        return false;
+    }
 };
 
 //==============================================================================
@@ -265,6 +391,13 @@ struct MIDIInputList
         return true;
     }
 
+    /** Adds the FIFO space needed for a block containing the given number of MIDI events. */
+    void addFIFOSpaceNeeded (MultiEndpointFIFO::SpaceNeeded& space, uint32_t maxEventsPerBlock) const
+    {
+        for (auto& input : inputs)
+            space.add (input.midiEvent.getType(), maxEventsPerBlock);
+    }
+
     struct MIDIInput
     {
         EndpointHandle endpoint;
@@ -317,16 +450,28 @@ struct EventOutputList
 
     void clear()
     {
-        fifo.reset (128 * 1024, 4096);
+        fifo.reset (MultiEndpointFIFO::SpaceNeeded());
         endpointNames.clear();
     }
 
+    /** Connects all the non-MIDI event outputs, and sizes the FIFO so that each one can queue
+        up to maxEventsPerEndpoint events before they're delivered.
+    */
     template <typename PerformerOrSession>
-    void initialise (PerformerOrSession& p)
+    void initialise (PerformerOrSession& p, uint32_t maxEventsPerEndpoint)
     {
+        MultiEndpointFIFO::SpaceNeeded space;
+
         for (auto& e : getOutputEndpointsOfType (p, OutputEndpointType::event))
-            if (! isMIDIEventEndpoint (e))
+        {
+            if (! (isMIDIEventEndpoint (e) || isConsoleEndpoint (e.name)))
+            {
                 connectEndpoint (p, e.endpointID);
+                space.add (e, maxEventsPerEndpoint);
+            }
+        }
+
+        fifo.reset (space);
     }
 
     template <typename PerformerOrSession>
@@ -381,6 +526,299 @@ struct EventOutputList
     std::unordered_map<EndpointHandle, std::string> endpointNames;
 };
 
+//==============================================================================
+/** Collects the messages that a performer writes to its console, without formatting
+    them on the rendering thread.
+
+    Each message is stored in a FIFO as a small binary record holding its frame, the
+    index of its type in the console endpoint's list of types, and a copy of its raw
+    data, and is only turned into text when deliverPendingMessages() is called on the
+    reader's thread. The rendering thread is the only writer, so it never has to wait.
+    The text of any strings in the message is copied into the record after its data,
+    because the performer's string dictionary can't be used from the reader's thread.
+
+    A message whose data is bigger than maxMessageSize is truncated: an array or vector
+    keeps as many of its leading elements as will fit, and anything else is replaced by
+    a note saying that it was too large to display. Strings are cut short if there isn't
+    room for all of their text.
+
+    Rather than blocking, a message is dropped if the FIFO is full or if it goes over
+    the rate limit, and getNumDroppedMessages() returns the number that have been lost.
+*/
+struct ConsoleOutputList
+{
+    ConsoleOutputList() = default;
+
+    static constexpr uint32_t maxMessageSize = 1024;
+
+    static constexpr uint32_t fifoSize = 64 * 1024;
+
+    void clear()
+    {
+        fifo.reset (0);
+        outputs.clear();
+        types.clear();
+        stringOffsets.clear();
+        numDropped = 0;
+        lastDroppedFrame = 0;
+        windowStart = 0;
+        numMessagesInWindow = 0;
+    }
+
+    /** Limits the number of messages that can be recorded during each period of the
+        given number of frames, so that a processor which logs on every frame can't flood
+        the FIFO. A maxMessages value of 0 removes the limit.
+    */
+    void setRateLimit (uint32_t maxMessages, uint64_t framesPerPeriod)
+    {
+        maxMessagesPerWindow = maxMessages;
+        framesPerWindow = std::max<uint64_t> (framesPerPeriod, 1);
+    }
+
+    template <typename PerformerOrSession>
+    void initialise (PerformerOrSession& p)
+    {
+        for (auto& e : getOutputEndpointsOfType (p, OutputEndpointType::event))
+        {
+            if (isConsoleEndpoint (e.name))
+            {
+                outputs.push_back ({ p.getEndpointHandle (e.endpointID), types.size(), e.dataTypes.size() });
+                types.insert (types.end(), e.dataTypes.begin(), e.dataTypes.end());
+
+                for (auto& type : e.dataTypes)
+                    stringOffsets.push_back (findStringOffsets (type));
+            }
+        }
+
+        if (! outputs.empty())
+            fifo.reset (fifoSize);
+    }
+
+    template <typename PerformerOrSession>
+    void postOutputEvents (PerformerOrSession& p, uint64_t position)
+    {
+        for (auto& output : outputs)
+        {
+            p.iterateOutputEvents (output.handle, [&] (uint32_t frameOffset, const choc::value::ValueView& event) -> bool
+            {
+                addMessage (output, position + frameOffset, event);
+                return true;
+            });
+        }
+    }
+
+    /** Formats and passes on any messages that are waiting in the FIFO. The function will
+        be called as handleMessage (uint64_t frameIndex, const std::string& text).
+    */
+    template <typename HandleMessageFn>
+    void deliverPendingMessages (HandleMessageFn&& handleMessage)
+    {
+        fifo.popAllAvailable ([&] (void* data, uint32_t size)
+        {
+            Record record;
+            SOUL_ASSERT (size >= sizeof (record));
+            std::memcpy (std::addressof (record), data, sizeof (record));
+            SOUL_ASSERT (record.typeIndex < types.size() && sizeof (record) + record.dataSize <= size);
+
+            auto& type = types[record.typeIndex];
+            auto valueData = static_cast<char*> (data) + sizeof (record);
+            auto dataSize = record.dataSize;
+            RecordStrings strings (valueData + dataSize, size - static_cast<uint32_t> (sizeof (record)) - dataSize);
+
+            std::string text;
+
+            if (dataSize == type.getValueDataSize())
+            {
+                text = dump (choc::value::ValueView (type, valueData, std::addressof (strings)));
+            }
+            else if (type.isUniformArray() || type.isVector())
+            {
+                auto elementType = type.getElementType();
+                auto numElements = static_cast<uint32_t> (dataSize / elementType.getValueDataSize());
+                auto truncatedType = choc::value::Type::createArray (elementType, numElements);
+
+                text = dump (choc::value::ValueView (truncatedType, valueData, std::addressof (strings)))
+                         + " ... (" + std::to_string (type.getNumElements() - numElements) + " more elements)";
+            }
+            else
+            {
+                text = "(" + dump (type) + " value too large to display)";
+            }
+
+            handleMessage (record.frameIndex, text);
+        });
+    }
+
+    uint64_t getNumDroppedMessages() const      { return numDropped; }
+
+    /** Returns the frame of the most recently dropped message. */
+    uint64_t getLastDroppedMessageFrame() const { return lastDroppedFrame; }
+    size_t getMemoryUsage() const               { return outputs.empty() ? 0 : fifoSize; }
+
+private:
+    struct Output
+    {
+        EndpointHandle handle;
+        size_t firstType, numTypes;
+    };
+
+    // A record is followed by dataSize bytes of the value's data, and then the text of each
+    // of its strings, with a null terminator. The string handles in the copy of the data
+    // are replaced by one plus the position of their text, or 0 if it didn't fit.
+    struct Record
+    {
+        uint64_t frameIndex;
+        uint32_t typeIndex, dataSize;
+    };
+
+    struct RecordStrings  : public choc::value::StringDictionary
+    {
+        RecordStrings (const char* d, uint32_t s) : text (d), size (s) {}
+
+        Handle getHandleForString (std::string_view) override     { SOUL_ASSERT_FALSE; return {}; }
+
+        std::string_view getStringForHandle (Handle h) const override
+        {
+            if (h.handle == 0 || h.handle > size)
+                return {};
+
+            return std::string_view (text + h.handle - 1);
+        }
+
+        const char* text;
+        uint32_t size;
+    };
+
+    std::vector<Output> outputs;
+    std::vector<choc::value::Type> types;
+    std::vector<std::vector<uint32_t>> stringOffsets;
+    choc::fifo::VariableSizeFIFO fifo;
+    std::atomic<uint64_t> numDropped { 0 }, lastDroppedFrame { 0 };
+    uint32_t maxMessagesPerWindow = 0, numMessagesInWindow = 0;
+    uint64_t framesPerWindow = 1, windowStart = 0;
+
+    bool isWithinRateLimit (uint64_t frameIndex)
+    {
+        if (maxMessagesPerWindow == 0)
+            return true;
+
+        if (frameIndex >= windowStart + framesPerWindow)
+        {
+            windowStart = frameIndex - (frameIndex - windowStart) % framesPerWindow;
+            numMessagesInWindow = 0;
+        }
+
+        if (numMessagesInWindow >= maxMessagesPerWindow)
+            return false;
+
+        ++numMessagesInWindow;
+        return true;
+    }
+
+    template <typename VisitFn>
+    static void visitStrings (const choc::value::ValueView& value, VisitFn&& visit)
+    {
+        if (value.isString())
+            visit (value);
+        else if (! value.getType().usesStrings())
+            return;
+        else if (value.isArray())
+            for (uint32_t i = 0; i < value.size(); ++i)
+                visitStrings (value[i], visit);
+        else if (value.isObject())
+            for (uint32_t i = 0; i < value.size(); ++i)
+                visitStrings (value.getObjectMemberAt (i).value, visit);
+    }
+
+    // Finding these when the endpoints are connected means that the rendering thread
+    // doesn't need to walk through the value's type to find its strings
+    static std::vector<uint32_t> findStringOffsets (const choc::value::Type& type)
+    {
+        std::vector<uint32_t> offsets;
+
+        if (type.usesStrings())
+        {
+            choc::value::Value value (type);
+            auto start = static_cast<const char*> (value.getRawData());
+
+            visitStrings (value, [&] (const choc::value::ValueView& s)
+            {
+                offsets.push_back (static_cast<uint32_t> (static_cast<const char*> (s.getRawData()) - start));
+            });
+        }
+
+        return offsets;
+    }
+
+    uint32_t copyStrings (const choc::value::ValueView& value, const std::vector<uint32_t>& offsets,
+                          char* valueData, uint32_t dataSize, uint32_t spaceAvailable)
+    {
+        uint32_t stringDataSize = 0;
+
+        for (auto offset : offsets)
+        {
+            if (offset + sizeof (uint32_t) > dataSize)
+                break;
+
+            choc::value::StringDictionary::Handle handle;
+            std::memcpy (std::addressof (handle.handle), valueData + offset, sizeof (handle.handle));
+            std::string_view text;
+
+            if (auto dictionary = value.getDictionary())
+                text = dictionary->getStringForHandle (handle);
+
+            handle.handle = 0;
+
+            if (stringDataSize < spaceAvailable)
+            {
+                auto length = std::min (static_cast<uint32_t> (text.length()), spaceAvailable - stringDataSize - 1);
+                auto dest = valueData + dataSize + stringDataSize;
+                std::memcpy (dest, text.data(), length);
+                dest[length] = 0;
+                handle.handle = stringDataSize + 1;
+                stringDataSize += length + 1;
+            }
+
+            std::memcpy (valueData + offset, std::addressof (handle.handle), sizeof (handle.handle));
+        }
+
+        return stringDataSize;
+    }
+
+    void addMessage (const Output& output, uint64_t frameIndex, const choc::value::ValueView& value)
+    {
+        if (isWithinRateLimit (frameIndex))
+        {
+            const auto& type = value.getType();
+            auto dataSize = static_cast<uint32_t> (std::min (type.getValueDataSize(), maxMessageSize - sizeof (Record)));
+
+            for (auto i = output.firstType; i < output.firstType + output.numTypes; ++i)
+            {
+                if (types[i] == type)
+                {
+                    char record[maxMessageSize];
+                    auto valueData = record + sizeof (Record);
+                    std::memcpy (valueData, value.getRawData(), dataSize);
+
+                    auto stringDataSize = copyStrings (value, stringOffsets[i], valueData, dataSize,
+                                                       maxMessageSize - static_cast<uint32_t> (sizeof (Record)) - dataSize);
+
+                    Record header { frameIndex, static_cast<uint32_t> (i), dataSize };
+                    std::memcpy (record, std::addressof (header), sizeof (header));
+
+                    if (fifo.push (record, static_cast<uint32_t> (sizeof (header)) + dataSize + stringDataSize))
+                        return;
+
+                    break;
+                }
+            }
+        }
+
+        ++numDropped;
+        lastDroppedFrame = frameIndex;
+    }
+};
+
 //==============================================================================
 /** Holds the values for a list of traditional float32 parameters, and efficiently
     allows them to be updated and for changed ones to be iterated.
@@ -455,6 +893,13 @@ struct ParameterStateList
         dirtyList.markAsDirty (parameters[parameterIndex].dirtyListHandle);
     }
 
+    /** Adds the FIFO space needed for every parameter to change once. */
+    void addFIFOSpaceNeeded (MultiEndpointFIFO::SpaceNeeded& space) const
+    {
+        for (auto& param : parameters)
+            space.add (param.rampFrames == 0 ? valueHolder.getType() : rampedValueHolder.getType(), 1);
+    }
+
     /** Pushes events for any endpoints which have had their value
         modified by setParameter() or markAsChanged().
     */
@@ -656,7 +1101,8 @@ struct AudioMIDIWrapper
         midiOutputList.clear();
         timelineEventEndpointList.clear();
         eventOutputList.clear();
-        inputFIFO.reset (256 * maxInternalBlockSize, maxInternalBlockSize * 2);
+        consoleOutputList.clear();
+        inputFIFO.reset (MultiEndpointFIFO::SpaceNeeded());
         maxBlockSize = 0;
     }
 
@@ -681,16 +1127,40 @@ struct AudioMIDIWrapper
         midiOutputList.initialise (perf);
         parameterList.initialise (perf, std::move (getRampLengthForSparseStreamFn));
         timelineEventEndpointList.initialise (perf);
-        eventOutputList.initialise (perf);
+        eventOutputList.initialise (perf, maxQueuedEventsPerEndpoint);
+        consoleOutputList.initialise (perf);
+
+        // The input FIFO needs room for a whole block of audio, MIDI and parameter changes,
+        // plus any events that other threads have posted to the event inputs
+        MultiEndpointFIFO::SpaceNeeded inputSpace;
+        audioInputList.addFIFOSpaceNeeded (inputSpace, maxInternalBlockSize);
+        midiInputList.addFIFOSpaceNeeded (inputSpace, maxMIDIEventsPerBlock);
+        parameterList.addFIFOSpaceNeeded (inputSpace);
+
+        for (auto& e : getEventInputEndpoints())
+            inputSpace.add (e, maxQueuedEventsPerEndpoint);
+
+        inputFIFO.reset (inputSpace);
     }
 
-    void render (choc::buffer::ChannelArrayView<const float> input,
-                 choc::buffer::ChannelArrayView<float> output,
+    /** Renders a block, reading and writing any kind of choc buffer views with float or
+        double samples, e.g. channel arrays or interleaved data.
+
+        The number of channels doesn't have to match getExpectedNumInputChannels() and
+        getExpectedNumOutputChannels(): missing input channels are silent, and output
+        channels that the performer doesn't write are cleared. Each output frame is written
+        exactly once, so the output doesn't need clearing beforehand, and because the input
+        is consumed before anything gets written, it's fine for the input and output to be
+        the same memory, as long as they have the same layout.
+    */
+    template <typename InputSample, template<typename> typename InputLayout,
+              typename OutputSample, template<typename> typename OutputLayout>
+    void render (choc::buffer::BufferView<InputSample, InputLayout> input,
+                 choc::buffer::BufferView<OutputSample, OutputLayout> output,
                  MIDIEventInputList midiIn,
                  MIDIEventOutputList& midiOut)
     {
         auto numFrames = output.getNumFrames();
-        output.clear();
 
         if (numFrames > maxInternalBlockSize)
             return renderInChunks (input, output, midiIn, midiOut);
@@ -718,9 +1188,10 @@ struct AudioMIDIWrapper
                                             deliverValueToEndpoint (endpoint, value);
                                         });
             performer.advance();
-            audioOutputList.handleOutputData (performer, output.getFrameRange ({ framesDone, output.size.numFrames }));
+            audioOutputList.replaceOutputData (performer, output.getFrameRange ({ framesDone, framesDone + numFramesToDo }));
             midiOutputList.handleOutputData (performer, framesDone, midiOut);
             eventOutputList.postOutputEvents (performer, totalFramesRendered + framesDone);
+            consoleOutputList.postOutputEvents (performer, totalFramesRendered + framesDone);
             framesDone += numFramesToDo;
         }
 
@@ -728,6 +1199,15 @@ struct AudioMIDIWrapper
         totalFramesRendered += framesDone;
     }
 
+    /** Returns the number of bytes allocated for the FIFOs that carry data to and from the performer. */
+    size_t getFIFOMemoryUsage() const
+    {
+        return inputFIFO.getMemoryUsage() + eventOutputList.fifo.getMemoryUsage() + consoleOutputList.getMemoryUsage();
+    }
+
+    /** Returns the number of bytes allocated for temporary buffers used while rendering. */
+    size_t getScratchMemoryUsage() const        { return audioInputList.getScratchMemoryUsage(); }
+
     uint32_t getExpectedNumInputChannels() const     { return audioInputList.totalNumChannels; }
     uint32_t getExpectedNumOutputChannels() const    { return audioOutputList.totalNumChannels; }
 
@@ -742,9 +1222,16 @@ struct AudioMIDIWrapper
         eventOutputList.deliverPendingEvents (handleEvent);
     }
 
+    template <typename HandleMessageFn>
+    void deliverConsoleMessages (HandleMessageFn&& handleMessage)
+    {
+        consoleOutputList.deliverPendingMessages (handleMessage);
+    }
+
     Performer& performer;
     ParameterStateList parameterList;
     TimelineEventEndpointList timelineEventEndpointList;
+    ConsoleOutputList consoleOutputList;
     uint64_t totalFramesRendered = 0;
 
 private:
@@ -760,9 +1247,12 @@ private:
     uint32_t maxBlockSize = 0;
 
     static constexpr uint32_t maxInternalBlockSize = 512;
+    static constexpr uint32_t maxMIDIEventsPerBlock = 1024;
+    static constexpr uint32_t maxQueuedEventsPerEndpoint = 256;
 
-    void renderInChunks (choc::buffer::ChannelArrayView<const float> input,
-                         choc::buffer::ChannelArrayView<float> output,
+    template <typename InputView, typename OutputView>
+    void renderInChunks (InputView input,
+                         OutputView output,
                          MIDIEventInputList midiIn,
                          MIDIEventOutputList& midiOut)
     {
@@ -46,11 +46,28 @@ struct Identifier  final
         Pool() = default;
         Pool (const Pool&) = delete;
         Pool (Pool&&) = default;
+        Pool& operator= (Pool&&) = default;
+
+        /** Creates a pool which will return the base pool's identifiers for any strings
+            that it contains, and only stores new strings itself. The base can itself have
+            a base, in which case the whole chain is searched.
+            Because the base is shared and never modified, any number of pools on different
+            threads can safely use the same one.
+        */
+        Pool (std::shared_ptr<const Pool> base) : sharedBase (std::move (base)) {}
 
         Identifier get (std::string_view newString)
         {
             SOUL_ASSERT (! newString.empty());
 
+            if (sharedBase != nullptr)
+            {
+                auto i = sharedBase->find (newString);
+
+                if (i.isValid())
+                    return i;
+            }
+
             size_t s = 0;
             size_t e = strings.size();
 
@@ -78,9 +95,9 @@ struct Identifier  final
                     s = halfway;
             }
 
-            auto* sharedString = new std::string (newString);
-            strings.insert (strings.begin() + (int) s, std::unique_ptr<std::string> (sharedString));
-            return Identifier (sharedString);
+            auto sharedString = std::make_shared<const std::string> (newString);
+            strings.insert (strings.begin() + (int) s, sharedString);
+            return Identifier (sharedString.get());
         }
 
         Identifier get (const Identifier& i)
@@ -91,13 +108,43 @@ struct Identifier  final
             return get (static_cast<std::string_view> (i));
         }
 
+        /** Returns the identifier for a string if it's already in the pool (or in its base
+            pool, if it has one), or an invalid one if not.
+        */
+        Identifier find (std::string_view s) const
+        {
+            auto found = std::lower_bound (strings.begin(), strings.end(), s,
+                                           [] (const std::shared_ptr<const std::string>& a, std::string_view b) { return *a < b; });
+
+            if (found != strings.end() && **found == s)
+                return Identifier (found->get());
+
+            if (sharedBase != nullptr)
+                return sharedBase->find (s);
+
+            return {};
+        }
+
+        /** Makes this empty pool hold the same strings as another one, so that any identifier
+            from the other pool is also one of this pool's identifiers. The strings themselves
+            are shared rather than copied, and stay alive for as long as either pool needs them.
+        */
+        void shareStringsOf (const Pool& other)
+        {
+            SOUL_ASSERT (strings.empty() && sharedBase == nullptr);
+            strings = other.strings;
+            sharedBase = other.sharedBase;
+        }
+
+        /** Removes all the strings that this pool holds. Any shared base pool is left in place. */
         void clear()
         {
             strings.clear();
         }
 
     private:
-        std::vector<std::unique_ptr<std::string>> strings;
+        std::vector<std::shared_ptr<const std::string>> strings;
+        std::shared_ptr<const Pool> sharedBase;
     };
 
 private:
@@ -38,16 +38,17 @@ struct MultiEndpointFIFO
 
     ~MultiEndpointFIFO() = default;
 
-    void reset (uint32_t fifoSize, uint32_t maxNumPendingItems)
+    void reset (uint32_t newFIFOSize, uint32_t maxNumPendingItems)
     {
         fifoBatchReadOp.release();
 
+        fifoSize = newFIFOSize;
         fifo.reset (fifoSize);
-        itemPool.resize (maxNumPendingItems);
+        itemPool = std::vector<Item> (maxNumPendingItems);
 
-        pendingItems.clear();
+        pendingItems = {};
         pendingItems.reserve (maxNumPendingItems);
-        freeItems.clear();
+        freeItems = {};
         freeItems.reserve (maxNumPendingItems);
 
         for (auto& i : itemPool)
@@ -190,10 +191,13 @@ struct MultiEndpointFIFO
     bool iterateAllAvailable (HandleItem&& handleItem)
     {
         bool success = true;
-        incomingItemAllocator->reset();
 
         fifo.popAllAvailable ([&] (const void* data, uint32_t size)
                               {
+                                  // Each item is finished with before the next one is read, so
+                                  // they can all re-use the same space for their types
+                                  incomingItemAllocator->reset();
+
                                   auto d = static_cast<const uint8_t*> (data);
                                   Item item;
 
@@ -208,6 +212,82 @@ struct MultiEndpointFIFO
 
     static constexpr uint32_t maxItemSize = 4096;
 
+    /** The number of bytes that getItemSize() allows for the content of the strings in an
+        item, as this can't be known from its type.
+    */
+    static constexpr uint32_t stringContentAllowance = 256;
+
+    /** Returns the number of bytes that an item holding a value of the given type is expected
+        to take up in the FIFO. If the type contains any strings, this includes an allowance of
+        stringContentAllowance bytes for their content, so an item with longer strings than
+        that will use some of the FIFO's headroom.
+    */
+    static uint32_t getItemSize (const choc::value::Type& type)
+    {
+        struct ByteCounter
+        {
+            size_t total = sizeof (uint32_t) + sizeof (uint64_t) + sizeof (soul::EndpointHandle);
+            void write (const void*, size_t size)   { total += size; }
+        };
+
+        ByteCounter counter;
+        choc::value::Value (type).serialise (counter);
+
+        if (type.usesStrings())
+            counter.total += stringContentAllowance;
+
+        return static_cast<uint32_t> (counter.total);
+    }
+
+    /** Adds up the space that a FIFO will need for a set of items, so that it can be
+        sized for the endpoints that are actually in use.
+    */
+    struct SpaceNeeded
+    {
+        size_t numBytes = 0;
+        uint32_t numItems = 0;
+
+        void add (const choc::value::Type& type, uint32_t numItemsOfType)
+        {
+            numBytes += static_cast<size_t> (getItemSize (type)) * numItemsOfType;
+            numItems += numItemsOfType;
+        }
+
+        /** Adds space for items of the largest of the endpoint's data types. */
+        void add (const EndpointDetails& endpoint, uint32_t numItemsOfType)
+        {
+            uint32_t largestItem = 0;
+
+            for (auto& type : endpoint.dataTypes)
+                largestItem = std::max (largestItem, getItemSize (type));
+
+            numBytes += static_cast<size_t> (largestItem) * numItemsOfType;
+            numItems += numItemsOfType;
+        }
+    };
+
+    /** Resets the FIFO with room for twice the given amount of data, which leaves enough
+        headroom for items that won't fit into the space left at the end of its buffer.
+    */
+    void reset (const SpaceNeeded& space)
+    {
+        uint32_t size = 4096;
+
+        while (size < space.numBytes * 2)
+            size *= 2;
+
+        reset (size, std::max (64u, space.numItems * 2));
+    }
+
+    /** Returns the number of bytes that have been allocated for this FIFO and its items. */
+    size_t getMemoryUsage() const
+    {
+        return fifoSize
+                + itemPool.capacity() * sizeof (Item)
+                + (pendingItems.capacity() + freeItems.capacity()) * sizeof (Item*)
+                + incomingItemAllocationSpace;
+    }
+
 private:
     struct SerialisedStringDictionary  : public choc::value::StringDictionary
     {
@@ -261,6 +341,7 @@ private:
 
     choc::fifo::VariableSizeFIFO fifo;
     choc::fifo::VariableSizeFIFO::BatchReadOperation fifoBatchReadOp;
+    uint32_t fifoSize = 0;
 
     static constexpr size_t incomingItemAllocationSpace = 65536;
     std::unique_ptr<choc::value::FixedPoolAllocator<incomingItemAllocationSpace>> incomingItemAllocator;
@@ -232,6 +232,8 @@ public:
         pools.clear();
         pools.reserve (32);
         addNewPool();
+        totalBytesAllocated = 0;
+        totalItemsAllocated = 0;
     }
 
     /** Allocates a new object for the pool, returning a reference to it. */
@@ -249,6 +251,12 @@ public:
         return *newObject;
     }
 
+    /** Returns the total number of bytes that have been used by objects in the pool. */
+    size_t getTotalBytesAllocated() const noexcept     { return totalBytesAllocated; }
+
+    /** Returns the total number of objects that have been allocated in the pool. */
+    size_t getTotalItemsAllocated() const noexcept     { return totalItemsAllocated; }
+
 private:
     using DestructorFn = void(void*);
 
@@ -316,6 +324,7 @@ private:
 
     std::vector<std::unique_ptr<Pool>> pools;
     Pool* currentPool = nullptr;
+    size_t totalBytesAllocated = 0, totalItemsAllocated = 0;
 
     void addNewPool()
     {
@@ -331,7 +340,10 @@ private:
             SOUL_ASSERT (currentPool->hasSpaceFor (size));
         }
 
-        return currentPool->createItem (size);
+        auto& item = currentPool->createItem (size);
+        totalBytesAllocated += item.size;
+        ++totalItemsAllocated;
+        return item;
     }
 };
 
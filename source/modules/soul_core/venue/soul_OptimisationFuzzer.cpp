@@ -0,0 +1,1046 @@
+/*
+    _____ _____ _____ __
+   |   __|     |  |  |  |      The SOUL language
+   |__   |  |  |  |  |  |__    Copyright (c) 2019 - ROLI Ltd.
+   |_____|_____|_____|_____|
+
+   The code in this file is provided under the terms of the ISC license:
+
+   Permission to use, copy, modify, and/or distribute this software for any purpose
+   with or without fee is hereby granted, provided that the above copyright notice and
+   this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+   TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+   NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+   IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+   CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#if ! SOUL_INSIDE_CORE_CPP
+ #error "Don't add this cpp file to your build, it gets included indirectly by soul_core.cpp"
+#endif
+
+namespace soul
+{
+
+static std::mt19937 createFuzzerRandom (uint64_t seed, size_t caseIndex)
+{
+    std::seed_seq sequence { static_cast<uint32_t> (seed), static_cast<uint32_t> (seed >> 32), static_cast<uint32_t> (caseIndex) };
+    return std::mt19937 (sequence);
+}
+
+//==============================================================================
+struct OptimisationFuzzer::TestCase
+{
+    TestCase (const Options& o, std::string caseName, BuildBundle b, bool shouldChange, size_t caseIndex)
+        : options (o), name (std::move (caseName)), bundle (std::move (b)), makeChanges (shouldChange),
+          random (createFuzzerRandom (o.randomSeed, caseIndex))
+    {
+        bundle.settings.sampleRate = options.sampleRate;
+        bundle.settings.maxBlockSize = options.blockSize;
+    }
+
+    Result run()
+    {
+        result.name = name;
+
+        CompileMessageList messages;
+        auto program = Compiler::buildUnoptimised (messages, bundle);
+
+        if (program.isEmpty())
+            return skip ("Failed to compile: " + getFirstError (messages));
+
+        originalHEART = program.toHEART();
+
+        if (makeChanges)
+            createRandomChanges (program);
+
+        auto heart = applyChanges (changes);
+
+        if (heart.empty())
+            return skip ("Failed to apply the random changes");
+
+        auto reference = render (heart, {}, options.numFramesToRender);
+
+        if (! reference.error.empty())
+            return skip ("The unoptimised program failed: " + reference.error);
+
+        for (auto level : options.optimisationLevels)
+        {
+            Variant optimised { level, true, false };
+            auto divergence = compare (reference, render (heart, optimised, options.numFramesToRender), optimised);
+
+            if (divergence.found)
+                return minimise (heart, optimised, divergence);
+        }
+
+        if (options.testGraphLowering && program.getMainProcessor().isGraph())
+        {
+            Variant lowered { 0, true, true };
+            auto rendering = render (heart, lowered, options.numFramesToRender);
+
+            // A graph that uses a feature which can't be lowered isn't a miscompilation
+            if (rendering.failedToLower)
+            {
+                result.message = rendering.error;
+            }
+            else
+            {
+                auto divergence = compare (reference, rendering, lowered);
+
+                if (divergence.found)
+                    return minimise (heart, lowered, divergence);
+            }
+        }
+
+        for (auto& c : changes)
+            result.changes.push_back (c.description);
+
+        return result;
+    }
+
+private:
+    //==============================================================================
+    const Options& options;
+    const std::string name;
+    BuildBundle bundle;
+    const bool makeChanges;
+    std::mt19937 random;
+
+    Result result;
+    std::string originalHEART;
+    uint32_t numRendersLeft = 0;
+
+    Result skip (std::string message)
+    {
+        result.status = Status::skipped;
+        result.message = std::move (message);
+        return result;
+    }
+
+    static std::string getFirstError (const CompileMessageList& messages)
+    {
+        for (auto& m : messages.messages)
+            if (m.isError())
+                return m.getFullDescription();
+
+        return "Unknown error";
+    }
+
+    //==============================================================================
+    // The HEART code is modified by parsing it, changing the program, and printing it
+    // again, and the result is empty if the modified program isn't valid.
+    template <typename ModifyFn>
+    static std::string modifyHEART (const std::string& heart, ModifyFn&& modify)
+    {
+        CompileMessageList messages;
+        auto program = Program::createFromHEART (messages, CodeLocation::createFromString ("fuzzer", heart));
+
+        if (program.isEmpty())
+            return {};
+
+        try
+        {
+            CompileMessageHandler handler (messages);
+
+            if (! modify (program))
+                return {};
+
+            heart::Checker::sanityCheck (program);
+            return program.toHEART();
+        }
+        catch (AbortCompilationException) {}
+
+        return {};
+    }
+
+    static std::string getFunctionName (const Module& module, const heart::Function& f)
+    {
+        return module.fullName + "::" + f.name.toString();
+    }
+
+    //==============================================================================
+    // A change either scales a floating point constant, or swaps a floating point add,
+    // subtract or multiply for one of the others. Neither can alter the program's
+    // structure, so the sites they apply to are numbered in the same order however
+    // many of the other changes have been made.
+    struct Change
+    {
+        size_t site = 0;
+        double factor = 1.0;
+        uint32_t operatorChoice = 0;
+        std::string description;
+    };
+
+    std::vector<Change> changes;
+
+    static bool isChangeable (heart::Expression& e)
+    {
+        if (auto c = cast<heart::Constant> (e))
+            return c->value.getType().isPrimitive() && c->value.getType().isFloatingPoint();
+
+        if (auto b = cast<heart::BinaryOperator> (e))
+            return (b->operation == BinaryOp::Op::add || b->operation == BinaryOp::Op::subtract || b->operation == BinaryOp::Op::multiply)
+                     && b->getType().isFloatingPoint();
+
+        return false;
+    }
+
+    template <typename VisitorFn>
+    static void visitChangeSites (Program& program, VisitorFn&& visit)
+    {
+        for (auto& m : program.getModules())
+        {
+            for (auto& f : m->functions.get())
+            {
+                f->visitExpressions ([&] (pool_ref<heart::Expression>& e, AccessType mode)
+                {
+                    if (mode == AccessType::read && isChangeable (e))
+                        visit (m.get(), f.get(), e);
+                });
+            }
+        }
+    }
+
+    void createRandomChanges (Program& program)
+    {
+        size_t numSites = 0;
+        visitChangeSites (program, [&] (Module&, heart::Function&, pool_ref<heart::Expression>&) { ++numSites; });
+
+        if (numSites == 0)
+            return;
+
+        auto numChanges = std::uniform_int_distribution<uint32_t> (1, std::max (1u, options.maxChangesPerVariant)) (random);
+
+        for (uint32_t i = 0; i < numChanges; ++i)
+        {
+            Change c;
+            c.site = std::uniform_int_distribution<size_t> (0, numSites - 1) (random);
+            c.factor = std::uniform_real_distribution<double> (0.5, 2.0) (random);
+            c.operatorChoice = std::uniform_int_distribution<uint32_t> (0, 1) (random);
+            changes.push_back (std::move (c));
+        }
+    }
+
+    // Returns the original HEART with some changes applied, and fills in their descriptions
+    std::string applyChanges (std::vector<Change>& changesToApply) const
+    {
+        if (changesToApply.empty())
+            return originalHEART;
+
+        return modifyHEART (originalHEART, [&] (Program& program)
+        {
+            for (auto& change : changesToApply)
+            {
+                size_t site = 0;
+
+                visitChangeSites (program, [&] (Module& module, heart::Function& f, pool_ref<heart::Expression>& e)
+                {
+                    if (site++ != change.site)
+                        return;
+
+                    if (auto c = cast<heart::Constant> (e))
+                    {
+                        auto oldValue = c->value.getAsDouble();
+                        auto newValue = oldValue == 0 ? change.factor - 1.0 : oldValue * change.factor;
+
+                        e = program.getAllocator().allocate<heart::Constant> (c->location, Value (newValue).castToTypeExpectingSuccess (c->value.getType()));
+                        change.description = "In " + getFunctionName (module, f) + ", changed the constant " + choc::text::floatToString (oldValue, 6)
+                                               + " to " + choc::text::floatToString (newValue, 6);
+                    }
+                    else if (auto b = cast<heart::BinaryOperator> (e))
+                    {
+                        const BinaryOp::Op ops[] = { BinaryOp::Op::add, BinaryOp::Op::subtract, BinaryOp::Op::multiply };
+                        std::vector<BinaryOp::Op> otherOps;
+
+                        for (auto op : ops)
+                            if (op != b->operation)
+                                otherOps.push_back (op);
+
+                        auto newOp = otherOps[change.operatorChoice % otherOps.size()];
+                        change.description = "In " + getFunctionName (module, f) + ", changed an operator " + choc::text::addDoubleQuotes (BinaryOp::getSymbol (b->operation))
+                                               + " to " + choc::text::addDoubleQuotes (BinaryOp::getSymbol (newOp));
+                        b->operation = newOp;
+                    }
+                });
+            }
+
+            return true;
+        });
+    }
+
+    //==============================================================================
+    // A statement can be simplified if its value can be replaced by a zero, or if it
+    // can just be removed. Only floating point values are replaced, because changing
+    // an integer or bool could stop a loop from terminating, and for the same reason,
+    // calls which might modify their arguments are left alone.
+    static bool canBeSimplified (heart::Statement& s)
+    {
+        if (is_type<heart::WriteStream> (s))
+            return true;
+
+        if (auto a = cast<heart::AssignFromValue> (s))
+            return ! is_type<heart::Constant> (a->source) && hasFloatingPointTarget (*a);
+
+        if (auto call = cast<heart::FunctionCall> (s))
+        {
+            for (auto& p : call->getFunction().parameters)
+                if (p->type.isReference())
+                    return false;
+
+            return call->target == nullptr || hasFloatingPointTarget (*call);
+        }
+
+        return false;
+    }
+
+    static bool hasFloatingPointTarget (heart::Assignment& a)
+    {
+        if (a.target == nullptr)
+            return false;
+
+        auto type = a.target->getType().removeReferenceIfPresent();
+        return type.isPrimitiveOrVector() && type.isFloatingPoint();
+    }
+
+    // Removes the namespace functions that the processors don't call, which are mostly
+    // from the standard library, and then any namespaces left empty
+    static std::string removeUnusedFunctions (const std::string& heart)
+    {
+        return modifyHEART (heart, [] (Program& program)
+        {
+            for (auto& m : program.getModules())
+                for (auto& f : m->functions.get())
+                    f->functionUseTestFlag = false;
+
+            for (auto& m : program.getModules())
+                if (! m->isNamespace())
+                    for (auto& f : m->functions.get())
+                        heart::Utilities::recursivelyFlagFunctionUse (f);
+
+            for (auto& m : program.getModules())
+                if (m->isNamespace())
+                    m->functions.removeIf ([] (heart::Function& f) { return ! f.functionUseTestFlag; });
+
+            Optimisations::removeUnusedNamespaces (program);
+            return true;
+        });
+    }
+
+    static std::string simplifyStatement (const std::string& heart, size_t index)
+    {
+        return modifyHEART (heart, [&] (Program& program)
+        {
+            size_t statementIndex = 0;
+
+            for (auto& m : program.getModules())
+            {
+                for (auto& f : m->functions.get())
+                {
+                    for (auto b : f->blocks)
+                    {
+                        LinkedList<heart::Statement>::Iterator last;
+
+                        for (auto s : b->statements)
+                        {
+                            if (canBeSimplified (*s) && statementIndex++ == index)
+                            {
+                                auto assignment = cast<heart::Assignment> (*s);
+
+                                if (assignment != nullptr && assignment->target != nullptr)
+                                {
+                                    auto& target = *assignment->target;
+                                    auto& zero = program.getAllocator().allocateZeroInitialiser (target.getType().removeReferenceIfPresent());
+                                    b->statements.replaceAfter (last, program.getAllocator().allocate<heart::AssignFromValue> (s->location, target, zero));
+                                }
+                                else
+                                {
+                                    b->statements.removeNext (last);
+                                }
+
+                                return true;
+                            }
+
+                            last = *s;
+                        }
+                    }
+                }
+            }
+
+            return false;
+        });
+    }
+
+    //==============================================================================
+    struct OutputEvent
+    {
+        uint64_t frame;
+        std::string endpoint;
+        choc::value::Value value;
+    };
+
+    struct Rendering
+    {
+        choc::buffer::ChannelArrayBuffer<float> audio;
+        std::vector<MIDIEvent> midi;
+        std::vector<OutputEvent> events;
+        std::string error;
+        bool failedToLower = false;
+    };
+
+    // How the HEART code is transformed before it gets rendered. The reference rendering
+    // uses the default, and the others get compared with it.
+    struct Variant
+    {
+        int optimisationLevel = 0;
+        bool optimise = false, lowerGraphs = false;
+
+        std::string getDescription() const    { return lowerGraphs ? "lowered" : "optimised"; }
+    };
+
+    static std::vector<MIDIEvent> createMIDIStimulus (uint64_t numFrames, double sampleRate)
+    {
+        static constexpr uint8_t notes[] = { 48, 60, 64, 67, 72, 55, 62, 69 };
+
+        std::vector<MIDIEvent> events;
+        auto noteInterval = static_cast<uint64_t> (sampleRate * 0.05);
+        auto noteLength   = static_cast<uint64_t> (sampleRate * 0.03);
+
+        for (uint64_t i = 0; (i + 1) * noteInterval < numFrames; ++i)
+        {
+            auto note = notes[i % std::size (notes)];
+            events.push_back ({ static_cast<uint32_t> (i * noteInterval), { 0x90, note, static_cast<uint8_t> (40 + (i * 23) % 87) } });
+            events.push_back ({ static_cast<uint32_t> (i * noteInterval + noteLength), { 0x80, note, 0 } });
+        }
+
+        std::stable_sort (events.begin(), events.end(), [] (const MIDIEvent& a, const MIDIEvent& b) { return a.frameIndex < b.frameIndex; });
+        return events;
+    }
+
+    // Every rendering of a test case gets the same noise and MIDI, whatever its length,
+    // so a shorter rendering is the same as the start of a longer one.
+    Rendering render (const std::string& heart, const Variant& variant, uint64_t numFrames) const
+    {
+        Rendering r;
+        CompileMessageList messages;
+        auto program = Program::createFromHEART (messages, CodeLocation::createFromString (name, heart));
+
+        if (program.isEmpty())
+        {
+            r.error = "Failed to parse the HEART code: " + getFirstError (messages);
+            return r;
+        }
+
+        if (variant.optimise)
+        {
+            try
+            {
+                CompileMessageHandler handler (messages);
+                Compiler::optimise (program);
+                heart::Checker::sanityCheck (program);
+            }
+            catch (AbortCompilationException)
+            {
+                r.error = "Failed to optimise the program: " + getFirstError (messages);
+                return r;
+            }
+        }
+
+        if (variant.lowerGraphs)
+        {
+            try
+            {
+                CompileMessageHandler handler (messages);
+                Compiler::lowerGraphs (program, variant.optimise);
+            }
+            catch (AbortCompilationException)
+            {
+                r.error = "Failed to lower the graphs: " + getFirstError (messages);
+                r.failedToLower = true;
+                return r;
+            }
+        }
+
+        auto performer = options.performerFactory->createPerformer();
+
+        if (performer == nullptr || ! performer->load (messages, program))
+        {
+            r.error = "Failed to load the program: " + getFirstError (messages);
+            return r;
+        }
+
+        AudioMIDIWrapper wrapper (*performer);
+        wrapper.prepare (options.blockSize, [] (const EndpointDetails&) -> uint32_t { return 0; });
+
+        BuildSettings settings;
+        settings.sampleRate = options.sampleRate;
+        settings.maxBlockSize = options.blockSize;
+        settings.optimisationLevel = variant.optimisationLevel;
+
+        if (! performer->link (messages, settings, nullptr))
+        {
+            r.error = "Failed to link the program: " + getFirstError (messages);
+            return r;
+        }
+
+        auto totalFrames = static_cast<uint32_t> (numFrames);
+        choc::buffer::ChannelArrayBuffer<float> input (wrapper.getExpectedNumInputChannels(), totalFrames);
+        r.audio = choc::buffer::ChannelArrayBuffer<float> (wrapper.getExpectedNumOutputChannels(), totalFrames);
+
+        for (uint32_t channel = 0; channel < input.getNumChannels(); ++channel)
+        {
+            std::minstd_rand noise (channel + 1);
+            std::uniform_real_distribution<float> distribution (-0.5f, 0.5f);
+
+            for (uint32_t frame = 0; frame < totalFrames; ++frame)
+                input.getSample (channel, frame) = distribution (noise);
+        }
+
+        auto midiIn = createMIDIStimulus (numFrames, options.sampleRate);
+        auto nextMIDIEvent = midiIn.begin();
+        std::vector<MIDIEvent> blockMIDIIn, blockMIDIOut (1024);
+
+        for (uint32_t start = 0; start < totalFrames; start += options.blockSize)
+        {
+            auto end = std::min (totalFrames, start + options.blockSize);
+            blockMIDIIn.clear();
+
+            for (; nextMIDIEvent != midiIn.end() && nextMIDIEvent->frameIndex < end; ++nextMIDIEvent)
+                blockMIDIIn.push_back ({ nextMIDIEvent->frameIndex - start, nextMIDIEvent->message });
+
+            MIDIEventOutputList midiOut { blockMIDIOut.data(), static_cast<uint32_t> (blockMIDIOut.size()) };
+
+            wrapper.render (input.getFrameRange ({ start, end }), r.audio.getFrameRange ({ start, end }),
+                            { blockMIDIIn.data(), blockMIDIIn.data() + blockMIDIIn.size() }, midiOut);
+
+            if (performer->hasError())
+            {
+                r.error = performer->getError();
+                return r;
+            }
+
+            for (auto e = blockMIDIOut.data(); e != midiOut.start; ++e)
+                r.midi.push_back ({ e->frameIndex + start, e->message });
+
+            wrapper.deliverOutgoingEvents ([&] (uint64_t frame, const std::string& endpoint, const choc::value::ValueView& value)
+            {
+                r.events.push_back ({ frame, endpoint, choc::value::Value (value) });
+            });
+        }
+
+        return r;
+    }
+
+    //==============================================================================
+    struct Divergence
+    {
+        bool found = false;
+        uint64_t frame = 0;
+        double maxDifference = 0;
+        std::string description;
+
+        void add (uint64_t divergentFrame, std::string desc)
+        {
+            if (! found || divergentFrame < frame)
+            {
+                frame = divergentFrame;
+                description = std::move (desc);
+            }
+
+            found = true;
+        }
+    };
+
+    static double getDifference (double a, double b)
+    {
+        if (std::isnan (a) || std::isnan (b))
+            return std::isnan (a) && std::isnan (b) ? 0 : std::numeric_limits<double>::infinity();
+
+        return a == b ? 0 : std::abs (a - b);
+    }
+
+    bool areEqual (const choc::value::ValueView& a, const choc::value::ValueView& b) const
+    {
+        if (a.isFloat() && b.isFloat())
+            return getDifference (a.getWithDefault<double> (0), b.getWithDefault<double> (0)) <= options.tolerance;
+
+        if (! (a.getType() == b.getType()))
+            return false;
+
+        if (a.isVector() || a.isArray())
+        {
+            for (uint32_t i = 0; i < a.size(); ++i)
+                if (! areEqual (a[i], b[i]))
+                    return false;
+
+            return true;
+        }
+
+        if (a.isObject())
+        {
+            for (uint32_t i = 0; i < a.size(); ++i)
+                if (! areEqual (a.getObjectMemberAt (i).value, b.getObjectMemberAt (i).value))
+                    return false;
+
+            return true;
+        }
+
+        return choc::json::toString (a) == choc::json::toString (b);
+    }
+
+    Divergence compare (const Rendering& reference, const Rendering& other, const Variant& variant) const
+    {
+        Divergence d;
+
+        if (! other.error.empty())
+        {
+            d.add (0, "The " + variant.getDescription() + " program failed: " + other.error);
+            return d;
+        }
+
+        auto numChannels = reference.audio.getNumChannels();
+
+        if (other.audio.getNumChannels() != numChannels)
+        {
+            d.add (0, "The " + variant.getDescription() + " program has " + std::to_string (other.audio.getNumChannels())
+                        + " audio output channels instead of " + std::to_string (numChannels));
+            return d;
+        }
+
+        for (uint32_t channel = 0; channel < numChannels; ++channel)
+        {
+            for (uint32_t frame = 0; frame < reference.audio.getNumFrames(); ++frame)
+            {
+                auto difference = getDifference (reference.audio.getSample (channel, frame),
+                                                  other.audio.getSample (channel, frame));
+
+                if (difference > options.tolerance)
+                {
+                    if (! d.found || frame < d.frame)
+                        d.add (frame, "Audio output channel " + std::to_string (channel) + " differs by "
+                                        + choc::text::floatToString (difference, 6) + " at frame " + std::to_string (frame));
+
+                    d.maxDifference = std::max (d.maxDifference, difference);
+                }
+            }
+        }
+
+        auto numMIDIEvents = std::min (reference.midi.size(), other.midi.size());
+
+        for (size_t i = 0; i <= numMIDIEvents; ++i)
+        {
+            if (i == numMIDIEvents)
+            {
+                if (reference.midi.size() != other.midi.size())
+                    d.add (i < reference.midi.size() ? reference.midi[i].frameIndex : other.midi[i].frameIndex,
+                           "The " + variant.getDescription() + " program sent " + std::to_string (other.midi.size()) + " MIDI messages instead of "
+                             + std::to_string (reference.midi.size()));
+
+                break;
+            }
+
+            auto& a = reference.midi[i];
+            auto& b = other.midi[i];
+
+            if (a.frameIndex != b.frameIndex || a.getPackedMIDIData() != b.getPackedMIDIData())
+            {
+                d.add (std::min (a.frameIndex, b.frameIndex), "MIDI message " + std::to_string (i) + " differs");
+                break;
+            }
+        }
+
+        auto numEvents = std::min (reference.events.size(), other.events.size());
+
+        for (size_t i = 0; i <= numEvents; ++i)
+        {
+            if (i == numEvents)
+            {
+                if (reference.events.size() != other.events.size())
+                    d.add (i < reference.events.size() ? reference.events[i].frame : other.events[i].frame,
+                           "The " + variant.getDescription() + " program sent " + std::to_string (other.events.size()) + " events instead of "
+                             + std::to_string (reference.events.size()));
+
+                break;
+            }
+
+            auto& a = reference.events[i];
+            auto& b = other.events[i];
+
+            if (a.frame != b.frame || a.endpoint != b.endpoint || ! areEqual (a.value, b.value))
+            {
+                d.add (std::min (a.frame, b.frame), "Event " + std::to_string (i) + " from " + quoteName (a.endpoint)
+                                                      + " differs: expected " + choc::json::toString (a.value)
+                                                      + " at frame " + std::to_string (a.frame) + ", but got "
+                                                      + choc::json::toString (b.value) + " at frame " + std::to_string (b.frame));
+                break;
+            }
+        }
+
+        return d;
+    }
+
+    //==============================================================================
+    bool stillDiverges (const std::string& heart, const Variant& variant, uint64_t numFrames, Divergence& divergence)
+    {
+        if (heart.empty() || numRendersLeft < 2)
+            return false;
+
+        numRendersLeft -= 2;
+        auto reference = render (heart, {}, numFrames);
+
+        if (! reference.error.empty())
+            return false;
+
+        auto d = compare (reference, render (heart, variant, numFrames), variant);
+
+        if (! d.found)
+            return false;
+
+        divergence = std::move (d);
+        return true;
+    }
+
+    Result minimise (std::string heart, const Variant& variant, Divergence divergence)
+    {
+        numRendersLeft = options.maxMinimisationAttempts;
+
+        // Everything up to the first divergent frame is the same, so the rest can go
+        auto numFrames = std::min (options.numFramesToRender, divergence.frame + 1);
+
+        for (size_t i = changes.size(); i > 0; --i)
+        {
+            auto fewerChanges = changes;
+            fewerChanges.erase (fewerChanges.begin() + static_cast<std::ptrdiff_t> (i - 1));
+            auto newHEART = applyChanges (fewerChanges);
+
+            if (stillDiverges (newHEART, variant, numFrames, divergence))
+            {
+                changes = std::move (fewerChanges);
+                heart = std::move (newHEART);
+            }
+        }
+
+        auto withoutUnusedFunctions = removeUnusedFunctions (heart);
+
+        if (stillDiverges (withoutUnusedFunctions, variant, numFrames, divergence))
+            heart = std::move (withoutUnusedFunctions);
+
+        // Simplifying a statement makes it no longer a candidate, so if it works, the
+        // same index will refer to the next candidate statement
+        for (size_t index = 0; numRendersLeft >= 2;)
+        {
+            auto newHEART = simplifyStatement (heart, index);
+
+            if (newHEART.empty())
+                break;
+
+            if (stillDiverges (newHEART, variant, numFrames, divergence))
+            {
+                heart = std::move (newHEART);
+                ++result.numStatementsSimplified;
+            }
+            else
+            {
+                ++index;
+            }
+        }
+
+        // Once the calls have been simplified, more functions may have become unused
+        withoutUnusedFunctions = removeUnusedFunctions (heart);
+
+        if (stillDiverges (withoutUnusedFunctions, variant, numFrames, divergence))
+            heart = std::move (withoutUnusedFunctions);
+
+        for (auto& c : changes)
+            result.changes.push_back (c.description);
+
+        result.status = Status::diverged;
+        result.message = divergence.description;
+        result.optimisationLevel = variant.optimisationLevel;
+        result.graphsLowered = variant.lowerGraphs;
+        result.firstDivergentFrame = divergence.frame;
+        result.maxDifference = divergence.maxDifference;
+        result.minimisedHEART = std::move (heart);
+        return result;
+    }
+};
+
+//==============================================================================
+std::string OptimisationFuzzer::generateProgram (std::mt19937& random)
+{
+    auto randomInt = [&] (int min, int max) { return std::uniform_int_distribution<int> (min, max) (random); };
+
+    auto pick = [&] (const std::vector<std::string>& items) -> std::string
+    {
+        return items[static_cast<size_t> (randomInt (0, static_cast<int> (items.size()) - 1))];
+    };
+
+    auto randomConstant = [&]
+    {
+        std::ostringstream s;
+        s << std::fixed << std::setprecision (3) << std::uniform_real_distribution<double> (-2.0, 2.0) (random) << "f";
+        return "(" + s.str() + ")";
+    };
+
+    std::vector<std::string> helpers;
+
+    // Integers are only used in conditions and converted to floats, never the other
+    // way round, so rounding differences can't be amplified by a change of branch
+    std::function<std::string(int, const std::vector<std::string>&, const std::vector<std::string>&)> createExpression;
+
+    createExpression = [&] (int depth, const std::vector<std::string>& floats, const std::vector<std::string>& ints) -> std::string
+    {
+        if (depth <= 0 || randomInt (0, 3) == 0)
+        {
+            auto leafType = randomInt (0, 3);
+
+            if (leafType == 0)                      return randomConstant();
+            if (leafType == 1 && ! ints.empty())    return "(float (" + pick (ints) + ") * 0.01f)";
+
+            return pick (floats);
+        }
+
+        auto a = createExpression (depth - 1, floats, ints);
+        auto b = createExpression (depth - 1, floats, ints);
+
+        switch (randomInt (0, 9))
+        {
+            case 0:  return "(" + a + " + " + b + ")";
+            case 1:  return "(" + a + " - " + b + ")";
+            case 2:  return "(" + a + " * " + b + ")";
+            case 3:  return "(" + a + " / (abs (" + b + ") + 1.0f))";
+            case 4:  return "sin (" + a + ")";
+            case 5:  return "tanh (" + a + ")";
+            case 6:  return "min (" + a + ", " + b + ")";
+            case 7:  return "max (" + a + ", " + b + ")";
+
+            case 8:
+                if (! ints.empty())
+                    return "((" + pick (ints) + " & " + std::to_string (1 << randomInt (0, 5)) + ") != 0 ? " + a + " : " + b + ")";
+
+                return "(" + a + " * " + b + ")";
+
+            default:
+                if (! helpers.empty())
+                    return pick (helpers) + " (" + a + ", " + b + ")";
+
+                return "(" + a + " + " + b + ")";
+        }
+    };
+
+    std::ostringstream code;
+    code << "processor Generated" << std::endl
+         << "{" << std::endl
+         << "    input stream float in;" << std::endl
+         << "    output stream float out;" << std::endl
+         << std::endl;
+
+    std::vector<std::string> states, ints, temps;
+
+    for (int i = randomInt (1, 3); --i >= 0;)
+    {
+        states.push_back ("s" + std::to_string (states.size()));
+        code << "    float " << states.back() << " = " << randomConstant() << ";" << std::endl;
+    }
+
+    for (int i = randomInt (0, 3); --i >= 0;)
+    {
+        auto helperName = "f" + std::to_string (helpers.size());
+
+        code << std::endl
+             << "    float " << helperName << " (float a, float b)" << std::endl
+             << "    {" << std::endl
+             << "        return " << createExpression (2, { "a", "b" }, {}) << ";" << std::endl
+             << "    }" << std::endl;
+
+        helpers.push_back (helperName);
+    }
+
+    code << std::endl
+         << "    void run()" << std::endl
+         << "    {" << std::endl;
+
+    for (int i = randomInt (1, 2); --i >= 0;)
+    {
+        ints.push_back ("i" + std::to_string (ints.size()));
+        code << "        int " << ints.back() << " = " << randomInt (0, 1023) << ";" << std::endl;
+    }
+
+    code << std::endl
+         << "        loop" << std::endl
+         << "        {" << std::endl
+         << "            let x = in;" << std::endl;
+
+    for (int i = randomInt (1, 4); --i >= 0;)
+    {
+        auto temp = "t" + std::to_string (temps.size());
+        auto inputs = states;
+        inputs.push_back ("x");
+        inputs.insert (inputs.end(), temps.begin(), temps.end());
+
+        code << "            float " << temp << " = clamp (" << createExpression (3, inputs, ints) << ", -4.0f, 4.0f);" << std::endl;
+
+        if (randomInt (0, 2) == 0)
+            code << "            if ((" << pick (ints) << " & " << (1 << randomInt (0, 5)) << ") != 0) " << temp
+                 << " = clamp (" << createExpression (2, inputs, ints) << ", -4.0f, 4.0f);" << std::endl;
+
+        if (randomInt (0, 2) == 0)
+            code << "            loop (" << randomInt (1, 8) << ") " << temp << " = " << temp << " * 0.5f + clamp ("
+                 << createExpression (2, inputs, ints) << ", -1.0f, 1.0f);" << std::endl;
+
+        temps.push_back (temp);
+    }
+
+    // The states are leaky integrators of expressions which don't read them, so any
+    // rounding differences decay, rather than being fed back and amplified
+    for (auto& s : states)
+        code << "            " << s << " = " << s << " * 0.9f + 0.1f * tanh (" << createExpression (3, { "x" }, ints) << ");" << std::endl;
+
+    for (auto& i : ints)
+        code << "            " << i << " = ((" << i << " * " << (2 * randomInt (1, 8) + 1) << ") + (" << pick (ints)
+             << " ^ " << randomInt (1, 255) << ") + " << randomInt (1, 99) << ") & 1023;" << std::endl;
+
+    auto outputInputs = states;
+    outputInputs.push_back ("x");
+    outputInputs.insert (outputInputs.end(), temps.begin(), temps.end());
+
+    code << "            out << tanh (" << createExpression (3, outputInputs, ints) << ");" << std::endl
+         << "            advance();" << std::endl
+         << "        }" << std::endl
+         << "    }" << std::endl
+         << "}" << std::endl;
+
+    return code.str();
+}
+
+//==============================================================================
+std::vector<OptimisationFuzzer::Result> OptimisationFuzzer::run (ArrayView<BuildBundle> seeds, const Options& options)
+{
+    SOUL_ASSERT (options.performerFactory != nullptr);
+
+    std::vector<std::unique_ptr<TestCase>> testCases;
+
+    for (auto& seed : seeds)
+    {
+        auto seedName = ! seed.settings.mainProcessor.empty() ? seed.settings.mainProcessor
+                                                              : (seed.sourceFiles.empty() ? std::string ("seed") : seed.sourceFiles.front().filename);
+
+        for (uint32_t variant = 0; variant <= options.numVariantsPerSeed; ++variant)
+            testCases.push_back (std::make_unique<TestCase> (options, variant == 0 ? seedName : seedName + " variant " + std::to_string (variant),
+                                                             seed, variant != 0, testCases.size()));
+    }
+
+    for (uint32_t i = 0; i < options.numGeneratedPrograms; ++i)
+    {
+        auto name = "generated_" + std::to_string (i + 1) + ".soul";
+        auto random = createFuzzerRandom (options.randomSeed, testCases.size());
+
+        BuildBundle bundle;
+        bundle.sourceFiles.push_back ({ name, generateProgram (random) });
+        testCases.push_back (std::make_unique<TestCase> (options, name, std::move (bundle), false, testCases.size()));
+    }
+
+    std::vector<Result> results (testCases.size());
+    std::atomic<size_t> nextTestCase { 0 };
+
+    auto runNextTestCases = [&]
+    {
+        for (;;)
+        {
+            auto index = nextTestCase++;
+
+            if (index >= testCases.size())
+                return;
+
+            results[index] = testCases[index]->run();
+        }
+    };
+
+    auto maxNumThreads = options.maxNumThreads != 0 ? options.maxNumThreads
+                                                    : std::max (1u, std::thread::hardware_concurrency());
+
+    auto numThreads = std::min (static_cast<size_t> (maxNumThreads), testCases.size());
+    std::vector<std::thread> threads;
+
+    for (size_t i = 1; i < numThreads; ++i)
+        threads.emplace_back (runNextTestCases);
+
+    runNextTestCases();
+
+    for (auto& t : threads)
+        t.join();
+
+    return results;
+}
+
+bool OptimisationFuzzer::allPassed (ArrayView<Result> results)
+{
+    for (auto& r : results)
+        if (r.status == Status::diverged)
+            return false;
+
+    return true;
+}
+
+static const char* getStatusName (OptimisationFuzzer::Status status)
+{
+    switch (status)
+    {
+        case OptimisationFuzzer::Status::passed:    return "passed";
+        case OptimisationFuzzer::Status::diverged:  return "diverged";
+        case OptimisationFuzzer::Status::skipped:   return "skipped";
+        default:                                    return "";
+    }
+}
+
+choc::value::Value OptimisationFuzzer::toJSON (ArrayView<Result> results)
+{
+    auto testCases = choc::value::createEmptyArray();
+    int32_t numPassed = 0, numDiverged = 0, numSkipped = 0;
+
+    for (auto& r : results)
+    {
+        auto testCase = choc::value::createObject ("TestCase",
+                                                   "name", r.name,
+                                                   "status", std::string (getStatusName (r.status)));
+
+        if (! r.message.empty())
+            testCase.addMember ("message", r.message);
+
+        if (! r.changes.empty())
+        {
+            auto changes = choc::value::createEmptyArray();
+
+            for (auto& c : r.changes)
+                changes.addArrayElement (c);
+
+            testCase.addMember ("changes", changes);
+        }
+
+        if (r.status == Status::diverged)
+        {
+            testCase.addMember ("optimisationLevel", static_cast<int32_t> (r.optimisationLevel));
+            testCase.addMember ("graphsLowered", r.graphsLowered);
+            testCase.addMember ("firstDivergentFrame", static_cast<int64_t> (r.firstDivergentFrame));
+            testCase.addMember ("maxDifference", r.maxDifference);
+            testCase.addMember ("numStatementsSimplified", static_cast<int32_t> (r.numStatementsSimplified));
+            testCase.addMember ("minimisedHEART", r.minimisedHEART);
+        }
+
+        testCases.addArrayElement (testCase);
+
+        if (r.status == Status::passed)    ++numPassed;
+        if (r.status == Status::diverged)  ++numDiverged;
+        if (r.status == Status::skipped)   ++numSkipped;
+    }
+
+    return choc::value::createObject ("FuzzResults",
+                                      "numPassed", numPassed,
+                                      "numDiverged", numDiverged,
+                                      "numSkipped", numSkipped,
+                                      "testCases", testCases);
+}
+
+} // namespace soul
@@ -0,0 +1,151 @@
+/*
+    _____ _____ _____ __
+   |   __|     |  |  |  |      The SOUL language
+   |__   |  |  |  |  |  |__    Copyright (c) 2019 - ROLI Ltd.
+   |_____|_____|_____|_____|
+
+   The code in this file is provided under the terms of the ISC license:
+
+   Permission to use, copy, modify, and/or distribute this software for any purpose
+   with or without fee is hereby granted, provided that the above copyright notice and
+   this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+   TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+   NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+   IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+   CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+namespace soul
+{
+
+//==============================================================================
+/**
+    Looks for miscompilations by rendering programs with and without optimisation,
+    and checking that they produce the same output.
+
+    Each test case is a program in unoptimised HEART form, which is either built from
+    one of the seed bundles (with some random changes made to its constants and
+    arithmetic operators), or from some randomly generated SOUL code. The reference
+    rendering comes from that HEART code loaded into a performer at optimisation level
+    0. Then the HEART code is run through the compiler's optimisation passes, and
+    rendered again at each of the levels in Options::optimisationLevels. If the main
+    processor is a graph, the optimised code is also rendered after Compiler::lowerGraphs()
+    has flattened it, which is how the experimental GraphLowering pass gets tested. Every
+    rendering gets the same noise on its audio inputs and the same MIDI notes, and
+    their audio, MIDI and event outputs are compared.
+
+    When an optimised rendering diverges from the reference, the test case is minimised:
+    any random changes that aren't needed to make it diverge are dropped, the library
+    functions that it doesn't use are removed, and then each statement which writes to
+    a stream or calculates a floating point value is removed (or has its value replaced
+    by zero) if the divergence still happens without it. The result contains the
+    minimised HEART code, which can be loaded with Program::createFromHEART() to
+    reproduce the problem.
+
+    Note that the random changes can't alter a program's control flow or integer
+    arithmetic, so they can't make it index out of bounds or loop forever, unless it
+    has loops whose number of iterations depends on floating point values.
+*/
+struct OptimisationFuzzer
+{
+    struct Options
+    {
+        /** Creates the performers that render the programs. Its createPerformer() method
+            may be called from several threads at once, and must not be null.
+        */
+        PerformerFactory* performerFactory = nullptr;
+
+        /** The levels at which to render the optimised HEART code. Level 0 only tests
+            the compiler's HEART optimisations, and the others also test the performer's.
+        */
+        std::vector<int> optimisationLevels { 0, 1, 2, 3 };
+
+        /** If this is true, test cases whose main processor is a graph are also rendered
+            with the graph lowered into a single processor. A graph which uses a feature
+            that GraphLowering doesn't support isn't counted as a divergence, but the
+            error is given in the result's message.
+        */
+        bool testGraphLowering = true;
+
+        /** The number of randomly altered versions of each seed to test, as well as the
+            unaltered seed, and the maximum number of changes made to each one.
+        */
+        uint32_t numVariantsPerSeed = 10;
+        uint32_t maxChangesPerVariant = 4;
+
+        /** The number of randomly generated programs to test. */
+        uint32_t numGeneratedPrograms = 20;
+
+        /** The test cases are reproducible for a given seed. */
+        uint64_t randomSeed = 1;
+
+        double sampleRate = 44100.0;
+        uint32_t blockSize = 512;
+        uint64_t numFramesToRender = 8192;
+
+        /** The largest difference allowed between two samples, or two floating point
+            values in an event.
+        */
+        double tolerance = 1.0e-4;
+
+        /** The maximum number of times the program will be rendered when minimising a
+            divergent test case.
+        */
+        uint32_t maxMinimisationAttempts = 400;
+
+        /** The number of test cases to run at once, or 0 to use one per hardware thread. */
+        uint32_t maxNumThreads = 0;
+    };
+
+    enum class Status
+    {
+        passed,
+        diverged,
+
+        /** The unoptimised program couldn't be built or rendered, so there was nothing
+            to compare against. This is expected for some seeds, e.g. if they need externals.
+        */
+        skipped
+    };
+
+    struct Result
+    {
+        std::string name, message;
+        Status status = Status::passed;
+
+        /** Descriptions of the random changes that were made to the seed, after minimisation. */
+        std::vector<std::string> changes;
+
+        // Only used when the test case diverged
+        int optimisationLevel = 0;
+        bool graphsLowered = false;
+        uint64_t firstDivergentFrame = 0;
+        double maxDifference = 0;
+        uint32_t numStatementsSimplified = 0;
+        std::string minimisedHEART;
+    };
+
+    /** Builds some test cases from each of the seeds, plus the generated programs, and
+        tests them, returning the results in order. The seeds' build settings are used,
+        apart from the sample rate, block size and optimisation level.
+    */
+    static std::vector<Result> run (ArrayView<BuildBundle> seeds, const Options&);
+
+    /** Returns some random SOUL code that declares a processor called "Generated", with
+        an audio input and output.
+    */
+    static std::string generateProgram (std::mt19937& random);
+
+    /** Returns true if none of the test cases diverged. */
+    static bool allPassed (ArrayView<Result>);
+
+    static choc::value::Value toJSON (ArrayView<Result>);
+
+private:
+    struct TestCase;
+};
+
+} // namespace soul
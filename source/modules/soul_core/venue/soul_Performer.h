@@ -191,7 +191,12 @@ public:
     */
     virtual bool isEndpointActive (const EndpointID&) noexcept = 0;
 
-    /** Returns the latency, in samples, of the currently loaded program. */
+    /** Returns the latency, in samples, of the currently loaded program.
+        If the program contains processors whose latency can switch between different
+        values while it runs, this may change between calls to advance(), so callers
+        should check it again rather than caching it. A performer can use
+        DelayCompensation::calculateLatency() to work out the new value.
+    */
     virtual uint32_t getLatency() noexcept = 0;
 
     /** Returns the number of over- or under-runs that have happened since the program was linked.
@@ -205,6 +210,25 @@ public:
     */
     virtual uint32_t getBlockSize() noexcept = 0;
 
+    /** If the program was linked with BuildSettings::executionProfileLevel set, this returns
+        the layout of the counters that ExecutionProfile::apply() added to it, otherwise it
+        returns nullptr. Performers which don't support profiling may leave it unimplemented.
+    */
+    virtual const ExecutionProfile* getExecutionProfile() noexcept      { return nullptr; }
+
+    /** Returns the counters described by getExecutionProfile().
+        Unlike the other methods, this may be called from a different thread while the
+        program is running. The counters must be read with relaxed loads, e.g. by
+        ExecutionProfile::readCounters(), and may lag slightly behind the rendering thread.
+    */
+    virtual ArrayView<const std::atomic<int64_t>> getExecutionProfileCounters() noexcept      { return {}; }
+
+    /** When a program has been linked, this returns the number of bytes that its mutable
+        state is using. Performers which can't measure this may leave it unimplemented, in
+        which case it returns zero, meaning "unknown".
+    */
+    virtual size_t getStateSize() noexcept      { return 0; }
+
     /** Returns whether the performer is in an error state
     */
     virtual bool hasError() noexcept = 0;
@@ -0,0 +1,750 @@
+/*
+    _____ _____ _____ __
+   |   __|     |  |  |  |      The SOUL language
+   |__   |  |  |  |  |  |__    Copyright (c) 2019 - ROLI Ltd.
+   |_____|_____|_____|_____|
+
+   The code in this file is provided under the terms of the ISC license:
+
+   Permission to use, copy, modify, and/or distribute this software for any purpose
+   with or without fee is hereby granted, provided that the above copyright notice and
+   this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+   TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+   NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+   IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+   CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#if ! SOUL_INSIDE_CORE_CPP
+ #error "Don't add this cpp file to your build, it gets included indirectly by soul_core.cpp"
+#endif
+
+namespace soul
+{
+
+//==============================================================================
+std::vector<TestRunner::Section> TestRunner::parse (const SourceFile& file)
+{
+    std::vector<Section> sections;
+    uint32_t lineNumber = 0;
+
+    for (auto& line : choc::text::splitIntoLines (file.content, true))
+    {
+        ++lineNumber;
+
+        if (choc::text::startsWith (line, "##"))
+        {
+            auto header = choc::text::trim (line.substr (2));
+            auto typeEnd = std::find_if (header.begin(), header.end(), [] (char c) { return choc::text::isWhitespace (c); });
+
+            Section s;
+            s.filename = file.filename;
+            s.type = std::string (header.begin(), typeEnd);
+            s.arguments = choc::text::trim (std::string (typeEnd, header.end()));
+            s.line = lineNumber;
+            sections.push_back (std::move (s));
+        }
+        else if (! sections.empty())
+        {
+            sections.back().code += line;
+        }
+    }
+
+    return sections;
+}
+
+//==============================================================================
+struct TestRunner::SectionRunner
+{
+    SectionRunner (const Section& s, std::string global, const Options& o)
+        : section (s), globalCode (std::move (global)), options (o)
+    {
+    }
+
+    std::vector<Result> run()
+    {
+        auto startTime = clock::now();
+        auto results = runTests();
+        auto seconds = getSecondsSince (startTime);
+
+        for (auto& r : results)
+            r.seconds = seconds / static_cast<double> (results.size());
+
+        return results;
+    }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    const Section& section;
+    const std::string globalCode;
+    const Options& options;
+
+    static constexpr const char* chunkNamespace = "soultest_chunk";
+    static constexpr const char* harnessName    = "soultest_harness";
+
+    std::vector<Result> runTests()
+    {
+        if (section.type == "compile")     return { runCompileTest() };
+        if (section.type == "error")       return { runErrorTest() };
+        if (section.type == "function")    return runFunctionTests();
+        if (section.type == "processor")   return { runProcessorTest() };
+        if (section.type == "benchmark")   return { runBenchmark() };
+
+        return { createResult (section.type, Status::failed, "Unknown type of test section: " + quoteName (section.type)) };
+    }
+
+    Result createResult (std::string name, Status status, std::string message = {}) const
+    {
+        Result r;
+        r.filename = section.filename;
+        r.name = std::move (name);
+        r.type = section.type;
+        r.line = section.line;
+        r.status = status;
+        r.message = std::move (message);
+        return r;
+    }
+
+    static double getSecondsSince (clock::time_point start)
+    {
+        return std::chrono::duration<double> (clock::now() - start).count();
+    }
+
+    //==============================================================================
+    // The chunk gets wrapped in a namespace so that it can declare free functions. The
+    // chunk starts on the line after the section's header, and the namespace opens at the
+    // start of that line, so the line numbers of any errors are unaffected. That line is
+    // normally left blank, but if it isn't, the columns of errors on it will be shifted.
+    std::string getWrappedChunk() const
+    {
+        return "namespace " + std::string (chunkNamespace) + " {" + section.code + "\n}\n";
+    }
+
+    std::string getChunkName() const
+    {
+        return section.filename + ":" + std::to_string (section.line);
+    }
+
+    BuildBundle createBuildBundle (const std::string& mainProcessor, const std::string& harnessCode) const
+    {
+        BuildBundle bundle;
+        bundle.settings.sampleRate = options.sampleRate;
+        bundle.settings.maxBlockSize = options.blockSize;
+        bundle.settings.mainProcessor = mainProcessor;
+
+        if (! globalCode.empty())
+            bundle.sourceFiles.push_back ({ section.filename, globalCode });
+
+        bundle.sourceFiles.push_back ({ getChunkName(), getWrappedChunk() });
+
+        if (! harnessCode.empty())
+            bundle.sourceFiles.push_back ({ harnessName, harnessCode });
+
+        return bundle;
+    }
+
+    static Program build (CompileMessageList& messages, const BuildBundle& bundle)
+    {
+        try
+        {
+            CompileMessageHandler handler (messages);
+            return Compiler::build (messages, bundle);
+        }
+        catch (AbortCompilationException) {}
+
+        return {};
+    }
+
+    static std::string getFirstError (const CompileMessageList& messages)
+    {
+        for (auto& m : messages.messages)
+            if (m.isError())
+                return m.getFullDescription();
+
+        return "Failed to compile";
+    }
+
+    // The test functions and processors are found by parsing the chunk without resolving
+    // it, so any errors are left for the real build to report.
+    struct Declarations
+    {
+        std::vector<std::string> testFunctions;
+        bool hasProcessor = false;
+    };
+
+    Declarations findDeclarations() const
+    {
+        Declarations decls;
+        AST::Allocator allocator;
+        CompileMessageList messages;
+
+        try
+        {
+            CompileMessageHandler handler (messages);
+            auto& root = AST::createRootNamespace (allocator);
+
+            for (auto& m : Compiler::parseTopLevelDeclarations (allocator, CodeLocation::createFromString (getChunkName(), getWrappedChunk()), root))
+                addDeclarations (decls, m);
+        }
+        catch (AbortCompilationException) {}
+
+        return decls;
+    }
+
+    static void addDeclarations (Declarations& decls, AST::ModuleBase& module)
+    {
+        if (module.isProcessor() || module.isGraph())
+            decls.hasProcessor = true;
+
+        if (module.isNamespace() && module.name == chunkNamespace)
+        {
+            for (auto& f : module.getFunctions())
+            {
+                if (f->parameters.empty() && ! f->isGeneric())
+                    if (auto returnType = cast<AST::ConcreteType> (f->returnType))
+                        if (returnType->type.isBool())
+                            decls.testFunctions.push_back (f->name.toString());
+            }
+        }
+
+        for (auto& m : module.getSubModules())
+            addDeclarations (decls, m);
+    }
+
+    // A processor which writes the results of some function calls to its output, then
+    // writes -1 to say that it has finished
+    static std::string createHarness (const std::vector<std::string>& functionsToCall)
+    {
+        std::string code = std::string ("processor ") + harnessName + "\n"
+                             "{\n"
+                             "    output event int results;\n"
+                             "\n"
+                             "    void run()\n"
+                             "    {\n";
+
+        for (auto& f : functionsToCall)
+            code += "        results << (" + std::string (chunkNamespace) + "::" + f + "() ? 1 : 0);\n";
+
+        return code + "        loop { results << -1; advance(); }\n"
+                      "    }\n"
+                      "}\n";
+    }
+
+    //==============================================================================
+    Result runCompileTest()
+    {
+        CompileMessageList messages;
+        auto decls = findDeclarations();
+
+        // a chunk that doesn't declare a processor is linked with an empty one, because
+        // a program can't be built without one
+        auto program = decls.hasProcessor ? build (messages, createBuildBundle ({}, {}))
+                                          : build (messages, createBuildBundle (harnessName, createHarness ({})));
+
+        if (program.isEmpty())
+            return createResult ("compile", Status::failed, getFirstError (messages));
+
+        return createResult ("compile", Status::passed);
+    }
+
+    Result runErrorTest()
+    {
+        CompileMessageList messages;
+        auto decls = findDeclarations();
+
+        auto program = decls.hasProcessor ? build (messages, createBuildBundle ({}, {}))
+                                          : build (messages, createBuildBundle (harnessName, createHarness ({})));
+
+        for (auto& m : messages.messages)
+        {
+            if (m.isError())
+            {
+                auto error = m.getFullDescriptionWithoutFilename();
+
+                if (error == section.arguments)
+                    return createResult ("error", Status::passed);
+
+                if (section.arguments.empty())
+                    return createResult ("error", Status::failed, "No error message was given to match: " + error);
+
+                return createResult ("error", Status::failed, "Expected error: " + section.arguments + ", but got: " + error);
+            }
+        }
+
+        return createResult ("error", Status::failed, "Expected error: " + section.arguments + ", but the code compiled");
+    }
+
+    std::vector<Result> runFunctionTests()
+    {
+        auto decls = findDeclarations();
+
+        if (decls.testFunctions.empty())
+            return { createResult ("function", Status::failed, "No functions which take no parameters and return a bool were found") };
+
+        std::vector<Result> results;
+
+        auto addResultForEachFunction = [&] (Status status, const std::string& message)
+        {
+            for (auto& f : decls.testFunctions)
+                results.push_back (createResult (f, status, message));
+
+            return results;
+        };
+
+        CompileMessageList messages;
+        auto program = build (messages, createBuildBundle (harnessName, createHarness (decls.testFunctions)));
+
+        if (program.isEmpty())
+            return addResultForEachFunction (Status::failed, getFirstError (messages));
+
+        if (options.performerFactory == nullptr)
+            return addResultForEachFunction (Status::skipped, "No performer is available to run the test");
+
+        std::vector<int32_t> values;
+        auto error = runUntilFinished (program, values);
+
+        if (! error.empty())
+            return addResultForEachFunction (Status::failed, error);
+
+        for (size_t i = 0; i < decls.testFunctions.size(); ++i)
+        {
+            if (i < values.size() && values[i] != 0)
+                results.push_back (createResult (decls.testFunctions[i], Status::passed));
+            else
+                results.push_back (createResult (decls.testFunctions[i], Status::failed, "Returned false"));
+        }
+
+        return results;
+    }
+
+    Result runProcessorTest()
+    {
+        CompileMessageList messages;
+        auto program = build (messages, createBuildBundle (std::string (chunkNamespace) + "::test", {}));
+
+        if (program.isEmpty())
+            return createResult ("test", Status::failed, getFirstError (messages));
+
+        if (options.performerFactory == nullptr)
+            return createResult ("test", Status::skipped, "No performer is available to run the test");
+
+        std::vector<int32_t> values;
+        auto error = runUntilFinished (program, values);
+
+        if (! error.empty())
+            return createResult ("test", Status::failed, error);
+
+        for (size_t i = 0; i < values.size(); ++i)
+            if (values[i] == 0)
+                return createResult ("test", Status::failed, "Result " + std::to_string (i) + " was a failure");
+
+        return createResult ("test", Status::passed);
+    }
+
+    //==============================================================================
+    std::unique_ptr<Performer> createPerformer (CompileMessageList& messages, const Program& program)
+    {
+        auto performer = options.performerFactory->createPerformer();
+
+        if (performer != nullptr && performer->load (messages, program))
+            return performer;
+
+        return {};
+    }
+
+    bool link (Performer& performer, CompileMessageList& messages)
+    {
+        BuildSettings settings;
+        settings.sampleRate = options.sampleRate;
+        settings.maxBlockSize = options.blockSize;
+
+        return performer.link (messages, settings, nullptr);
+    }
+
+    // Runs a program until its first output produces a -1, collecting the values that
+    // it produced before that, and returns an error message if something went wrong.
+    std::string runUntilFinished (const Program& program, std::vector<int32_t>& values)
+    {
+        CompileMessageList messages;
+        auto performer = createPerformer (messages, program);
+
+        if (performer == nullptr)
+            return "Failed to load the program: " + getFirstError (messages);
+
+        const EndpointDetails* output = nullptr;
+
+        for (auto& e : performer->getOutputEndpoints())
+        {
+            if (! e.isConsoleOutput())
+            {
+                output = std::addressof (e);
+                break;
+            }
+        }
+
+        if (output == nullptr || output->endpointType == EndpointType::value
+             || output->dataTypes.size() != 1 || ! output->dataTypes.front().isInt32())
+            return "The test must have an int output stream or event endpoint";
+
+        auto handle = performer->getEndpointHandle (output->endpointID);
+
+        if (! link (*performer, messages))
+            return "Failed to link the program: " + getFirstError (messages);
+
+        bool finished = false;
+
+        auto addValue = [&] (int32_t value)
+        {
+            if (value == -1)
+                finished = true;
+            else if (! finished)
+                values.push_back (value);
+        };
+
+        for (uint64_t framesDone = 0; framesDone < options.maxFramesPerTest; framesDone += options.blockSize)
+        {
+            performer->prepare (options.blockSize);
+            performer->advance();
+
+            if (performer->hasError())
+                return performer->getError();
+
+            if (output->endpointType == EndpointType::event)
+            {
+                performer->iterateOutputEvents (handle, [&] (uint32_t, const choc::value::ValueView& event)
+                {
+                    addValue (event.getInt32());
+                    return ! finished;
+                });
+            }
+            else
+            {
+                auto frames = performer->getOutputStreamFrames (handle);
+
+                for (uint32_t i = 0; i < options.blockSize && ! finished; ++i)
+                    addValue (frames[i].getInt32());
+            }
+
+            if (finished)
+                return {};
+        }
+
+        return "The test didn't finish within " + std::to_string (options.maxFramesPerTest) + " frames";
+    }
+
+    //==============================================================================
+    Result runBenchmark()
+    {
+        auto numFrames = options.defaultBenchmarkFrames;
+
+        if (! section.arguments.empty())
+        {
+            auto value = std::strtoll (section.arguments.c_str(), nullptr, 10);
+
+            if (value <= 0)
+                return createResult ("benchmark", Status::failed, "Expected a number of frames to render, but got: " + section.arguments);
+
+            numFrames = static_cast<uint64_t> (value);
+        }
+
+        auto compileStart = clock::now();
+        CompileMessageList messages;
+        auto program = build (messages, createBuildBundle (std::string (chunkNamespace) + "::test", {}));
+
+        if (program.isEmpty())
+            return createResult ("benchmark", Status::failed, getFirstError (messages));
+
+        if (options.performerFactory == nullptr)
+            return createResult ("benchmark", Status::skipped, "No performer is available to run the benchmark");
+
+        auto performer = createPerformer (messages, program);
+
+        if (performer == nullptr)
+            return createResult ("benchmark", Status::failed, "Failed to load the program: " + getFirstError (messages));
+
+        AudioMIDIWrapper wrapper (*performer);
+        wrapper.prepare (options.blockSize, [] (const EndpointDetails&) -> uint32_t { return 0; });
+
+        if (! link (*performer, messages))
+            return createResult ("benchmark", Status::failed, "Failed to link the program: " + getFirstError (messages));
+
+        auto result = createResult ("benchmark", Status::passed);
+        result.compileSeconds = getSecondsSince (compileStart);
+        result.stateSize = heart::Utilities::getStateSize (program, program.getMainProcessor());
+        result.numFrames = numFrames;
+
+        choc::buffer::ChannelArrayBuffer<float> input (wrapper.getExpectedNumInputChannels(), options.blockSize),
+                                                output (wrapper.getExpectedNumOutputChannels(), options.blockSize);
+        std::minstd_rand random (1);
+        std::uniform_real_distribution<float> distribution (-0.5f, 0.5f);
+
+        for (uint32_t channel = 0; channel < input.getNumChannels(); ++channel)
+            for (uint32_t frame = 0; frame < options.blockSize; ++frame)
+                input.getSample (channel, frame) = distribution (random);
+
+        MIDIEventOutputList midiOut;
+        auto renderStart = clock::now();
+
+        for (uint64_t framesDone = 0; framesDone < numFrames;)
+        {
+            auto framesToDo = static_cast<uint32_t> (std::min (numFrames - framesDone, static_cast<uint64_t> (options.blockSize)));
+
+            wrapper.render (input.getFrameRange ({ 0, framesToDo }),
+                            output.getFrameRange ({ 0, framesToDo }),
+                            {}, midiOut);
+
+            framesDone += framesToDo;
+        }
+
+        result.nanosecondsPerFrame = getSecondsSince (renderStart) * 1.0e9 / static_cast<double> (numFrames);
+
+        if (performer->hasError())
+            return createResult ("benchmark", Status::failed, performer->getError());
+
+        checkAgainstBaseline (result);
+        return result;
+    }
+
+    void checkAgainstBaseline (Result& result) const
+    {
+        if (! (options.baseline.isObject() && options.baseline.hasObjectMember ("tests")))
+            return;
+
+        auto tests = options.baseline["tests"];
+
+        auto getString = [] (const choc::value::ValueView& v)
+        {
+            return v.isString() ? std::string (v.getString()) : std::string();
+        };
+
+        for (uint32_t i = 0; i < tests.size(); ++i)
+        {
+            auto test = tests[i];
+
+            if (test.isObject() && test.hasObjectMember ("nanosecondsPerFrame")
+                 && getString (test["filename"]) == result.filename
+                 && getString (test["name"]) == result.name
+                 && test["line"].getWithDefault<int64_t> (0) == result.line)
+            {
+                auto previous = test["nanosecondsPerFrame"].getWithDefault<double> (0);
+
+                if (previous > 0 && result.nanosecondsPerFrame > previous * (1.0 + options.maxSlowdown))
+                {
+                    result.status = Status::failed;
+                    result.message = "The time per frame went up from " + choc::text::floatToString (previous, 4) + "ns to "
+                                        + choc::text::floatToString (result.nanosecondsPerFrame, 4) + "ns";
+                }
+
+                return;
+            }
+        }
+    }
+};
+
+//==============================================================================
+std::vector<TestRunner::Result> TestRunner::run (ArrayView<SourceFile> testFiles, const Options& options)
+{
+    struct Test
+    {
+        Section section;
+        std::string globalCode;
+        std::vector<Result> results;
+    };
+
+    std::vector<Test> tests;
+
+    for (auto& file : testFiles)
+    {
+        std::string globalCode;
+
+        for (auto& section : parse (file))
+        {
+            if (section.type == "global")
+                globalCode += section.code;
+            else
+                tests.push_back ({ std::move (section), globalCode, {} });
+        }
+    }
+
+    auto runTest = [&] (Test& t)
+    {
+        t.results = SectionRunner (t.section, t.globalCode, options).run();
+    };
+
+    std::vector<Test*> concurrentTests, benchmarks;
+
+    for (auto& t : tests)
+        (t.section.type == "benchmark" ? benchmarks : concurrentTests).push_back (std::addressof (t));
+
+    auto maxNumThreads = options.maxNumThreads != 0 ? options.maxNumThreads
+                                                    : std::max (1u, std::thread::hardware_concurrency());
+
+    std::atomic<size_t> nextTest { 0 };
+
+    auto runNextTests = [&]
+    {
+        for (;;)
+        {
+            auto index = nextTest++;
+
+            if (index >= concurrentTests.size())
+                return;
+
+            runTest (*concurrentTests[index]);
+        }
+    };
+
+    auto numThreads = std::min (static_cast<size_t> (maxNumThreads), concurrentTests.size());
+    std::vector<std::thread> threads;
+
+    for (size_t i = 1; i < numThreads; ++i)
+        threads.emplace_back (runNextTests);
+
+    runNextTests();
+
+    for (auto& t : threads)
+        t.join();
+
+    for (auto t : benchmarks)
+        runTest (*t);
+
+    std::vector<Result> results;
+
+    for (auto& t : tests)
+        for (auto& r : t.results)
+            results.push_back (std::move (r));
+
+    return results;
+}
+
+bool TestRunner::allPassed (ArrayView<Result> results)
+{
+    for (auto& r : results)
+        if (r.status == Status::failed)
+            return false;
+
+    return true;
+}
+
+static const char* getStatusName (TestRunner::Status status)
+{
+    switch (status)
+    {
+        case TestRunner::Status::passed:   return "passed";
+        case TestRunner::Status::failed:   return "failed";
+        case TestRunner::Status::skipped:  return "skipped";
+        default:                           return "";
+    }
+}
+
+choc::value::Value TestRunner::toJSON (ArrayView<Result> results)
+{
+    auto tests = choc::value::createEmptyArray();
+    int32_t numPassed = 0, numFailed = 0, numSkipped = 0;
+
+    for (auto& r : results)
+    {
+        auto test = choc::value::createObject ("Test",
+                                               "filename", r.filename,
+                                               "line", static_cast<int32_t> (r.line),
+                                               "type", r.type,
+                                               "name", r.name,
+                                               "status", std::string (getStatusName (r.status)),
+                                               "seconds", r.seconds);
+
+        if (! r.message.empty())
+            test.addMember ("message", r.message);
+
+        if (r.type == "benchmark" && r.numFrames != 0)
+        {
+            test.addMember ("numFrames", static_cast<int64_t> (r.numFrames));
+            test.addMember ("nanosecondsPerFrame", r.nanosecondsPerFrame);
+            test.addMember ("compileSeconds", r.compileSeconds);
+            test.addMember ("stateSize", static_cast<int64_t> (r.stateSize));
+        }
+
+        tests.addArrayElement (test);
+
+        if (r.status == Status::passed)   ++numPassed;
+        if (r.status == Status::failed)   ++numFailed;
+        if (r.status == Status::skipped)  ++numSkipped;
+    }
+
+    return choc::value::createObject ("TestResults",
+                                      "numPassed", numPassed,
+                                      "numFailed", numFailed,
+                                      "numSkipped", numSkipped,
+                                      "tests", tests);
+}
+
+std::string TestRunner::toJUnitXML (ArrayView<Result> results)
+{
+    auto escape = [] (const std::string& s)
+    {
+        return choc::text::replace (s, "&", "&amp;", "<", "&lt;", ">", "&gt;", "\"", "&quot;", "\n", "&#10;");
+    };
+
+    std::vector<std::string> filenames;
+
+    for (auto& r : results)
+        appendIfNotPresent (filenames, r.filename);
+
+    std::ostringstream out;
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" << std::endl
+        << "<testsuites>" << std::endl;
+
+    for (auto& filename : filenames)
+    {
+        size_t numTests = 0, numFailures = 0, numSkipped = 0;
+        double seconds = 0;
+
+        for (auto& r : results)
+        {
+            if (r.filename == filename)
+            {
+                ++numTests;
+                seconds += r.seconds;
+                if (r.status == Status::failed)   ++numFailures;
+                if (r.status == Status::skipped)  ++numSkipped;
+            }
+        }
+
+        out << "  <testsuite name=\"" << escape (filename) << "\" tests=\"" << numTests << "\" failures=\"" << numFailures
+            << "\" skipped=\"" << numSkipped << "\" time=\"" << seconds << "\">" << std::endl;
+
+        for (auto& r : results)
+        {
+            if (r.filename != filename)
+                continue;
+
+            out << "    <testcase classname=\"" << escape (filename + ":" + std::to_string (r.line) + " " + r.type)
+                << "\" name=\"" << escape (r.name) << "\" time=\"" << r.seconds << "\">" << std::endl;
+
+            if (r.status == Status::failed)
+                out << "      <failure message=\"" << escape (r.message) << "\"/>" << std::endl;
+            else if (r.status == Status::skipped)
+                out << "      <skipped message=\"" << escape (r.message) << "\"/>" << std::endl;
+
+            if (r.type == "benchmark" && r.numFrames != 0)
+                out << "      <properties>" << std::endl
+                    << "        <property name=\"numFrames\" value=\"" << r.numFrames << "\"/>" << std::endl
+                    << "        <property name=\"nanosecondsPerFrame\" value=\"" << r.nanosecondsPerFrame << "\"/>" << std::endl
+                    << "        <property name=\"compileSeconds\" value=\"" << r.compileSeconds << "\"/>" << std::endl
+                    << "        <property name=\"stateSize\" value=\"" << r.stateSize << "\"/>" << std::endl
+                    << "      </properties>" << std::endl;
+
+            out << "    </testcase>" << std::endl;
+        }
+
+        out << "  </testsuite>" << std::endl;
+    }
+
+    out << "</testsuites>" << std::endl;
+    return out.str();
+}
+
+} // namespace soul
@@ -0,0 +1,125 @@
+/*
+    _____ _____ _____ __
+   |   __|     |  |  |  |      The SOUL language
+   |__   |  |  |  |  |  |__    Copyright (c) 2019 - ROLI Ltd.
+   |_____|_____|_____|_____|
+
+   The code in this file is provided under the terms of the ISC license:
+
+   Permission to use, copy, modify, and/or distribute this software for any purpose
+   with or without fee is hereby granted, provided that the above copyright notice and
+   this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+   TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+   NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+   DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+   IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+   CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+namespace soul
+{
+
+//==============================================================================
+/**
+    Runs the tests in a set of .soultest files.
+
+    A .soultest file is a sequence of chunks of code, each one following a line that
+    begins with "##" and says what kind of section it is:
+
+     - "## global" code is added to the program for every test that follows it.
+     - "## compile" code must compile without any errors.
+     - "## error <message>" code must fail to compile, and the first error must match
+       the message, in the form "line:column: error: description", with the position
+       being relative to the start of the chunk.
+     - "## function" code is compiled, and each function in it which takes no parameters
+       and returns a bool is called, and fails if it returns false.
+     - "## processor" code must contain a processor or graph called "test" with an int
+       output stream or event endpoint. It runs until it writes a -1, and fails if it
+       writes a 0 before that.
+     - "## benchmark <numFrames>" code must contain a processor or graph called "test",
+       which gets rendered for the given number of frames (or defaultBenchmarkFrames),
+       with noise being fed into any audio inputs.
+
+    The compile, error, function and processor tests are run concurrently, and then the
+    benchmarks are run one at a time, so that they're not competing for the CPU.
+*/
+struct TestRunner
+{
+    struct Section
+    {
+        std::string filename, type, arguments, code;
+        uint32_t line = 0;
+    };
+
+    /** Splits a .soultest file into its sections. */
+    static std::vector<Section> parse (const SourceFile&);
+
+    //==============================================================================
+    struct Options
+    {
+        /** Creates the performers for the tests that need to run some code. Its
+            createPerformer() method may be called from several threads at once. If this
+            is null, every section is still compiled, and any compile errors are failures,
+            but the tests which need to run some code are then skipped.
+        */
+        PerformerFactory* performerFactory = nullptr;
+
+        /** The number of tests to run at once, or 0 to use one per hardware thread. */
+        uint32_t maxNumThreads = 0;
+
+        double sampleRate = 44100.0;
+        uint32_t blockSize = 512;
+
+        /** A processor test fails if it hasn't finished after this many frames. */
+        uint64_t maxFramesPerTest = 10000000;
+        uint64_t defaultBenchmarkFrames = 100000;
+
+        /** The results of a previous run, as returned by toJSON(). A benchmark fails if
+            it's more than maxSlowdown (as a proportion) slower per frame than it was in
+            the baseline.
+        */
+        choc::value::Value baseline;
+        double maxSlowdown = 0.1;
+    };
+
+    enum class Status
+    {
+        passed,
+        failed,
+        skipped
+    };
+
+    struct Result
+    {
+        std::string filename, name, type, message;
+        uint32_t line = 0;
+        Status status = Status::passed;
+
+        /** The time taken by this test. The functions in a function section share one
+            build and run, so they each get an equal part of its time.
+        */
+        double seconds = 0;
+
+        // Only used by benchmarks
+        double compileSeconds = 0, nanosecondsPerFrame = 0;
+        uint64_t numFrames = 0, stateSize = 0;
+    };
+
+    /** Parses and runs the tests in some .soultest files, returning a result for each
+        test, in the order they appear in the files.
+    */
+    static std::vector<Result> run (ArrayView<SourceFile> testFiles, const Options&);
+
+    /** Returns true if none of the results are failures. */
+    static bool allPassed (ArrayView<Result>);
+
+    static choc::value::Value toJSON (ArrayView<Result>);
+    static std::string toJUnitXML (ArrayView<Result>);
+
+private:
+    struct SectionRunner;
+};
+
+} // namespace soul
@@ -55,7 +55,7 @@ struct PatchPlayerImpl final  : public RefCountHelper<PatchPlayer, PatchPlayerIm
     Span<Parameter::Ptr> getParameters() const override                 { return parameterSpan; }
     Span<EndpointDescription> getInputEventEndpoints() const override   { return inputEventEndpointSpan; }
     Span<EndpointDescription> getOutputEventEndpoints() const override  { return outputEventEndpointSpan; }
-    uint32_t getLatencySamples() const override                         { return latency; }
+    uint32_t getLatencySamples() const override                         { return latency.load(); }
 
     EndpointDescription getEndpointDetails (const char* endpointID) const override
     {
@@ -79,19 +79,26 @@ struct PatchPlayerImpl final  : public RefCountHelper<PatchPlayer, PatchPlayerIm
     //==============================================================================
     soul::Program compileSources (soul::CompileMessageList& messageList,
                                   const BuildSettings& settings,
+                                  CompilerCache* cache,
                                   SourceFilePreprocessor* preprocessor)
     {
         BuildBundle build;
         fileList.addSource (build, preprocessor);
         build.settings = settings;
-        auto program = Compiler::build (messageList, build);
+
+        return buildProgram (messageList, build, CacheConverter::create (cache).get());
+    }
+
+    static soul::Program buildProgram (soul::CompileMessageList& messageList, const BuildBundle& build, LinkerCache* cache)
+    {
+        auto program = Compiler::build (messageList, build, cache);
 
        #if JUCE_BELA
         {
             auto wrappedBuild = build;
             wrappedBuild.sourceFiles.push_back ({ "BelaWrapper", soul::patch::BelaWrapper::build (program) });
             wrappedBuild.settings.mainProcessor = "BelaWrapper";
-            program = Compiler::build (messageList, wrappedBuild);
+            program = Compiler::build (messageList, wrappedBuild, cache);
         }
        #endif
 
@@ -107,7 +114,7 @@ struct PatchPlayerImpl final  : public RefCountHelper<PatchPlayer, PatchPlayerIm
         if (performer == nullptr)
             return messageList.addError ("Failed to initialise JIT engine", {});
 
-        auto program = compileSources (messageList, settings, preprocessor);
+        auto program = compileSources (messageList, settings, cache, preprocessor);
 
         if (program.isEmpty())
         {
@@ -120,6 +127,8 @@ struct PatchPlayerImpl final  : public RefCountHelper<PatchPlayer, PatchPlayerIm
         if (! performer->load (messageList, program))
             return messageList.addError ("Failed to load program", {});
 
+        programStateSize = heart::Utilities::getStateSize (program, program.getMainProcessor());
+
         createBusesAndEventEndpoints();
         createRenderOperations();
         resolveExternalVariables (externalDataProvider);
@@ -175,12 +184,17 @@ struct PatchPlayerImpl final  : public RefCountHelper<PatchPlayer, PatchPlayerIm
 
     void resolveExternalVariables (ExternalDataProvider* externalDataProvider)
     {
+        externalsSize = 0;
+
         for (auto& ev : performer->getExternalVariables())
         {
             auto value = resolveExternalVariable (externalDataProvider, ev);
 
             if (! value.isVoid())
+            {
+                externalsSize += value.getRawDataSize();
                 performer->setExternalVariable (ev.name.c_str(), value);
+            }
         }
     }
 
@@ -307,6 +321,9 @@ struct PatchPlayerImpl final  : public RefCountHelper<PatchPlayer, PatchPlayerIm
     {
         checkSampleRateAndBlockSize();
 
+        wrapper.consoleOutputList.setRateLimit (config.maxConsoleMessagesPerSecond, static_cast<uint64_t> (config.sampleRate));
+        numConsoleMessagesDropped = 0;
+
         wrapper.prepare ((uint32_t) config.maxFramesPerBlock,
                          [] (const EndpointDetails& endpoint) -> uint32_t
                          {
@@ -341,17 +358,26 @@ struct PatchPlayerImpl final  : public RefCountHelper<PatchPlayer, PatchPlayerIm
              || rc.numOutputChannels != wrapper.getExpectedNumOutputChannels())
             return RenderResult::wrongNumberOfChannels;
 
-        auto midiInStart = reinterpret_cast<const MIDIEvent*> (rc.incomingMIDI);
-        auto midiOutStart = reinterpret_cast<MIDIEvent*> (rc.outgoingMIDI);
-        auto midiOut = MIDIEventOutputList { midiOutStart, rc.maximumMIDIMessagesOut };
+        return renderViews (rc, choc::buffer::createChannelArrayView (rc.inputChannels, rc.numInputChannels, rc.numFrames),
+                                choc::buffer::createChannelArrayView (rc.outputChannels, rc.numOutputChannels, rc.numFrames));
+    }
 
-        wrapper.render (choc::buffer::createChannelArrayView (rc.inputChannels, rc.numInputChannels, rc.numFrames),
-                        choc::buffer::createChannelArrayView (rc.outputChannels, rc.numOutputChannels, rc.numFrames),
-                        { midiInStart, midiInStart + rc.numMIDIMessagesIn },
-                        midiOut);
+    RenderResult renderInterleaved (InterleavedRenderContext& rc) override
+    {
+        if (anyErrors)
+            return RenderResult::noProgramLoaded;
 
-        rc.numMIDIMessagesOut = static_cast<uint32_t> (midiOut.start - midiOutStart);
-        return RenderResult::ok;
+        return renderViews (rc, choc::buffer::createInterleavedView (rc.input, rc.numInputChannels, rc.numFrames),
+                                choc::buffer::createInterleavedView (rc.output, rc.numOutputChannels, rc.numFrames));
+    }
+
+    RenderResult renderFloat64 (Float64RenderContext& rc) override
+    {
+        if (anyErrors)
+            return RenderResult::noProgramLoaded;
+
+        return renderViews (rc, choc::buffer::createChannelArrayView (rc.inputChannels, rc.numInputChannels, rc.numFrames),
+                                choc::buffer::createChannelArrayView (rc.outputChannels, rc.numOutputChannels, rc.numFrames));
     }
 
     void handleOutgoingEvents (void* userContext,
@@ -360,16 +386,26 @@ struct PatchPlayerImpl final  : public RefCountHelper<PatchPlayer, PatchPlayerIm
     {
         wrapper.deliverOutgoingEvents ([=] (uint64_t frameIndex, const std::string& endpointName, const choc::value::ValueView& eventData)
         {
-            if (isConsoleEndpoint (endpointName))
-            {
-                if (handleConsoleMessage != nullptr)
-                    handleConsoleMessage (userContext, frameIndex, dump (eventData).c_str());
-            }
-            else if (handleEvent != nullptr)
-            {
+            if (handleEvent != nullptr)
                 handleEvent (userContext, frameIndex, endpointName.c_str(), eventData);
-            }
         });
+
+        wrapper.deliverConsoleMessages ([&] (uint64_t frameIndex, const std::string& message)
+        {
+            if (handleConsoleMessage != nullptr)
+                handleConsoleMessage (userContext, frameIndex, message.c_str());
+        });
+
+        auto numDropped = wrapper.consoleOutputList.getNumDroppedMessages();
+
+        if (numDropped != numConsoleMessagesDropped)
+        {
+            if (handleConsoleMessage != nullptr)
+                handleConsoleMessage (userContext, wrapper.consoleOutputList.getLastDroppedMessageFrame(),
+                                      ("(" + std::to_string (numDropped - numConsoleMessagesDropped) + " console messages were dropped)\n").c_str());
+
+            numConsoleMessagesDropped = numDropped;
+        }
     }
 
     void applyNewTimeSignature (TimeSignature newTimeSig) override
@@ -392,7 +428,38 @@ struct PatchPlayerImpl final  : public RefCountHelper<PatchPlayer, PatchPlayerIm
         wrapper.timelineEventEndpointList.applyNewTimelinePosition (newPosition);
     }
 
+    MemoryReport getMemoryReport() const override
+    {
+        MemoryReport report {};
+
+        if (performer != nullptr && performer->isLinked())
+        {
+            // if the performer can't say, the size of the program's state variables is a fair estimate
+            auto stateSize = performer->getStateSize();
+            report.stateSize = stateSize != 0 ? stateSize : programStateSize;
+            report.externalsSize = externalsSize;
+        }
+
+        report.fifoSize    = wrapper.getFIFOMemoryUsage();
+        report.scratchSize = wrapper.getScratchMemoryUsage();
+        return report;
+    }
+
     //==============================================================================
+    template <typename Context, typename InputView, typename OutputView>
+    RenderResult renderViews (Context& rc, InputView input, OutputView output)
+    {
+        auto midiInStart = reinterpret_cast<const MIDIEvent*> (rc.incomingMIDI);
+        auto midiOutStart = reinterpret_cast<MIDIEvent*> (rc.outgoingMIDI);
+        auto midiOut = MIDIEventOutputList { midiOutStart, rc.maximumMIDIMessagesOut };
+
+        wrapper.render (input, output, { midiInStart, midiInStart + rc.numMIDIMessagesIn }, midiOut);
+
+        rc.numMIDIMessagesOut = static_cast<uint32_t> (midiOut.start - midiOutStart);
+        latency = performer->getLatency();
+        return RenderResult::ok;
+    }
+
     void checkSampleRateAndBlockSize() const
     {
         if (config.sampleRate <= 0)         throwPatchLoadError ("Illegal sample rate");
@@ -414,7 +481,9 @@ struct PatchPlayerImpl final  : public RefCountHelper<PatchPlayer, PatchPlayerIm
     Span<Bus> inputBusesSpan = {}, outputBusesSpan = {};
     Span<Parameter::Ptr> parameterSpan = {};
     Span<EndpointDescription> inputEventEndpointSpan, outputEventEndpointSpan;
-    uint32_t latency = 0;
+    std::atomic<uint32_t> latency { 0 };
+    uint64_t programStateSize = 0, externalsSize = 0;
+    uint64_t numConsoleMessagesDropped = 0;
 
     PatchPlayerConfiguration config;
     std::unique_ptr<soul::Performer> performer;
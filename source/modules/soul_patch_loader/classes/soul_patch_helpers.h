@@ -22,7 +22,8 @@ namespace soul::patch
 {
 
 //==============================================================================
-bool operator== (PatchPlayerConfiguration s1, PatchPlayerConfiguration s2)    { return s1.sampleRate == s2.sampleRate && s1.maxFramesPerBlock == s2.maxFramesPerBlock; }
+bool operator== (PatchPlayerConfiguration s1, PatchPlayerConfiguration s2)    { return s1.sampleRate == s2.sampleRate && s1.maxFramesPerBlock == s2.maxFramesPerBlock
+                                                                                    && s1.maxConsoleMessagesPerSecond == s2.maxConsoleMessagesPerSecond; }
 bool operator!= (PatchPlayerConfiguration s1, PatchPlayerConfiguration s2)    { return ! (s1 == s2); }
 
 //==============================================================================
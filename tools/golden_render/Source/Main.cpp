@@ -0,0 +1,139 @@
+/*
+     _____ _____ _____ __
+    |   __|     |  |  |  |
+    |__   |  |  |  |  |  |__
+    |_____|_____|_____|_____|
+
+    Copyright (c) 2018 - ROLI Ltd.
+*/
+
+#include <JuceHeader.h>
+#include "../../../include/soul/patch/helper_classes/soul_patch_GoldenRenderer.h"
+
+
+//==============================================================================
+/**
+    A command-line wrapper around soul::patch::GoldenRenderer, which renders all the
+    patches in a folder and checks them against their golden files. See the README
+    in this folder for the options.
+*/
+struct PatchLibrary
+{
+    PatchLibrary (const juce::String& path)  : library (path.toRawUTF8()) {}
+
+    soul::patch::PatchInstance::Ptr createPatchInstance (const std::string& patchFile)
+    {
+        return library.createPatchFromFileBundle (patchFile.c_str());
+    }
+
+    soul::patch::SOULPatchLibrary library;
+};
+
+static juce::String findPatchLibrary (const juce::ArgumentList& args)
+{
+    if (args.containsOption ("--library"))
+        return args.getExistingFileForOption ("--library").getFullPathName();
+
+    auto dllName = soul::patch::SOULPatchLibrary::getLibraryFileName();
+    auto sibling = juce::File::getSpecialLocation (juce::File::currentExecutableFile).getSiblingFile (dllName);
+
+    if (sibling.existsAsFile())
+        return sibling.getFullPathName();
+
+    auto inAppData = juce::File::getSpecialLocation (juce::File::userApplicationDataDirectory)
+                        .getChildFile ("SOUL").getChildFile (dllName);
+
+    if (inAppData.existsAsFile())
+        return inAppData.getFullPathName();
+
+    return dllName;
+}
+
+static choc::value::Value loadBaseline (const juce::File& file)
+{
+    try
+    {
+        return choc::json::parse (file.loadFileAsString().toStdString());
+    }
+    catch (choc::json::ParseError error)
+    {
+        juce::ConsoleApplication::fail ("Failed to parse " + file.getFullPathName() + ": " + error.message);
+    }
+
+    return {};
+}
+
+static void printResult (const soul::patch::GoldenRenderer::Result& r)
+{
+    auto name = juce::File (r.patchFile).getFileNameWithoutExtension();
+
+    if (r.numFrames != 0)
+        std::cout << name << ": " << soul::patch::GoldenRenderer::getStatusName (r.status)
+                  << ", " << juce::String (r.realtimeFactor, 1) << "x realtime"
+                  << ", compiled in " << juce::String (r.compileSeconds, 2) << "s"
+                  << ", max difference " << r.maxDifference << std::endl;
+    else
+        std::cout << name << ": " << soul::patch::GoldenRenderer::getStatusName (r.status) << std::endl;
+
+    if (! r.message.empty())
+        std::cout << "    " << r.message << std::endl;
+}
+
+static void render (const juce::ArgumentList& args)
+{
+    args.failIfOptionIsMissing ("--patches");
+    args.failIfOptionIsMissing ("--golden");
+
+    soul::patch::GoldenRenderer::Options options;
+
+    if (args.containsOption ("--sample-rate"))  options.sampleRate = args.getValueForOption ("--sample-rate").getDoubleValue();
+    if (args.containsOption ("--block-size"))   options.blockSize = (uint32_t) args.getValueForOption ("--block-size").getIntValue();
+    if (args.containsOption ("--seconds"))      options.secondsToRender = args.getValueForOption ("--seconds").getDoubleValue();
+    if (args.containsOption ("--tolerance"))    options.tolerance = args.getValueForOption ("--tolerance").getFloatValue();
+    if (args.containsOption ("--max-slowdown")) options.maxSlowdown = args.getValueForOption ("--max-slowdown").getDoubleValue();
+    if (args.containsOption ("--baseline"))     options.baseline = loadBaseline (args.getExistingFileForOption ("--baseline"));
+
+    options.overwriteGoldenFiles = args.containsOption ("--update");
+    options.createMissingGoldenFiles = ! args.containsOption ("--no-create");
+
+    if (options.sampleRate <= 0 || options.blockSize == 0 || options.secondsToRender <= 0)
+        juce::ConsoleApplication::fail ("Invalid render settings");
+
+    PatchLibrary library (findPatchLibrary (args));
+
+    if (! library.library.loadedSuccessfully())
+        juce::ConsoleApplication::fail (juce::String ("Couldn't find or load ") + soul::patch::SOULPatchLibrary::getLibraryFileName());
+
+    auto results = soul::patch::GoldenRenderer::renderFolder (library,
+                                                              args.getExistingFolderForOption ("--patches"),
+                                                              args.getFileForOption ("--golden"),
+                                                              options);
+
+    for (auto& r : results)
+        printResult (r);
+
+    if (args.containsOption ("--output"))
+        if (! args.getFileForOption ("--output").replaceWithText (choc::json::toString (soul::patch::GoldenRenderer::toJSON (results))))
+            juce::ConsoleApplication::fail ("Failed to write the results");
+
+    if (! soul::patch::GoldenRenderer::allPassed (results))
+        juce::ConsoleApplication::fail ("Some patches failed", 1);
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ConsoleApplication app;
+
+    app.addHelpCommand ("--help|-h", "Usage: SOUL_GoldenRender --patches=<folder> --golden=<folder> [options]", false);
+
+    app.addDefaultCommand ({ "",
+                             "--patches=<folder> --golden=<folder> [--update] [--no-create] [--output=<file>] [--baseline=<file>] "
+                             "[--max-slowdown=<proportion>] [--tolerance=<value>] [--seconds=<length>] [--sample-rate=<rate>] "
+                             "[--block-size=<frames>] [--library=<file>]",
+                             "Renders all the patches in a folder and checks them against their golden files",
+                             {},
+                             render });
+
+    return app.findAndRunCommand (argc, argv);
+}
@@ -0,0 +1,281 @@
+/*
+     _____ _____ _____ __
+    |   __|     |  |  |  |
+    |__   |  |  |  |  |  |__
+    |_____|_____|_____|_____|
+
+    Copyright (c) 2018 - ROLI Ltd.
+*/
+
+#include "SOULTestUtilities.h"
+
+
+//==============================================================================
+/**
+    Checks the numbers that soul::heart::Analyser works out for a small HEART program,
+    how it adds up the costs of a graph's nodes, and that its annotated HEART can still
+    be parsed.
+*/
+struct AnalyserTests  : public juce::UnitTest
+{
+    AnalyserTests()  : juce::UnitTest ("HEART analyser", "SOUL") {}
+
+    // Each call to shape() runs its loop 10 times, and each iteration does a cast, a
+    // multiply and an add, calls sin(), and increments and compares the counter
+    static constexpr const char* knownProgram = R"(#SOUL 1
+
+namespace _root::maths
+{
+  function _sin (float32 $n) -> float32 [[ intrin: "sin" ]];
+}
+
+processor _root::Test [[ main ]]
+{
+  input   in    stream  float32;
+  output  out   stream  float32;
+
+  var float32 $gain = 0.5f;
+
+  function shape (float32 $x) -> float32
+  {
+    @block_0:
+      $total = 0.0f;
+      $i = 0;
+      branch @loop_0;
+    @loop_0:
+      branch_if lessThan ($i, 10) ? @body_0 : @break_0;
+    @body_0:
+      let $0 = call _root::maths::_sin (multiply ($x, cast float32 ($i)));
+      $total = add ($total, $0);
+      let $1 = $i;
+      $i = add ($1, 1);
+      branch @loop_0;
+    @break_0:
+      return $total;
+  }
+
+  function run() -> void
+  {
+    @block_0:
+      branch @body_0;
+    @body_0:
+      let $0 = read in;
+      let $1 = call shape (multiply ($0, $gain));
+      write out $1;
+      advance;
+      branch @body_0;
+  }
+
+}
+)";
+
+    static constexpr const char* graphSource = R"(
+        processor Gain
+        {
+            input stream float in;
+            output stream float out;
+
+            void run()
+            {
+                loop
+                {
+                    out << in * 0.5f;
+                    advance();
+                }
+            }
+        }
+
+        graph Main  [[ main ]]
+        {
+            input stream float in;
+            output stream float out;
+
+            let
+            {
+                voices = Gain[3];
+                slow = Gain / 2;
+            }
+
+            connection
+            {
+                in -> voices.in, slow.in;
+                voices.out -> out;
+                slow.out -> out;
+            }
+        }
+    )";
+
+    static const soul::heart::Analyser::ModuleStats* findModule (const soul::heart::Analyser& analyser, const std::string& moduleName)
+    {
+        for (auto& m : analyser.modules)
+            if (m.name == moduleName)
+                return std::addressof (m);
+
+        return nullptr;
+    }
+
+    static const soul::heart::Analyser::FunctionStats* findFunction (const soul::heart::Analyser::ModuleStats& module, const std::string& functionName)
+    {
+        for (auto& f : module.functions)
+            if (f.name == functionName)
+                return std::addressof (f);
+
+        return nullptr;
+    }
+
+    static uint32_t getStatementCount (const soul::heart::Analyser::FunctionStats& f, const std::string& kind)
+    {
+        for (auto& count : f.statementCounts)
+            if (kind == count.first)
+                return count.second;
+
+        return 0;
+    }
+
+    void checkCounts (const soul::heart::Analyser::OperationCounts& c, double flops, double integerOps, double functionCalls,
+                      double memoryReads, double streamOps, const std::string& description)
+    {
+        expect (c.flops == flops, description + " flops: " + std::to_string (c.flops));
+        expect (c.integerOps == integerOps, description + " int ops: " + std::to_string (c.integerOps));
+        expect (c.transcendentals == 10, description + " transcendentals: " + std::to_string (c.transcendentals));
+        expect (c.intrinsicCalls == 10, description + " intrinsic calls: " + std::to_string (c.intrinsicCalls));
+        expect (c.functionCalls == functionCalls, description + " calls: " + std::to_string (c.functionCalls));
+        expect (c.branches == 10, description + " branches: " + std::to_string (c.branches));
+        expect (c.memoryReads == memoryReads, description + " reads: " + std::to_string (c.memoryReads));
+        expect (c.memoryWrites == 0, description + " writes: " + std::to_string (c.memoryWrites));
+        expect (c.streamReads == streamOps && c.streamWrites == streamOps, description + " stream ops");
+        expect (c.eventWrites == 0, description + " event writes");
+    }
+
+    void checkAnnotatedHEARTParses (const soul::Program& program, const soul::heart::Analyser& analyser, const std::string& description)
+    {
+        auto annotated = analyser.createAnnotatedHEART (program);
+        expect (annotated != program.toHEART(), description);
+        expect (annotated.find ("Per frame: ") != std::string::npos, description);
+
+        soul::CompileMessageList messages;
+        auto reparsed = soul::Program::createFromHEART (messages, soul::CodeLocation::createFromString ("annotated", annotated));
+        expect (! reparsed.isEmpty(), description + ": " + messages.toString());
+        expect (reparsed.toHEART() == program.toHEART(), description + ": the re-parsed program doesn't match");
+    }
+
+    void runTest() override
+    {
+        beginTest ("A known program");
+        {
+            soul::CompileMessageList messages;
+            auto program = soul::Program::createFromHEART (messages, soul::CodeLocation::createFromString ("known", knownProgram));
+            expect (! program.isEmpty(), messages.toString());
+
+            if (program.isEmpty())
+                return;
+
+            auto analyser = soul::heart::Analyser::analyse (program, {});
+            auto module = findModule (analyser, "Test");
+            expect (module != nullptr);
+
+            if (module == nullptr)
+                return;
+
+            expect (std::string (module->kind) == "processor");
+            expectEquals ((int) module->stateSize, 4);
+            expectEquals ((int) module->streamInputBytesPerFrame, 4);
+            expectEquals ((int) module->streamOutputBytesPerFrame, 4);
+
+            auto shape = findFunction (*module, "shape");
+            auto run = findFunction (*module, "run");
+            expect (shape != nullptr && run != nullptr);
+
+            if (shape == nullptr || run == nullptr)
+                return;
+
+            expectEquals ((int) shape->numBlocks, 4);
+            expectEquals ((int) shape->maxLoopDepth, 1);
+            expectEquals ((int) getStatementCount (*shape, "FunctionCall"), 1);
+            expectEquals ((int) getStatementCount (*shape, "AssignFromValue"), 5);
+            expectEquals ((int) getStatementCount (*shape, "BranchIf"), 1);
+            expectEquals ((int) shape->loops.size(), 1);
+
+            if (shape->loops.size() == 1)
+            {
+                expect (shape->loops.front().headerBlock == "@loop_0", shape->loops.front().headerBlock);
+                expect (shape->loops.front().isTripCountKnown && ! shape->loops.front().isFrameLoop);
+                expectEquals ((int) shape->loops.front().tripCount, 10);
+            }
+
+            checkCounts (shape->perCall, 30, 20, 0, 0, 0, "shape");
+
+            expectEquals ((int) run->loops.size(), 1);
+            expect (run->loops.size() == 1 && run->loops.front().isFrameLoop);
+
+            // A frame reads the input and $gain, multiplies them, calls shape() and writes the output
+            checkCounts (run->perFrame, 31, 20, 1, 1, 1, "run");
+            checkCounts (module->perFrame, 31, 20, 1, 1, 1, "Test");
+            expect (module->perFrame.getWeightedTotal() == 31 + 20 + 10 * 20 + 5 + 1 + 2 + 10 * 2,
+                    std::to_string (module->perFrame.getWeightedTotal()));
+
+            expectEquals ((int) analyser.hotSpots.size(), 1);
+            expect (analyser.hotSpots.size() == 1 && analyser.hotSpots.front().name == "Test"
+                     && analyser.hotSpots.front().instancesPerFrame == 1
+                     && analyser.hotSpots.front().costPerFrame == module->perFrame.getWeightedTotal());
+
+            auto json = analyser.toJSON();
+            expect (json["hotSpots"].size() == 1);
+
+            checkAnnotatedHEARTParses (program, analyser, "known");
+        }
+
+        beginTest ("Graphs");
+        {
+            soul::CompileMessageList messages;
+            auto program = soul::Compiler::build (messages, SOULTests::createBuildBundle ("graph.soul", graphSource));
+            expect (! program.isEmpty(), messages.toString());
+
+            if (program.isEmpty())
+                return;
+
+            auto analyser = soul::heart::Analyser::analyse (program, {});
+            auto gain = findModule (analyser, "Gain");
+            auto main = findModule (analyser, "Main");
+            expect (gain != nullptr && main != nullptr);
+
+            if (gain == nullptr || main == nullptr)
+                return;
+
+            auto gainCost = gain->perFrame.getWeightedTotal();
+            expect (gainCost > 0);
+
+            // Three voices, and one node which runs at half the rate, and which gets its own
+            // copy of the processor because of its clock divider
+            expect (main->perFrame.getWeightedTotal() == gainCost * 3.5, std::to_string (main->perFrame.getWeightedTotal()));
+            expectEquals ((int) analyser.hotSpots.size(), 2);
+
+            if (analyser.hotSpots.size() == 2)
+            {
+                auto& voices = analyser.hotSpots[0];
+                auto& slow = analyser.hotSpots[1];
+
+                expect (voices.name == "Gain" && voices.instancesPerFrame == 3 && voices.costPerFrame == gainCost * 3, voices.name);
+                expect (slow.instancesPerFrame == 0.5 && slow.costPerFrame == gainCost * 0.5, slow.name);
+            }
+
+            checkAnnotatedHEARTParses (program, analyser, "graph");
+        }
+
+        beginTest ("Example patches");
+        {
+            for (auto& patch : SOULTests::getExamplePatches())
+            {
+                soul::CompileMessageList messages;
+                auto program = soul::Compiler::build (messages, SOULTests::createBuildBundleForPatch (patch));
+
+                if (program.isEmpty())
+                    continue;
+
+                checkAnnotatedHEARTParses (program, soul::heart::Analyser::analyse (program, {}), patch.getFileName().toStdString());
+            }
+        }
+    }
+};
+
+static AnalyserTests analyserTests;
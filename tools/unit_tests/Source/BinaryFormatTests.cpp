@@ -0,0 +1,122 @@
+/*
+     _____ _____ _____ __
+    |   __|     |  |  |  |
+    |__   |  |  |  |  |  |__
+    |_____|_____|_____|_____|
+
+    Copyright (c) 2018 - ROLI Ltd.
+*/
+
+#include "SOULTestUtilities.h"
+
+
+//==============================================================================
+/**
+    Checks that every example patch survives a round-trip through the binary HEART
+    format, that the binary form is smaller than the HEART text, and that truncated or
+    corrupted data gets rejected rather than producing a broken program.
+*/
+struct BinaryFormatTests  : public juce::UnitTest
+{
+    BinaryFormatTests()  : juce::UnitTest ("Binary HEART format", "SOUL") {}
+
+    static constexpr const char* enumsSource = R"(
+        processor Voice
+        {
+            input event float in;
+            output stream float out;
+            output event float level;
+
+            float gain = 0.5f;
+
+            event in (float f)     { gain = clamp (f, 0.0f, 1.0f); level << -gain; }
+
+            void run()
+            {
+                loop
+                {
+                    out << (gain * float (processor.frequency) > 1.0f ? 1.0f : 0.0f);
+                    advance();
+                }
+            }
+        }
+
+        graph Test  [[ main ]]
+        {
+            input event float in;
+            output stream float out;
+
+            let voice = Voice * 2;
+
+            connection
+            {
+                in -> voice.in;
+                [linear] voice.out -> out;
+            }
+        }
+    )";
+
+    void runTest() override
+    {
+        beginTest ("Corrupted bytes");
+        {
+            soul::CompileMessageList messages;
+            auto program = soul::Compiler::build (messages, SOULTests::createBuildBundle ("enums.soul", enumsSource));
+            expect (! program.isEmpty(), messages.toString());
+
+            auto binary = program.toBinary();
+
+            // Every byte is overwritten in turn with a value that's out of range for any of the
+            // enums, so the reader has to reject it wherever an enum is stored. Any program that
+            // does load (e.g. with a changed name) must still be printable.
+            for (size_t i = 0; i < binary.size(); ++i)
+            {
+                auto corrupted = binary;
+                corrupted[i] = 0x7e;
+
+                soul::CompileMessageList loadMessages;
+                auto loaded = soul::Program::createFromBinary (loadMessages, corrupted.data(), corrupted.size());
+
+                if (! loaded.isEmpty())
+                    expect (! loaded.toHEART().empty(), "Byte " + juce::String (i));
+            }
+        }
+
+        auto patches = SOULTests::getExamplePatches();
+        expect (! patches.isEmpty(), "No example patches found");
+
+        for (auto& patch : patches)
+        {
+            beginTest (patch.getFileNameWithoutExtension());
+
+            soul::CompileMessageList messages;
+            auto program = soul::Compiler::build (messages, SOULTests::createBuildBundleForPatch (patch));
+
+            expect (! program.isEmpty(), messages.toString());
+
+            if (program.isEmpty())
+                continue;
+
+            auto heart = program.toHEART();
+            auto binary = program.toBinary();
+
+            soul::CompileMessageList loadMessages;
+            auto loaded = soul::Program::createFromBinary (loadMessages, binary.data(), binary.size());
+
+            expect (! loaded.isEmpty(), loadMessages.toString());
+            expect (loaded.toHEART() == heart, "The loaded program doesn't match the original");
+            expectLessThan (binary.size(), heart.length(), "The binary form is larger than the HEART text");
+
+            for (size_t size = 0; size < binary.size(); size += 1 + binary.size() / 50)
+            {
+                soul::CompileMessageList truncatedMessages;
+                auto truncated = soul::Program::createFromBinary (truncatedMessages, binary.data(), size);
+
+                expect (truncated.isEmpty() && truncatedMessages.hasErrors(),
+                        "Data truncated to " + juce::String (size) + " bytes wasn't rejected");
+            }
+        }
+    }
+};
+
+static BinaryFormatTests binaryFormatTests;
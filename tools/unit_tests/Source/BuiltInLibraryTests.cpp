@@ -0,0 +1,96 @@
+/*
+     _____ _____ _____ __
+    |   __|     |  |  |  |
+    |__   |  |  |  |  |  |__
+    |_____|_____|_____|_____|
+
+    Copyright (c) 2018 - ROLI Ltd.
+*/
+
+#include "SOULTestUtilities.h"
+
+
+//==============================================================================
+/**
+    Checks that building on top of the shared, pre-compiled copy of the built-in library
+    produces exactly the same programs as compiling the library's source from scratch,
+    no matter how many builds have used it before, or which thread they ran on.
+*/
+struct BuiltInLibraryTests  : public juce::UnitTest
+{
+    BuiltInLibraryTests()  : juce::UnitTest ("Built-in library", "SOUL") {}
+
+    /** Loads the library files in the same order that the compiler adds its built-in copy. */
+    static std::vector<soul::SourceFile> loadLibrarySource()
+    {
+        std::vector<soul::SourceFile> files;
+
+        for (auto name : { "intrinsics", "audio_utils", "midi", "notes", "frequency",
+                           "mixing", "oscillators", "noise", "timeline", "filters" })
+        {
+            auto file = SOULTests::getRepositoryFolder().getChildFile ("source/soul_library/soul_library_" + juce::String (name) + ".soul");
+            files.push_back ({ file.getFullPathName().toStdString(), file.loadFileAsString().toStdString() });
+        }
+
+        return files;
+    }
+
+    void runTest() override
+    {
+        std::vector<soul::BuildBundle> bundles;
+
+        for (auto& patch : SOULTests::getExamplePatches())
+            bundles.push_back (SOULTests::createBuildBundleForPatch (patch));
+
+        std::vector<std::string> expectedHEART;
+
+        beginTest ("Same as compiling the library source");
+        {
+            auto librarySource = loadLibrarySource();
+
+            for (auto& bundle : bundles)
+            {
+                auto fromSource = bundle;
+                fromSource.settings.overrideStandardLibrary = librarySource;
+
+                soul::CompileMessageList messages1, messages2;
+                auto program   = soul::Compiler::build (messages1, bundle);
+                auto reference = soul::Compiler::build (messages2, fromSource);
+
+                expect (! program.isEmpty(), messages1.toString());
+                expect (! reference.isEmpty(), messages2.toString());
+                expect (program.toHEART() == reference.toHEART(), bundle.sourceFiles.front().filename);
+
+                expectedHEART.push_back (program.toHEART());
+            }
+        }
+
+        beginTest ("Repeated builds");
+        {
+            for (size_t i = 0; i < bundles.size(); ++i)
+            {
+                soul::CompileMessageList messages;
+                auto program = soul::Compiler::build (messages, bundles[i]);
+                expect (program.toHEART() == expectedHEART[i], bundles[i].sourceFiles.front().filename);
+            }
+        }
+
+        beginTest ("Concurrent builds");
+        {
+            std::vector<soul::BuildBundle> allBundles;
+
+            for (int i = 0; i < 3; ++i)
+                allBundles.insert (allBundles.end(), bundles.begin(), bundles.end());
+
+            std::vector<soul::CompileMessageList> messageLists;
+            auto programs = soul::Compiler::buildConcurrently (messageLists, allBundles, 4);
+            expect (programs.size() == allBundles.size());
+
+            for (size_t i = 0; i < programs.size(); ++i)
+                expect (programs[i].toHEART() == expectedHEART[i % bundles.size()],
+                        allBundles[i].sourceFiles.front().filename + ": " + messageLists[i].toString());
+        }
+    }
+};
+
+static BuiltInLibraryTests builtInLibraryTests;
@@ -0,0 +1,89 @@
+/*
+     _____ _____ _____ __
+    |   __|     |  |  |  |
+    |__   |  |  |  |  |  |__
+    |_____|_____|_____|_____|
+
+    Copyright (c) 2018 - ROLI Ltd.
+*/
+
+#include "SOULTestUtilities.h"
+#include <chrono>
+#include <iomanip>
+#include <thread>
+
+
+//==============================================================================
+bool SOULTests::runCompileBenchmark (const std::vector<uint32_t>& threadCounts, uint32_t numBuilds)
+{
+    std::vector<soul::BuildBundle> patches;
+
+    for (auto& patch : getExamplePatches())
+        patches.push_back (createBuildBundleForPatch (patch));
+
+    if (patches.empty())
+        return false;
+
+    std::vector<soul::BuildBundle> bundles;
+
+    for (uint32_t i = 0; i < numBuilds; ++i)
+        bundles.push_back (patches[i % patches.size()]);
+
+    using Clock = std::chrono::steady_clock;
+
+    auto getMillisecondsSince = [] (Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli> (Clock::now() - start).count();
+    };
+
+    // The first build also compiles the built-in library which all the others then share,
+    // so it's timed separately rather than being counted in the first run
+    {
+        auto start = Clock::now();
+        soul::CompileMessageList messages;
+
+        if (soul::Compiler::build (messages, patches.front()).isEmpty())
+        {
+            std::cout << messages.toString() << std::endl;
+            return false;
+        }
+
+        std::cout << "First build, including the built-in library: "
+                  << std::fixed << std::setprecision (1) << getMillisecondsSince (start) << " ms" << std::endl;
+    }
+
+    std::cout << numBuilds << " builds of " << patches.size() << " example patches per run, "
+              << std::thread::hardware_concurrency() << " hardware threads" << std::endl
+              << std::endl
+              << " threads   time (ms)   builds/sec   speed-up" << std::endl;
+
+    // The speed-up is relative to the first run, which is single-threaded by default
+    double firstRunTime = 0;
+
+    for (auto numThreads : threadCounts)
+    {
+        auto start = Clock::now();
+        std::vector<soul::CompileMessageList> messageLists;
+        auto programs = soul::Compiler::buildConcurrently (messageLists, bundles, numThreads);
+        auto time = getMillisecondsSince (start);
+
+        for (size_t i = 0; i < programs.size(); ++i)
+        {
+            if (programs[i].isEmpty())
+            {
+                std::cout << bundles[i].sourceFiles.front().filename << ": " << messageLists[i].toString() << std::endl;
+                return false;
+            }
+        }
+
+        if (firstRunTime == 0)
+            firstRunTime = time;
+
+        std::cout << std::setw (8) << numThreads
+                  << std::setw (12) << std::setprecision (1) << time
+                  << std::setw (13) << std::setprecision (1) << (numBuilds * 1000.0 / time)
+                  << std::setw (11) << std::setprecision (2) << (firstRunTime / time) << std::endl;
+    }
+
+    return true;
+}
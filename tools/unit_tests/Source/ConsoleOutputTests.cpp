@@ -0,0 +1,184 @@
+/*
+     _____ _____ _____ __
+    |   __|     |  |  |  |
+    |__   |  |  |  |  |  |__
+    |_____|_____|_____|_____|
+
+    Copyright (c) 2018 - ROLI Ltd.
+*/
+
+#include "SOULTestUtilities.h"
+
+
+namespace
+{
+    /** Stands in for a performer which has a single console endpoint, and which emits
+        whatever events the test gives it.
+    */
+    struct FakeConsolePerformer
+    {
+        FakeConsolePerformer (std::vector<choc::value::Type> types)
+        {
+            soul::EndpointDetails details;
+            details.endpointID = soul::EndpointID::create ("_console");
+            details.name = "_console";
+            details.endpointType = soul::EndpointType::event;
+            details.dataTypes = std::move (types);
+            outputs.push_back (std::move (details));
+        }
+
+        soul::ArrayView<const soul::EndpointDetails> getOutputEndpoints()  { return outputs; }
+        soul::EndpointHandle getEndpointHandle (const soul::EndpointID&)   { return soul::EndpointHandle::create (soul::EndpointType::event, 1); }
+
+        template <typename HandleEventFn>
+        void iterateOutputEvents (soul::EndpointHandle, HandleEventFn&& handleEvent)
+        {
+            for (auto& e : events)
+                handleEvent (e.first, e.second);
+        }
+
+        std::vector<soul::EndpointDetails> outputs;
+        std::vector<std::pair<uint32_t, choc::value::Value>> events;
+    };
+
+    using Messages = std::vector<std::pair<uint64_t, std::string>>;
+
+    Messages deliver (soul::ConsoleOutputList& list)
+    {
+        Messages messages;
+        list.deliverPendingMessages ([&] (uint64_t frame, const std::string& text) { messages.push_back ({ frame, text }); });
+        return messages;
+    }
+}
+
+//==============================================================================
+/**
+    Checks how soul::ConsoleOutputList records, truncates and rate-limits the messages
+    that a performer writes to its console.
+*/
+struct ConsoleOutputTests  : public juce::UnitTest
+{
+    ConsoleOutputTests()  : juce::UnitTest ("Console output", "SOUL") {}
+
+    void runTest() override
+    {
+        auto floatArray = choc::value::Type::createArray (choc::value::Type::createFloat32(), 500);
+
+        auto createObject = [] (choc::value::Value member)
+        {
+            auto o = choc::value::createObject ("Message");
+            o.addMember ("id", choc::value::createInt32 (3));
+            o.addMember ("content", std::move (member));
+            return o;
+        };
+
+        beginTest ("Messages with strings");
+        {
+            auto object = createObject (choc::value::createString ("hello"));
+            FakeConsolePerformer performer ({ choc::value::Type::createInt32(), choc::value::Type::createString(), object.getType() });
+
+            soul::ConsoleOutputList list;
+            list.initialise (performer);
+            performer.events.push_back ({ 1, choc::value::createInt32 (42) });
+            performer.events.push_back ({ 2, choc::value::createString ("first") });
+            performer.events.push_back ({ 3, object });
+            auto expected = soul::dump (object);
+            list.postOutputEvents (performer, 100);
+
+            // The strings must have been copied, as the performer's dictionaries can go away
+            performer.events.clear();
+            object = choc::value::Value();
+
+            auto messages = deliver (list);
+            expectEquals ((int) messages.size(), 3);
+
+            if (messages.size() == 3)
+            {
+                expect (messages[0] == Messages::value_type (101, "42"), messages[0].second);
+                expect (messages[1] == Messages::value_type (102, "first"), messages[1].second);
+                expect (messages[2] == Messages::value_type (103, expected), messages[2].second);
+            }
+
+            expect (list.getNumDroppedMessages() == 0);
+        }
+
+        beginTest ("Oversized messages are truncated");
+        {
+            auto bigObject = createObject (choc::value::Value (floatArray));
+            auto longString = std::string (3000, 'x');
+            FakeConsolePerformer performer ({ floatArray, bigObject.getType(), choc::value::Type::createString() });
+
+            soul::ConsoleOutputList list;
+            list.initialise (performer);
+            performer.events.push_back ({ 0, choc::value::Value (floatArray) });
+            performer.events.push_back ({ 0, bigObject });
+            performer.events.push_back ({ 0, choc::value::createString (longString) });
+            list.postOutputEvents (performer, 0);
+
+            auto messages = deliver (list);
+            expectEquals ((int) messages.size(), 3);
+
+            if (messages.size() == 3)
+            {
+                auto& array = messages[0].second;
+                auto numShown = (soul::ConsoleOutputList::maxMessageSize - 16) / sizeof (float);
+                auto suffix = " ... (" + std::to_string (500 - numShown) + " more elements)";
+                expect (choc::text::endsWith (array, suffix), array);
+                expect (array.size() < soul::ConsoleOutputList::maxMessageSize * 8, array);
+
+                expect (messages[1].second == "(" + soul::dump (bigObject.getType()) + " value too large to display)", messages[1].second);
+
+                auto& text = messages[2].second;
+                expect (! text.empty() && text.size() < soul::ConsoleOutputList::maxMessageSize, std::to_string (text.size()));
+                expect (text == longString.substr (0, text.size()), text);
+            }
+
+            expect (list.getNumDroppedMessages() == 0);
+        }
+
+        beginTest ("Rate limit");
+        {
+            FakeConsolePerformer performer ({ choc::value::Type::createInt32() });
+
+            soul::ConsoleOutputList list;
+            list.initialise (performer);
+            list.setRateLimit (3, 100);
+
+            for (uint32_t i = 0; i < 5; ++i)
+                performer.events.push_back ({ i * 10, choc::value::createInt32 ((int32_t) i) });
+
+            // Frames 1000 to 1040 are all in the window that starts at frame 1000
+            list.postOutputEvents (performer, 1000);
+            expectEquals ((int) deliver (list).size(), 3);
+            expect (list.getNumDroppedMessages() == 2);
+            expect (list.getLastDroppedMessageFrame() == 1040);
+
+            // Frames 1090 to 1130 straddle the boundary at 1100: the first is still in the full
+            // window, and the rest start a new one
+            list.postOutputEvents (performer, 1090);
+            auto messages = deliver (list);
+            expectEquals ((int) messages.size(), 3);
+
+            if (messages.size() == 3)
+            {
+                expect (messages[0].first == 1100);
+                expect (messages[2].first == 1120);
+            }
+
+            expect (list.getNumDroppedMessages() == 4);
+            expect (list.getLastDroppedMessageFrame() == 1130);
+
+            // Skipping several windows ahead starts a new window aligned to the old ones
+            list.postOutputEvents (performer, 1550);
+            expectEquals ((int) deliver (list).size(), 3);
+            expect (list.getNumDroppedMessages() == 6);
+            expect (list.getLastDroppedMessageFrame() == 1590);
+
+            list.setRateLimit (0, 100);
+            list.postOutputEvents (performer, 2000);
+            expectEquals ((int) deliver (list).size(), 5);
+        }
+    }
+};
+
+static ConsoleOutputTests consoleOutputTests;
@@ -0,0 +1,303 @@
+/*
+     _____ _____ _____ __
+    |   __|     |  |  |  |
+    |__   |  |  |  |  |  |__
+    |_____|_____|_____|_____|
+
+    Copyright (c) 2018 - ROLI Ltd.
+*/
+
+#include "SOULTestUtilities.h"
+
+
+//==============================================================================
+/**
+    Checks the regions that soul::ExecutionProfile::apply() instruments at each level, that
+    the instrumented programs survive being printed and re-parsed and a round-trip through
+    the binary format, and the reports that it makes from a set of counter values.
+*/
+struct ExecutionProfileTests  : public juce::UnitTest
+{
+    ExecutionProfileTests()  : juce::UnitTest ("Execution profiles", "SOUL") {}
+
+    // The loops stop the optimiser from inlining inner() and outer()
+    static constexpr const char* processorSource = R"(
+        processor Test
+        {
+            input event float in;
+            output stream float out;
+
+            float gain = 0.5f;
+
+            float inner (float x)
+            {
+                var total = 0.0f;
+
+                for (int i = 0; i < 10; ++i)
+                    total += x * float (i);
+
+                return total;
+            }
+
+            float outer (float x)
+            {
+                var total = 0.0f;
+
+                for (int i = 0; i < 4; ++i)
+                    total += inner (x + float (i));
+
+                return total + inner (x);
+            }
+
+            event in (float f)     { gain = outer (f); }
+
+            void run()
+            {
+                loop
+                {
+                    out << outer (gain) + inner (gain);
+                    advance();
+                }
+            }
+        }
+    )";
+
+    static constexpr const char* graphSource = R"(
+        graph Main  [[ main ]]
+        {
+            input event float in;
+            output stream float out;
+
+            let
+            {
+                first = Test;
+                second = Test;
+            }
+
+            connection
+            {
+                in -> first.in, second.in;
+                first.out -> out;
+                second.out -> out;
+            }
+        }
+    )";
+
+    soul::Program build (const soul::BuildBundle& bundle)
+    {
+        soul::CompileMessageList messages;
+        auto program = soul::Compiler::build (messages, bundle);
+        expect (! program.isEmpty(), messages.toString());
+        return program;
+    }
+
+    soul::Program buildProcessor()
+    {
+        return build (SOULTests::createBuildBundle ("test.soul", processorSource));
+    }
+
+    soul::ExecutionProfile applyAndCheck (soul::Program& program, soul::ExecutionProfile::Level level)
+    {
+        soul::CompileMessageList messages;
+        soul::ExecutionProfile profile;
+
+        try
+        {
+            soul::CompileMessageHandler handler (messages);
+            profile = soul::ExecutionProfile::apply (program, level);
+        }
+        catch (soul::AbortCompilationException) {}
+
+        expect (! messages.hasErrors(), messages.toString());
+        return profile;
+    }
+
+    void checkRoundTrips (const soul::Program& program, const soul::ExecutionProfile& profile)
+    {
+        auto heart = program.toHEART();
+        expect (heart.find (profile.counterVariableName) != std::string::npos);
+        expect (heart.find ("readCycleCounter") != std::string::npos);
+
+        soul::CompileMessageList messages1;
+        auto reparsed = soul::Program::createFromHEART (messages1, soul::CodeLocation::createFromString ("profiled", heart));
+        expect (! reparsed.isEmpty(), messages1.toString());
+        expect (reparsed.toHEART() == heart, "The re-parsed program doesn't match");
+
+        auto binary = program.toBinary();
+        soul::CompileMessageList messages2;
+        auto loaded = soul::Program::createFromBinary (messages2, binary.data(), binary.size());
+        expect (! loaded.isEmpty(), messages2.toString());
+        expect (loaded.toHEART() == heart, "The program loaded from binary doesn't match");
+    }
+
+    static size_t countRegions (const soul::ExecutionProfile& profile, const std::string& function, const std::string& caller)
+    {
+        size_t num = 0;
+
+        for (auto& r : profile.regions)
+            if (r.function == "_root::Test::" + function && r.caller == (caller.empty() ? std::string() : "_root::Test::" + caller))
+                ++num;
+
+        return num;
+    }
+
+    // Removes the source positions that follow each frame's name
+    static std::vector<std::string> getSortedStacksWithoutLocations (const std::string& foldedStacks)
+    {
+        std::vector<std::string> lines;
+
+        for (auto line : choc::text::splitIntoLines (foldedStacks, false))
+        {
+            if (line.empty())
+                continue;
+
+            for (auto start = line.find (" ("); start != std::string::npos; start = line.find (" ("))
+                line.erase (start, line.find (')', start) + 1 - start);
+
+            lines.push_back (line);
+        }
+
+        std::sort (lines.begin(), lines.end());
+        return lines;
+    }
+
+    void runTest() override
+    {
+        using Level = soul::ExecutionProfile::Level;
+
+        beginTest ("No profiling");
+        {
+            auto program = buildProcessor();
+            auto heart = program.toHEART();
+
+            expect (soul::ExecutionProfile::apply (program, Level::none).regions.empty());
+            expect (soul::ExecutionProfile::apply (program, soul::BuildSettings()).regions.empty());
+            expect (program.toHEART() == heart);
+        }
+
+        beginTest ("Processors level");
+        {
+            auto program = buildProcessor();
+            auto profile = applyAndCheck (program, Level::processors);
+
+            // run() and the event handler, and the calls that they make
+            expectEquals ((int) profile.regions.size(), 5);
+            expectEquals ((int) profile.getNumCounters(), 10);
+            expectEquals ((int) countRegions (profile, "run", {}), 1);
+            expectEquals ((int) countRegions (profile, "_in_f32", {}), 1);
+            expectEquals ((int) countRegions (profile, "outer", "run"), 1);
+            expectEquals ((int) countRegions (profile, "inner", "run"), 1);
+            expectEquals ((int) countRegions (profile, "outer", "_in_f32"), 1);
+            expectEquals ((int) countRegions (profile, "inner", "outer"), 0);
+
+            checkRoundTrips (program, profile);
+        }
+
+        beginTest ("Functions level");
+        {
+            auto program = buildProcessor();
+            auto profile = applyAndCheck (program, Level::functions);
+
+            // ...and the two calls that outer() makes
+            expectEquals ((int) profile.regions.size(), 7);
+            expectEquals ((int) countRegions (profile, "inner", "outer"), 2);
+
+            checkRoundTrips (program, profile);
+        }
+
+        beginTest ("Reports");
+        {
+            auto program = buildProcessor();
+            auto profile = applyAndCheck (program, Level::functions);
+            std::vector<int64_t> counters (profile.getNumCounters());
+
+            for (size_t i = 0; i < profile.regions.size(); ++i)
+            {
+                auto& r = profile.regions[i];
+                auto function = r.function.substr (r.function.rfind (':') + 1);
+                auto caller = r.caller.empty() ? std::string() : r.caller.substr (r.caller.rfind (':') + 1);
+                int64_t cycles = 0;
+
+                if (function == "run")                             cycles = 1000;
+                else if (function == "_in_f32")                    cycles = 300;
+                else if (function == "outer" && caller == "run")   cycles = 600;
+                else if (function == "inner" && caller == "run")   cycles = 100;
+                else if (function == "outer")                      cycles = 200;
+                else if (function == "inner")                      cycles = 200;
+
+                counters[i * 2] = cycles;
+                counters[i * 2 + 1] = 10;
+            }
+
+            // outer() spends 400 of its 800 cycles calling inner(), and that time is shared
+            // between run() and the event handler in proportion to their calls to outer()
+            std::vector<std::string> expected { "_in_f32 100",
+                                                "_in_f32;outer 100",
+                                                "_in_f32;outer;inner 50",
+                                                "_in_f32;outer;inner 50",
+                                                "run 300",
+                                                "run;inner 100",
+                                                "run;outer 300",
+                                                "run;outer;inner 150",
+                                                "run;outer;inner 150" };
+
+            auto stacks = profile.createFoldedStacks (counters);
+            expect (getSortedStacksWithoutLocations (stacks) == expected, stacks);
+            expect (stacks.find ("test.soul:") != std::string::npos, stacks);
+
+            auto json = profile.toJSON (counters);
+            expectEquals ((int) json["regions"].size(), 7);
+
+            for (uint32_t i = 0; i < json["regions"].size(); ++i)
+            {
+                auto region = json["regions"][i];
+                expect (region["cycles"].getInt64() == counters[i * 2]);
+                expect (region["calls"].getInt64() == 10);
+                expect (region.hasObjectMember ("caller") == ! profile.regions[i].caller.empty());
+            }
+        }
+
+        beginTest ("Graphs are lowered first");
+        {
+            soul::BuildBundle bundle;
+            bundle.sourceFiles.push_back ({ "test.soul", processorSource });
+            bundle.sourceFiles.push_back ({ "graph.soul", graphSource });
+            bundle.settings.sampleRate = 44100;
+            bundle.settings.maxBlockSize = 512;
+
+            auto program = build (bundle);
+            bundle.settings.executionProfileLevel = 1;
+
+            soul::CompileMessageList messages;
+            soul::ExecutionProfile profile;
+
+            try
+            {
+                soul::CompileMessageHandler handler (messages);
+                profile = soul::ExecutionProfile::apply (program, bundle.settings);
+            }
+            catch (soul::AbortCompilationException) {}
+
+            expect (! messages.hasErrors(), messages.toString());
+            expect (program.getMainProcessor().isProcessor());
+
+            // The lowered run() calls each node's own copy of its run() function, and each
+            // of those calls gets its own counters
+            std::vector<std::string> nodeRunFunctions;
+
+            for (auto& r : profile.regions)
+                if (r.caller == "_root::Main::run")
+                    nodeRunFunctions.push_back (r.function);
+
+            std::sort (nodeRunFunctions.begin(), nodeRunFunctions.end());
+            expect (nodeRunFunctions == std::vector<std::string> { "_root::Main::first_run", "_root::Main::second_run" });
+
+            // run() and the event handler, and a call to each node's copy of them
+            expectEquals ((int) profile.regions.size(), 6);
+
+            checkRoundTrips (program, profile);
+        }
+    }
+};
+
+static ExecutionProfileTests executionProfileTests;
@@ -0,0 +1,315 @@
+/*
+     _____ _____ _____ __
+    |   __|     |  |  |  |
+    |__   |  |  |  |  |  |__
+    |_____|_____|_____|_____|
+
+    Copyright (c) 2018 - ROLI Ltd.
+*/
+
+#include "SOULTestUtilities.h"
+
+
+//==============================================================================
+/**
+    Checks the programs that Compiler::lowerGraphs() produces. These tests can't run the
+    code, so comparing the lowered and unlowered renderings is left to soul::OptimisationFuzzer,
+    which does that when it has a performer to use.
+*/
+struct GraphLoweringTests  : public juce::UnitTest
+{
+    GraphLoweringTests()  : juce::UnitTest ("Graph lowering", "SOUL") {}
+
+    /** The SOUL front-end turns a scalar written to an array endpoint into an array of copies,
+        so this is HEART, to give the lowering a single value written to the whole array.
+    */
+    static constexpr const char* arrayOutputSource = R"(#SOUL 1
+
+        graph _root::Test [[ main: true ]]
+        {
+          output  out                 stream  float32;
+
+          node source           = _root::Source;
+          node mixer            = _root::Mixer;
+
+          connection none source.out -> mixer.in;
+          connection none mixer.out -> out;
+        }
+
+        processor _root::Source
+        {
+          output  out[2]              stream  float32;
+
+          function run() -> void
+          {
+            @block_0:
+              branch @body_0;
+            @body_0:
+              write out 0.25f;
+              advance;
+              branch @body_0;
+          }
+        }
+
+        processor _root::Mixer
+        {
+          input   in[2]               stream  float32;
+          output  out                 stream  float32;
+
+          function run() -> void
+          {
+            @block_0:
+              let $0 = read in;
+              write out add ($0[0], $0[1]);
+              advance;
+              branch @block_0;
+          }
+        }
+    )";
+
+    static constexpr const char* quiescentNodesSource = R"(
+        processor Gain  [[ quiescent: 4 ]]
+        {
+            input stream float in;
+            output stream float out;
+
+            void run()
+            {
+                loop
+                {
+                    out << in * 0.5f;
+                    advance();
+                }
+            }
+        }
+
+        graph Inner
+        {
+            input stream float in;
+            output stream float out;
+
+            let gains = Gain[2];
+
+            connection
+            {
+                in -> gains.in;
+                gains.out -> out;
+            }
+        }
+
+        graph Test  [[ main ]]
+        {
+            input stream float in;
+            output stream float out;
+
+            let gain = Gain;
+            let inner = Inner;
+
+            connection
+            {
+                in -> gain.in;
+                gain.out -> inner.in;
+                inner.out -> out;
+            }
+        }
+    )";
+
+    static constexpr const char* latencySource = R"(
+        processor Lookahead
+        {
+            input stream float in;
+            output stream float out;
+
+            processor.latency = 20;
+
+            void run()
+            {
+                loop
+                {
+                    out << in;
+                    advance();
+                }
+            }
+        }
+
+        graph Chain
+        {
+            input stream float in;
+            output stream float out;
+
+            let first = Lookahead;
+            let second = Lookahead;
+
+            connection
+            {
+                in -> first -> second -> out;
+            }
+        }
+
+        graph Test  [[ main ]]
+        {
+            input stream float in;
+            output stream float out;
+
+            let chain = Chain;
+            let single = Lookahead;
+            let upsampled = Lookahead * 2;
+
+            connection
+            {
+                in -> chain.in;
+                in -> single.in;
+                [linear] in -> upsampled.in;
+                chain.out -> out;
+                single.out -> out;
+                [linear] upsampled.out -> out;
+            }
+        }
+    )";
+
+    static std::vector<std::string> getExternalNames (const soul::Program& program)
+    {
+        std::vector<std::string> names;
+
+        for (auto& v : program.getExternalVariables())
+            names.push_back (program.getExternalVariableName (v));
+
+        std::sort (names.begin(), names.end());
+        return names;
+    }
+
+    static soul::Program buildLowered (soul::CompileMessageList& messages, const soul::BuildBundle& bundle)
+    {
+        auto program = soul::Compiler::build (messages, bundle);
+
+        if (! program.isEmpty())
+        {
+            try
+            {
+                soul::CompileMessageHandler handler (messages);
+                soul::Compiler::lowerGraphs (program, true);
+            }
+            catch (soul::AbortCompilationException)
+            {
+                return {};
+            }
+        }
+
+        return program;
+    }
+
+    static bool isNotYetImplemented (const soul::CompileMessageList& messages)
+    {
+        return messages.toString().find ("not yet implemented") != std::string::npos;
+    }
+
+    void runTest() override
+    {
+        beginTest ("Example patches");
+        {
+            for (auto& patch : SOULTests::getExamplePatches())
+            {
+                auto bundle = SOULTests::createBuildBundleForPatch (patch);
+
+                soul::CompileMessageList messages1, messages2;
+                auto original = soul::Compiler::build (messages1, bundle);
+                auto program  = buildLowered (messages2, bundle);
+                auto patchName = patch.getFileName();
+
+                expect (! original.isEmpty(), messages1.toString());
+
+                if (program.isEmpty() && isNotYetImplemented (messages2))
+                    continue;
+
+                expect (! program.isEmpty(), patchName + ": " + messages2.toString());
+
+                if (program.isEmpty())
+                    continue;
+
+                expect (! program.getMainProcessor().isGraph(), patchName);
+                expectEquals ((int) program.getMainProcessor().latency, (int) soul::DelayCompensation::apply (original.getMainProcessor()), patchName);
+                expect (getExternalNames (program) == getExternalNames (original), patchName);
+
+                for (auto& m : program.getModules())
+                    expect (! m->isGraph(), patchName);
+
+                soul::CompileMessageList messages3;
+                auto reparsed = soul::Program::createFromHEART (messages3, soul::CodeLocation::createFromString ("lowered", program.toHEART()));
+                expect (! reparsed.isEmpty(), patchName + ": " + messages3.toString());
+                expect (reparsed.toHEART() == program.toHEART(), patchName);
+            }
+        }
+
+        beginTest ("A value written to a whole endpoint array");
+        {
+            auto bundle = SOULTests::createBuildBundle ("arrayOutput.heart", arrayOutputSource);
+
+            soul::CompileMessageList messages;
+            auto program = buildLowered (messages, bundle);
+            expect (! program.isEmpty(), messages.toString());
+            expect (! messages.hasErrors(), messages.toString());
+
+            if (! program.isEmpty())
+                expect (! program.getMainProcessor().isGraph());
+        }
+
+        beginTest ("Latency");
+        {
+            auto bundle = SOULTests::createBuildBundle ("latency.soul", latencySource);
+
+            soul::CompileMessageList messages1, messages2;
+            auto original = soul::Compiler::build (messages1, bundle);
+            auto program  = buildLowered (messages2, bundle);
+            expect (! original.isEmpty(), messages1.toString());
+            expect (! program.isEmpty(), messages2.toString());
+
+            if (! original.isEmpty() && ! program.isEmpty())
+            {
+                // A performer compensates an unlowered graph when it links it
+                auto latency = soul::DelayCompensation::apply (original.getMainProcessor());
+                expect (latency >= 40, std::to_string (latency));
+                expectEquals ((int) program.getMainProcessor().latency, (int) latency);
+            }
+        }
+
+        beginTest ("Counts of skipped frames");
+        {
+            auto bundle = SOULTests::createBuildBundle ("quiescent.soul", quiescentNodesSource);
+
+            soul::CompileMessageList messages1, messages2;
+            auto lowered = buildLowered (messages1, bundle);
+            expect (! lowered.isEmpty(), messages1.toString());
+
+            if (! lowered.isEmpty())
+                expect (lowered.getMainProcessor().findOutput (soul::GraphLowering::getFramesSkippedEndpointName()) == nullptr,
+                        "Only asking for it should add the skipped frames output");
+
+            auto program = soul::Compiler::build (messages2, bundle);
+            expect (! program.isEmpty(), messages2.toString());
+
+            if (! program.isEmpty())
+            {
+                {
+                    soul::CompileMessageHandler handler (messages2);
+                    soul::GraphLowering::apply (program, true);
+                }
+
+                auto output = program.getMainProcessor().findOutput (soul::GraphLowering::getFramesSkippedEndpointName());
+                expect (output != nullptr);
+
+                if (output != nullptr)
+                {
+                    expect (output->isValueEndpoint());
+                    expect (output->getSingleDataType().getDescription() == "int64[3]");
+                    expect (output->annotation.getString ("nodes") == "gain,inner.gains[0],inner.gains[1]", output->annotation.getString ("nodes"));
+                }
+
+                soul::CompileMessageList messages3;
+                auto reparsed = soul::Program::createFromHEART (messages3, soul::CodeLocation::createFromString ("lowered", program.toHEART()));
+                expect (reparsed.toHEART() == program.toHEART(), messages3.toString());
+            }
+        }
+    }
+};
+
+static GraphLoweringTests graphLoweringTests;
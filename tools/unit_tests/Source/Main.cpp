@@ -0,0 +1,130 @@
+/*
+     _____ _____ _____ __
+    |   __|     |  |  |  |
+    |__   |  |  |  |  |  |__
+    |_____|_____|_____|_____|
+
+    Copyright (c) 2018 - ROLI Ltd.
+*/
+
+#include "SOULTestUtilities.h"
+
+
+//==============================================================================
+static bool isRepositoryFolder (const juce::File& folder)
+{
+    return folder.getChildFile ("source/modules/soul_core/soul_core.h").existsAsFile()
+            && folder.getChildFile ("examples/patches").isDirectory();
+}
+
+static juce::File findRepositoryFolder (const juce::ArgumentList& args)
+{
+    if (args.containsOption ("--repo"))
+    {
+        auto folder = args.getExistingFolderForOption ("--repo");
+
+        if (! isRepositoryFolder (folder))
+            juce::ConsoleApplication::fail (folder.getFullPathName() + " isn't the root of the SOUL repository");
+
+        return folder;
+    }
+
+    for (auto start : { juce::File::getCurrentWorkingDirectory(),
+                        juce::File::getSpecialLocation (juce::File::currentExecutableFile) })
+        for (auto folder = start; ! folder.isRoot(); folder = folder.getParentDirectory())
+            if (isRepositoryFolder (folder))
+                return folder;
+
+    juce::ConsoleApplication::fail ("Couldn't find the SOUL repository - use the --repo option to specify it");
+    return {};
+}
+
+static void runTests (const juce::ArgumentList& args)
+{
+    SOULTests::getRepositoryFolder() = findRepositoryFolder (args);
+
+    juce::UnitTestRunner runner;
+    runner.setAssertOnFailure (false);
+
+    if (args.containsOption ("--test"))
+    {
+        auto name = args.getValueForOption ("--test");
+        juce::Array<juce::UnitTest*> tests;
+
+        for (auto test : juce::UnitTest::getTestsInCategory ("SOUL"))
+            if (test->getName() == name)
+                tests.add (test);
+
+        if (tests.isEmpty())
+            juce::ConsoleApplication::fail ("No test called \"" + name + "\"");
+
+        runner.runTests (tests);
+    }
+    else
+    {
+        runner.runTestsInCategory ("SOUL");
+    }
+
+    int numFailures = 0;
+
+    for (int i = 0; i < runner.getNumResults(); ++i)
+        numFailures += runner.getResult (i)->failures;
+
+    if (numFailures != 0)
+        juce::ConsoleApplication::fail (juce::String (numFailures) + " test(s) failed", 1);
+}
+
+static void runBenchmark (const juce::ArgumentList& args)
+{
+    SOULTests::getRepositoryFolder() = findRepositoryFolder (args);
+
+    std::vector<uint32_t> threadCounts { 1, 2, 4, 8, 16, 32 };
+    uint32_t numBuilds = 64;
+
+    if (args.containsOption ("--threads"))
+    {
+        threadCounts.clear();
+
+        for (auto& count : juce::StringArray::fromTokens (args.getValueForOption ("--threads"), ",", {}))
+            if (count.getIntValue() > 0)
+                threadCounts.push_back ((uint32_t) count.getIntValue());
+
+        if (threadCounts.empty())
+            juce::ConsoleApplication::fail ("Expected a comma-separated list of thread counts");
+    }
+
+    if (args.containsOption ("--builds"))
+    {
+        auto builds = args.getValueForOption ("--builds").getIntValue();
+
+        if (builds <= 0)
+            juce::ConsoleApplication::fail ("Expected a number of builds");
+
+        numBuilds = (uint32_t) builds;
+    }
+
+    if (! SOULTests::runCompileBenchmark (threadCounts, numBuilds))
+        juce::ConsoleApplication::fail ("The benchmark builds failed", 1);
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ConsoleApplication app;
+
+    app.addHelpCommand ("--help|-h", "Usage: SOUL_UnitTests [--repo=<folder>] [--test=<name>]", false);
+
+    app.addCommand ({ "--benchmark",
+                      "--benchmark [--repo=<folder>] [--threads=1,2,4...] [--builds=<number>]",
+                      "Measures how the compiler's throughput scales with the number of threads",
+                      {},
+                      runBenchmark });
+
+    app.addDefaultCommand ({ "",
+                             "[--repo=<folder>] [--test=<name>]",
+                             "Runs the SOUL unit tests",
+                             {},
+                             runTests });
+
+    return app.findAndRunCommand (argc, argv);
+}
@@ -0,0 +1,200 @@
+/*
+     _____ _____ _____ __
+    |   __|     |  |  |  |
+    |__   |  |  |  |  |  |__
+    |_____|_____|_____|_____|
+
+    Copyright (c) 2018 - ROLI Ltd.
+*/
+
+#include "SOULTestUtilities.h"
+
+
+namespace
+{
+    /** Stands in for a performer which has a single audio input stream. */
+    struct FakeAudioInputPerformer
+    {
+        FakeAudioInputPerformer (uint32_t numChannels)
+        {
+            soul::EndpointDetails details;
+            details.endpointID = soul::EndpointID::create ("in");
+            details.name = "in";
+            details.endpointType = soul::EndpointType::stream;
+            details.dataTypes.push_back (numChannels == 1 ? choc::value::Type::createFloat32()
+                                                          : choc::value::Type::createVectorFloat32 (numChannels));
+            inputs.push_back (std::move (details));
+        }
+
+        soul::ArrayView<const soul::EndpointDetails> getInputEndpoints()   { return inputs; }
+        soul::EndpointHandle getEndpointHandle (const soul::EndpointID&)   { return handle; }
+
+        std::vector<soul::EndpointDetails> inputs;
+        soul::EndpointHandle handle = soul::EndpointHandle::create (soul::EndpointType::stream, 1);
+    };
+
+    choc::value::Type createMessageType()
+    {
+        auto o = choc::value::createObject ("Message");
+        o.addMember ("id", choc::value::createInt32 (0));
+        o.addMember ("text", choc::value::createString ({}));
+        return o.getType();
+    }
+
+    choc::value::Value createMessage (int32_t id, const std::string& text)
+    {
+        auto o = choc::value::createObject ("Message");
+        o.addMember ("id", choc::value::createInt32 (id));
+        o.addMember ("text", choc::value::createString (text));
+        return o;
+    }
+}
+
+//==============================================================================
+/**
+    Checks how soul::MultiEndpointFIFO is sized for the items it will hold, and that
+    AudioInputList splits blocks of audio which are too big for a single FIFO item.
+*/
+struct MultiEndpointFIFOTests  : public juce::UnitTest
+{
+    MultiEndpointFIFOTests()  : juce::UnitTest ("Multi-endpoint FIFO", "SOUL") {}
+
+    void runTest() override
+    {
+        auto handle = soul::EndpointHandle::create (soul::EndpointType::event, 1);
+
+        beginTest ("Item sizes");
+        {
+            auto floatSize = soul::MultiEndpointFIFO::getItemSize (choc::value::Type::createFloat32());
+            auto arraySize = soul::MultiEndpointFIFO::getItemSize (choc::value::Type::createArray (choc::value::Type::createFloat32(), 100));
+            expect (arraySize >= floatSize + 99 * sizeof (float));
+
+            // Anything with strings gets an allowance for their content
+            auto stringSize = soul::MultiEndpointFIFO::getItemSize (choc::value::Type::createString());
+            expect (stringSize >= soul::MultiEndpointFIFO::stringContentAllowance);
+
+            auto messageSize = soul::MultiEndpointFIFO::getItemSize (createMessageType());
+            auto intObject = choc::value::createObject ("Message");
+            intObject.addMember ("id", choc::value::createInt32 (0));
+            intObject.addMember ("text", choc::value::createInt32 (0));
+            expect (messageSize >= soul::MultiEndpointFIFO::getItemSize (intObject.getType()) + soul::MultiEndpointFIFO::stringContentAllowance);
+        }
+
+        beginTest ("A FIFO sized for its items can hold them all");
+        {
+            const uint32_t numMessages = 300;
+            auto text = std::string (soul::MultiEndpointFIFO::stringContentAllowance - 16, 'x');
+
+            soul::MultiEndpointFIFO::SpaceNeeded space;
+            space.add (createMessageType(), numMessages);
+            expect (space.numItems == numMessages);
+
+            soul::MultiEndpointFIFO fifo;
+            fifo.reset (space);
+            expect (fifo.getMemoryUsage() >= space.numBytes * 2);
+
+            for (uint32_t i = 0; i < numMessages; ++i)
+                expect (fifo.addInputData (handle, i, createMessage ((int32_t) i, text)), "Message " + std::to_string (i));
+
+            uint32_t numRead = 0;
+            bool allCorrect = true;
+
+            expect (fifo.iterateAllAvailable ([&] (soul::EndpointHandle h, uint64_t time, const choc::value::ValueView& v)
+            {
+                allCorrect = allCorrect && h == handle && time == numRead
+                              && v["id"].getInt32() == (int32_t) numRead
+                              && v["text"].getString() == text;
+                ++numRead;
+            }));
+
+            expectEquals ((int) numRead, (int) numMessages);
+            expect (allCorrect);
+        }
+
+        beginTest ("A smaller FIFO runs out of space");
+        {
+            soul::MultiEndpointFIFO::SpaceNeeded space;
+            space.add (createMessageType(), 4);
+
+            soul::MultiEndpointFIFO fifo;
+            fifo.reset (space);
+
+            uint32_t numAdded = 0;
+
+            while (numAdded < 1000 && fifo.addInputData (handle, 0, createMessage (0, "hello")))
+                ++numAdded;
+
+            expect (numAdded >= 8 && numAdded < 1000, std::to_string (numAdded));
+        }
+
+        beginTest ("Audio blocks are split across items");
+        {
+            for (uint32_t numChannels : { 1u, 2u, 8u })
+            {
+                const uint32_t blockSize = 2048;
+                const uint64_t startFrame = 1000;
+                auto description = std::to_string (numChannels) + " channels";
+
+                FakeAudioInputPerformer performer (numChannels);
+                soul::AudioInputList audioInputs;
+                audioInputs.initialise (blockSize);
+                audioInputs.attachToAllAudioEndpoints (performer);
+
+                expectEquals ((int) audioInputs.mappings.size(), 1);
+                auto framesPerItem = audioInputs.mappings.front().maxFramesPerFIFOItem;
+                expect (framesPerItem < blockSize, description);
+
+                auto itemType = choc::value::Type::createArray (performer.inputs.front().dataTypes.front(), framesPerItem);
+                expect (soul::MultiEndpointFIFO::getItemSize (itemType) <= soul::MultiEndpointFIFO::maxItemSize, description);
+
+                soul::MultiEndpointFIFO::SpaceNeeded space;
+                audioInputs.addFIFOSpaceNeeded (space, blockSize);
+                expect (space.numItems == (blockSize + framesPerItem - 1) / framesPerItem, description);
+
+                soul::MultiEndpointFIFO fifo;
+                fifo.reset (space);
+
+                choc::buffer::InterleavedBuffer<float> input (numChannels, blockSize);
+
+                for (uint32_t frame = 0; frame < blockSize; ++frame)
+                    for (uint32_t chan = 0; chan < numChannels; ++chan)
+                        input.getSample (chan, frame) = (float) (frame * numChannels + chan);
+
+                expect (audioInputs.addToFIFO (fifo, startFrame, input.getView()), description);
+
+                // Read the block back in one go, and check that every frame arrives once, in order
+                choc::buffer::InterleavedBuffer<float> output (numChannels, blockSize);
+                uint32_t numFramesRead = 0, numItems = 0;
+                bool framesInOrder = true;
+
+                expect (fifo.prepareForReading (startFrame, blockSize), description);
+
+                while (fifo.getNumFramesInNextChunk (blockSize) != 0)
+                {
+                    fifo.processNextChunk ([&] (soul::EndpointHandle h, uint64_t frame, const choc::value::ValueView& v)
+                    {
+                        framesInOrder = framesInOrder && h == performer.handle && frame == startFrame + numFramesRead;
+                        auto numFrames = v.size();
+
+                        for (uint32_t i = 0; i < numFrames && numFramesRead + i < blockSize; ++i)
+                            for (uint32_t chan = 0; chan < numChannels; ++chan)
+                                output.getSample (chan, numFramesRead + i) = numChannels == 1 ? v[i].getFloat32()
+                                                                                            : v[i][chan].getFloat32();
+
+                        numFramesRead += numFrames;
+                        ++numItems;
+                    });
+                }
+
+                fifo.finishReading();
+
+                expectEquals ((int) numFramesRead, (int) blockSize);
+                expectEquals ((int) numItems, (int) space.numItems);
+                expect (framesInOrder, description);
+                expect (choc::buffer::contentMatches (output, input), description);
+            }
+        }
+    }
+};
+
+static MultiEndpointFIFOTests multiEndpointFIFOTests;
@@ -0,0 +1,78 @@
+/*
+     _____ _____ _____ __
+    |   __|     |  |  |  |
+    |__   |  |  |  |  |  |__
+    |_____|_____|_____|_____|
+
+    Copyright (c) 2018 - ROLI Ltd.
+*/
+
+#include "SOULTestUtilities.h"
+
+
+//==============================================================================
+/**
+    Checks the parts of soul::OptimisationFuzzer that don't need a performer: the
+    programs it generates, and the unoptimised and optimised builds that it compares.
+*/
+struct OptimisationFuzzerTests  : public juce::UnitTest
+{
+    OptimisationFuzzerTests()  : juce::UnitTest ("Optimisation fuzzer", "SOUL") {}
+
+    static std::string generate (uint32_t seed)
+    {
+        std::mt19937 random (seed);
+        return soul::OptimisationFuzzer::generateProgram (random);
+    }
+
+    void runTest() override
+    {
+        beginTest ("Generated programs are reproducible");
+        {
+            expect (generate (1) == generate (1));
+            expect (generate (1) != generate (2));
+        }
+
+        beginTest ("Unoptimised and optimised builds");
+        {
+            for (uint32_t seed = 1; seed <= 8; ++seed)
+            {
+                auto source = generate (seed);
+                auto bundle = SOULTests::createBuildBundle ("generated.soul", source);
+                auto seedName = "seed " + std::to_string (seed);
+
+                soul::CompileMessageList messages1, messages2;
+                auto unoptimised = soul::Compiler::buildUnoptimised (messages1, bundle);
+                auto optimised   = soul::Compiler::build (messages2, bundle);
+
+                expect (! unoptimised.isEmpty() && ! messages1.hasErrors(), seedName + ": " + messages1.toString() + "\n" + source);
+                expect (! optimised.isEmpty() && ! messages2.hasErrors(), seedName + ": " + messages2.toString() + "\n" + source);
+
+                if (unoptimised.isEmpty() || optimised.isEmpty())
+                    continue;
+
+                expect (unoptimised.toHEART() != optimised.toHEART(), seedName);
+
+                // The fuzzer modifies the unoptimised HEART, so it has to re-parse
+                soul::CompileMessageList messages3;
+                auto reparsed = soul::Program::createFromHEART (messages3, soul::CodeLocation::createFromString ("unoptimised", unoptimised.toHEART()));
+                expect (! reparsed.isEmpty(), seedName + ": " + messages3.toString());
+
+                // Optimising it afterwards gives the same result as a normal build
+                soul::CompileMessageList messages4;
+
+                try
+                {
+                    soul::CompileMessageHandler handler (messages4);
+                    soul::Compiler::optimise (unoptimised);
+                }
+                catch (soul::AbortCompilationException) {}
+
+                expect (! messages4.hasErrors(), seedName + ": " + messages4.toString());
+                expect (unoptimised.toHEART() == optimised.toHEART(), seedName);
+            }
+        }
+    }
+};
+
+static OptimisationFuzzerTests optimisationFuzzerTests;
@@ -0,0 +1,174 @@
+/*
+     _____ _____ _____ __
+    |   __|     |  |  |  |
+    |__   |  |  |  |  |  |__
+    |_____|_____|_____|_____|
+
+    Copyright (c) 2018 - ROLI Ltd.
+*/
+
+#include "SOULTestUtilities.h"
+
+
+//==============================================================================
+/**
+    Checks that Compiler::build() stores programs in a LinkerCache and loads them
+    back again when nothing has changed.
+*/
+struct ProgramCacheTests  : public juce::UnitTest
+{
+    ProgramCacheTests()  : juce::UnitTest ("Compiled program cache", "SOUL") {}
+
+    struct InMemoryCache  : public soul::LinkerCache
+    {
+        void storeItem (const char* key, const void* sourceData, uint64_t size) override
+        {
+            auto data = static_cast<const uint8_t*> (sourceData);
+            items[key].assign (data, data + size);
+            ++numStores;
+        }
+
+        uint64_t readItem (const char* key, void* destAddress, uint64_t destSize) override
+        {
+            auto found = items.find (key);
+
+            if (found == items.end())
+                return 0;
+
+            auto size = static_cast<uint64_t> (found->second.size());
+
+            if (destAddress != nullptr && destSize >= size)
+                std::memcpy (destAddress, found->second.data(), found->second.size());
+
+            return size;
+        }
+
+        std::map<std::string, std::vector<uint8_t>> items;
+        int numStores = 0;
+    };
+
+    static constexpr const char* gainSource = R"(
+        processor Gain
+        {
+            input stream float in;
+            output stream float out;
+
+            void run()
+            {
+                loop
+                {
+                    out << in * 0.5f;
+                    advance();
+                }
+            }
+        }
+    )";
+
+    static constexpr const char* sourceWithWarning = R"(
+        processor Shadow
+        {
+            output stream float out;
+
+            void run()
+            {
+                let x = 0.5f;
+
+                loop
+                {
+                    {
+                        let x = 0.25f;
+                        out << x;
+                    }
+
+                    advance();
+                }
+            }
+        }
+    )";
+
+    static soul::Program build (InMemoryCache& cache, const soul::BuildBundle& bundle, soul::CompileMessageList& messages)
+    {
+        return soul::Compiler::build (messages, bundle, std::addressof (cache));
+    }
+
+    void runTest() override
+    {
+        auto bundle = SOULTests::createBuildBundle ("gain.soul", gainSource);
+
+        beginTest ("Miss, then hit");
+        {
+            InMemoryCache cache;
+            soul::CompileMessageList messages1, messages2;
+            auto built = build (cache, bundle, messages1);
+            expect (! built.isEmpty(), messages1.toString());
+            expectEquals (cache.numStores, 1);
+
+            auto cached = build (cache, bundle, messages2);
+            expectEquals (cache.numStores, 1);
+            expect (! messages2.hasErrorsOrWarnings());
+            expect (cached.toHEART() == built.toHEART());
+        }
+
+        beginTest ("Changed settings miss");
+        {
+            InMemoryCache cache;
+            soul::CompileMessageList messages1, messages2;
+            build (cache, bundle, messages1);
+
+            auto otherRate = bundle;
+            otherRate.settings.sampleRate = 48000;
+            build (cache, otherRate, messages2);
+
+            expectEquals (cache.numStores, 2);
+            expectEquals ((int) cache.items.size(), 2);
+        }
+
+        beginTest ("Programs with warnings aren't cached");
+        {
+            InMemoryCache cache;
+            auto warningBundle = SOULTests::createBuildBundle ("shadow.soul", sourceWithWarning);
+
+            for (int i = 0; i < 2; ++i)
+            {
+                soul::CompileMessageList messages;
+                auto program = build (cache, warningBundle, messages);
+                expect (! program.isEmpty(), messages.toString());
+                expect (messages.hasWarnings());
+            }
+
+            expectEquals (cache.numStores, 0);
+        }
+
+        beginTest ("Corrupt data gets rebuilt");
+        {
+            InMemoryCache cache;
+            soul::CompileMessageList messages1, messages2;
+            auto built = build (cache, bundle, messages1);
+
+            for (auto& item : cache.items)
+                item.second.resize (item.second.size() / 2);
+
+            auto rebuilt = build (cache, bundle, messages2);
+            expect (! messages2.hasErrors(), messages2.toString());
+            expectEquals (cache.numStores, 2);
+            expect (rebuilt.toHEART() == built.toHEART());
+        }
+
+        beginTest ("Profiled builds still write their profile");
+        {
+            InMemoryCache cache;
+            soul::CompileMessageList messages1, messages2;
+            build (cache, bundle, messages1);
+
+            juce::TemporaryFile profileFile (".json");
+            auto profiled = bundle;
+            profiled.settings.compileProfileFile = profileFile.getFile().getFullPathName().toStdString();
+            auto program = build (cache, profiled, messages2);
+
+            expect (! program.isEmpty(), messages2.toString());
+            expect (profileFile.getFile().existsAsFile(), "The profile wasn't written");
+        }
+    }
+};
+
+static ProgramCacheTests programCacheTests;
@@ -0,0 +1,113 @@
+/*
+     _____ _____ _____ __
+    |   __|     |  |  |  |
+    |__   |  |  |  |  |  |__
+    |_____|_____|_____|_____|
+
+    Copyright (c) 2018 - ROLI Ltd.
+*/
+
+#include "SOULTestUtilities.h"
+
+
+//==============================================================================
+/**
+    Checks that Program::clone() produces an identical program which is completely
+    independent of the original, even though the two share their identifier strings.
+*/
+struct ProgramCloneTests  : public juce::UnitTest
+{
+    ProgramCloneTests()  : juce::UnitTest ("Program cloning", "SOUL") {}
+
+    static constexpr const char* gainSource = R"(
+        processor Gain
+        {
+            input stream float in;
+            output stream float out;
+            input event float gainIn;
+
+            float gain = 0.5f;
+
+            event gainIn (float f)   { gain = f; }
+
+            void run()
+            {
+                loop
+                {
+                    out << in * gain;
+                    advance();
+                }
+            }
+        }
+    )";
+
+    static soul::Program build()
+    {
+        soul::CompileMessageList messages;
+        return soul::Compiler::build (messages, SOULTests::createBuildBundle ("gain.soul", gainSource));
+    }
+
+    void runTest() override
+    {
+        beginTest ("Example patches");
+        {
+            for (auto& patch : SOULTests::getExamplePatches())
+            {
+                soul::CompileMessageList messages;
+                auto program = soul::Compiler::build (messages, SOULTests::createBuildBundleForPatch (patch));
+
+                if (! program.isEmpty())
+                    expect (program.clone().toHEART() == program.toHEART(), patch.getFileName());
+            }
+        }
+
+        beginTest ("Modifying a clone leaves the original unchanged");
+        {
+            auto original = build();
+            expect (! original.isEmpty());
+            auto originalHEART = original.toHEART();
+
+            auto clone = original.clone();
+            auto& processor = clone.getMainProcessor();
+            auto& gain = processor.stateVariables.get().front().get();
+            gain.name = clone.getAllocator().get ("renamedGain");
+            gain.initialValue = clone.getAllocator().allocateConstant (soul::Value (0.25f));
+            processor.annotation.set ("changed", true);
+
+            expect (original.toHEART() == originalHEART, "The original was changed");
+            expect (clone.toHEART() != originalHEART, "The clone wasn't changed");
+            expect (! original.getAllocator().identifiers.find ("renamedGain").isValid(),
+                    "A new identifier in the clone appeared in the original");
+        }
+
+        beginTest ("Modifying the original leaves a clone unchanged");
+        {
+            auto original = build();
+            auto clone = original.clone();
+            auto cloneHEART = clone.toHEART();
+
+            auto& gain = original.getMainProcessor().stateVariables.get().front().get();
+            gain.name = original.getAllocator().get ("renamedGain");
+
+            expect (clone.toHEART() == cloneHEART, "The clone was changed");
+            expect (! clone.getAllocator().identifiers.find ("renamedGain").isValid(),
+                    "A new identifier in the original appeared in the clone");
+        }
+
+        beginTest ("A clone outlives its original");
+        {
+            soul::Program clone;
+            std::string originalHEART;
+
+            {
+                auto original = build();
+                originalHEART = original.toHEART();
+                clone = original.clone();
+            }
+
+            expect (clone.toHEART() == originalHEART);
+        }
+    }
+};
+
+static ProgramCloneTests programCloneTests;
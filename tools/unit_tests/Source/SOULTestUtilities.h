@@ -0,0 +1,82 @@
+/*
+     _____ _____ _____ __
+    |   __|     |  |  |  |
+    |__   |  |  |  |  |  |__
+    |_____|_____|_____|_____|
+
+    Copyright (c) 2018 - ROLI Ltd.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace SOULTests
+{
+    /** The root folder of the SOUL repository, which the tests use to find the example
+        patches and the library's test files. This is set by main() before any tests run.
+    */
+    inline juce::File& getRepositoryFolder()
+    {
+        static juce::File folder;
+        return folder;
+    }
+
+    /** Returns all the .soulpatch manifest files in the examples/patches folder. */
+    inline juce::Array<juce::File> getExamplePatches()
+    {
+        auto files = getRepositoryFolder().getChildFile ("examples/patches")
+                        .findChildFiles (juce::File::findFiles, true, "*.soulpatch");
+        files.sort();
+        return files;
+    }
+
+    /** Returns all the .soultest files in the library's test folder. */
+    inline juce::Array<juce::File> getLibraryTestFiles()
+    {
+        auto files = getRepositoryFolder().getChildFile ("source/soul_library/test")
+                        .findChildFiles (juce::File::findFiles, false, "*.soultest");
+        files.sort();
+        return files;
+    }
+
+    inline soul::BuildBundle createBuildBundle (const std::string& filename, const std::string& content)
+    {
+        soul::BuildBundle bundle;
+        bundle.sourceFiles.push_back ({ filename, content });
+        bundle.settings.sampleRate = 44100;
+        bundle.settings.maxBlockSize = 512;
+        return bundle;
+    }
+
+    /** Creates a bundle containing the source files listed in a .soulpatch manifest. */
+    inline soul::BuildBundle createBuildBundleForPatch (const juce::File& manifestFile)
+    {
+        soul::BuildBundle bundle;
+        bundle.settings.sampleRate = 44100;
+        bundle.settings.maxBlockSize = 512;
+
+        auto manifest = choc::json::parse (manifestFile.loadFileAsString().toStdString());
+        auto sources = manifest["soulPatchV1"]["source"];
+
+        auto addSource = [&] (choc::value::ValueView name)
+        {
+            auto file = manifestFile.getSiblingFile (std::string (name.getString()));
+            bundle.sourceFiles.push_back ({ file.getFullPathName().toStdString(), file.loadFileAsString().toStdString() });
+        };
+
+        if (sources.isArray())
+            for (uint32_t i = 0; i < sources.size(); ++i)
+                addSource (sources[i]);
+        else
+            addSource (sources);
+
+        return bundle;
+    }
+
+    /** Builds the example patches with Compiler::buildConcurrently() using each of the given
+        numbers of threads, and prints how many builds per second each one managed. Each run
+        does the same numBuilds builds. Returns false if any of the builds failed.
+    */
+    bool runCompileBenchmark (const std::vector<uint32_t>& threadCounts, uint32_t numBuilds);
+}
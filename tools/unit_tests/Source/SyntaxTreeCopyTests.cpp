@@ -0,0 +1,221 @@
+/*
+     _____ _____ _____ __
+    |   __|     |  |  |  |
+    |__   |  |  |  |  |  |__
+    |_____|_____|_____|_____|
+
+    Copyright (c) 2018 - ROLI Ltd.
+*/
+
+#include "SOULTestUtilities.h"
+
+
+//==============================================================================
+/**
+    Checks that ASTCloner copies every kind of AST object, by comparing programs built
+    with soul::Compiler::buildFromCopiedSyntaxTree() against normal builds.
+*/
+struct SyntaxTreeCopyTests  : public juce::UnitTest
+{
+    SyntaxTreeCopyTests()  : juce::UnitTest ("Syntax tree copying", "SOUL") {}
+
+    // Uses each of the language's constructs at least once
+    static constexpr const char* allObjectTypesSource = R"(
+        namespace utils (using SampleType, int size)
+        {
+            using Frame = SampleType[size];
+
+            struct State
+            {
+                Frame frame;
+                int index;
+            }
+
+            let scale = 0.5f;
+
+            SampleType sum (const Frame& f)
+            {
+                static_assert (Frame.size == size, "wrong size");
+                SampleType total;
+
+                for (wrap<size> i)
+                    total += f[i];
+
+                return total;
+            }
+        }
+
+        namespace floats = utils (float, 4);
+
+        processor Voice (float level = 1.0f)
+        {
+            input stream float in;
+            input event float control[2];
+            output stream float out;
+            output event float levelOut;
+
+            floats::State state;
+            complex32 phase = complex32 (1.0f, 0.0f);
+            bool enabled = true;
+            int64 count;
+
+            event control (int index, float f)   { state.frame[index] = f; enabled = f != 0; }
+
+            float next (float x)
+            {
+                let period = float (processor.period);
+                var result = x * (enabled ? level : -level) + period * 0.0f;
+                result *= floats::scale;
+
+                if (! enabled)
+                    result = 0;
+                else if (result > 1.0f)
+                    result = 1.0f;
+
+                return result + phase.real;
+            }
+
+            void run()
+            {
+                loop
+                {
+                    state.frame[state.index] = next (in);
+                    state.index = (state.index + 1) % 4;
+                    count++;
+                    ++count;
+
+                    if (count > 1000)
+                        continue;
+
+                    int n = 0;
+
+                    while (n < 3)
+                    {
+                        if (n == 2)
+                            break;
+
+                        ++n;
+                    }
+
+                    loop (2)
+                        levelOut << floats::sum (state.frame);
+
+                    out << -state.frame[0];
+                    advance();
+                }
+            }
+        }
+
+        graph Wrapper (processor Inner)
+        {
+            input stream float in;
+            output stream float out;
+
+            let inner = Inner;
+
+            connection
+            {
+                in -> inner.in;
+                inner.out -> out;
+            }
+        }
+
+        graph Main  [[ main ]]
+        {
+            input stream float in;
+            input event float control;
+            output stream float out;
+
+            let
+            {
+                voices = Voice[2];
+                loud = Voice (2.0f);
+                quiet = Wrapper (Voice);
+            }
+
+            connection
+            {
+                in -> voices.in, loud.in;
+                in -> [2] -> quiet.in;
+                control -> voices.control;
+                [linear] voices.out -> out;
+                quiet.out -> out;
+                loud.out -> out;
+            }
+        }
+    )";
+
+    static std::vector<std::string> getAllObjectTypeNames()
+    {
+        std::vector<std::string> names;
+
+        #define SOUL_ADD_OBJECT_TYPE_NAME(Type)  names.push_back (#Type);
+        SOUL_AST_ALL_TYPES (SOUL_ADD_OBJECT_TYPE_NAME)
+        #undef SOUL_ADD_OBJECT_TYPE_NAME
+
+        return names;
+    }
+
+    template <typename BuildFn>
+    static std::string getHEART (const soul::BuildBundle& bundle, BuildFn&& build, std::string& errors)
+    {
+        soul::CompileMessageList messages;
+        auto program = build (messages, bundle);
+        errors = messages.toString();
+        return program.isEmpty() ? std::string() : program.toHEART();
+    }
+
+    void checkCopyMatchesNormalBuild (const soul::BuildBundle& bundle, const std::string& description, bool shouldCompile = true)
+    {
+        std::string errors1, errors2;
+        auto normal = getHEART (bundle, [] (auto& m, auto& b) { return soul::Compiler::build (m, b); }, errors1);
+        auto copied = getHEART (bundle, [] (auto& m, auto& b) { return soul::Compiler::buildFromCopiedSyntaxTree (m, b); }, errors2);
+
+        expect (normal.empty() != shouldCompile, description + ": " + errors1);
+        expect (errors1 == errors2, description + ": " + errors2);
+        expect (normal == copied, description);
+    }
+
+    void runTest() override
+    {
+        auto bundle = SOULTests::createBuildBundle ("all.soul", allObjectTypesSource);
+
+        beginTest ("Every type of object is copied");
+        {
+            soul::CompileProfiler profiler;
+
+            {
+                soul::CompileProfiler::ScopedAttachment attachment (profiler);
+                soul::CompileMessageList messages;
+                auto program = soul::Compiler::buildFromCopiedSyntaxTree (messages, bundle);
+                expect (! program.isEmpty(), messages.toString());
+            }
+
+            std::map<std::string, int64_t> numCopied;
+
+            for (auto& e : profiler.events)
+                if (e.name == "copy parsed syntax tree" || e.name == "copy resolved syntax tree")
+                    for (auto& c : e.counters)
+                        numCopied[c.first] += c.second;
+
+            for (auto& typeName : getAllObjectTypeNames())
+                expect (numCopied[typeName] > 0, "No " + typeName + " objects were copied");
+        }
+
+        beginTest ("Copied and normal builds match");
+        {
+            checkCopyMatchesNormalBuild (bundle, "all.soul");
+
+            for (auto& patch : SOULTests::getExamplePatches())
+                checkCopyMatchesNormalBuild (SOULTests::createBuildBundleForPatch (patch), patch.getFileName().toStdString());
+        }
+
+        beginTest ("Compile errors are unchanged");
+        {
+            checkCopyMatchesNormalBuild (SOULTests::createBuildBundle ("error.soul", "processor P { output stream float out; void run() { out << x; advance(); } }"),
+                                         "error.soul", false);
+        }
+    }
+};
+
+static SyntaxTreeCopyTests syntaxTreeCopyTests;
@@ -0,0 +1,138 @@
+/*
+     _____ _____ _____ __
+    |   __|     |  |  |  |
+    |__   |  |  |  |  |  |__
+    |_____|_____|_____|_____|
+
+    Copyright (c) 2018 - ROLI Ltd.
+*/
+
+#include "SOULTestUtilities.h"
+
+
+//==============================================================================
+/**
+    Parses the library's .soultest files and runs them with soul::TestRunner. There's no
+    performer to use here, so every section gets compiled, but only the compile and error
+    sections can pass, and the others must be reported as skipped.
+*/
+struct TestFileTests  : public juce::UnitTest
+{
+    TestFileTests()  : juce::UnitTest ("SOUL test files", "SOUL") {}
+
+    static bool isKnownSectionType (const std::string& type)
+    {
+        for (auto known : { "global", "compile", "error", "function", "processor", "benchmark" })
+            if (type == known)
+                return true;
+
+        return false;
+    }
+
+    void runTest() override
+    {
+        std::vector<soul::SourceFile> files;
+
+        for (auto& file : SOULTests::getLibraryTestFiles())
+            files.push_back ({ file.getFullPathName().toStdString(), file.loadFileAsString().toStdString() });
+
+        beginTest ("Parsing");
+        {
+            expect (! files.empty());
+
+            for (auto& file : files)
+            {
+                auto sections = soul::TestRunner::parse (file);
+                expect (! sections.empty(), file.filename);
+
+                for (auto& section : sections)
+                {
+                    expect (section.filename == file.filename);
+                    expect (section.line > 0, file.filename);
+
+                    expect (isKnownSectionType (section.type), file.filename + ": unknown section type " + section.type);
+                }
+            }
+        }
+
+        beginTest ("Running without a performer");
+        {
+            auto results = soul::TestRunner::run (files, {});
+            int numCompiled = 0;
+
+            for (auto& r : results)
+            {
+                auto testName = r.filename + ":" + std::to_string (r.line) + " " + r.name;
+
+                if (r.type == "compile" || r.type == "error")
+                {
+                    expect (r.status == soul::TestRunner::Status::passed, testName + ": " + r.message);
+                    ++numCompiled;
+                }
+                else
+                {
+                    expect (r.status == soul::TestRunner::Status::skipped, testName);
+                }
+            }
+
+            expect (numCompiled > 0);
+            expect (soul::TestRunner::allPassed (results));
+        }
+
+        beginTest ("Sections that can't run are still compiled");
+        {
+            soul::SourceFile inlineFile { "inline.soultest",
+                                    "## function\n"
+                                    "\n"
+                                    "bool first()   { return true; }\n"
+                                    "bool second()  { return false; }\n"
+                                    "\n"
+                                    "## function\n"
+                                    "\n"
+                                    "bool broken()  { return x; }\n"
+                                    "\n"
+                                    "## processor\n"
+                                    "\n"
+                                    "processor test { output event int out; void run() { out << y; advance(); } }\n"
+                                    "\n"
+                                    "## benchmark 100\n"
+                                    "\n"
+                                    "processor test { output stream float out; void run() { loop { out << 0.0f; advance(); } } }\n"
+                                    "\n"
+                                    "## benchmark lots\n"
+                                    "\n"
+                                    "processor test { output stream float out; void run() { loop { out << 0.0f; advance(); } } }\n" };
+
+            std::vector<soul::SourceFile> inlineFiles { inlineFile };
+            auto results = soul::TestRunner::run (inlineFiles, {});
+            expectEquals ((int) results.size(), 6);
+
+            if (results.size() == 6)
+            {
+                using Status = soul::TestRunner::Status;
+
+                // Both functions compiled, but there's nothing to call them with
+                expect (results[0].name == "first" && results[0].status == Status::skipped, results[0].message);
+                expect (results[1].name == "second" && results[1].status == Status::skipped, results[1].message);
+
+                expect (results[2].status == Status::failed, results[2].message);
+                expect (results[2].message.find ("'x'") != std::string::npos, results[2].message);
+                expect (results[3].status == Status::failed, results[3].message);
+                expect (results[3].message.find ("'y'") != std::string::npos, results[3].message);
+                expect (results[4].status == Status::skipped, results[4].message);
+                expect (results[5].status == Status::failed, results[5].message);
+                expect (results[5].message.find ("lots") != std::string::npos, results[5].message);
+
+                for (auto& r : results)
+                    expect (r.seconds > 0, r.name);
+
+                // The two functions shared a build, so they get half of its time each
+                expect (results[0].seconds == results[1].seconds);
+            }
+
+            expect (! soul::TestRunner::allPassed (results));
+        }
+    }
+};
+
+static TestFileTests testFileTests;